@@ -0,0 +1,299 @@
+#include "fbx_anim.h"
+#include "fbx_thread_pool.h"
+
+#include <math.h>
+#include <algorithm>
+#include <chrono>
+#include <map>
+
+namespace fbxl {
+
+namespace {
+
+/**
+* Which of translation (0), rotation (1) and scaling (2) a curve node
+* animates, or -1 for any other property.
+*/
+int GetTransformGroup(const AnimCurveNode& pCurveNode)
+{
+	if (!pCurveNode.node)
+		return -1;
+	if (pCurveNode.property == "Lcl Translation")
+		return 0;
+	if (pCurveNode.property == "Lcl Rotation")
+		return 1;
+	if (pCurveNode.property == "Lcl Scaling")
+		return 2;
+	return -1;
+}
+
+/**
+* Value between key pKey and the next one at time pTime, following the
+* interpolation of pKey's attribute entry pAttribute.
+*/
+double Interpolate(const std::vector<int64_t>& pTimes, const std::vector<float>& pValues, const std::vector<int>& pFlags,
+	const std::vector<float>& pData, size_t pKey, int pAttribute, double pTime)
+{
+	const double t0 = (double)pTimes[pKey];
+	const double t1 = (double)pTimes[pKey + 1];
+	const double v0 = pValues[pKey];
+	const double v1 = pValues[pKey + 1];
+	const int flags = pAttribute >= 0 && (size_t)pAttribute < pFlags.size() ?
+		pFlags[pAttribute] : (int)AnimCurve::eInterpolationLinear;
+
+	if (flags & AnimCurve::eInterpolationConstant)
+		return flags & AnimCurve::eConstantNext ? v1 : v0;
+
+	const double u = t1 > t0 ? (pTime - t0) / (t1 - t0) : 0.0;
+	if ((flags & AnimCurve::eInterpolationCubic) && (size_t)pAttribute * 4 + 2 <= pData.size())
+	{
+		// Slopes are stored per second; scale them to the segment.
+		const double seconds = (t1 - t0) / kTimeTicksPerSecond;
+		const double m0 = pData[pAttribute * 4] * seconds;
+		const double m1 = pData[pAttribute * 4 + 1] * seconds;
+		const double u2 = u * u;
+		const double u3 = u2 * u;
+		return (2.0 * u3 - 3.0 * u2 + 1.0) * v0 + (u3 - 2.0 * u2 + u) * m0 + (3.0 * u2 - 2.0 * u3) * v1 + (u3 - u2) * m1;
+	}
+	return v0 + (v1 - v0) * u;
+}
+
+}
+
+void SampleCurve(const AnimCurve& pCurve, double pStart, double pStep, int pCount, float* pOut)
+{
+	std::vector<int64_t> times;
+	std::vector<float> values;
+	pCurve.keyTimes.CopyTo(times);
+	pCurve.keyValues.CopyTo(values);
+	const size_t keyCount = std::min(times.size(), values.size());
+	if (!keyCount)
+	{
+		std::fill(pOut, pOut + pCount, (float)pCurve.defaultValue);
+		return;
+	}
+
+	// Expand the run-length attribute table to one entry index per key.
+	std::vector<int> flags;
+	std::vector<float> data;
+	std::vector<int> refCounts;
+	pCurve.keyFlags.CopyTo(flags);
+	pCurve.keyData.CopyTo(data);
+	pCurve.keyRefCounts.CopyTo(refCounts);
+	std::vector<int> attributes(keyCount, -1);
+	size_t key = 0;
+	for (size_t a = 0; a < refCounts.size() && key < keyCount; a++)
+	{
+		for (int r = 0; r < refCounts[a] && key < keyCount; r++)
+			attributes[key++] = (int)a;
+	}
+
+	// The last key at or before the first sample; every later sample only
+	// moves forward from there.
+	key = std::upper_bound(times.begin(), times.begin() + keyCount, pStart) - times.begin();
+	key = key ? key - 1 : 0;
+	for (int i = 0; i < pCount; i++)
+	{
+		const double time = pStart + i * pStep;
+		while (key + 1 < keyCount && (double)times[key + 1] <= time)
+			key++;
+		double value;
+		if (time <= (double)times[0])
+			value = values[0];
+		else if (key + 1 >= keyCount)
+			value = values[keyCount - 1];
+		else
+			value = Interpolate(times, values, flags, data, key, attributes[key], time);
+		pOut[i] = (float)value;
+	}
+}
+
+void GetAnimStackSpan(const AnimStack& pStack, int64_t& pStart, int64_t& pStop)
+{
+	int64_t first = 0, last = 0;
+	bool found = false;
+	for (size_t l = 0; l < pStack.layers.size(); l++)
+	{
+		const AnimLayer* layer = pStack.layers[l];
+		for (size_t n = 0; n < layer->curveNodes.size(); n++)
+		{
+			for (int c = 0; c < 3; c++)
+			{
+				const AnimCurve* curve = layer->curveNodes[n]->curves[c];
+				if (!curve || !curve->GetKeyCount())
+					continue;
+				int64_t curveFirst = curve->keyTimes.Get<int64_t>(0);
+				int64_t curveLast = curve->keyTimes.Get<int64_t>(curve->GetKeyCount() - 1);
+				if (!found || curveFirst < first)
+					first = curveFirst;
+				if (!found || curveLast > last)
+					last = curveLast;
+				found = true;
+			}
+		}
+	}
+
+	// Some exporters leave a span that misses every key; the keys win then.
+	pStart = pStack.localStart;
+	pStop = pStack.localStop;
+	if (pStop <= pStart || (found && (pStop < first || pStart > last)))
+	{
+		pStart = first;
+		pStop = last;
+	}
+}
+
+void BakeAnimStack(const AnimStack& pStack, double pSampleRate, BakedAnimation& pOut)
+{
+	int64_t start, stop;
+	GetAnimStackSpan(pStack, start, stop);
+	const double seconds = (double)(stop - start) / kTimeTicksPerSecond;
+	const double step = kTimeTicksPerSecond / pSampleRate;
+
+	pOut.name = pStack.name;
+	pOut.startTime = (double)start / kTimeTicksPerSecond;
+	pOut.sampleRate = pSampleRate;
+	pOut.frameCount = (int)floor(seconds * pSampleRate + 1e-6) + 1;
+	pOut.frameStride = (pOut.frameCount + 3) & ~3;
+	pOut.nodes.clear();
+
+	std::map<const Node*, size_t> nodeIndex;
+	for (size_t l = 0; l < pStack.layers.size(); l++)
+	{
+		const AnimLayer* layer = pStack.layers[l];
+		for (size_t n = 0; n < layer->curveNodes.size(); n++)
+		{
+			const AnimCurveNode* curveNode = layer->curveNodes[n];
+			if (GetTransformGroup(*curveNode) >= 0 && !nodeIndex.count(curveNode->node))
+			{
+				nodeIndex[curveNode->node] = pOut.nodes.size();
+				pOut.nodes.push_back(curveNode->node);
+			}
+		}
+	}
+
+	// Streams start out at the nodes' rest transforms.
+	const size_t stride = pOut.frameStride;
+	pOut.samples.assign(pOut.nodes.size() * eAnimChannelCount * stride, 0.0f);
+	for (size_t n = 0; n < pOut.nodes.size(); n++)
+	{
+		const double* rest[3] = { pOut.nodes[n]->translation, pOut.nodes[n]->rotation, pOut.nodes[n]->scaling };
+		for (int channel = 0; channel < eAnimChannelCount; channel++)
+		{
+			float* out = &pOut.samples[(n * eAnimChannelCount + channel) * stride];
+			std::fill(out, out + pOut.frameCount, (float)rest[channel / 3][channel % 3]);
+		}
+	}
+
+	std::vector<float> layerValues(stride);
+	for (size_t l = 0; l < pStack.layers.size(); l++)
+	{
+		const AnimLayer* layer = pStack.layers[l];
+		const float weight = (float)(layer->weight / 100.0);
+		for (size_t n = 0; n < layer->curveNodes.size(); n++)
+		{
+			const AnimCurveNode* curveNode = layer->curveNodes[n];
+			const int group = GetTransformGroup(*curveNode);
+			if (group < 0)
+				continue;
+			for (int c = 0; c < 3; c++)
+			{
+				float* out = &pOut.samples[(nodeIndex[curveNode->node] * eAnimChannelCount + group * 3 + c) * stride];
+				if (curveNode->curves[c])
+					SampleCurve(*curveNode->curves[c], (double)start, step, pOut.frameCount, &layerValues[0]);
+				else
+					std::fill(layerValues.begin(), layerValues.begin() + pOut.frameCount, (float)curveNode->defaults[c]);
+
+				if (l == 0)
+					std::copy(layerValues.begin(), layerValues.begin() + pOut.frameCount, out);
+				else if (layer->blendMode != AnimLayer::eBlendAdditive)
+				{
+					for (int f = 0; f < pOut.frameCount; f++)
+						out[f] += (layerValues[f] - out[f]) * weight;
+				}
+				else if (group == 2)
+				{
+					for (int f = 0; f < pOut.frameCount; f++)
+						out[f] *= 1.0f + (layerValues[f] - 1.0f) * weight;
+				}
+				else
+				{
+					for (int f = 0; f < pOut.frameCount; f++)
+						out[f] += layerValues[f] * weight;
+				}
+			}
+		}
+	}
+}
+
+void DescribeAnimStacks(const Scene& pScene, std::vector<AnimStackInfo>& pOut)
+{
+	pOut.assign(pScene.animStacks.size(), AnimStackInfo());
+	for (size_t i = 0; i < pScene.animStacks.size(); i++)
+	{
+		const AnimStack& stack = pScene.animStacks[i];
+		AnimStackInfo& info = pOut[i];
+		info.stack = &stack;
+		info.localStart = stack.localStart;
+		info.localStop = stack.localStop;
+		GetAnimStackSpan(stack, info.start, info.stop);
+		info.layers.assign(stack.layers.size(), AnimLayerInfo());
+		for (size_t l = 0; l < stack.layers.size(); l++)
+		{
+			const AnimLayer* layer = stack.layers[l];
+			AnimLayerInfo& layerInfo = info.layers[l];
+			layerInfo.layer = layer;
+			layerInfo.curveNodeCount = layer->curveNodes.size();
+			for (size_t n = 0; n < layer->curveNodes.size(); n++)
+			{
+				for (int c = 0; c < 3; c++)
+				{
+					const AnimCurve* curve = layer->curveNodes[n]->curves[c];
+					if (!curve)
+						continue;
+					layerInfo.curveCount++;
+					const size_t keyCount = curve->GetKeyCount();
+					if (!keyCount)
+						continue;
+					int64_t first = curve->keyTimes.Get<int64_t>(0);
+					int64_t last = curve->keyTimes.Get<int64_t>(keyCount - 1);
+					if (!layerInfo.keyCount || first < layerInfo.firstKey)
+						layerInfo.firstKey = first;
+					if (!layerInfo.keyCount || last > layerInfo.lastKey)
+						layerInfo.lastKey = last;
+					layerInfo.keyCount += keyCount;
+				}
+			}
+			info.curveNodeCount += layerInfo.curveNodeCount;
+			info.curveCount += layerInfo.curveCount;
+			info.keyCount += layerInfo.keyCount;
+		}
+	}
+}
+
+AnimBakeStats BakeAnimStacks(const Scene& pScene, double pSampleRate, ThreadPool& pPool, std::vector<BakedAnimation>& pOut)
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	const size_t stackCount = pScene.animStacks.size();
+	pOut.assign(stackCount, BakedAnimation());
+	std::vector<double> seconds(stackCount, 0.0);
+	pPool.ParallelFor(stackCount, [&](size_t i) {
+		std::chrono::steady_clock::time_point stackStart = std::chrono::steady_clock::now();
+		BakeAnimStack(pScene.animStacks[i], pSampleRate, pOut[i]);
+		seconds[i] = std::chrono::duration<double>(std::chrono::steady_clock::now() - stackStart).count();
+	});
+
+	AnimBakeStats stats = AnimBakeStats();
+	stats.stackCount = stackCount;
+	stats.threadCount = pPool.GetThreadCount();
+	for (size_t i = 0; i < stackCount; i++)
+	{
+		stats.frameCount += pOut[i].frameCount;
+		stats.bytes += pOut[i].samples.size() * sizeof(float);
+		stats.longestSeconds = std::max(stats.longestSeconds, seconds[i]);
+	}
+	stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	return stats;
+}
+
+}
@@ -0,0 +1,144 @@
+#ifndef FBX_ANIM_H
+#define FBX_ANIM_H
+
+#include "fbx_scene.h"
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace fbxl {
+
+class ThreadPool;
+
+/**
+* Streams of a baked node, in storage order: translation, Euler rotation in
+* degrees, scaling.
+*/
+enum EAnimChannel
+{
+	eTranslationX,
+	eTranslationY,
+	eTranslationZ,
+	eRotationX,
+	eRotationY,
+	eRotationZ,
+	eScalingX,
+	eScalingY,
+	eScalingZ,
+	eAnimChannelCount
+};
+
+/**
+* An animation stack sampled at a fixed rate. Every node the stack animates
+* gets eAnimChannelCount streams of frameCount floats, frame f of a stream
+* being its local value at startTime + f / sampleRate. Streams are
+* frameStride floats apart, a multiple of four, so each starts 16-byte
+* aligned relative to the buffer and can be processed four frames at a
+* time.
+*/
+struct BakedAnimation
+{
+	std::string name;
+	double startTime;
+	double sampleRate;
+	int frameCount;
+	int frameStride;
+	std::vector<const Node*> nodes;
+	std::vector<float> samples;
+
+	BakedAnimation() : startTime(0.0), sampleRate(0.0), frameCount(0), frameStride(0) {}
+
+	double GetDuration() const { return frameCount > 1 ? (frameCount - 1) / sampleRate : 0.0; }
+
+	const float* GetStream(size_t pNode, int pChannel) const
+	{
+		return &samples[(pNode * eAnimChannelCount + pChannel) * frameStride];
+	}
+};
+
+/**
+* What one layer of a stack holds. firstKey/lastKey are in KTime ticks and
+* only meaningful when keyCount is not 0.
+*/
+struct AnimLayerInfo
+{
+	const AnimLayer* layer;
+	size_t curveNodeCount;
+	size_t curveCount;
+	size_t keyCount;
+	int64_t firstKey;
+	int64_t lastKey;
+};
+
+/**
+* What one stack holds: the span it plays (see GetAnimStackSpan), the take
+* span stored in the file, and its layers with their totals summed.
+*/
+struct AnimStackInfo
+{
+	const AnimStack* stack;
+	int64_t start;
+	int64_t stop;
+	int64_t localStart;
+	int64_t localStop;
+	size_t curveNodeCount;
+	size_t curveCount;
+	size_t keyCount;
+	std::vector<AnimLayerInfo> layers;
+};
+
+/**
+* What BakeAnimStacks did. longestSeconds is the time of the slowest stack,
+* which bounds seconds when there are enough threads.
+*/
+struct AnimBakeStats
+{
+	size_t stackCount;
+	size_t frameCount;
+	size_t bytes;
+	int threadCount;
+	double seconds;
+	double longestSeconds;
+};
+
+/**
+* Sample the curve at pCount times pStart, pStart + pStep, ... (KTime
+* ticks) into pOut. The first key is found by binary search once and
+* later keys by stepping forward, so a whole stream costs O(keys + samples).
+* Constant, linear and cubic (Hermite on the stored slopes) interpolation
+* are supported; tangent weights are not, so weighted keys are treated as
+* if they had the default weight of one third.
+*/
+void SampleCurve(const AnimCurve& pCurve, double pStart, double pStep, int pCount, float* pOut);
+
+/**
+* The span of pStack in KTime ticks: LocalStart to LocalStop when set and
+* overlapping its keys, otherwise the first to the last key of its curves.
+*/
+void GetAnimStackSpan(const AnimStack& pStack, int64_t& pStart, int64_t& pStop);
+
+/**
+* Evaluate the local translation, rotation and scaling of every node
+* pStack animates at pSampleRate frames per second across the stack's span.
+* Channels without a curve keep their default value. Layers after the
+* first are blended in with their weight: override layers replace values,
+* additive layers add translation and rotation and multiply scaling.
+*/
+void BakeAnimStack(const AnimStack& pStack, double pSampleRate, BakedAnimation& pOut);
+
+/**
+* One AnimStackInfo per stack of pScene, in file order.
+*/
+void DescribeAnimStacks(const Scene& pScene, std::vector<AnimStackInfo>& pOut);
+
+/**
+* Bake every stack of pScene into pOut, in file order, one stack per work
+* item on pPool, so a file with many clips takes about as long as its
+* longest one.
+*/
+AnimBakeStats BakeAnimStacks(const Scene& pScene, double pSampleRate, ThreadPool& pPool, std::vector<BakedAnimation>& pOut);
+
+}
+
+#endif
@@ -0,0 +1,360 @@
+#include "fbx_anim_compress.h"
+#include "fbx_thread_pool.h"
+#include "fbx_transform.h"
+
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+
+namespace fbxl {
+
+namespace {
+
+const float kPi = 3.14159265358979f;
+const float kQuaternionRange = 0.70710678f;
+const int kQuaternionSteps = 0x7FFF;
+
+void MultiplyQuaternions(const float* a, const float* b, float* pOut)
+{
+	float x = a[3] * b[0] + a[0] * b[3] + a[1] * b[2] - a[2] * b[1];
+	float y = a[3] * b[1] - a[0] * b[2] + a[1] * b[3] + a[2] * b[0];
+	float z = a[3] * b[2] + a[0] * b[1] - a[1] * b[0] + a[2] * b[3];
+	float w = a[3] * b[3] - a[0] * b[0] - a[1] * b[1] - a[2] * b[2];
+	pOut[0] = x;
+	pOut[1] = y;
+	pOut[2] = z;
+	pOut[3] = w;
+}
+
+float Dot4(const float* a, const float* b)
+{
+	return a[0] * b[0] + a[1] * b[1] + a[2] * b[2] + a[3] * b[3];
+}
+
+/**
+* Normalized lerp along the shorter arc.
+*/
+void Nlerp(const float* a, const float* b, float pT, float* pOut)
+{
+	float sign = Dot4(a, b) < 0.0f ? -1.0f : 1.0f;
+	float length = 0.0f;
+	for (int i = 0; i < 4; i++)
+	{
+		pOut[i] = a[i] + (b[i] * sign - a[i]) * pT;
+		length += pOut[i] * pOut[i];
+	}
+	float scale = length > 0.0f ? 1.0f / sqrtf(length) : 0.0f;
+	for (int i = 0; i < 4; i++)
+		pOut[i] *= scale;
+}
+
+/**
+* Distance between two unit quaternions on the same hemisphere. A dot
+* product this close to one has too few float bits left to tell angles of
+* a few hundredths of a degree apart; the chord keeps them.
+*/
+double GetChord(const float* a, const float* b)
+{
+	double sign = Dot4(a, b) < 0.0f ? -1.0 : 1.0;
+	double sum = 0.0;
+	for (int i = 0; i < 4; i++)
+	{
+		double difference = a[i] - sign * b[i];
+		sum += difference * difference;
+	}
+	return sqrt(sum);
+}
+
+/**
+* Angle in degrees between the rotations of two unit quaternions.
+*/
+float AngleBetween(const float* a, const float* b)
+{
+	return (float)(4.0 * asin(std::min(1.0, GetChord(a, b) * 0.5)) * 180.0 / kPi);
+}
+
+/**
+* Greedy key reduction over pCount frames: from each kept frame, reach as
+* far as pFits(start, end) allows, keep that frame and go on from it.
+*/
+template <typename Fits>
+void ReduceFrames(int pCount, Fits pFits, std::vector<uint32_t>& pFrames)
+{
+	pFrames.clear();
+	pFrames.push_back(0);
+	int start = 0;
+	while (start < pCount - 1)
+	{
+		int end = start + 1;
+		while (end + 1 < pCount && pFits(start, end + 1))
+			end++;
+		pFrames.push_back(end);
+		start = end;
+	}
+}
+
+void CompressChannel(const float* pValues, int pCount, float pTolerance, CompressedChannel& pOut)
+{
+	bool constant = true;
+	for (int i = 1; i < pCount && constant; i++)
+		constant = fabsf(pValues[i] - pValues[0]) <= pTolerance;
+	if (constant)
+		pOut.frames.assign(1, 0);
+	else
+	{
+		ReduceFrames(pCount, [&](int a, int b) {
+			for (int i = a + 1; i < b; i++)
+			{
+				float value = pValues[a] + (pValues[b] - pValues[a]) * (float)(i - a) / (float)(b - a);
+				if (fabsf(value - pValues[i]) > pTolerance)
+					return false;
+			}
+			return true;
+		}, pOut.frames);
+	}
+	pOut.values.resize(pOut.frames.size());
+	for (size_t k = 0; k < pOut.frames.size(); k++)
+		pOut.values[k] = pValues[pOut.frames[k]];
+}
+
+/**
+* pRotations holds pCount quaternions; keys are chosen so the quantized
+* ones interpolate to within pTolerance degrees of them.
+*/
+void CompressRotation(const std::vector<float>& pRotations, int pCount, float pTolerance, CompressedRotation& pOut)
+{
+	std::vector<uint16_t> packed((size_t)pCount * 3);
+	std::vector<float> decoded((size_t)pCount * 4);
+	for (int f = 0; f < pCount; f++)
+	{
+		PackQuaternion(&pRotations[f * 4], &packed[f * 3]);
+		UnpackQuaternion(&packed[f * 3], &decoded[f * 4]);
+	}
+
+	const double maxChord = 2.0 * sin(pTolerance * kPi / 720.0);
+	bool constant = true;
+	for (int f = 0; f < pCount && constant; f++)
+		constant = GetChord(&decoded[0], &pRotations[f * 4]) <= maxChord;
+	if (constant)
+		pOut.frames.assign(1, 0);
+	else
+	{
+		ReduceFrames(pCount, [&](int a, int b) {
+			float rotation[4];
+			for (int i = a + 1; i < b; i++)
+			{
+				Nlerp(&decoded[a * 4], &decoded[b * 4], (float)(i - a) / (float)(b - a), rotation);
+				if (GetChord(rotation, &pRotations[i * 4]) > maxChord)
+					return false;
+			}
+			return true;
+		}, pOut.frames);
+	}
+	pOut.packed.resize(pOut.frames.size() * 3);
+	for (size_t k = 0; k < pOut.frames.size(); k++)
+	{
+		for (int w = 0; w < 3; w++)
+			pOut.packed[k * 3 + w] = packed[pOut.frames[k] * 3 + w];
+	}
+}
+
+/**
+* Index of the last key at or before pFrame and the blend towards the next.
+*/
+size_t FindKey(const std::vector<uint32_t>& pFrames, int pFrame, float& pT)
+{
+	size_t key = std::upper_bound(pFrames.begin(), pFrames.end(), (uint32_t)pFrame) - pFrames.begin();
+	key = key ? key - 1 : 0;
+	pT = key + 1 < pFrames.size() ? (float)(pFrame - (int)pFrames[key]) / (float)(pFrames[key + 1] - pFrames[key]) : 0.0f;
+	return key;
+}
+
+float EvaluateChannel(const CompressedChannel& pChannel, int pFrame)
+{
+	float t;
+	size_t key = FindKey(pChannel.frames, pFrame, t);
+	if (key + 1 >= pChannel.values.size())
+		return pChannel.values[key];
+	return pChannel.values[key] + (pChannel.values[key + 1] - pChannel.values[key]) * t;
+}
+
+}
+
+void PackQuaternion(const float* pRotation, uint16_t* pPacked)
+{
+	int largest = 0;
+	for (int i = 1; i < 4; i++)
+	{
+		if (fabsf(pRotation[i]) > fabsf(pRotation[largest]))
+			largest = i;
+	}
+	// q and -q are the same rotation; pick the one whose largest is positive.
+	const float sign = pRotation[largest] < 0.0f ? -1.0f : 1.0f;
+	uint64_t bits = (uint64_t)largest;
+	for (int i = 0; i < 4; i++)
+	{
+		if (i == largest)
+			continue;
+		float value = std::max(-kQuaternionRange, std::min(kQuaternionRange, pRotation[i] * sign));
+		int step = (int)floorf((value + kQuaternionRange) / (2.0f * kQuaternionRange) * kQuaternionSteps + 0.5f);
+		bits = (bits << 15) | (uint64_t)step;
+	}
+	bits <<= 1;
+	pPacked[0] = (uint16_t)(bits >> 32);
+	pPacked[1] = (uint16_t)(bits >> 16);
+	pPacked[2] = (uint16_t)bits;
+}
+
+void UnpackQuaternion(const uint16_t* pPacked, float* pRotation)
+{
+	uint64_t bits = ((uint64_t)pPacked[0] << 32) | ((uint64_t)pPacked[1] << 16) | pPacked[2];
+	bits >>= 1;
+	float values[3];
+	for (int k = 2; k >= 0; k--)
+	{
+		values[k] = (float)(bits & kQuaternionSteps) / kQuaternionSteps * (2.0f * kQuaternionRange) - kQuaternionRange;
+		bits >>= 15;
+	}
+	const int largest = (int)(bits & 3);
+	float sum = 0.0f;
+	for (int i = 0, k = 0; i < 4; i++)
+	{
+		if (i == largest)
+			continue;
+		pRotation[i] = values[k++];
+		sum += pRotation[i] * pRotation[i];
+	}
+	pRotation[largest] = sqrtf(std::max(0.0f, 1.0f - sum));
+}
+
+void EulerToQuaternion(const float* pDegrees, int pRotationOrder, float* pRotation)
+{
+	float axes[3][4];
+	for (int a = 0; a < 3; a++)
+	{
+		float half = pDegrees[a] * (kPi / 360.0f);
+		axes[a][0] = axes[a][1] = axes[a][2] = 0.0f;
+		axes[a][a] = sinf(half);
+		axes[a][3] = cosf(half);
+	}
+	// The first axis applied is the rightmost factor.
+	const int* order = kRotationOrderAxes[pRotationOrder >= 0 && pRotationOrder < 7 ? pRotationOrder : 0];
+	float last[4];
+	MultiplyQuaternions(axes[order[2]], axes[order[1]], last);
+	MultiplyQuaternions(last, axes[order[0]], pRotation);
+}
+
+size_t CompressedAnimation::GetByteSize() const
+{
+	const size_t frameSize = frameCount <= 0x10000 ? 2 : 4;
+	size_t bytes = 0;
+	for (size_t n = 0; n < tracks.size(); n++)
+	{
+		const CompressedNode& track = tracks[n];
+		for (int c = 0; c < 3; c++)
+		{
+			bytes += track.translation[c].frames.size() * (frameSize + sizeof(float));
+			bytes += track.scaling[c].frames.size() * (frameSize + sizeof(float));
+		}
+		bytes += track.rotation.frames.size() * (frameSize + 3 * sizeof(uint16_t));
+	}
+	return bytes;
+}
+
+void CompressedAnimation::Evaluate(size_t pNode, int pFrame, float* pTranslation, float* pRotation, float* pScaling) const
+{
+	const CompressedNode& track = tracks[pNode];
+	for (int c = 0; c < 3; c++)
+	{
+		pTranslation[c] = EvaluateChannel(track.translation[c], pFrame);
+		pScaling[c] = EvaluateChannel(track.scaling[c], pFrame);
+	}
+
+	float t;
+	size_t key = FindKey(track.rotation.frames, pFrame, t);
+	UnpackQuaternion(&track.rotation.packed[key * 3], pRotation);
+	if (key + 1 < track.rotation.frames.size())
+	{
+		float a[4], b[4];
+		memcpy(a, pRotation, sizeof(a));
+		UnpackQuaternion(&track.rotation.packed[(key + 1) * 3], b);
+		Nlerp(a, b, t, pRotation);
+	}
+}
+
+CompressionReport CompressAnimation(const BakedAnimation& pAnimation, const CompressionTolerances& pTolerances,
+	ThreadPool& pPool, CompressedAnimation& pOut)
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	const int frameCount = pAnimation.frameCount;
+	const size_t nodeCount = pAnimation.nodes.size();
+
+	pOut.name = pAnimation.name;
+	pOut.startTime = pAnimation.startTime;
+	pOut.sampleRate = pAnimation.sampleRate;
+	pOut.frameCount = frameCount;
+	pOut.nodes = pAnimation.nodes;
+	pOut.tracks.assign(nodeCount, CompressedNode());
+
+	// Per node: largest translation, rotation and scaling error.
+	std::vector<float> errors(nodeCount * 3, 0.0f);
+	pPool.ParallelFor(nodeCount, [&](size_t n) {
+		CompressedNode& track = pOut.tracks[n];
+		for (int c = 0; c < 3; c++)
+		{
+			CompressChannel(pAnimation.GetStream(n, eTranslationX + c), frameCount, pTolerances.translation, track.translation[c]);
+			CompressChannel(pAnimation.GetStream(n, eScalingX + c), frameCount, pTolerances.scaling, track.scaling[c]);
+		}
+
+		// Quaternions kept on one hemisphere from frame to frame, so
+		// neighbouring keys interpolate the short way.
+		std::vector<float> rotations((size_t)frameCount * 4);
+		const int rotationOrder = pAnimation.nodes[n]->rotationOrder;
+		for (int f = 0; f < frameCount; f++)
+		{
+			float degrees[3];
+			for (int c = 0; c < 3; c++)
+				degrees[c] = pAnimation.GetStream(n, eRotationX + c)[f];
+			float* rotation = &rotations[f * 4];
+			EulerToQuaternion(degrees, rotationOrder, rotation);
+			if (f && Dot4(rotation, rotation - 4) < 0.0f)
+			{
+				for (int i = 0; i < 4; i++)
+					rotation[i] = -rotation[i];
+			}
+		}
+		CompressRotation(rotations, frameCount, pTolerances.rotation, track.rotation);
+
+		for (int f = 0; f < frameCount; f++)
+		{
+			float translation[3], rotation[4], scaling[3];
+			pOut.Evaluate(n, f, translation, rotation, scaling);
+			for (int c = 0; c < 3; c++)
+			{
+				errors[n * 3] = std::max(errors[n * 3], fabsf(translation[c] - pAnimation.GetStream(n, eTranslationX + c)[f]));
+				errors[n * 3 + 2] = std::max(errors[n * 3 + 2], fabsf(scaling[c] - pAnimation.GetStream(n, eScalingX + c)[f]));
+			}
+			errors[n * 3 + 1] = std::max(errors[n * 3 + 1], AngleBetween(rotation, &rotations[f * 4]));
+		}
+	});
+
+	CompressionReport report = CompressionReport();
+	report.rawBytes = nodeCount * eAnimChannelCount * frameCount * sizeof(float);
+	report.compressedBytes = pOut.GetByteSize();
+	report.rawKeys = nodeCount * 7 * frameCount;
+	for (size_t n = 0; n < nodeCount; n++)
+	{
+		const CompressedNode& track = pOut.tracks[n];
+		for (int c = 0; c < 3; c++)
+			report.keptKeys += track.translation[c].frames.size() + track.scaling[c].frames.size();
+		report.keptKeys += track.rotation.frames.size();
+		report.maxTranslationError = std::max(report.maxTranslationError, errors[n * 3]);
+		report.maxRotationError = std::max(report.maxRotationError, errors[n * 3 + 1]);
+		report.maxScalingError = std::max(report.maxScalingError, errors[n * 3 + 2]);
+	}
+	report.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	return report;
+}
+
+}
@@ -0,0 +1,130 @@
+#ifndef FBX_ANIM_COMPRESS_H
+#define FBX_ANIM_COMPRESS_H
+
+#include "fbx_anim.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace fbxl {
+
+class ThreadPool;
+
+/**
+* How far a compressed animation may stray from the baked one: translation
+* and scaling in their own units, rotation as an angle in degrees.
+*/
+struct CompressionTolerances
+{
+	float translation;
+	float rotation;
+	float scaling;
+
+	CompressionTolerances() : translation(0.01f), rotation(0.05f), scaling(0.001f) {}
+};
+
+/**
+* The frames kept of one scalar stream and their values; frames between two
+* kept ones are linearly interpolated, and a single key holds for the whole
+* clip.
+*/
+struct CompressedChannel
+{
+	std::vector<uint32_t> frames;
+	std::vector<float> values;
+};
+
+/**
+* The frames kept of a rotation stream, each as a 48-bit smallest-three
+* quaternion in three 16-bit words: the index of the largest component in
+* the top two bits, then the other three in 15 bits each, scaled from
+* [-1/sqrt(2), 1/sqrt(2)]. Frames in between are normalized-lerped.
+*/
+struct CompressedRotation
+{
+	std::vector<uint32_t> frames;
+	std::vector<uint16_t> packed;
+};
+
+struct CompressedNode
+{
+	CompressedChannel translation[3];
+	CompressedRotation rotation;
+	CompressedChannel scaling[3];
+};
+
+/**
+* A BakedAnimation after key reduction, one CompressedNode per node.
+*/
+struct CompressedAnimation
+{
+	std::string name;
+	double startTime;
+	double sampleRate;
+	int frameCount;
+	std::vector<const Node*> nodes;
+	std::vector<CompressedNode> tracks;
+
+	CompressedAnimation() : startTime(0.0), sampleRate(0.0), frameCount(0) {}
+
+	/**
+	* Bytes the keys take stored tightly: frame numbers as 16-bit values when
+	* the clip has at most 65536 frames, 32-bit otherwise.
+	*/
+	size_t GetByteSize() const;
+
+	/**
+	* Local transform of node pNode at frame pFrame: translation, rotation
+	* as a quaternion (x, y, z, w) and scaling.
+	*/
+	void Evaluate(size_t pNode, int pFrame, float* pTranslation, float* pRotation, float* pScaling) const;
+};
+
+/**
+* What compression achieved. Errors are measured over every frame of the
+* decompressed animation against the baked one.
+*/
+struct CompressionReport
+{
+	size_t rawBytes;
+	size_t compressedBytes;
+	size_t rawKeys;
+	size_t keptKeys;
+	float maxTranslationError;
+	float maxRotationError;
+	float maxScalingError;
+	double seconds;
+
+	double GetRatio() const { return compressedBytes ? (double)rawBytes / compressedBytes : 0.0; }
+};
+
+/**
+* Pack the unit quaternion pRotation (x, y, z, w) into three words, and
+* back.
+*/
+void PackQuaternion(const float* pRotation, uint16_t* pPacked);
+void UnpackQuaternion(const uint16_t* pPacked, float* pRotation);
+
+/**
+* Quaternion (x, y, z, w) of FBX Euler angles in degrees, applied in
+* pRotationOrder (an EFbxRotationOrder, see kRotationOrderAxes): for the
+* default eEulerXYZ, X first, then Y, then Z.
+*/
+void EulerToQuaternion(const float* pDegrees, int pRotationOrder, float* pRotation);
+
+/**
+* Drop every key of pAnimation that interpolating its neighbours reproduces
+* within pTolerances, quantize rotations to 48 bits, and measure the result.
+* Rotations become quaternions in each node's own rotation order.
+* Nodes are compressed in parallel on pPool. Rotation keys are chosen
+* against the quantized values, so the rotation tolerance holds unless it
+* is tighter than the quantization step (about 0.003 degrees).
+*/
+CompressionReport CompressAnimation(const BakedAnimation& pAnimation, const CompressionTolerances& pTolerances,
+	ThreadPool& pPool, CompressedAnimation& pOut);
+
+}
+
+#endif
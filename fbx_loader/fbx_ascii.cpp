@@ -0,0 +1,351 @@
+#include "fbx_reader.h"
+
+#include <ctype.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace fbxl {
+
+namespace {
+
+/**
+* Cursor over the ASCII text. The grammar is small: a record is
+* "Name: value, value, ... { children }", values are numbers, quoted
+* strings, bare words or "*N { a: ... }" arrays, and ';' starts a comment.
+*/
+struct AsciiCursor
+{
+	const char* p;
+	const char* end;
+	const char* begin;
+
+	void SkipSpace()
+	{
+		while (p < end)
+		{
+			if (*p == ';')
+			{
+				while (p < end && *p != '\n')
+					++p;
+			}
+			else if (isspace((unsigned char)*p))
+				++p;
+			else
+				break;
+		}
+	}
+
+	bool AtName() const
+	{
+		const char* q = p;
+		if (q >= end || !(isalpha((unsigned char)*q) || *q == '_'))
+			return false;
+		while (q < end && (isalnum((unsigned char)*q) || *q == '_' || *q == '|' || *q == '-'))
+			++q;
+		return q < end && *q == ':';
+	}
+
+	StringRef ReadName()
+	{
+		const char* start = p;
+		while (*p != ':')
+			++p;
+		StringRef name(start, p - start);
+		++p;
+		return name;
+	}
+
+	unsigned long Offset() const { return (unsigned long)(p - begin); }
+};
+
+/**
+* Decodes base64 fed in pieces of any length, skipping characters outside
+* the alphabet and stopping at the first '='.
+*/
+struct Base64Decoder
+{
+	unsigned char* out;
+	uint32_t bits;
+	int bitCount;
+	bool done;
+
+	explicit Base64Decoder(unsigned char* pOut) : out(pOut), bits(0), bitCount(0), done(false) {}
+
+	void Feed(const unsigned char* pText, size_t pSize)
+	{
+		for (size_t i = 0; i < pSize && !done; i++)
+		{
+			const unsigned char c = pText[i];
+			int value;
+			if (c >= 'A' && c <= 'Z') value = c - 'A';
+			else if (c >= 'a' && c <= 'z') value = c - 'a' + 26;
+			else if (c >= '0' && c <= '9') value = c - '0' + 52;
+			else if (c == '+') value = 62;
+			else if (c == '/') value = 63;
+			else
+			{
+				done = c == '=';
+				continue;
+			}
+			bits = (bits << 6) | (uint32_t)value;
+			bitCount += 6;
+			if (bitCount >= 8)
+			{
+				bitCount -= 8;
+				*out++ = (unsigned char)(bits >> bitCount);
+			}
+		}
+	}
+};
+
+bool IsNumberStart(char c)
+{
+	return isdigit((unsigned char)c) || c == '-' || c == '+' || c == '.';
+}
+
+/**
+* Parse one number token, reporting whether it was written as an integer.
+*/
+const char* ReadNumber(const char* p, const char* end, double& pValue, int64_t& pInt, bool& pIsInt)
+{
+	const char* start = p;
+	pIsInt = true;
+	if (p < end && (*p == '-' || *p == '+'))
+		++p;
+	while (p < end && (isalnum((unsigned char)*p) || *p == '.' || *p == '#' ||
+		((*p == '-' || *p == '+') && (p[-1] == 'e' || p[-1] == 'E'))))
+	{
+		if (!isdigit((unsigned char)*p))
+			pIsInt = false;
+		++p;
+	}
+
+	std::string text(start, p - start);
+	if (pIsInt)
+	{
+		pInt = strtoll(text.c_str(), NULL, 10);
+		pValue = (double)pInt;
+	}
+	else
+	{
+		pValue = strtod(text.c_str(), NULL);
+		pInt = (int64_t)pValue;
+	}
+	return p;
+}
+
+}
+
+bool Document::ParseAscii()
+{
+	AsciiCursor cur;
+	cur.begin = cur.p = (const char*)mFile.GetData();
+	cur.end = cur.p + mFile.GetSize();
+
+	std::vector<Record*> stack;
+	stack.push_back(&mRoot);
+
+	for (;;)
+	{
+		cur.SkipSpace();
+		if (cur.p >= cur.end)
+			break;
+
+		if (*cur.p == '}')
+		{
+			if (stack.size() == 1)
+				return Fail("unbalanced '}' at offset %lu", cur.Offset());
+			stack.pop_back();
+			++cur.p;
+			continue;
+		}
+
+		if (!cur.AtName())
+			return Fail("expected a record name at offset %lu", cur.Offset());
+
+		Record* parent = stack.back();
+		parent->children.push_back(Record());
+		Record& record = parent->children.back();
+		record.name = cur.ReadName();
+
+		// Values follow the name and are separated by commas.
+		cur.SkipSpace();
+		bool expectValue = cur.p < cur.end && *cur.p != '{' && *cur.p != '}' && !cur.AtName();
+		while (expectValue)
+		{
+			if (cur.p >= cur.end)
+				return Fail("expected a value at offset %lu", cur.Offset());
+			Property prop;
+			prop.encoding = 0;
+			prop.arrayCount = 0;
+
+			if (*cur.p == '"')
+			{
+				const char* start = ++cur.p;
+				while (cur.p < cur.end && *cur.p != '"')
+					++cur.p;
+				if (cur.p >= cur.end)
+					return Fail("unterminated string at offset %lu", (unsigned long)(start - cur.begin));
+				size_t len = cur.p - start;
+				unsigned char* dst = AllocateOwned(len + 1);
+				memcpy(dst, start, len);
+				prop.type = 'S';
+				prop.size = (uint32_t)len;
+				prop.data = dst;
+				++cur.p;
+			}
+			else if (*cur.p == '*')
+			{
+				++cur.p;
+				double countValue;
+				int64_t count;
+				bool isInt;
+				cur.p = ReadNumber(cur.p, cur.end, countValue, count, isInt);
+				cur.SkipSpace();
+				if (cur.p >= cur.end || *cur.p != '{')
+					return Fail("expected array body at offset %lu", cur.Offset());
+				++cur.p;
+				cur.SkipSpace();
+				if (cur.AtName())
+				{
+					cur.ReadName();
+					cur.SkipSpace();
+				}
+
+				std::vector<double> values;
+				std::vector<int64_t> ints;
+				bool allInt = true;
+				values.reserve((size_t)(count > 0 ? count : 0));
+				ints.reserve(values.capacity());
+				while (cur.p < cur.end && *cur.p != '}')
+				{
+					if (*cur.p == ',')
+					{
+						++cur.p;
+						cur.SkipSpace();
+						continue;
+					}
+					if (!IsNumberStart(*cur.p))
+						return Fail("bad array element at offset %lu", cur.Offset());
+					double value;
+					int64_t intValue;
+					cur.p = ReadNumber(cur.p, cur.end, value, intValue, isInt);
+					allInt = allInt && isInt;
+					values.push_back(value);
+					ints.push_back(intValue);
+					cur.SkipSpace();
+				}
+				if (cur.p >= cur.end)
+					return Fail("unterminated array in '%s'", record.name.Str().c_str());
+				++cur.p;
+
+				bool fitsInt32 = allInt;
+				for (size_t i = 0; fitsInt32 && i < ints.size(); i++)
+					fitsInt32 = ints[i] >= INT_MIN && ints[i] <= INT_MAX;
+
+				prop.type = fitsInt32 ? 'i' : (allInt ? 'l' : 'd');
+				prop.arrayCount = (uint32_t)values.size();
+				prop.size = prop.arrayCount * (fitsInt32 ? 4 : 8);
+				unsigned char* dst = AllocateOwned(prop.size ? prop.size : 1);
+				for (size_t i = 0; i < values.size(); i++)
+				{
+					if (fitsInt32)
+					{
+						int32_t v = (int32_t)ints[i];
+						memcpy(dst + i * 4, &v, 4);
+					}
+					else if (allInt)
+						memcpy(dst + i * 8, &ints[i], 8);
+					else
+						memcpy(dst + i * 8, &values[i], 8);
+				}
+				prop.data = dst;
+			}
+			else if (IsNumberStart(*cur.p))
+			{
+				double value;
+				int64_t intValue;
+				bool isInt;
+				cur.p = ReadNumber(cur.p, cur.end, value, intValue, isInt);
+				prop.type = isInt ? 'L' : 'D';
+				prop.size = 8;
+				unsigned char* dst = AllocateOwned(8);
+				if (isInt)
+					memcpy(dst, &intValue, 8);
+				else
+					memcpy(dst, &value, 8);
+				prop.data = dst;
+			}
+			else
+			{
+				// Bare words such as "Shading: T" are kept as strings.
+				const char* start = cur.p;
+				while (cur.p < cur.end && !isspace((unsigned char)*cur.p) && *cur.p != ',' && *cur.p != '{' && *cur.p != '}')
+					++cur.p;
+				// An empty value, as in "Content: , ...", is kept as an empty
+				// string.
+				if (cur.p == start && *cur.p != ',')
+					return Fail("unexpected character at offset %lu", cur.Offset());
+				size_t len = cur.p - start;
+				unsigned char* dst = AllocateOwned(len + 1);
+				memcpy(dst, start, len);
+				prop.type = 'S';
+				prop.size = (uint32_t)len;
+				prop.data = dst;
+			}
+			record.properties.push_back(prop);
+
+			cur.SkipSpace();
+			expectValue = cur.p < cur.end && *cur.p == ',';
+			if (expectValue)
+			{
+				++cur.p;
+				cur.SkipSpace();
+				if (cur.p >= cur.end)
+					return Fail("expected a value at offset %lu", cur.Offset());
+			}
+		}
+
+		// Embedded files (Video Content) are base64 split over several
+		// strings; decode them into the one raw value binary files store.
+		size_t textSize = 0;
+		bool base64 = record.name == "Content" && !record.properties.empty();
+		for (size_t i = 0; base64 && i < record.properties.size(); i++)
+		{
+			base64 = record.properties[i].type == 'S';
+			textSize += record.properties[i].size;
+		}
+		if (base64)
+		{
+			Property raw;
+			raw.type = 'R';
+			raw.encoding = 0;
+			raw.arrayCount = 0;
+			unsigned char* dst = AllocateOwned(textSize / 4 * 3 + 3);
+			Base64Decoder decoder(dst);
+			for (size_t i = 0; i < record.properties.size(); i++)
+				decoder.Feed(record.properties[i].data, record.properties[i].size);
+			raw.size = (uint32_t)(decoder.out - dst);
+			raw.data = dst;
+			record.properties.assign(1, raw);
+		}
+
+		if (cur.p < cur.end && *cur.p == '{')
+		{
+			++cur.p;
+			stack.push_back(&record);
+		}
+	}
+
+	if (stack.size() != 1)
+		return Fail("unexpected end of file inside '%s'", stack.back()->name.Str().c_str());
+
+	const Record* header = mRoot.Find("FBXHeaderExtension");
+	const Record* version = header ? header->Find("FBXVersion") : NULL;
+	mVersion = version && !version->properties.empty() ? (int)version->properties[0].AsInt() : 0;
+	return true;
+}
+
+}
@@ -0,0 +1,518 @@
+#include "fbx_baked.h"
+#include "fbx_convert.h"
+#include "fbx_material.h"
+#include "fbx_media.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <map>
+
+namespace fbxl {
+
+static_assert(sizeof(BakedHeader) % 16 == 0, "BakedHeader must keep 16-byte alignment");
+static_assert(sizeof(BakedNode) % 16 == 0, "BakedNode must keep 16-byte alignment");
+static_assert(sizeof(BakedMesh) % 16 == 0, "BakedMesh must keep 16-byte alignment");
+static_assert(sizeof(BakedLod) % 16 == 0, "BakedLod must keep 16-byte alignment");
+static_assert(sizeof(BakedMaterial) % 16 == 0, "BakedMaterial must keep 16-byte alignment");
+static_assert(sizeof(BakedMaterialRange) % 16 == 0, "BakedMaterialRange must keep 16-byte alignment");
+static_assert(kBakedTextureChannels == kMaterialTextureSlots, "BakedMaterial must have a texture per material slot");
+static_assert(sizeof(BakedMedia) % 16 == 0, "BakedMedia must keep 16-byte alignment");
+
+namespace {
+
+bool IsLittleEndian()
+{
+	const uint16_t probe = 1;
+	unsigned char first;
+	memcpy(&first, &probe, 1);
+	return first == 1;
+}
+
+size_t Align16(size_t pOffset)
+{
+	return (pOffset + 15) & ~(size_t)15;
+}
+
+/**
+* Accumulates the file in memory: 16-byte aligned blocks plus a deduplicated
+* string pool.
+*/
+class BakedBuilder
+{
+public:
+	BakedBuilder()
+	{
+		mStrings.push_back('\0');
+	}
+
+	uint64_t Reserve(size_t pSize)
+	{
+		size_t offset = Align16(mData.size());
+		mData.resize(offset + pSize, 0);
+		return offset;
+	}
+
+	uint64_t Append(const void* pData, size_t pSize)
+	{
+		if (!pSize)
+			return 0;
+		uint64_t offset = Reserve(pSize);
+		memcpy(&mData[(size_t)offset], pData, pSize);
+		return offset;
+	}
+
+	template <typename T>
+	uint64_t Append(const std::vector<T>& pValues)
+	{
+		return pValues.empty() ? 0 : Append(&pValues[0], pValues.size() * sizeof(T));
+	}
+
+	void Write(uint64_t pOffset, const void* pData, size_t pSize)
+	{
+		memcpy(&mData[(size_t)pOffset], pData, pSize);
+	}
+
+	uint32_t AddString(const std::string& pText)
+	{
+		if (pText.empty())
+			return 0;
+		std::map<std::string, uint32_t>::iterator found = mStringOffsets.find(pText);
+		if (found != mStringOffsets.end())
+			return found->second;
+		uint32_t offset = (uint32_t)mStrings.size();
+		mStrings.insert(mStrings.end(), pText.begin(), pText.end());
+		mStrings.push_back('\0');
+		mStringOffsets[pText] = offset;
+		return offset;
+	}
+
+	const std::vector<char>& GetStrings() const { return mStrings; }
+	std::vector<unsigned char>& GetData() { return mData; }
+
+private:
+	std::vector<unsigned char> mData;
+	std::vector<char> mStrings;
+	std::map<std::string, uint32_t> mStringOffsets;
+};
+
+uint64_t AppendIndices(BakedBuilder& pBuilder, const std::vector<uint32_t>& pIndices, uint32_t pIndexSize)
+{
+	if (pIndexSize == 2)
+	{
+		std::vector<uint16_t> indices(pIndices.begin(), pIndices.end());
+		return pBuilder.Append(indices);
+	}
+	return pBuilder.Append(pIndices);
+}
+
+uint64_t AppendRanges(BakedBuilder& pBuilder, const std::vector<MaterialRange>& pRanges)
+{
+	std::vector<BakedMaterialRange> ranges(pRanges.size());
+	for (size_t r = 0; r < ranges.size(); r++)
+	{
+		ranges[r].slot = (uint32_t)pRanges[r].slot;
+		ranges[r].firstIndex = pRanges[r].firstIndex;
+		ranges[r].indexCount = pRanges[r].indexCount;
+		ranges[r].reserved = 0;
+	}
+	return pBuilder.Append(ranges);
+}
+
+bool InRange(uint64_t pOffset, uint64_t pSize, uint64_t pFileSize)
+{
+	return pOffset <= pFileSize && pSize <= pFileSize - pOffset;
+}
+
+/**
+* Whether pCount ranges at pOffset lie in the file and within pIndexCount
+* indices.
+*/
+bool RangesValid(const unsigned char* pBase, uint64_t pFileSize, uint64_t pOffset, uint32_t pCount, uint32_t pIndexCount)
+{
+	if (!InRange(pOffset, (uint64_t)pCount * sizeof(BakedMaterialRange), pFileSize))
+		return false;
+	const BakedMaterialRange* ranges = (const BakedMaterialRange*)(pBase + pOffset);
+	for (uint32_t r = 0; r < pCount; r++)
+	{
+		if (ranges[r].firstIndex > pIndexCount || ranges[r].indexCount > pIndexCount - ranges[r].firstIndex)
+			return false;
+	}
+	return true;
+}
+
+}
+
+bool WriteBakedScene(const Scene& pScene, const std::vector<MeshJob>& pJobs, const char* pFilename, std::string& pError,
+	bool pEmbedMedia, const AxisConversion& pConversion)
+{
+	if (!IsLittleEndian())
+	{
+		pError = "baked files can only be written on little-endian hosts";
+		return false;
+	}
+
+	// Nodes come in the hierarchy's order, parent before child; their poses,
+	// rotation orders, pivots and pre/post matrices go through the same
+	// conversion as the meshes.
+	FlatHierarchy hierarchy;
+	BuildFlatHierarchy(pScene, hierarchy);
+	std::vector<float> pose;
+	GetDefaultPose(hierarchy, pose);
+	if (!pConversion.IsIdentity())
+	{
+		ConvertFlatHierarchy(pConversion, hierarchy);
+		ConvertPose(pConversion, pose.empty() ? NULL : &pose[0], (size_t)hierarchy.GetNodeCount());
+	}
+	const std::vector<const Node*>& nodes = hierarchy.nodes;
+	const std::vector<int>& parents = hierarchy.parents;
+	std::vector<const Video*> media;
+	if (pEmbedMedia)
+		CollectEmbeddedMedia(pScene, media);
+
+	std::map<const Mesh*, int> meshIndex;
+	for (size_t i = 0; i < pJobs.size(); i++)
+		meshIndex[pJobs[i].mesh] = (int)i;
+	MaterialTable table;
+	BuildMaterialTable(pScene, table);
+
+	BakedBuilder builder;
+	BakedHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, kBakedMagic, sizeof(kBakedMagic));
+	header.version = kBakedVersion;
+	header.headerSize = sizeof(BakedHeader);
+	header.nodeCount = (uint32_t)nodes.size();
+	header.meshCount = (uint32_t)pJobs.size();
+	header.materialCount = (uint32_t)table.materials.size();
+	header.mediaCount = (uint32_t)media.size();
+
+	builder.Reserve(sizeof(BakedHeader));
+	header.nodes = builder.Reserve(nodes.size() * sizeof(BakedNode));
+	header.meshes = builder.Reserve(pJobs.size() * sizeof(BakedMesh));
+	header.materials = builder.Reserve(table.materials.size() * sizeof(BakedMaterial));
+	header.media = builder.Reserve(media.size() * sizeof(BakedMedia));
+
+	for (size_t i = 0; i < nodes.size(); i++)
+	{
+		const Node& node = *nodes[i];
+		BakedNode baked;
+		memset(&baked, 0, sizeof(baked));
+		baked.name = builder.AddString(node.name);
+		baked.parent = parents[i];
+		baked.mesh = -1;
+		for (size_t a = 0; a < node.attributes.size() && baked.mesh < 0; a++)
+		{
+			std::map<const Mesh*, int>::const_iterator found = meshIndex.find(node.attributes[a]->mesh);
+			if (node.attributes[a]->mesh && found != meshIndex.end())
+				baked.mesh = found->second;
+		}
+		std::vector<uint32_t> materials;
+		for (size_t m = 0; m < node.materials.size(); m++)
+			materials.push_back((uint32_t)table.GetIndex(node.materials[m]));
+		baked.materialCount = (uint32_t)materials.size();
+		baked.materials = builder.Append(materials);
+		const float* nodePose = &pose[i * kPoseStride];
+		for (int c = 0; c < 3; c++)
+		{
+			baked.translation[c] = nodePose[c];
+			baked.rotation[c] = nodePose[3 + c];
+			baked.scaling[c] = nodePose[6 + c];
+		}
+		baked.rotationOrder = hierarchy.rotationOrders[i];
+		memcpy(baked.pre, &hierarchy.pre[i * 16], sizeof(baked.pre));
+		memcpy(baked.post, &hierarchy.post[i * 16], sizeof(baked.post));
+		memcpy(baked.scalingPivot, &hierarchy.scalingPivots[i * 3], sizeof(baked.scalingPivot));
+		// Types the SDK does not define compose like the default, RSrs.
+		baked.inheritType = hierarchy.inheritTypes[i] <= 2 ? hierarchy.inheritTypes[i] : 1;
+		builder.Write(header.nodes + i * sizeof(BakedNode), &baked, sizeof(baked));
+	}
+
+	for (size_t i = 0; i < pJobs.size(); i++)
+	{
+		const MeshJob& job = pJobs[i];
+		const IndexedMeshF& mesh = job.indexed;
+		BakedMesh baked;
+		memset(&baked, 0, sizeof(baked));
+		baked.name = builder.AddString(job.nodes.empty() ? std::string() : job.nodes[0]->name);
+		baked.vertexCount = (uint32_t)mesh.GetVertexCount();
+		baked.indexCount = (uint32_t)job.triangles.size();
+		baked.indexSize = baked.vertexCount <= 0x10000 ? 2 : 4;
+		baked.uvSetCount = (uint32_t)mesh.uvSets.size();
+
+		for (uint32_t v = 0; v < baked.vertexCount; v++)
+		{
+			for (int c = 0; c < 3; c++)
+			{
+				float value = mesh.positions[(size_t)v * 3 + c];
+				if (v == 0 || value < baked.boundsMin[c])
+					baked.boundsMin[c] = value;
+				if (v == 0 || value > baked.boundsMax[c])
+					baked.boundsMax[c] = value;
+			}
+		}
+
+		baked.positions = builder.Append(mesh.positions);
+		if (!mesh.normals.empty())
+		{
+			baked.flags |= BakedMesh::eHasNormals;
+			baked.normals = builder.Append(mesh.normals);
+		}
+		if (!mesh.tangents.empty())
+		{
+			baked.flags |= BakedMesh::eHasTangents;
+			baked.tangents = builder.Append(mesh.tangents);
+		}
+		if (!mesh.colors.empty())
+		{
+			baked.flags |= BakedMesh::eHasColors;
+			baked.colors = builder.Append(mesh.colors);
+		}
+		if (baked.uvSetCount)
+		{
+			const size_t setBytes = (size_t)baked.vertexCount * 2 * sizeof(float);
+			baked.uvs = builder.Reserve(setBytes * baked.uvSetCount);
+			for (uint32_t s = 0; s < baked.uvSetCount; s++)
+			{
+				if (setBytes)
+					builder.Write(baked.uvs + s * setBytes, &mesh.uvSets[s][0], setBytes);
+			}
+		}
+		baked.indices = AppendIndices(builder, job.triangles, baked.indexSize);
+		baked.rangeCount = (uint32_t)job.materialRanges.size();
+		baked.ranges = AppendRanges(builder, job.materialRanges);
+		if (!job.lods.empty())
+		{
+			std::vector<BakedLod> lods(job.lods.size());
+			memset(&lods[0], 0, lods.size() * sizeof(BakedLod));
+			for (size_t l = 0; l < lods.size(); l++)
+			{
+				lods[l].indexCount = (uint32_t)job.lods[l].triangles.size();
+				lods[l].error = job.lods[l].error;
+				lods[l].indices = AppendIndices(builder, job.lods[l].triangles, baked.indexSize);
+				lods[l].rangeCount = (uint32_t)job.lods[l].materialRanges.size();
+				lods[l].ranges = AppendRanges(builder, job.lods[l].materialRanges);
+			}
+			baked.lodCount = (uint32_t)lods.size();
+			baked.lods = builder.Append(lods);
+		}
+
+		builder.Write(header.meshes + i * sizeof(BakedMesh), &baked, sizeof(baked));
+	}
+
+	for (size_t i = 0; i < table.materials.size(); i++)
+	{
+		const FlatMaterial& material = table.materials[i];
+		BakedMaterial baked;
+		memset(&baked, 0, sizeof(baked));
+		baked.name = builder.AddString(table.sources[i]->name);
+		baked.shadingModel = material.shadingModel;
+		memcpy(baked.ambient, material.ambient, sizeof(baked.ambient));
+		baked.ambientFactor = material.ambientFactor;
+		memcpy(baked.diffuse, material.diffuse, sizeof(baked.diffuse));
+		baked.diffuseFactor = material.diffuseFactor;
+		memcpy(baked.emissive, material.emissive, sizeof(baked.emissive));
+		baked.emissiveFactor = material.emissiveFactor;
+		memcpy(baked.specular, material.specular, sizeof(baked.specular));
+		baked.specularFactor = material.specularFactor;
+		baked.shininess = material.shininess;
+		memcpy(baked.transparent, material.transparent, sizeof(baked.transparent));
+		baked.transparencyFactor = material.transparencyFactor;
+		memcpy(baked.reflection, material.reflection, sizeof(baked.reflection));
+		baked.reflectionFactor = material.reflectionFactor;
+		baked.bumpFactor = material.bumpFactor;
+		for (int c = 0; c < kBakedTextureChannels; c++)
+		{
+			if (material.textures[c] >= 0)
+				baked.textures[c] = builder.AddString(table.textures[material.textures[c]]->fileName);
+		}
+		builder.Write(header.materials + i * sizeof(BakedMaterial), &baked, sizeof(baked));
+	}
+
+	for (size_t i = 0; i < media.size(); i++)
+	{
+		BakedMedia baked;
+		memset(&baked, 0, sizeof(baked));
+		baked.name = builder.AddString(media[i]->relativeFileName);
+		baked.fileName = builder.AddString(media[i]->fileName);
+		baked.size = media[i]->contentSize;
+		baked.data = builder.Append(media[i]->content, media[i]->contentSize);
+		builder.Write(header.media + i * sizeof(BakedMedia), &baked, sizeof(baked));
+	}
+
+	const std::vector<char>& strings = builder.GetStrings();
+	header.stringsSize = (uint32_t)strings.size();
+	header.strings = builder.Append(&strings[0], strings.size());
+	header.fileSize = Align16(builder.GetData().size());
+	builder.GetData().resize((size_t)header.fileSize, 0);
+	builder.Write(0, &header, sizeof(header));
+
+	FILE* file = fopen(pFilename, "wb");
+	if (!file)
+	{
+		pError = std::string("cannot write '") + pFilename + "'";
+		return false;
+	}
+	const std::vector<unsigned char>& data = builder.GetData();
+	bool written = fwrite(&data[0], 1, data.size(), file) == data.size();
+	if (fclose(file) != 0 || !written)
+	{
+		pError = std::string("cannot write '") + pFilename + "'";
+		return false;
+	}
+	return true;
+}
+
+BakedScene::BakedScene()
+	: mHeader(NULL)
+	, mNodes(NULL)
+	, mMaterials(NULL)
+	, mMedia(NULL)
+	, mStrings(NULL)
+{
+}
+
+bool BakedScene::Fail(const char* pFormat, ...)
+{
+	char message[512];
+	va_list args;
+	va_start(args, pFormat);
+	vsnprintf(message, sizeof(message), pFormat, args);
+	va_end(args);
+	mError = message;
+	mHeader = NULL;
+	mMeshes.clear();
+	mFile.Close();
+	return false;
+}
+
+bool BakedScene::Load(const char* pFilename)
+{
+	mMeshes.clear();
+	if (!IsLittleEndian())
+		return Fail("baked files can only be read on little-endian hosts");
+	if (!mFile.Open(pFilename))
+		return Fail("cannot open '%s'", pFilename);
+
+	const unsigned char* base = mFile.GetData();
+	const uint64_t size = mFile.GetSize();
+	if (size < sizeof(BakedHeader))
+		return Fail("'%s' is too small to be a baked file", pFilename);
+	mHeader = (const BakedHeader*)base;
+	if (memcmp(mHeader->magic, kBakedMagic, sizeof(kBakedMagic)) != 0)
+		return Fail("'%s' is not a baked file", pFilename);
+	if (mHeader->version != kBakedVersion || mHeader->headerSize != sizeof(BakedHeader))
+		return Fail("'%s' has version %u, expected %u", pFilename, mHeader->version, kBakedVersion);
+	if (mHeader->fileSize != size)
+		return Fail("'%s' is truncated", pFilename);
+
+	if (!InRange(mHeader->nodes, (uint64_t)mHeader->nodeCount * sizeof(BakedNode), size) ||
+		!InRange(mHeader->meshes, (uint64_t)mHeader->meshCount * sizeof(BakedMesh), size) ||
+		!InRange(mHeader->materials, (uint64_t)mHeader->materialCount * sizeof(BakedMaterial), size) ||
+		!InRange(mHeader->media, (uint64_t)mHeader->mediaCount * sizeof(BakedMedia), size) ||
+		!InRange(mHeader->strings, mHeader->stringsSize, size) ||
+		mHeader->stringsSize == 0 || base[mHeader->strings + mHeader->stringsSize - 1] != 0)
+		return Fail("'%s' has a corrupt table", pFilename);
+
+	mNodes = (const BakedNode*)(base + mHeader->nodes);
+	mMaterials = (const BakedMaterial*)(base + mHeader->materials);
+	mMedia = (const BakedMedia*)(base + mHeader->media);
+	mStrings = (const char*)(base + mHeader->strings);
+
+	for (uint32_t i = 0; i < mHeader->nodeCount; i++)
+	{
+		const BakedNode& node = mNodes[i];
+		if (node.name >= mHeader->stringsSize || node.parent >= (int32_t)i || node.rotationOrder >= 7 ||
+			node.inheritType > 2 || node.mesh >= (int32_t)mHeader->meshCount ||
+			!InRange(node.materials, (uint64_t)node.materialCount * 4, size))
+			return Fail("'%s' has a corrupt node %u", pFilename, i);
+		const uint32_t* materials = (const uint32_t*)(base + node.materials);
+		for (uint32_t m = 0; m < node.materialCount; m++)
+		{
+			if (materials[m] >= mHeader->materialCount)
+				return Fail("'%s' has a corrupt node %u", pFilename, i);
+		}
+	}
+
+	for (uint32_t i = 0; i < mHeader->materialCount; i++)
+	{
+		const BakedMaterial& material = mMaterials[i];
+		bool valid = material.name < mHeader->stringsSize;
+		for (int c = 0; c < kBakedTextureChannels; c++)
+			valid = valid && material.textures[c] < mHeader->stringsSize;
+		if (!valid)
+			return Fail("'%s' has a corrupt material %u", pFilename, i);
+	}
+
+	for (uint32_t i = 0; i < mHeader->mediaCount; i++)
+	{
+		const BakedMedia& media = mMedia[i];
+		if (media.name >= mHeader->stringsSize || media.fileName >= mHeader->stringsSize ||
+			!InRange(media.data, media.size, size))
+			return Fail("'%s' has a corrupt media entry %u", pFilename, i);
+	}
+
+	// The only per-mesh work at load time: turn offsets into pointers.
+	const BakedMesh* meshes = (const BakedMesh*)(base + mHeader->meshes);
+	mMeshes.resize(mHeader->meshCount);
+	for (uint32_t i = 0; i < mHeader->meshCount; i++)
+	{
+		const BakedMesh& mesh = meshes[i];
+		const uint64_t vertexBytes = (uint64_t)mesh.vertexCount * sizeof(float);
+		if (mesh.name >= mHeader->stringsSize || (mesh.indexSize != 2 && mesh.indexSize != 4) ||
+			!InRange(mesh.positions, vertexBytes * 3, size) ||
+			((mesh.flags & BakedMesh::eHasNormals) && !InRange(mesh.normals, vertexBytes * 3, size)) ||
+			((mesh.flags & BakedMesh::eHasTangents) && !InRange(mesh.tangents, vertexBytes * 3, size)) ||
+			((mesh.flags & BakedMesh::eHasColors) && !InRange(mesh.colors, vertexBytes * 4, size)) ||
+			!InRange(mesh.uvs, vertexBytes * 2 * mesh.uvSetCount, size) ||
+			!InRange(mesh.indices, (uint64_t)mesh.indexCount * mesh.indexSize, size) ||
+			!InRange(mesh.lods, (uint64_t)mesh.lodCount * sizeof(BakedLod), size) ||
+			!RangesValid(base, size, mesh.ranges, mesh.rangeCount, mesh.indexCount))
+			return Fail("'%s' has a corrupt mesh %u", pFilename, i);
+		const BakedLod* lods = mesh.lodCount ? (const BakedLod*)(base + mesh.lods) : NULL;
+		for (uint32_t l = 0; l < mesh.lodCount; l++)
+		{
+			if (!InRange(lods[l].indices, (uint64_t)lods[l].indexCount * mesh.indexSize, size) ||
+				!RangesValid(base, size, lods[l].ranges, lods[l].rangeCount, lods[l].indexCount))
+				return Fail("'%s' has a corrupt level of detail in mesh %u", pFilename, i);
+		}
+
+		BakedMeshView& view = mMeshes[i];
+		view.mesh = &mesh;
+		view.name = mStrings + mesh.name;
+		view.positions = (const float*)(base + mesh.positions);
+		view.normals = (mesh.flags & BakedMesh::eHasNormals) ? (const float*)(base + mesh.normals) : NULL;
+		view.tangents = (mesh.flags & BakedMesh::eHasTangents) ? (const float*)(base + mesh.tangents) : NULL;
+		view.colors = (mesh.flags & BakedMesh::eHasColors) ? (const float*)(base + mesh.colors) : NULL;
+		view.uvs = mesh.uvSetCount ? (const float*)(base + mesh.uvs) : NULL;
+		view.indices16 = mesh.indexSize == 2 ? (const uint16_t*)(base + mesh.indices) : NULL;
+		view.indices32 = mesh.indexSize == 4 ? (const uint32_t*)(base + mesh.indices) : NULL;
+		view.lods = lods;
+		view.ranges = mesh.rangeCount ? (const BakedMaterialRange*)(base + mesh.ranges) : NULL;
+	}
+	return true;
+}
+
+const uint32_t* BakedScene::GetNodeMaterials(int pIndex) const
+{
+	const BakedNode& node = mNodes[pIndex];
+	return node.materialCount ? (const uint32_t*)(mFile.GetData() + node.materials) : NULL;
+}
+
+const unsigned char* BakedScene::GetMediaData(int pIndex) const
+{
+	return mFile.GetData() + mMedia[pIndex].data;
+}
+
+const void* BakedScene::GetLodIndices(int pMesh, int pLod) const
+{
+	return mFile.GetData() + mMeshes[pMesh].lods[pLod].indices;
+}
+
+const BakedMaterialRange* BakedScene::GetLodRanges(int pMesh, int pLod) const
+{
+	const BakedLod& lod = mMeshes[pMesh].lods[pLod];
+	return lod.rangeCount ? (const BakedMaterialRange*)(mFile.GetData() + lod.ranges) : NULL;
+}
+
+}
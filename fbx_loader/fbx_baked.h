@@ -0,0 +1,276 @@
+#ifndef FBX_BAKED_H
+#define FBX_BAKED_H
+
+#include "fbx_mmap.h"
+#include "fbx_pipeline.h"
+#include "fbx_scene.h"
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace fbxl {
+
+/**
+* Baked scene files: the pipeline's welded, triangulated meshes plus the node
+* hierarchy and a deduplicated material table, laid out so that a runtime can map the file and
+* use it in place. Everything is little-endian; every table and array starts
+* on a 16-byte boundary; references between parts are byte offsets from the
+* start of the file, and names are offsets into a string pool whose first
+* byte is an empty string. Files embedded in the FBX (textures, mostly) can
+* be carried along as a media table, so a runtime never needs them on disk.
+*/
+const char kBakedMagic[8] = { 'F', 'B', 'X', 'L', 'B', 'A', 'K', 'E' };
+const uint32_t kBakedVersion = 6;
+const int kBakedTextureChannels = LayerElement::eTypeCount - LayerElement::eTextureDiffuse;
+
+struct BakedHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t headerSize;
+	uint64_t fileSize;
+	uint32_t nodeCount;
+	uint32_t meshCount;
+	uint32_t materialCount;
+	uint32_t stringsSize;
+	uint64_t nodes;
+	uint64_t meshes;
+	uint64_t materials;
+	uint64_t strings;
+	uint64_t media;
+	uint32_t mediaCount;
+	uint32_t reserved[3];
+};
+
+/**
+* A node with its Lcl translation, rotation (Euler degrees, applied in
+* rotationOrder, an EFbxRotationOrder) and scaling, and the parts of its
+* transform that do not change with the pose, as FlatHierarchy keeps them:
+* pre (Roff * Rp * Rpre) and post (Rpost^-1 * Rp^-1 * Soff * Sp), 16 floats
+* in four columns, and the scaling pivot, so that its local matrix is
+*   T * pre * R * post * S * Sp^-1
+* and inheritType (an FbxTransform::EInheritType) says how it composes with
+* its parent's global matrix. Everything is in the same axes and units as
+* the meshes: with a conversion C, the local matrix L is stored as
+* C * L * C^-1, so that a global matrix times a converted vertex is C times
+* the original product.
+*/
+struct BakedNode
+{
+	uint32_t name;
+	int32_t parent;
+	int32_t mesh;
+	uint32_t materialCount;
+	uint64_t materials;
+	float translation[3];
+	float rotation[3];
+	float scaling[3];
+	uint32_t rotationOrder;
+	float pre[16];
+	float post[16];
+	float scalingPivot[3];
+	uint32_t inheritType;
+};
+
+struct BakedMesh
+{
+	enum
+	{
+		eHasNormals = 1,
+		eHasTangents = 2,
+		eHasColors = 4
+	};
+
+	uint32_t name;
+	uint32_t flags;
+	uint32_t vertexCount;
+	uint32_t indexCount;
+	uint32_t indexSize;
+	uint32_t uvSetCount;
+	float boundsMin[3];
+	float boundsMax[3];
+	uint64_t positions;
+	uint64_t normals;
+	uint64_t tangents;
+	uint64_t colors;
+	uint64_t uvs;
+	uint64_t indices;
+	uint32_t lodCount;
+	uint32_t rangeCount;
+	uint64_t lods;
+	uint64_t ranges;
+	uint64_t reserved;
+};
+
+/**
+* indexCount indices from firstIndex that use material slot slot of the
+* nodes instancing the mesh (BakedNode::materials maps it to the material
+* table): one draw call. A mesh's ranges cover its indices in slot order.
+*/
+struct BakedMaterialRange
+{
+	uint32_t slot;
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	uint32_t reserved;
+};
+
+/**
+* A level of detail of a mesh, lods[lodCount] after the full mesh in
+* decreasing detail: indexCount indices of the mesh's index size over the
+* mesh's vertices, and the geometric error in mesh units, so a runtime can
+* pick the first level whose error, projected to the screen, is small
+* enough without reading any geometry. Its indices are grouped by material
+* like the mesh's, in rangeCount ranges of its own.
+*/
+struct BakedLod
+{
+	uint32_t indexCount;
+	float error;
+	uint64_t indices;
+	uint32_t rangeCount;
+	uint32_t reserved;
+	uint64_t ranges;
+};
+
+/**
+* An entry of the material table (see BuildMaterialTable): the properties of
+* a FlatMaterial, and for each texture channel the Filename of its texture
+* in the string pool (0 when it has none). Scene materials that only differ
+* by name share one entry, named after the first of them.
+*/
+struct BakedMaterial
+{
+	uint32_t name;
+	int32_t shadingModel;
+	float ambient[3];
+	float ambientFactor;
+	float diffuse[3];
+	float diffuseFactor;
+	float emissive[3];
+	float emissiveFactor;
+	float specular[3];
+	float specularFactor;
+	float shininess;
+	float transparent[3];
+	float transparencyFactor;
+	float reflection[3];
+	float reflectionFactor;
+	float bumpFactor;
+	uint32_t textures[kBakedTextureChannels];
+	uint32_t reserved[3];
+};
+
+/**
+* An embedded file: size bytes at data, under the RelativeFilename and
+* Filename of its video, which material texture names can be matched
+* against.
+*/
+struct BakedMedia
+{
+	uint32_t name;
+	uint32_t fileName;
+	uint64_t size;
+	uint64_t data;
+	uint64_t reserved;
+};
+
+/**
+* Write pScene and the meshes pJobs produced for it (see RunMeshPipeline) to
+* pFilename. Nodes are stored parent before child, in the order PrintNode
+* visits them. With pEmbedMedia, the files embedded in the FBX (see
+* CollectEmbeddedMedia) are copied from the document straight into the
+* media table. pConversion must be the one the pipeline applied to the
+* meshes (PipelineOptions::conversion); node transforms are converted by it
+* too.
+*/
+bool WriteBakedScene(const Scene& pScene, const std::vector<MeshJob>& pJobs, const char* pFilename, std::string& pError,
+	bool pEmbedMedia = false, const AxisConversion& pConversion = AxisConversion());
+
+/**
+* A mesh of a loaded baked file with its offsets resolved to pointers into
+* the mapping. Absent attributes are NULL; the UV sets follow each other,
+* vertexCount * 2 floats apiece. Exactly one of indices16/indices32 is set.
+* lods is NULL when the mesh has no level of detail, ranges when it has no
+* triangles.
+*/
+struct BakedMeshView
+{
+	const BakedMesh* mesh;
+	const char* name;
+	const float* positions;
+	const float* normals;
+	const float* tangents;
+	const float* colors;
+	const float* uvs;
+	const uint16_t* indices16;
+	const uint32_t* indices32;
+	const BakedLod* lods;
+	const BakedMaterialRange* ranges;
+};
+
+/**
+* A baked file mapped into memory. Load checks that the header and every
+* offset are in range and resolves the meshes' offsets; no vertex or index
+* data is read or copied.
+*/
+class BakedScene
+{
+public:
+	BakedScene();
+
+	bool Load(const char* pFilename);
+
+	const std::string& GetError() const { return mError; }
+	const BakedHeader& GetHeader() const { return *mHeader; }
+
+	int GetNodeCount() const { return (int)mHeader->nodeCount; }
+	const BakedNode& GetNode(int pIndex) const { return mNodes[pIndex]; }
+	int GetMeshCount() const { return (int)mMeshes.size(); }
+	const BakedMeshView& GetMesh(int pIndex) const { return mMeshes[pIndex]; }
+	int GetMaterialCount() const { return (int)mHeader->materialCount; }
+	const BakedMaterial& GetMaterial(int pIndex) const { return mMaterials[pIndex]; }
+	const uint32_t* GetNodeMaterials(int pIndex) const;
+	int GetMediaCount() const { return (int)mHeader->mediaCount; }
+	const BakedMedia& GetMedia(int pIndex) const { return mMedia[pIndex]; }
+
+	/**
+	* The bytes of embedded file pIndex, GetMedia(pIndex).size of them.
+	*/
+	const unsigned char* GetMediaData(int pIndex) const;
+
+	/**
+	* Indices of level of detail pLod of mesh pMesh, of the mesh's index size.
+	*/
+	const void* GetLodIndices(int pMesh, int pLod) const;
+
+	/**
+	* Material ranges of level of detail pLod of mesh pMesh.
+	*/
+	const BakedMaterialRange* GetLodRanges(int pMesh, int pLod) const;
+
+	/**
+	* String at pOffset of the string pool.
+	*/
+	const char* GetString(uint32_t pOffset) const { return mStrings + pOffset; }
+
+private:
+	BakedScene(const BakedScene&);
+	BakedScene& operator=(const BakedScene&);
+
+	bool Fail(const char* pFormat, ...);
+
+	MappedFile mFile;
+	const BakedHeader* mHeader;
+	const BakedNode* mNodes;
+	const BakedMaterial* mMaterials;
+	const BakedMedia* mMedia;
+	const char* mStrings;
+	std::vector<BakedMeshView> mMeshes;
+	std::string mError;
+};
+
+}
+
+#endif
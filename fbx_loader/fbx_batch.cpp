@@ -0,0 +1,382 @@
+#include "fbx_batch.h"
+#include "fbx_cache.h"
+#include "fbx_material.h"
+#include "fbx_path.h"
+#include "fbx_pipeline.h"
+#include "fbx_reader.h"
+#include "fbx_scene.h"
+#include "fbx_thread_pool.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <chrono>
+#include <memory>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+
+namespace fbxl {
+
+namespace {
+
+/**
+* Cache options for batch output. Change it whenever the OBJ or MTL text
+* produced for the same input, or the layout of an entry (see PackEntry),
+* changes, so stale entries stop matching.
+*/
+const char kBatchCacheOptions[] = "obj 6";
+
+#ifdef _WIN32
+
+bool IsDirectory(const std::string& pPath)
+{
+	DWORD attributes = GetFileAttributesA(pPath.c_str());
+	return attributes != INVALID_FILE_ATTRIBUTES && (attributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
+}
+
+bool ListDirectory(const std::string& pDirectory, std::vector<std::string>& pFiles, std::vector<std::string>& pDirectories)
+{
+	WIN32_FIND_DATAA data;
+	HANDLE find = FindFirstFileA((pDirectory + "\\*").c_str(), &data);
+	if (find == INVALID_HANDLE_VALUE)
+		return false;
+	do
+	{
+		std::string name = data.cFileName;
+		if (name == "." || name == "..")
+			continue;
+		if (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+			pDirectories.push_back(name);
+		else
+			pFiles.push_back(name);
+	} while (FindNextFileA(find, &data));
+	FindClose(find);
+	return true;
+}
+
+#else
+
+bool IsDirectory(const std::string& pPath)
+{
+	struct stat st;
+	return stat(pPath.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+bool ListDirectory(const std::string& pDirectory, std::vector<std::string>& pFiles, std::vector<std::string>& pDirectories)
+{
+	DIR* dir = opendir(pDirectory.c_str());
+	if (!dir)
+		return false;
+	while (struct dirent* entry = readdir(dir))
+	{
+		std::string name = entry->d_name;
+		if (name == "." || name == "..")
+			continue;
+		if (IsDirectory(pDirectory + "/" + name))
+			pDirectories.push_back(name);
+		else
+			pFiles.push_back(name);
+	}
+	closedir(dir);
+	return true;
+}
+
+#endif
+
+bool HasFbxExtension(const std::string& pName)
+{
+	if (pName.size() < 4)
+		return false;
+	const char* ext = pName.c_str() + pName.size() - 4;
+	return ext[0] == '.' && tolower(ext[1]) == 'f' && tolower(ext[2]) == 'b' && tolower(ext[3]) == 'x';
+}
+
+/**
+* Case-sensitive match of pName against a pattern with * and ? wildcards.
+*/
+bool MatchWildcard(const char* pPattern, const char* pName)
+{
+	const char* star = NULL;
+	const char* resume = NULL;
+	while (*pName)
+	{
+		if (*pPattern == '*')
+		{
+			star = pPattern++;
+			resume = pName;
+		}
+		else if (*pPattern == '?' || *pPattern == *pName)
+		{
+			++pPattern;
+			++pName;
+		}
+		else if (star)
+		{
+			pPattern = star + 1;
+			pName = ++resume;
+		}
+		else
+			return false;
+	}
+	while (*pPattern == '*')
+		++pPattern;
+	return *pPattern == 0;
+}
+
+void CollectDirectory(const std::string& pDirectory, std::vector<std::string>& pFiles)
+{
+	std::vector<std::string> files;
+	std::vector<std::string> directories;
+	if (!ListDirectory(pDirectory, files, directories))
+		return;
+	for (size_t i = 0; i < files.size(); i++)
+	{
+		if (HasFbxExtension(files[i]))
+			pFiles.push_back(JoinPath(pDirectory, files[i]));
+	}
+	for (size_t i = 0; i < directories.size(); i++)
+		CollectDirectory(JoinPath(pDirectory, directories[i]), pFiles);
+}
+
+/**
+* What a pool thread keeps between files.
+*/
+struct BatchWorker
+{
+	Document document;
+	ThreadPool serial;
+	std::vector<MeshJob> jobs;
+	std::string output;
+	std::string library;
+	std::string entry;
+
+	BatchWorker() : serial(1) {}
+};
+
+bool WriteOutput(const std::string& pPath, const char* pData, size_t pSize)
+{
+	FILE* out = fopen(pPath.c_str(), "wb");
+	if (!out)
+		return false;
+	bool ok = fwrite(pData, 1, pSize, out) == pSize;
+	return fclose(out) == 0 && ok;
+}
+
+/**
+* Write the MTL library pLibrary, when there is one, and the OBJ text pText
+* of pResult, setting its error if either fails.
+*/
+void WriteOutputs(BatchResult& pResult, const char* pLibrary, size_t pLibrarySize, const char* pText, size_t pTextSize)
+{
+	const std::string library = pResult.input + ".mtl";
+	if (pLibrarySize && !WriteOutput(library, pLibrary, pLibrarySize))
+		pResult.error = "cannot write '" + library + "'";
+	else if (!WriteOutput(pResult.output, pText, pTextSize))
+		pResult.error = "cannot write '" + pResult.output + "'";
+}
+
+/**
+* A cache entry holds the size of the MTL text on a line of its own, then
+* the MTL text, then the OBJ text.
+*/
+void PackEntry(const BatchWorker& pWorker, std::string& pEntry)
+{
+	char size[32];
+	sprintf(size, "%lu\n", (unsigned long)pWorker.library.size());
+	pEntry.assign(size);
+	pEntry += pWorker.library;
+	pEntry += pWorker.output;
+}
+
+bool WriteEntry(const std::string& pEntry, BatchResult& pResult)
+{
+	const size_t newline = pEntry.find('\n');
+	if (newline == std::string::npos)
+		return false;
+	const size_t librarySize = strtoul(pEntry.c_str(), NULL, 10);
+	if (librarySize > pEntry.size() - newline - 1)
+		return false;
+	const char* library = pEntry.data() + newline + 1;
+	WriteOutputs(pResult, library, librarySize, library + librarySize, pEntry.size() - newline - 1 - librarySize);
+	return true;
+}
+
+/**
+* Parse, convert and write one file, leaving its OBJ text in pWorker.output
+* and its MTL text, empty when it has no materials, in pWorker.library.
+*/
+void ConvertSource(BatchWorker& pWorker, BatchResult& pResult)
+{
+	Document& document = pWorker.document;
+	if (!document.Load(pResult.input.c_str()))
+	{
+		pResult.error = document.GetError();
+		return;
+	}
+	pResult.fileSize = document.GetFileSize();
+	document.InflateArrays(pWorker.serial);
+	Scene scene;
+	if (!BuildScene(document, scene))
+	{
+		pResult.error = "no Objects section";
+		return;
+	}
+
+	MaterialTable table;
+	BuildMaterialTable(scene, table);
+	PipelineOptions options;
+	options.materials = &table;
+	CollectMeshJobs(scene, pWorker.jobs);
+	PipelineStats stats = RunMeshPipeline(pWorker.jobs, pWorker.serial, options);
+	pResult.meshCount = stats.meshCount;
+	pResult.triangleCount = stats.triangleCount;
+
+	pWorker.library.clear();
+	pWorker.output.clear();
+	if (!table.materials.empty())
+	{
+		SerializeMtl(table, pWorker.library);
+		const size_t slash = pResult.input.find_last_of("/\\");
+		pWorker.output = "mtllib " + pResult.input.substr(slash == std::string::npos ? 0 : slash + 1) + ".mtl\n";
+	}
+	pWorker.output.reserve(pWorker.output.size() + stats.outputBytes);
+	for (size_t i = 0; i < pWorker.jobs.size(); i++)
+		pWorker.output += pWorker.jobs[i].output;
+	WriteOutputs(pResult, pWorker.library.data(), pWorker.library.size(), pWorker.output.data(), pWorker.output.size());
+}
+
+void ConvertFile(BatchWorker& pWorker, BatchResult& pResult, ConversionCache* pCache)
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	pResult.output = pResult.input + ".obj";
+
+	// A cache hit costs one pass of hashing over the mapped file and one
+	// write; the document is never parsed.
+	std::string key;
+	if (pCache)
+	{
+		MappedFile source;
+		if (source.Open(pResult.input.c_str()))
+		{
+			key = ConversionCache::MakeKey(source.GetData(), source.GetSize(), kBatchCacheOptions);
+			pResult.fileSize = source.GetSize();
+			if (pCache->Lookup(key, pWorker.entry) && WriteEntry(pWorker.entry, pResult))
+				pResult.cached = true;
+		}
+	}
+
+	if (!pResult.cached)
+	{
+		ConvertSource(pWorker, pResult);
+		if (pResult.error.empty() && pCache && !key.empty())
+		{
+			PackEntry(pWorker, pWorker.entry);
+			pCache->Store(key, pWorker.entry);
+		}
+	}
+	pWorker.jobs.clear();
+	pWorker.document.Close();
+
+	pResult.ok = pResult.error.empty();
+	pResult.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+}
+
+bool CollectBatchInputs(const std::string& pSpec, std::vector<std::string>& pFiles, std::string& pError)
+{
+	pFiles.clear();
+	if (!pSpec.empty() && pSpec[0] == '@')
+	{
+		FILE* list = fopen(pSpec.c_str() + 1, "rb");
+		if (!list)
+		{
+			pError = "cannot open list '" + pSpec.substr(1) + "'";
+			return false;
+		}
+		char line[4096];
+		while (fgets(line, sizeof(line), list))
+		{
+			std::string name = line;
+			while (!name.empty() && isspace((unsigned char)name[name.size() - 1]))
+				name.erase(name.size() - 1);
+			if (!name.empty())
+				pFiles.push_back(name);
+		}
+		fclose(list);
+	}
+	else if (IsDirectory(pSpec))
+		CollectDirectory(pSpec, pFiles);
+	else if (pSpec.find_first_of("*?") != std::string::npos)
+	{
+		size_t slash = pSpec.find_last_of("/\\");
+		std::string directory = slash == std::string::npos ? std::string(".") : pSpec.substr(0, slash);
+		std::string pattern = slash == std::string::npos ? pSpec : pSpec.substr(slash + 1);
+		std::vector<std::string> files;
+		std::vector<std::string> directories;
+		if (!ListDirectory(directory, files, directories))
+		{
+			pError = "cannot list '" + directory + "'";
+			return false;
+		}
+		for (size_t i = 0; i < files.size(); i++)
+		{
+			if (MatchWildcard(pattern.c_str(), files[i].c_str()))
+				pFiles.push_back(slash == std::string::npos ? files[i] : JoinPath(directory, files[i]));
+		}
+	}
+	else
+		pFiles.push_back(pSpec);
+
+	std::sort(pFiles.begin(), pFiles.end());
+	if (pFiles.empty())
+	{
+		pError = "no input files match '" + pSpec + "'";
+		return false;
+	}
+	return true;
+}
+
+BatchStats RunBatch(const std::vector<std::string>& pFiles, ThreadPool& pPool, std::vector<BatchResult>& pResults,
+	ConversionCache* pCache)
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	pResults.assign(pFiles.size(), BatchResult());
+	for (size_t i = 0; i < pFiles.size(); i++)
+	{
+		pResults[i].input = pFiles[i];
+		pResults[i].ok = false;
+		pResults[i].cached = false;
+		pResults[i].fileSize = 0;
+		pResults[i].meshCount = 0;
+		pResults[i].triangleCount = 0;
+		pResults[i].seconds = 0.0;
+	}
+
+	std::unique_ptr<BatchWorker[]> workers(new BatchWorker[pPool.GetThreadCount()]);
+	pPool.ParallelForSlots(pFiles.size(), [&](size_t i, int slot) {
+		ConvertFile(workers[slot], pResults[i], pCache);
+	});
+
+	BatchStats stats = BatchStats();
+	stats.fileCount = pResults.size();
+	stats.threadCount = pPool.GetThreadCount();
+	for (size_t i = 0; i < pResults.size(); i++)
+	{
+		if (!pResults[i].ok)
+			++stats.failedCount;
+		stats.bytes += pResults[i].fileSize;
+	}
+	stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	return stats;
+}
+
+}
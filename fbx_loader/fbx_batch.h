@@ -0,0 +1,67 @@
+#ifndef FBX_BATCH_H
+#define FBX_BATCH_H
+
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+namespace fbxl {
+
+class ConversionCache;
+class ThreadPool;
+
+/**
+* Expand a batch input specification into file names:
+* - a directory: every .fbx file below it, recursively;
+* - a path whose last component holds * or ? wildcards: the matching files
+*   of that directory;
+* - @list.txt: the file names listed one per line;
+* - anything else: that single file.
+* The result is sorted, so batches run in the same order every time.
+*/
+bool CollectBatchInputs(const std::string& pSpec, std::vector<std::string>& pFiles, std::string& pError);
+
+/**
+* What happened to one input file.
+*/
+struct BatchResult
+{
+	std::string input;
+	std::string output;
+	std::string error;
+	bool ok;
+	bool cached;
+	size_t fileSize;
+	size_t meshCount;
+	size_t triangleCount;
+	double seconds;
+};
+
+/**
+* Totals over a whole batch.
+*/
+struct BatchStats
+{
+	size_t fileCount;
+	size_t failedCount;
+	size_t bytes;
+	int threadCount;
+	double seconds;
+};
+
+/**
+* Convert every input to "<input>.obj", with its materials in "<input>.mtl"
+* when it has any, several files at once on pPool. Each pool thread keeps
+* one document and one set of mesh buffers and reuses them for every file
+* it takes, and a file is unmapped as soon as it is written,
+* so memory stays bounded by the thread count times the largest file however
+* long the list is. pResults comes back in input order.
+* With pCache, files whose contents were converted before are answered from
+* the cache without being parsed, and new results are added to it.
+*/
+BatchStats RunBatch(const std::vector<std::string>& pFiles, ThreadPool& pPool, std::vector<BatchResult>& pResults,
+	ConversionCache* pCache = NULL);
+
+}
+
+#endif
@@ -0,0 +1,217 @@
+#include "fbx_blend_shape.h"
+
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+namespace fbxl {
+
+namespace {
+
+/**
+* Control points per block of ApplyBlendShapes: 24 KB of positions, which
+* stay in L1 while every active target adds into them.
+*/
+const int kBlockVertices = 2048;
+
+struct ActiveTarget
+{
+	const SparseTarget* target;
+	float weight;
+	size_t cursor;
+};
+
+bool HasLowerFullWeight(const SparseTarget& a, const SparseTarget& b)
+{
+	return a.fullWeight < b.fullWeight;
+}
+
+/**
+* Decode pShape's deltas into pOut, dropping those within pEpsilon of zero
+* and ordering what is left by control point.
+*/
+bool ExtractTarget(const Shape& pShape, int pVertexCount, float pEpsilon, SparseTarget& pOut)
+{
+	std::vector<int> indexes;
+	std::vector<float> vertices;
+	std::vector<float> normals;
+	if (!pShape.indexes.CopyTo(indexes) || !pShape.vertices.CopyTo(vertices) || !pShape.normals.CopyTo(normals))
+		return false;
+	const size_t count = std::min(indexes.size(), vertices.size() / 3);
+	const bool hasNormals = normals.size() == vertices.size();
+
+	std::vector<size_t> kept;
+	kept.reserve(count);
+	for (size_t i = 0; i < count; i++)
+	{
+		if (indexes[i] < 0 || indexes[i] >= pVertexCount)
+			continue;
+		bool zero = true;
+		for (int c = 0; c < 3 && zero; c++)
+		{
+			zero = fabsf(vertices[i * 3 + c]) <= pEpsilon;
+			if (zero && hasNormals)
+				zero = fabsf(normals[i * 3 + c]) <= pEpsilon;
+		}
+		if (!zero)
+			kept.push_back(i);
+	}
+	// Exporters write indexes in order, but nothing guarantees it.
+	struct ByIndex
+	{
+		const std::vector<int>* indexes;
+		bool operator()(size_t a, size_t b) const { return (*indexes)[a] < (*indexes)[b]; }
+	} byIndex = { &indexes };
+	if (!std::is_sorted(kept.begin(), kept.end(), byIndex))
+		std::stable_sort(kept.begin(), kept.end(), byIndex);
+
+	pOut.name = pShape.name;
+	pOut.indices.resize(kept.size());
+	pOut.positions.resize(kept.size() * 3);
+	pOut.normals.resize(hasNormals ? kept.size() * 3 : 0);
+	for (size_t k = 0; k < kept.size(); k++)
+	{
+		const size_t i = kept[k];
+		pOut.indices[k] = (uint32_t)indexes[i];
+		memcpy(&pOut.positions[k * 3], &vertices[i * 3], 3 * sizeof(float));
+		if (hasNormals)
+			memcpy(&pOut.normals[k * 3], &normals[i * 3], 3 * sizeof(float));
+	}
+	return true;
+}
+
+}
+
+size_t SparseBlendShapes::GetByteSize() const
+{
+	size_t bytes = 0;
+	for (size_t t = 0; t < targets.size(); t++)
+	{
+		bytes += targets[t].indices.size() * sizeof(uint32_t);
+		bytes += (targets[t].positions.size() + targets[t].normals.size()) * sizeof(float);
+	}
+	return bytes;
+}
+
+size_t SparseBlendShapes::GetDenseByteSize() const
+{
+	return targets.size() * (size_t)vertexCount * 3 * sizeof(float) * (hasNormals ? 2 : 1);
+}
+
+bool ExtractBlendShapes(const Mesh& pMesh, float pEpsilon, SparseBlendShapes& pOut)
+{
+	pOut = SparseBlendShapes();
+	pOut.vertexCount = pMesh.GetControlPointsCount();
+	for (size_t b = 0; b < pMesh.blendShapes.size(); b++)
+	{
+		const BlendShape* blendShape = pMesh.blendShapes[b];
+		for (size_t c = 0; c < blendShape->channels.size(); c++)
+		{
+			const BlendShapeChannel* channel = blendShape->channels[c];
+			std::vector<double> fullWeights;
+			channel->fullWeights.CopyTo(fullWeights);
+
+			SparseChannel sparse;
+			sparse.name = channel->name;
+			sparse.defaultWeight = (float)channel->deformPercent;
+			sparse.firstTarget = (int)pOut.targets.size();
+			sparse.targetCount = (int)channel->shapes.size();
+			for (size_t s = 0; s < channel->shapes.size(); s++)
+			{
+				pOut.targets.push_back(SparseTarget());
+				SparseTarget& target = pOut.targets.back();
+				if (!ExtractTarget(*channel->shapes[s], pOut.vertexCount, pEpsilon, target))
+					return false;
+				// Without FullWeights the targets are spread evenly up to 100%.
+				target.fullWeight = s < fullWeights.size() ? (float)fullWeights[s] :
+					100.0f * (float)(s + 1) / (float)channel->shapes.size();
+				pOut.hasNormals = pOut.hasNormals || !target.normals.empty();
+			}
+			std::stable_sort(pOut.targets.begin() + sparse.firstTarget, pOut.targets.end(), HasLowerFullWeight);
+			pOut.channels.push_back(sparse);
+		}
+	}
+	return !pOut.channels.empty();
+}
+
+void GetTargetWeights(const SparseBlendShapes& pShapes, const float* pChannelWeights, std::vector<float>& pOut)
+{
+	pOut.assign(pShapes.targets.size(), 0.0f);
+	for (size_t c = 0; c < pShapes.channels.size(); c++)
+	{
+		const SparseChannel& channel = pShapes.channels[c];
+		if (!channel.targetCount)
+			continue;
+		const float weight = pChannelWeights[c];
+		const SparseTarget* targets = &pShapes.targets[channel.firstTarget];
+		float* out = &pOut[channel.firstTarget];
+		if (channel.targetCount == 1 || weight <= targets[0].fullWeight)
+		{
+			out[0] = targets[0].fullWeight != 0.0f ? weight / targets[0].fullWeight : 0.0f;
+			continue;
+		}
+		// Past the last full weight, the last pair extrapolates.
+		int k = 0;
+		while (k + 2 < channel.targetCount && weight > targets[k + 1].fullWeight)
+			k++;
+		const float span = targets[k + 1].fullWeight - targets[k].fullWeight;
+		const float u = span > 0.0f ? (weight - targets[k].fullWeight) / span : 1.0f;
+		out[k] = 1.0f - u;
+		out[k + 1] = u;
+	}
+}
+
+void ApplyBlendShapes(const SparseBlendShapes& pShapes, const float* pTargetWeights, const float* pBasePositions,
+	const float* pBaseNormals, float* pOutPositions, float* pOutNormals)
+{
+	std::vector<ActiveTarget> active;
+	for (size_t t = 0; t < pShapes.targets.size(); t++)
+	{
+		if (pTargetWeights[t] != 0.0f && pShapes.targets[t].GetCount())
+		{
+			ActiveTarget target = { &pShapes.targets[t], pTargetWeights[t], 0 };
+			active.push_back(target);
+		}
+	}
+
+	const bool normals = pBaseNormals && pOutNormals;
+	for (int start = 0; start < pShapes.vertexCount; start += kBlockVertices)
+	{
+		const int end = std::min(start + kBlockVertices, pShapes.vertexCount);
+		const size_t blockFloats = (size_t)(end - start) * 3;
+		if (pOutPositions != pBasePositions)
+			memcpy(pOutPositions + (size_t)start * 3, pBasePositions + (size_t)start * 3, blockFloats * sizeof(float));
+		if (normals && pOutNormals != pBaseNormals)
+			memcpy(pOutNormals + (size_t)start * 3, pBaseNormals + (size_t)start * 3, blockFloats * sizeof(float));
+
+		for (size_t a = 0; a < active.size(); a++)
+		{
+			const SparseTarget& target = *active[a].target;
+			const float weight = active[a].weight;
+			const size_t first = active[a].cursor;
+			size_t k = first;
+			for (; k < target.indices.size() && target.indices[k] < (uint32_t)end; k++)
+			{
+				float* out = pOutPositions + (size_t)target.indices[k] * 3;
+				const float* delta = &target.positions[k * 3];
+				out[0] += weight * delta[0];
+				out[1] += weight * delta[1];
+				out[2] += weight * delta[2];
+			}
+			if (normals && !target.normals.empty())
+			{
+				for (size_t n = first; n < k; n++)
+				{
+					float* out = pOutNormals + (size_t)target.indices[n] * 3;
+					const float* delta = &target.normals[n * 3];
+					out[0] += weight * delta[0];
+					out[1] += weight * delta[1];
+					out[2] += weight * delta[2];
+				}
+			}
+			active[a].cursor = k;
+		}
+	}
+}
+
+}
@@ -0,0 +1,94 @@
+#ifndef FBX_BLEND_SHAPE_H
+#define FBX_BLEND_SHAPE_H
+
+#include "fbx_scene.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace fbxl {
+
+/**
+* One blend shape target as sparse deltas: the control points it moves, in
+* increasing order, and their xyz position offsets and, when the shape has
+* them, normal offsets. Points the target leaves in place are not stored.
+*/
+struct SparseTarget
+{
+	std::string name;
+	float fullWeight;
+	std::vector<uint32_t> indices;
+	std::vector<float> positions;
+	std::vector<float> normals;
+
+	SparseTarget() : fullWeight(100.0f) {}
+
+	size_t GetCount() const { return indices.size(); }
+};
+
+/**
+* A channel's targets are targets[firstTarget, firstTarget + targetCount),
+* ordered by increasing fullWeight (in-betweens first).
+*/
+struct SparseChannel
+{
+	std::string name;
+	float defaultWeight;
+	int firstTarget;
+	int targetCount;
+};
+
+/**
+* Every blend shape channel of a mesh, with the targets of all channels in
+* one array.
+*/
+struct SparseBlendShapes
+{
+	int vertexCount;
+	bool hasNormals;
+	std::vector<SparseChannel> channels;
+	std::vector<SparseTarget> targets;
+
+	SparseBlendShapes() : vertexCount(0), hasNormals(false) {}
+
+	/**
+	* Bytes the sparse targets hold, and what the same targets would hold
+	* as full control point copies (positions, plus normals if any target
+	* has them).
+	*/
+	size_t GetByteSize() const;
+	size_t GetDenseByteSize() const;
+};
+
+/**
+* Read every blend shape of pMesh into pOut, dropping deltas whose position
+* and normal components are all within pEpsilon of zero. Returns false if
+* the mesh has no blend shape or a shape's arrays could not be decoded.
+*/
+bool ExtractBlendShapes(const Mesh& pMesh, float pEpsilon, SparseBlendShapes& pOut);
+
+/**
+* Turn channel weights, in percent like DeformPercent, into one factor per
+* target. A channel with a single target scales it by weight / fullWeight;
+* one with in-betweens blends linearly between the two targets whose full
+* weights surround its weight, going from the base mesh to the first.
+*/
+void GetTargetWeights(const SparseBlendShapes& pShapes, const float* pChannelWeights, std::vector<float>& pOut);
+
+/**
+* Apply every target with a non-zero factor in pTargetWeights to the base
+* control points in a single pass: the output is walked in blocks small
+* enough to stay in cache, and within a block each active target adds the
+* deltas that fall into it, reading its arrays front to back. Targets with
+* a zero factor cost nothing. pOutPositions may equal pBasePositions.
+* Normals are only blended when both pBaseNormals and pOutNormals are given,
+* and are not renormalized.
+*/
+void ApplyBlendShapes(const SparseBlendShapes& pShapes, const float* pTargetWeights, const float* pBasePositions,
+	const float* pBaseNormals, float* pOutPositions, float* pOutNormals);
+
+}
+
+#endif
@@ -0,0 +1,269 @@
+#include "fbx_cache.h"
+#include "fbx_hash.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <errno.h>
+#include <sys/stat.h>
+#endif
+
+namespace fbxl {
+
+namespace {
+
+const char kIndexName[] = "index.txt";
+const char kIndexHeader[] = "fbx_loader cache 1";
+
+bool MakeDirectory(const std::string& pPath)
+{
+#ifdef _WIN32
+	return CreateDirectoryA(pPath.c_str(), NULL) || GetLastError() == ERROR_ALREADY_EXISTS;
+#else
+	return mkdir(pPath.c_str(), 0755) == 0 || errno == EEXIST;
+#endif
+}
+
+bool ReadWholeFile(const std::string& pPath, std::string& pOut)
+{
+	FILE* file = fopen(pPath.c_str(), "rb");
+	if (!file)
+		return false;
+	pOut.clear();
+	char buffer[64 * 1024];
+	size_t read;
+	while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0)
+		pOut.append(buffer, read);
+	bool ok = !ferror(file);
+	fclose(file);
+	return ok;
+}
+
+bool WriteWholeFile(const std::string& pPath, const std::string& pData)
+{
+	FILE* file = fopen(pPath.c_str(), "wb");
+	if (!file)
+		return false;
+	bool ok = fwrite(pData.data(), 1, pData.size(), file) == pData.size();
+	return fclose(file) == 0 && ok;
+}
+
+bool ReplaceFile(const std::string& pFrom, const std::string& pTo)
+{
+#ifdef _WIN32
+	return MoveFileExA(pFrom.c_str(), pTo.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+	return rename(pFrom.c_str(), pTo.c_str()) == 0;
+#endif
+}
+
+}
+
+ConversionCache::ConversionCache()
+	: mMaxBytes(0)
+	, mTotalBytes(0)
+	, mClock(0)
+	, mOpen(false)
+	, mDirty(false)
+{
+	memset(&mStats, 0, sizeof(mStats));
+}
+
+ConversionCache::~ConversionCache()
+{
+	Flush();
+}
+
+std::string ConversionCache::MakeKey(const unsigned char* pData, size_t pSize, const std::string& pOptions)
+{
+	uint64_t seed = HashBytes(pOptions.data(), pOptions.size());
+	char key[64];
+	sprintf(key, "%016llx-%llx", (unsigned long long)HashBytes(pData, pSize, seed), (unsigned long long)pSize);
+	return key;
+}
+
+std::string ConversionCache::EntryPath(const std::string& pKey) const
+{
+	return mDirectory + "/" + pKey;
+}
+
+bool ConversionCache::Open(const std::string& pDirectory, uint64_t pMaxBytes)
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	mDirectory = pDirectory;
+	mMaxBytes = pMaxBytes;
+	mTotalBytes = 0;
+	mClock = 0;
+	mEntries.clear();
+	mByUse.clear();
+	memset(&mStats, 0, sizeof(mStats));
+	mOpen = false;
+	mDirty = false;
+	if (!MakeDirectory(pDirectory))
+	{
+		mError = "cannot create cache directory '" + pDirectory + "'";
+		return false;
+	}
+
+	// A missing or unreadable index just means an empty cache.
+	FILE* index = fopen((pDirectory + "/" + kIndexName).c_str(), "rb");
+	if (index)
+	{
+		char line[256];
+		if (fgets(line, sizeof(line), index) && strncmp(line, kIndexHeader, strlen(kIndexHeader)) == 0)
+		{
+			char key[128];
+			unsigned long long size, lastUse;
+			while (fgets(line, sizeof(line), index))
+			{
+				if (sscanf(line, "%127s %llu %llu", key, &size, &lastUse) != 3 || mEntries.count(key) || mByUse.count(lastUse))
+					continue;
+				Entry entry = { size, lastUse };
+				mEntries[key] = entry;
+				mByUse[lastUse] = key;
+				mTotalBytes += size;
+				if (lastUse >= mClock)
+					mClock = lastUse + 1;
+			}
+		}
+		fclose(index);
+	}
+	mOpen = true;
+	Evict();
+	return true;
+}
+
+bool ConversionCache::Flush()
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	if (!mOpen || !mDirty)
+		return true;
+
+	std::string text = std::string(kIndexHeader) + "\n";
+	for (std::map<uint64_t, std::string>::const_iterator it = mByUse.begin(); it != mByUse.end(); ++it)
+	{
+		char line[256];
+		sprintf(line, "%s %llu %llu\n", it->second.c_str(),
+			(unsigned long long)mEntries[it->second].size, (unsigned long long)it->first);
+		text += line;
+	}
+	std::string path = mDirectory + "/" + kIndexName;
+	if (!WriteWholeFile(path + ".tmp", text) || !ReplaceFile(path + ".tmp", path))
+	{
+		mError = "cannot write cache index '" + path + "'";
+		return false;
+	}
+	mDirty = false;
+	return true;
+}
+
+void ConversionCache::Touch(std::map<std::string, Entry>::iterator pEntry)
+{
+	mByUse.erase(pEntry->second.lastUse);
+	pEntry->second.lastUse = mClock++;
+	mByUse[pEntry->second.lastUse] = pEntry->first;
+	mDirty = true;
+}
+
+void ConversionCache::Remove(std::map<std::string, Entry>::iterator pEntry)
+{
+	remove(EntryPath(pEntry->first).c_str());
+	mByUse.erase(pEntry->second.lastUse);
+	mTotalBytes -= pEntry->second.size;
+	mEntries.erase(pEntry);
+	mDirty = true;
+}
+
+void ConversionCache::Evict()
+{
+	while (mTotalBytes > mMaxBytes && !mByUse.empty())
+	{
+		Remove(mEntries.find(mByUse.begin()->second));
+		++mStats.evictions;
+	}
+}
+
+bool ConversionCache::Lookup(const std::string& pKey, std::string& pPayload)
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		std::map<std::string, Entry>::iterator found = mEntries.find(pKey);
+		if (!mOpen || found == mEntries.end())
+		{
+			++mStats.misses;
+			return false;
+		}
+		Touch(found);
+	}
+
+	if (ReadWholeFile(EntryPath(pKey), pPayload))
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		++mStats.hits;
+		return true;
+	}
+
+	// Deleted behind our back, or evicted by another thread meanwhile.
+	std::lock_guard<std::mutex> lock(mMutex);
+	std::map<std::string, Entry>::iterator found = mEntries.find(pKey);
+	if (found != mEntries.end())
+		Remove(found);
+	++mStats.misses;
+	return false;
+}
+
+bool ConversionCache::Store(const std::string& pKey, const std::string& pPayload)
+{
+	std::string temporary;
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		if (!mOpen || pPayload.size() > mMaxBytes)
+			return false;
+		char suffix[32];
+		sprintf(suffix, ".%llu.tmp", (unsigned long long)mClock++);
+		temporary = EntryPath(pKey) + suffix;
+	}
+
+	// Written under a private name and renamed into place, so a reader never
+	// sees a half-written entry.
+	if (!WriteWholeFile(temporary, pPayload) || !ReplaceFile(temporary, EntryPath(pKey)))
+	{
+		remove(temporary.c_str());
+		return false;
+	}
+
+	std::lock_guard<std::mutex> lock(mMutex);
+	std::map<std::string, Entry>::iterator found = mEntries.find(pKey);
+	if (found != mEntries.end())
+	{
+		mTotalBytes -= found->second.size;
+		found->second.size = pPayload.size();
+		Touch(found);
+	}
+	else
+	{
+		Entry entry = { pPayload.size(), mClock++ };
+		mEntries[pKey] = entry;
+		mByUse[entry.lastUse] = pKey;
+		mDirty = true;
+	}
+	mTotalBytes += pPayload.size();
+	++mStats.stores;
+	Evict();
+	return true;
+}
+
+CacheStats ConversionCache::GetStats()
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	CacheStats stats = mStats;
+	stats.bytes = mTotalBytes;
+	stats.entries = mEntries.size();
+	return stats;
+}
+
+}
@@ -0,0 +1,99 @@
+#ifndef FBX_CACHE_H
+#define FBX_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <map>
+#include <mutex>
+#include <string>
+
+namespace fbxl {
+
+/**
+* What a ConversionCache did since it was opened.
+*/
+struct CacheStats
+{
+	size_t hits;
+	size_t misses;
+	size_t stores;
+	size_t evictions;
+	uint64_t bytes;
+	size_t entries;
+};
+
+/**
+* On-disk cache of conversion results, keyed by a hash of the source file's
+* bytes and the conversion options, so a renamed or touched file still hits
+* and an edited one misses. Entries live as one file each in the cache
+* directory; an index file keeps their sizes and use order, and the least
+* recently used entries are deleted once the total exceeds the size limit.
+* All methods may be called from several threads at once.
+*/
+class ConversionCache
+{
+public:
+	ConversionCache();
+	~ConversionCache();
+
+	/**
+	* Use pDirectory (created if missing) holding at most pMaxBytes of
+	* entries.
+	*/
+	bool Open(const std::string& pDirectory, uint64_t pMaxBytes);
+
+	/**
+	* Write the index back. Also done on destruction.
+	*/
+	bool Flush();
+
+	/**
+	* Key for converting the file contents pData with pOptions (a string
+	* naming the output format and anything else the output depends on).
+	*/
+	static std::string MakeKey(const unsigned char* pData, size_t pSize, const std::string& pOptions);
+
+	/**
+	* Fetch the entry for pKey into pPayload and mark it most recently used.
+	*/
+	bool Lookup(const std::string& pKey, std::string& pPayload);
+
+	/**
+	* Add or replace the entry for pKey, evicting old entries as needed.
+	*/
+	bool Store(const std::string& pKey, const std::string& pPayload);
+
+	CacheStats GetStats();
+	const std::string& GetError() const { return mError; }
+
+private:
+	ConversionCache(const ConversionCache&);
+	ConversionCache& operator=(const ConversionCache&);
+
+	struct Entry
+	{
+		uint64_t size;
+		uint64_t lastUse;
+	};
+
+	std::string EntryPath(const std::string& pKey) const;
+	void Touch(std::map<std::string, Entry>::iterator pEntry);
+	void Remove(std::map<std::string, Entry>::iterator pEntry);
+	void Evict();
+
+	std::mutex mMutex;
+	std::string mDirectory;
+	std::string mError;
+	uint64_t mMaxBytes;
+	uint64_t mTotalBytes;
+	uint64_t mClock;
+	std::map<std::string, Entry> mEntries;
+	std::map<uint64_t, std::string> mByUse;
+	CacheStats mStats;
+	bool mOpen;
+	bool mDirty;
+};
+
+}
+
+#endif
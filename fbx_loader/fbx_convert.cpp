@@ -0,0 +1,291 @@
+#include "fbx_convert.h"
+
+#include <string.h>
+#include <algorithm>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define FBX_CONVERT_SSE
+#include <xmmintrin.h>
+#endif
+
+namespace fbxl {
+
+namespace {
+
+bool IsValid(const AxisSystem& pSystem)
+{
+	const int axes[3] = { pSystem.upAxis, pSystem.frontAxis, pSystem.coordAxis };
+	const int signs[3] = { pSystem.upSign, pSystem.frontSign, pSystem.coordSign };
+	for (int i = 0; i < 3; i++)
+	{
+		if (axes[i] < 0 || axes[i] > 2 || (signs[i] != 1 && signs[i] != -1))
+			return false;
+	}
+	return axes[0] != axes[1] && axes[1] != axes[2] && axes[0] != axes[2];
+}
+
+/**
+* pData = pMatrix * pData for pCount xyz triples, pMatrix being 3x3 floats
+* column by column.
+*/
+void Transform3(const float* pMatrix, float* pData, size_t pCount)
+{
+	size_t i = 0;
+#ifdef FBX_CONVERT_SSE
+	const __m128 m0 = _mm_set1_ps(pMatrix[0]), m1 = _mm_set1_ps(pMatrix[1]), m2 = _mm_set1_ps(pMatrix[2]);
+	const __m128 m3 = _mm_set1_ps(pMatrix[3]), m4 = _mm_set1_ps(pMatrix[4]), m5 = _mm_set1_ps(pMatrix[5]);
+	const __m128 m6 = _mm_set1_ps(pMatrix[6]), m7 = _mm_set1_ps(pMatrix[7]), m8 = _mm_set1_ps(pMatrix[8]);
+	for (; i + 4 <= pCount; i += 4)
+	{
+		float* p = pData + i * 3;
+		// (x0 y0 z0 x1) (y1 z1 x2 y2) (z2 x3 y3 z3) -> (x0 x1 x2 x3) ...
+		const __m128 v0 = _mm_loadu_ps(p);
+		const __m128 v1 = _mm_loadu_ps(p + 4);
+		const __m128 v2 = _mm_loadu_ps(p + 8);
+		const __m128 x = _mm_shuffle_ps(v0, _mm_shuffle_ps(v1, v2, _MM_SHUFFLE(1, 1, 2, 2)), _MM_SHUFFLE(2, 0, 3, 0));
+		const __m128 y = _mm_shuffle_ps(_mm_shuffle_ps(v0, v1, _MM_SHUFFLE(0, 0, 1, 1)),
+			_mm_shuffle_ps(v1, v2, _MM_SHUFFLE(2, 2, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0));
+		const __m128 z = _mm_shuffle_ps(_mm_shuffle_ps(v0, v1, _MM_SHUFFLE(1, 1, 2, 2)), v2, _MM_SHUFFLE(3, 0, 2, 0));
+
+		const __m128 rx = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m0, x), _mm_mul_ps(m3, y)), _mm_mul_ps(m6, z));
+		const __m128 ry = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m1, x), _mm_mul_ps(m4, y)), _mm_mul_ps(m7, z));
+		const __m128 rz = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m2, x), _mm_mul_ps(m5, y)), _mm_mul_ps(m8, z));
+
+		_mm_storeu_ps(p, _mm_shuffle_ps(_mm_shuffle_ps(rx, ry, _MM_SHUFFLE(0, 0, 0, 0)),
+			_mm_shuffle_ps(rz, rx, _MM_SHUFFLE(1, 1, 0, 0)), _MM_SHUFFLE(2, 0, 2, 0)));
+		_mm_storeu_ps(p + 4, _mm_shuffle_ps(_mm_shuffle_ps(ry, rz, _MM_SHUFFLE(1, 1, 1, 1)),
+			_mm_shuffle_ps(rx, ry, _MM_SHUFFLE(2, 2, 2, 2)), _MM_SHUFFLE(2, 0, 2, 0)));
+		_mm_storeu_ps(p + 8, _mm_shuffle_ps(_mm_shuffle_ps(rz, rx, _MM_SHUFFLE(3, 3, 2, 2)),
+			_mm_shuffle_ps(ry, rz, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0)));
+	}
+#endif
+	for (; i < pCount; i++)
+	{
+		float* p = pData + i * 3;
+		const float x = p[0], y = p[1], z = p[2];
+		p[0] = pMatrix[0] * x + pMatrix[3] * y + pMatrix[6] * z;
+		p[1] = pMatrix[1] * x + pMatrix[4] * y + pMatrix[7] * z;
+		p[2] = pMatrix[2] * x + pMatrix[5] * y + pMatrix[8] * z;
+	}
+}
+
+/**
+* Move the three streams of one channel group to their new axes, each
+* multiplied by its factor: stream pStreams[c] ends up in
+* pStreams[axes[c]]. pCount is a multiple of four when SSE is used.
+*/
+void PermuteStreams(const AxisConversion& pConversion, float* const* pStreams, const float* pFactors, size_t pCount)
+{
+	size_t i = 0;
+#ifdef FBX_CONVERT_SSE
+	const __m128 f0 = _mm_set1_ps(pFactors[0]), f1 = _mm_set1_ps(pFactors[1]), f2 = _mm_set1_ps(pFactors[2]);
+	for (; i + 4 <= pCount; i += 4)
+	{
+		const __m128 v0 = _mm_mul_ps(f0, _mm_loadu_ps(pStreams[0] + i));
+		const __m128 v1 = _mm_mul_ps(f1, _mm_loadu_ps(pStreams[1] + i));
+		const __m128 v2 = _mm_mul_ps(f2, _mm_loadu_ps(pStreams[2] + i));
+		_mm_storeu_ps(pStreams[pConversion.axes[0]] + i, v0);
+		_mm_storeu_ps(pStreams[pConversion.axes[1]] + i, v1);
+		_mm_storeu_ps(pStreams[pConversion.axes[2]] + i, v2);
+	}
+#endif
+	for (; i < pCount; i++)
+	{
+		const float v0 = pFactors[0] * pStreams[0][i], v1 = pFactors[1] * pStreams[1][i], v2 = pFactors[2] * pStreams[2][i];
+		pStreams[pConversion.axes[0]][i] = v0;
+		pStreams[pConversion.axes[1]][i] = v1;
+		pStreams[pConversion.axes[2]][i] = v2;
+	}
+}
+
+/**
+* Factors PermuteStreams applies to translations, Euler angles and
+* scalings.
+*/
+void GetChannelFactors(const AxisConversion& pConversion, float (*pFactors)[3])
+{
+	const float reflection = pConversion.flipsHandedness ? -1.0f : 1.0f;
+	for (int c = 0; c < 3; c++)
+	{
+		pFactors[0][c] = pConversion.signs[c] * pConversion.scale;
+		pFactors[1][c] = pConversion.signs[c] * reflection;
+		pFactors[2][c] = 1.0f;
+	}
+}
+
+template <typename Index>
+void ReversePolygons(const std::vector<int>& pStarts, std::vector<Index>& pIndices)
+{
+	for (size_t p = 0; p + 1 < pStarts.size(); p++)
+	{
+		if (pStarts[p + 1] - pStarts[p] > 2)
+			std::reverse(pIndices.begin() + pStarts[p] + 1, pIndices.begin() + pStarts[p + 1]);
+	}
+}
+
+}
+
+AxisConversion::AxisConversion() : scale(1.0f), flipsHandedness(false)
+{
+	for (int c = 0; c < 3; c++)
+	{
+		axes[c] = c;
+		signs[c] = 1.0f;
+	}
+	for (int i = 0; i < 9; i++)
+		matrix[i] = i % 4 == 0 ? 1.0f : 0.0f;
+}
+
+bool AxisConversion::IsIdentity() const
+{
+	for (int i = 0; i < 9; i++)
+	{
+		if (matrix[i] != (i % 4 == 0 ? 1.0f : 0.0f))
+			return false;
+	}
+	return true;
+}
+
+bool GetAxisConversion(const AxisSystem& pFrom, double pFromUnit, const AxisSystem& pTo, double pToUnit,
+	AxisConversion& pOut)
+{
+	if (!IsValid(pFrom) || !IsValid(pTo) || !(pFromUnit > 0.0) || !(pToUnit > 0.0))
+		return false;
+	pOut = AxisConversion();
+	// The up, front and side components are the same numbers in both
+	// systems; only the axes and signs holding them differ.
+	pOut.axes[pFrom.upAxis] = pTo.upAxis;
+	pOut.signs[pFrom.upAxis] = (float)(pFrom.upSign * pTo.upSign);
+	pOut.axes[pFrom.frontAxis] = pTo.frontAxis;
+	pOut.signs[pFrom.frontAxis] = (float)(pFrom.frontSign * pTo.frontSign);
+	pOut.axes[pFrom.coordAxis] = pTo.coordAxis;
+	pOut.signs[pFrom.coordAxis] = (float)(pFrom.coordSign * pTo.coordSign);
+	pOut.scale = (float)(pFromUnit / pToUnit);
+
+	// The determinant is the sign of the permutation times the signs.
+	int inversions = 0;
+	for (int a = 0; a < 3; a++)
+	{
+		for (int b = a + 1; b < 3; b++)
+			inversions += pOut.axes[a] > pOut.axes[b];
+	}
+	const float determinant = (inversions % 2 ? -1.0f : 1.0f) * pOut.signs[0] * pOut.signs[1] * pOut.signs[2];
+	pOut.flipsHandedness = determinant < 0.0f;
+
+	for (int i = 0; i < 9; i++)
+		pOut.matrix[i] = 0.0f;
+	for (int c = 0; c < 3; c++)
+		pOut.matrix[c * 3 + pOut.axes[c]] = pOut.signs[c] * pOut.scale;
+	return true;
+}
+
+void ConvertPoints(const AxisConversion& pConversion, float* pPoints, size_t pCount)
+{
+	Transform3(pConversion.matrix, pPoints, pCount);
+}
+
+void ConvertDirections(const AxisConversion& pConversion, float* pDirections, size_t pCount)
+{
+	float basis[9] = { 0.0f };
+	for (int c = 0; c < 3; c++)
+		basis[c * 3 + pConversion.axes[c]] = pConversion.signs[c];
+	Transform3(basis, pDirections, pCount);
+}
+
+void ReverseWinding(uint32_t* pTriangles, size_t pCount)
+{
+	for (size_t t = 0; t < pCount; t++)
+	{
+		const uint32_t second = pTriangles[t * 3 + 1];
+		pTriangles[t * 3 + 1] = pTriangles[t * 3 + 2];
+		pTriangles[t * 3 + 2] = second;
+	}
+}
+
+void ConvertIndexedMesh(const AxisConversion& pConversion, IndexedMeshF& pMesh, std::vector<uint32_t>& pTriangles)
+{
+	if (!pMesh.positions.empty())
+		ConvertPoints(pConversion, &pMesh.positions[0], pMesh.positions.size() / 3);
+	std::vector<float>* directions[] = { &pMesh.normals, &pMesh.tangents, &pMesh.binormals };
+	for (int i = 0; i < 3; i++)
+	{
+		if (!directions[i]->empty())
+			ConvertDirections(pConversion, &(*directions[i])[0], directions[i]->size() / 3);
+	}
+	if (!pConversion.flipsHandedness)
+		return;
+	if (pMesh.indices32.empty())
+		ReversePolygons(pMesh.polygonStarts, pMesh.indices16);
+	else
+		ReversePolygons(pMesh.polygonStarts, pMesh.indices32);
+	if (!pTriangles.empty())
+		ReverseWinding(&pTriangles[0], pTriangles.size() / 3);
+}
+
+void ConvertMatrix(const AxisConversion& pConversion, float* pMatrix)
+{
+	float out[16];
+	memcpy(out, pMatrix, sizeof(out));
+	for (int c = 0; c < 3; c++)
+	{
+		for (int r = 0; r < 3; r++)
+			out[pConversion.axes[c] * 4 + pConversion.axes[r]] = pConversion.signs[r] * pConversion.signs[c] * pMatrix[c * 4 + r];
+		out[12 + pConversion.axes[c]] = pConversion.signs[c] * pConversion.scale * pMatrix[12 + c];
+	}
+	memcpy(pMatrix, out, sizeof(out));
+}
+
+void ConvertFlatHierarchy(const AxisConversion& pConversion, FlatHierarchy& pHierarchy)
+{
+	for (int i = 0; i < pHierarchy.GetNodeCount(); i++)
+	{
+		ConvertMatrix(pConversion, &pHierarchy.pre[(size_t)i * 16]);
+		ConvertMatrix(pConversion, &pHierarchy.post[(size_t)i * 16]);
+		ConvertPoints(pConversion, &pHierarchy.scalingPivots[(size_t)i * 3], 1);
+
+		const int* axes = kRotationOrderAxes[pHierarchy.rotationOrders[i]];
+		const int renamed[3] = { pConversion.axes[axes[0]], pConversion.axes[axes[1]], pConversion.axes[axes[2]] };
+		for (int order = 0; order < 6; order++)
+		{
+			if (memcmp(kRotationOrderAxes[order], renamed, sizeof(renamed)) == 0)
+			{
+				pHierarchy.rotationOrders[i] = (unsigned char)order;
+				break;
+			}
+		}
+	}
+}
+
+void ConvertPose(const AxisConversion& pConversion, float* pPose, size_t pCount)
+{
+	float factors[3][3];
+	GetChannelFactors(pConversion, factors);
+	for (size_t n = 0; n < pCount; n++)
+	{
+		for (int group = 0; group < 3; group++)
+		{
+			float* channels = pPose + n * kPoseStride + group * 3;
+			float* streams[3] = { channels, channels + 1, channels + 2 };
+			PermuteStreams(pConversion, streams, factors[group], 1);
+		}
+	}
+}
+
+void ConvertBakedAnimation(const AxisConversion& pConversion, BakedAnimation& pAnimation)
+{
+	float factors[3][3];
+	GetChannelFactors(pConversion, factors);
+	for (size_t n = 0; n < pAnimation.nodes.size(); n++)
+	{
+		for (int group = 0; group < 3; group++)
+		{
+			float* streams[3];
+			for (int c = 0; c < 3; c++)
+				streams[c] = &pAnimation.samples[(n * eAnimChannelCount + group * 3 + c) * pAnimation.frameStride];
+			// Streams are padded to frameStride, a multiple of four.
+			PermuteStreams(pConversion, streams, factors[group], pAnimation.frameStride);
+		}
+	}
+}
+
+}
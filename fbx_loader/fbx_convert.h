@@ -0,0 +1,113 @@
+#ifndef FBX_CONVERT_H
+#define FBX_CONVERT_H
+
+#include "fbx_anim.h"
+#include "fbx_scene.h"
+#include "fbx_transform.h"
+#include "fbx_weld.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace fbxl {
+
+const double kCentimetersPerMeter = 100.0;
+
+/**
+* Z up, -Y front and X to the side, right handed: a Y-up asset turned a
+* quarter turn about X.
+*/
+const AxisSystem kZUpAxisSystem(2, 1, 1, -1, 0, 1);
+
+/**
+* A change of axis system and unit as one matrix, C = scale * basis. FBX
+* axis systems are signed axes, so the basis is a signed permutation: file
+* axis c becomes axis axes[c] with sign signs[c]. matrix is C column by
+* column, as 3x3 floats. flipsHandedness is set when the basis is a
+* reflection, which turns every triangle inside out unless its winding is
+* reversed too.
+*/
+struct AxisConversion
+{
+	int axes[3];
+	float signs[3];
+	float scale;
+	float matrix[9];
+	bool flipsHandedness;
+
+	AxisConversion();
+
+	bool IsIdentity() const;
+};
+
+/**
+* The conversion from pFrom in units of pFromUnit centimetres to pTo in
+* units of pToUnit. False when either system does not name three different
+* axes or a unit is not positive.
+*/
+bool GetAxisConversion(const AxisSystem& pFrom, double pFromUnit, const AxisSystem& pTo, double pToUnit,
+	AxisConversion& pOut);
+
+/**
+* Multiply pCount xyz points in place by the conversion matrix. Four points
+* at a time are split into x, y and z vectors with SSE shuffles, transformed
+* and interleaved back, so the array is read and written once.
+*/
+void ConvertPoints(const AxisConversion& pConversion, float* pPoints, size_t pCount);
+
+/**
+* The same for directions (normals, tangents, binormals), which take the
+* basis but not the scale; the basis is orthonormal, so lengths are kept.
+*/
+void ConvertDirections(const AxisConversion& pConversion, float* pDirections, size_t pCount);
+
+/**
+* Swap the last two corners of each of pCount triangles.
+*/
+void ReverseWinding(uint32_t* pTriangles, size_t pCount);
+
+/**
+* Convert pMesh in place: positions, normals, tangents and binormals, and,
+* when the handedness flips, the winding of pMesh's polygons (all but the
+* first corner reversed, so polygon starts and triangulations stay valid)
+* and of pTriangles.
+*/
+void ConvertIndexedMesh(const AxisConversion& pConversion, IndexedMeshF& pMesh, std::vector<uint32_t>& pTriangles);
+
+/**
+* pMatrix = C * pMatrix * C^-1 for a 16-float affine matrix, such as a
+* node's global matrix or a cluster's bind matrix. The scale cancels out of
+* the 3x3 part and the basis is a signed permutation, so this only moves
+* and negates elements.
+*/
+void ConvertMatrix(const AxisConversion& pConversion, float* pMatrix);
+
+/**
+* Convert pHierarchy so that, with poses converted by ConvertPose or
+* ConvertBakedAnimation, every global matrix G becomes C * G * C^-1: a
+* converted mesh under a converted node lands where C would put the
+* original. Pre and post matrices are conjugated by C, scaling pivots
+* transformed, and rotation orders renamed, since a rotation about file
+* axis c becomes one about axis axes[c].
+*/
+void ConvertFlatHierarchy(const AxisConversion& pConversion, FlatHierarchy& pHierarchy);
+
+/**
+* Convert pCount poses of kPoseStride floats in place: translation by the
+* matrix, Euler angles moved to their new axes (negated where the axis
+* flips, and all of them under a reflection), scaling moved to its new
+* axes.
+*/
+void ConvertPose(const AxisConversion& pConversion, float* pPose, size_t pCount);
+
+/**
+* ConvertPose for every frame of pAnimation, a whole stream at a time:
+* translations four frames per SSE product, rotations and scalings by
+* moving and negating streams.
+*/
+void ConvertBakedAnimation(const AxisConversion& pConversion, BakedAnimation& pAnimation);
+
+}
+
+#endif
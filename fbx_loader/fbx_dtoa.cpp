@@ -0,0 +1,391 @@
+#include "fbx_dtoa.h"
+
+#include <stdint.h>
+#include <string.h>
+
+namespace fbxl {
+
+namespace {
+
+/**
+* f * 2^e with a full 64-bit significand.
+*/
+struct DiyFp
+{
+	uint64_t f;
+	int e;
+
+	DiyFp() : f(0), e(0) {}
+	DiyFp(uint64_t pF, int pE) : f(pF), e(pE) {}
+};
+
+/**
+* Upper 64 bits of the 128-bit product, rounded.
+*/
+inline DiyFp Multiply(const DiyFp& a, const DiyFp& b)
+{
+	const uint64_t mask = 0xFFFFFFFFULL;
+	uint64_t ah = a.f >> 32, al = a.f & mask;
+	uint64_t bh = b.f >> 32, bl = b.f & mask;
+	uint64_t hh = ah * bh, hl = ah * bl, lh = al * bh, ll = al * bl;
+	uint64_t middle = (ll >> 32) + (hl & mask) + (lh & mask) + (1ULL << 31);
+	return DiyFp(hh + (hl >> 32) + (lh >> 32) + (middle >> 32), a.e + b.e + 64);
+}
+
+/**
+* Shift pValue.f (not 0) left until its top bit is set.
+*/
+inline DiyFp Normalize(DiyFp pValue)
+{
+	static const int kSteps[] = { 32, 16, 8, 4, 2, 1 };
+	for (int i = 0; i < 6; i++)
+	{
+		if (!(pValue.f >> (64 - kSteps[i])))
+		{
+			pValue.f <<= kSteps[i];
+			pValue.e -= kSteps[i];
+		}
+	}
+	return pValue;
+}
+
+/**
+* 10^k for k = -348, -340, ..., 340, normalized and rounded to nearest.
+*/
+const uint64_t kCachedPowersF[] = {
+	0xfa8fd5a0081c0288ULL, 0xbaaee17fa23ebf76ULL, 0x8b16fb203055ac76ULL, 0xcf42894a5dce35eaULL,
+	0x9a6bb0aa55653b2dULL, 0xe61acf033d1a45dfULL, 0xab70fe17c79ac6caULL, 0xff77b1fcbebcdc4fULL,
+	0xbe5691ef416bd60cULL, 0x8dd01fad907ffc3cULL, 0xd3515c2831559a83ULL, 0x9d71ac8fada6c9b5ULL,
+	0xea9c227723ee8bcbULL, 0xaecc49914078536dULL, 0x823c12795db6ce57ULL, 0xc21094364dfb5637ULL,
+	0x9096ea6f3848984fULL, 0xd77485cb25823ac7ULL, 0xa086cfcd97bf97f4ULL, 0xef340a98172aace5ULL,
+	0xb23867fb2a35b28eULL, 0x84c8d4dfd2c63f3bULL, 0xc5dd44271ad3cdbaULL, 0x936b9fcebb25c996ULL,
+	0xdbac6c247d62a584ULL, 0xa3ab66580d5fdaf6ULL, 0xf3e2f893dec3f126ULL, 0xb5b5ada8aaff80b8ULL,
+	0x87625f056c7c4a8bULL, 0xc9bcff6034c13053ULL, 0x964e858c91ba2655ULL, 0xdff9772470297ebdULL,
+	0xa6dfbd9fb8e5b88fULL, 0xf8a95fcf88747d94ULL, 0xb94470938fa89bcfULL, 0x8a08f0f8bf0f156bULL,
+	0xcdb02555653131b6ULL, 0x993fe2c6d07b7facULL, 0xe45c10c42a2b3b06ULL, 0xaa242499697392d3ULL,
+	0xfd87b5f28300ca0eULL, 0xbce5086492111aebULL, 0x8cbccc096f5088ccULL, 0xd1b71758e219652cULL,
+	0x9c40000000000000ULL, 0xe8d4a51000000000ULL, 0xad78ebc5ac620000ULL, 0x813f3978f8940984ULL,
+	0xc097ce7bc90715b3ULL, 0x8f7e32ce7bea5c70ULL, 0xd5d238a4abe98068ULL, 0x9f4f2726179a2245ULL,
+	0xed63a231d4c4fb27ULL, 0xb0de65388cc8ada8ULL, 0x83c7088e1aab65dbULL, 0xc45d1df942711d9aULL,
+	0x924d692ca61be758ULL, 0xda01ee641a708deaULL, 0xa26da3999aef774aULL, 0xf209787bb47d6b85ULL,
+	0xb454e4a179dd1877ULL, 0x865b86925b9bc5c2ULL, 0xc83553c5c8965d3dULL, 0x952ab45cfa97a0b3ULL,
+	0xde469fbd99a05fe3ULL, 0xa59bc234db398c25ULL, 0xf6c69a72a3989f5cULL, 0xb7dcbf5354e9beceULL,
+	0x88fcf317f22241e2ULL, 0xcc20ce9bd35c78a5ULL, 0x98165af37b2153dfULL, 0xe2a0b5dc971f303aULL,
+	0xa8d9d1535ce3b396ULL, 0xfb9b7cd9a4a7443cULL, 0xbb764c4ca7a44410ULL, 0x8bab8eefb6409c1aULL,
+	0xd01fef10a657842cULL, 0x9b10a4e5e9913129ULL, 0xe7109bfba19c0c9dULL, 0xac2820d9623bf429ULL,
+	0x80444b5e7aa7cf85ULL, 0xbf21e44003acdd2dULL, 0x8e679c2f5e44ff8fULL, 0xd433179d9c8cb841ULL,
+	0x9e19db92b4e31ba9ULL, 0xeb96bf6ebadf77d9ULL, 0xaf87023b9bf0ee6bULL,
+};
+
+const short kCachedPowersE[] = {
+	-1220, -1193, -1166, -1140, -1113, -1087, -1060, -1034, -1007, -980, -954,
+	-927, -901, -874, -847, -821, -794, -768, -741, -715, -688, -661,
+	-635, -608, -582, -555, -529, -502, -475, -449, -422, -396, -369,
+	-343, -316, -289, -263, -236, -210, -183, -157, -130, -103, -77,
+	-50, -24, 3, 30, 56, 83, 109, 136, 162, 189, 216,
+	242, 269, 295, 322, 348, 375, 402, 428, 455, 481, 508,
+	534, 561, 588, 614, 641, 667, 694, 720, 747, 774, 800,
+	827, 853, 880, 907, 933, 960, 986, 1013, 1039, 1066,
+};
+
+const uint64_t kPow10[] = {
+	1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL, 100000000ULL,
+	1000000000ULL, 10000000000ULL, 100000000000ULL, 1000000000000ULL, 10000000000000ULL,
+	100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL, 100000000000000000ULL,
+	1000000000000000000ULL, 10000000000000000000ULL
+};
+
+/**
+* Cached power c with c * 2^pExponent scaled into [2^-60, 2^-32]; pK gets
+* the decimal exponent to undo it.
+*/
+DiyFp GetCachedPower(int pExponent, int& pK)
+{
+	double dk = (-61 - pExponent) * 0.30102999566398114 + 347;
+	int k = (int)dk;
+	if (dk - k > 0.0)
+		k++;
+	unsigned index = (unsigned)((k >> 3) + 1);
+	pK = -(-348 + (int)(index << 3));
+	return DiyFp(kCachedPowersF[index], kCachedPowersE[index]);
+}
+
+int CountDecimalDigits(uint32_t pValue)
+{
+	int count = 1;
+	while (count < 10 && pValue >= kPow10[count])
+		count++;
+	return count;
+}
+
+/**
+* Move the last digit towards w while that stays inside the interval and
+* gets closer.
+*/
+void GrisuRound(char* pDigits, int pLength, uint64_t pDelta, uint64_t pRest, uint64_t pTenKappa, uint64_t pDistance)
+{
+	while (pRest < pDistance && pDelta - pRest >= pTenKappa &&
+		(pRest + pTenKappa < pDistance || pDistance - pRest > pRest + pTenKappa - pDistance))
+	{
+		pDigits[pLength - 1]--;
+		pRest += pTenKappa;
+	}
+}
+
+/**
+* Generate the fewest digits of a number in (pHigh - pDelta, pHigh], as close
+* to pValue as they can get.
+*/
+void GenerateDigits(const DiyFp& pValue, const DiyFp& pHigh, uint64_t pDelta, char* pDigits, int& pLength, int& pK)
+{
+	const DiyFp one(1ULL << -pHigh.e, pHigh.e);
+	const uint64_t distance = pHigh.f - pValue.f;
+	uint32_t integral = (uint32_t)(pHigh.f >> -one.e);
+	uint64_t fraction = pHigh.f & (one.f - 1);
+	int kappa = CountDecimalDigits(integral);
+	pLength = 0;
+
+	while (kappa > 0)
+	{
+		uint32_t divisor = (uint32_t)kPow10[kappa - 1];
+		uint32_t digit = integral / divisor;
+		integral %= divisor;
+		if (digit || pLength)
+			pDigits[pLength++] = (char)('0' + digit);
+		kappa--;
+		uint64_t rest = ((uint64_t)integral << -one.e) + fraction;
+		if (rest <= pDelta)
+		{
+			pK += kappa;
+			GrisuRound(pDigits, pLength, pDelta, rest, kPow10[kappa] << -one.e, distance);
+			return;
+		}
+	}
+
+	for (;;)
+	{
+		fraction *= 10;
+		pDelta *= 10;
+		char digit = (char)(fraction >> -one.e);
+		if (digit || pLength)
+			pDigits[pLength++] = (char)('0' + digit);
+		fraction &= one.f - 1;
+		kappa--;
+		if (fraction < pDelta)
+		{
+			pK += kappa;
+			int index = -kappa;
+			GrisuRound(pDigits, pLength, pDelta, fraction, one.f, distance * (index < 20 ? kPow10[index] : 0));
+			return;
+		}
+	}
+}
+
+/**
+* Shortest digits of pSignificand * 2^pExponent (> 0) that still round to
+* it, where the next representable values are half a unit of the significand
+* away on either side, or a quarter below for the lowest significand of a
+* binade (pLowerCloser).
+*/
+void Grisu2(uint64_t pSignificand, int pExponent, bool pLowerCloser, char* pDigits, int& pLength, int& pK)
+{
+	DiyFp upper = Normalize(DiyFp((pSignificand << 1) + 1, pExponent - 1));
+	DiyFp lower = pLowerCloser ? DiyFp((pSignificand << 2) - 1, pExponent - 2)
+		: DiyFp((pSignificand << 1) - 1, pExponent - 1);
+	lower.f <<= lower.e - upper.e;
+	lower.e = upper.e;
+
+	const DiyFp power = GetCachedPower(upper.e, pK);
+	const DiyFp w = Multiply(Normalize(DiyFp(pSignificand, pExponent)), power);
+	DiyFp high = Multiply(upper, power);
+	DiyFp low = Multiply(lower, power);
+	low.f++;
+	high.f--;
+	GenerateDigits(w, high, high.f - low.f, pDigits, pLength, pK);
+}
+
+int WriteExponent(int pExponent, char* pOut)
+{
+	char* out = pOut;
+	*out++ = 'e';
+	*out++ = pExponent < 0 ? '-' : '+';
+	if (pExponent < 0)
+		pExponent = -pExponent;
+	if (pExponent >= 100)
+	{
+		*out++ = (char)('0' + pExponent / 100);
+		pExponent %= 100;
+	}
+	*out++ = (char)('0' + pExponent / 10);
+	*out++ = (char)('0' + pExponent % 10);
+	return (int)(out - pOut);
+}
+
+/**
+* Lay out pLength digits times 10^pK: plainly when the decimal point falls
+* within 21 digits of them, with an exponent otherwise.
+*/
+int Layout(const char* pDigits, int pLength, int pK, char* pOut)
+{
+	char* out = pOut;
+	const int point = pLength + pK;
+	if (pK >= 0 && point <= 21)
+	{
+		memcpy(out, pDigits, pLength);
+		out += pLength;
+		for (int i = 0; i < pK; i++)
+			*out++ = '0';
+	}
+	else if (point > 0 && point <= 21)
+	{
+		memcpy(out, pDigits, point);
+		out += point;
+		*out++ = '.';
+		memcpy(out, pDigits + point, pLength - point);
+		out += pLength - point;
+	}
+	else if (point > -6 && point <= 0)
+	{
+		*out++ = '0';
+		*out++ = '.';
+		for (int i = point; i < 0; i++)
+			*out++ = '0';
+		memcpy(out, pDigits, pLength);
+		out += pLength;
+	}
+	else
+	{
+		*out++ = pDigits[0];
+		if (pLength > 1)
+		{
+			*out++ = '.';
+			memcpy(out, pDigits + 1, pLength - 1);
+			out += pLength - 1;
+		}
+		out += WriteExponent(point - 1, out);
+	}
+	*out = 0;
+	return (int)(out - pOut);
+}
+
+int CopyText(const char* pText, char* pOut)
+{
+	strcpy(pOut, pText);
+	return (int)strlen(pText);
+}
+
+int FormatShortest(uint64_t pSignificand, int pExponent, bool pLowerCloser, bool pNegative, char* pOut)
+{
+	char* out = pOut;
+	if (pNegative)
+		*out++ = '-';
+	char digits[24];
+	int length, k;
+	Grisu2(pSignificand, pExponent, pLowerCloser, digits, length, k);
+	return (int)(out - pOut) + Layout(digits, length, k, out);
+}
+
+}
+
+int FormatShortest(double pValue, char* pOut)
+{
+	uint64_t bits;
+	memcpy(&bits, &pValue, sizeof(bits));
+	const bool negative = (bits >> 63) != 0;
+	const int biased = (int)((bits >> 52) & 0x7FF);
+	const uint64_t fraction = bits & 0xFFFFFFFFFFFFFULL;
+	if (biased == 0x7FF)
+		return CopyText(fraction ? "nan" : negative ? "-inf" : "inf", pOut);
+	if (biased == 0 && fraction == 0)
+		return CopyText(negative ? "-0" : "0", pOut);
+	if (biased == 0)
+		return FormatShortest(fraction, -1074, false, negative, pOut);
+	return FormatShortest(fraction | (1ULL << 52), biased - 1075, fraction == 0 && biased > 1, negative, pOut);
+}
+
+int FormatShortest(float pValue, char* pOut)
+{
+	uint32_t bits;
+	memcpy(&bits, &pValue, sizeof(bits));
+	const bool negative = (bits >> 31) != 0;
+	const int biased = (int)((bits >> 23) & 0xFF);
+	const uint32_t fraction = bits & 0x7FFFFF;
+	if (biased == 0xFF)
+		return CopyText(fraction ? "nan" : negative ? "-inf" : "inf", pOut);
+	if (biased == 0 && fraction == 0)
+		return CopyText(negative ? "-0" : "0", pOut);
+	if (biased == 0)
+		return FormatShortest(fraction, -149, false, negative, pOut);
+	return FormatShortest(fraction | (1U << 23), biased - 150, fraction == 0 && biased > 1, negative, pOut);
+}
+
+int FormatFixed6(double pValue, char* pOut)
+{
+	uint64_t bits;
+	memcpy(&bits, &pValue, sizeof(bits));
+	const bool negative = (bits >> 63) != 0;
+	const int biased = (int)((bits >> 52) & 0x7FF);
+	const uint64_t fraction = bits & 0xFFFFFFFFFFFFFULL;
+	if (biased >= 1075)
+		return 0;
+
+	// pValue * 10^6 = significand * 10^6 * 2^-shift exactly, as a 128-bit
+	// product (hi, lo) shifted right with round-half-even, as printf does.
+	const uint64_t significand = biased ? fraction | (1ULL << 52) : fraction;
+	const int shift = biased ? 1075 - biased : 1074;
+	const uint64_t mask = 0xFFFFFFFFULL;
+	const uint64_t upper = (significand >> 32) * 1000000, lower = (significand & mask) * 1000000;
+	uint64_t lo = lower + (upper << 32);
+	uint64_t hi = (upper >> 32) + (lo < lower ? 1 : 0);
+
+	uint64_t scaled = 0;
+	bool roundUp = false;
+	if (shift < 64)
+	{
+		if (hi >> shift)
+			return 0;
+		scaled = (hi << (64 - shift)) | (lo >> shift);
+		uint64_t rest = lo & ((1ULL << shift) - 1);
+		uint64_t half = 1ULL << (shift - 1);
+		roundUp = rest > half || (rest == half && (scaled & 1));
+	}
+	else if (shift < 128)
+	{
+		int high = shift - 64;
+		scaled = hi >> high;
+		uint64_t restHi = high ? hi & ((1ULL << high) - 1) : 0;
+		uint64_t halfHi = high ? 1ULL << (high - 1) : 0;
+		uint64_t halfLo = high ? 0 : 1ULL << 63;
+		bool above = restHi > halfHi || (restHi == halfHi && lo > halfLo);
+		bool tie = restHi == halfHi && lo == halfLo;
+		roundUp = above || (tie && (scaled & 1));
+	}
+	if (roundUp && ++scaled == 0)
+		return 0;
+
+	char* out = pOut;
+	if (negative)
+		*out++ = '-';
+	uint64_t integral = scaled / 1000000;
+	uint32_t decimals = (uint32_t)(scaled % 1000000);
+	char reversed[24];
+	int count = 0;
+	do
+	{
+		reversed[count++] = (char)('0' + integral % 10);
+		integral /= 10;
+	} while (integral);
+	while (count)
+		*out++ = reversed[--count];
+	*out++ = '.';
+	for (int i = 5; i >= 0; i--)
+	{
+		out[i] = (char)('0' + decimals % 10);
+		decimals /= 10;
+	}
+	out += 6;
+	*out = 0;
+	return (int)(out - pOut);
+}
+
+}
@@ -0,0 +1,32 @@
+#ifndef FBX_DTOA_H
+#define FBX_DTOA_H
+
+namespace fbxl {
+
+/**
+* Longest text the formatters below produce, terminator included.
+*/
+const int kMaxNumberText = 32;
+
+/**
+* Write a decimal text that reads back as exactly pValue, e.g. "0.1", "12",
+* "1.5e-07", and return its length. Grisu2 finds the shortest such text for
+* all but a small fraction of values, and a slightly longer one for the
+* rest. The float overload stops at the digits a float needs, so 0.1f gives
+* "0.1" rather than the digits of its double value. NaN and infinities give
+* "nan", "inf", "-inf".
+*/
+int FormatShortest(double pValue, char* pOut);
+int FormatShortest(float pValue, char* pOut);
+
+/**
+* Write pValue with six decimals, byte for byte what printf("%f") gives,
+* and return its length, using integer arithmetic only. Returns 0 for NaN,
+* infinities and magnitudes of 10^13 and above, whose text can be far
+* longer; print those with printf.
+*/
+int FormatFixed6(double pValue, char* pOut);
+
+}
+
+#endif
@@ -0,0 +1,473 @@
+#include "fbx_dump.h"
+#include "fbx_writer.h"
+
+#include <float.h>
+#include <stdint.h>
+#include <string.h>
+
+namespace fbxl {
+
+namespace {
+
+const char kBase64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+int BlockElementSize(char pType)
+{
+	switch (pType)
+	{
+	case 'd': case 'l': return 8;
+	case 'f': case 'i': return 4;
+	case 'b': return 1;
+	default: return 0;
+	}
+}
+
+const char* BlockTypeName(char pType)
+{
+	switch (pType)
+	{
+	case 'd': return "f64";
+	case 'f': return "f32";
+	case 'l': return "i64";
+	case 'i': return "i32";
+	case 'b': return "u8";
+	default: return "";
+	}
+}
+
+/**
+* RFC 8746 typed array tag for little-endian elements of pType.
+*/
+int BlockTag(char pType)
+{
+	switch (pType)
+	{
+	case 'd': return 86;
+	case 'f': return 85;
+	case 'l': return 79;
+	case 'i': return 78;
+	default: return 64;
+	}
+}
+
+void WriteBase64(TextWriter& pOut, const unsigned char* pData, size_t pSize)
+{
+	char chunk[4096];
+	size_t i = 0;
+	while (i + 3 <= pSize)
+	{
+		int used = 0;
+		for (; i + 3 <= pSize && used < (int)sizeof(chunk); i += 3, used += 4)
+		{
+			unsigned value = (pData[i] << 16) | (pData[i + 1] << 8) | pData[i + 2];
+			chunk[used] = kBase64[value >> 18];
+			chunk[used + 1] = kBase64[(value >> 12) & 63];
+			chunk[used + 2] = kBase64[(value >> 6) & 63];
+			chunk[used + 3] = kBase64[value & 63];
+		}
+		pOut.WriteText(chunk, used);
+	}
+	if (i < pSize)
+	{
+		unsigned value = pData[i] << 16;
+		if (i + 1 < pSize)
+			value |= pData[i + 1] << 8;
+		chunk[0] = kBase64[value >> 18];
+		chunk[1] = kBase64[(value >> 12) & 63];
+		chunk[2] = i + 1 < pSize ? kBase64[(value >> 6) & 63] : '=';
+		chunk[3] = '=';
+		pOut.WriteText(chunk, 4);
+	}
+}
+
+const char* GetMappingModeName(LayerElement::EMappingMode pMode)
+{
+	switch (pMode)
+	{
+	case LayerElement::eByControlPoint: return "byControlPoint";
+	case LayerElement::eByPolygonVertex: return "byPolygonVertex";
+	case LayerElement::eByPolygon: return "byPolygon";
+	case LayerElement::eByEdge: return "byEdge";
+	case LayerElement::eAllSame: return "allSame";
+	default: return "none";
+	}
+}
+
+const char* GetReferenceModeName(LayerElement::EReferenceMode pMode)
+{
+	switch (pMode)
+	{
+	case LayerElement::eIndex: return "index";
+	case LayerElement::eIndexToDirect: return "indexToDirect";
+	default: return "direct";
+	}
+}
+
+void DumpText(DumpEncoder& pEncoder, const char* pKey, const std::string& pText)
+{
+	pEncoder.Key(pKey);
+	pEncoder.String(pText);
+}
+
+void DumpText(DumpEncoder& pEncoder, const char* pKey, const char* pText)
+{
+	pEncoder.Key(pKey);
+	pEncoder.String(pText, strlen(pText));
+}
+
+void DumpVector(DumpEncoder& pEncoder, const char* pKey, const double* pValues)
+{
+	pEncoder.Key(pKey);
+	pEncoder.BeginList();
+	for (int i = 0; i < 3; i++)
+		pEncoder.Real(pValues[i]);
+	pEncoder.EndList();
+}
+
+void DumpArray(DumpEncoder& pEncoder, const char* pKey, const ArrayView& pArray)
+{
+	if (pArray.Empty())
+		return;
+	pEncoder.Key(pKey);
+	pEncoder.Block(pArray.GetType(), pArray.GetData(), pArray.Size());
+}
+
+void DumpElement(DumpEncoder& pEncoder, const char* pKey, const LayerElement* pElement)
+{
+	if (!pElement)
+		return;
+	pEncoder.Key(pKey);
+	pEncoder.BeginMap();
+	DumpText(pEncoder, "name", pElement->name);
+	DumpText(pEncoder, "mappingMode", GetMappingModeName(pElement->mappingMode));
+	DumpText(pEncoder, "referenceMode", GetReferenceModeName(pElement->referenceMode));
+	pEncoder.Key("stride");
+	pEncoder.Int(pElement->stride);
+	DumpArray(pEncoder, "direct", pElement->directArray);
+	DumpArray(pEncoder, "index", pElement->indexArray);
+	pEncoder.EndMap();
+}
+
+void DumpMesh(DumpEncoder& pEncoder, const Mesh& pMesh)
+{
+	pEncoder.BeginMap();
+	DumpArray(pEncoder, "vertices", pMesh.vertices);
+	DumpArray(pEncoder, "polygonVertexIndex", pMesh.polygonVertexIndex);
+	pEncoder.Key("layers");
+	pEncoder.BeginList();
+	for (size_t i = 0; i < pMesh.layers.size(); i++)
+	{
+		const Layer& layer = pMesh.layers[i];
+		pEncoder.BeginMap();
+		DumpElement(pEncoder, "normals", layer.normals);
+		DumpElement(pEncoder, "binormals", layer.binormals);
+		DumpElement(pEncoder, "tangents", layer.tangents);
+		DumpElement(pEncoder, "uvs", layer.uvs);
+		DumpElement(pEncoder, "colors", layer.colors);
+		DumpElement(pEncoder, "materials", layer.materials);
+		pEncoder.Key("textures");
+		pEncoder.BeginList();
+		for (int channel = LayerElement::eTextureDiffuse; channel < LayerElement::eTypeCount; channel++)
+		{
+			for (size_t t = 0; t < layer.textures[channel].size(); t++)
+			{
+				pEncoder.BeginMap();
+				pEncoder.Key("channel");
+				pEncoder.Int(channel);
+				DumpText(pEncoder, "fileName", layer.textures[channel][t]->fileName);
+				pEncoder.EndMap();
+			}
+		}
+		pEncoder.EndList();
+		pEncoder.EndMap();
+	}
+	pEncoder.EndList();
+	pEncoder.EndMap();
+}
+
+void DumpNode(DumpEncoder& pEncoder, const Node& pNode)
+{
+	pEncoder.BeginMap();
+	DumpText(pEncoder, "name", pNode.name);
+	DumpVector(pEncoder, "translation", pNode.translation);
+	DumpVector(pEncoder, "rotation", pNode.rotation);
+	DumpVector(pEncoder, "scaling", pNode.scaling);
+
+	pEncoder.Key("attributes");
+	pEncoder.BeginList();
+	for (size_t i = 0; i < pNode.attributes.size(); i++)
+	{
+		const NodeAttribute* attribute = pNode.attributes[i];
+		pEncoder.BeginMap();
+		pEncoder.Key("type");
+		pEncoder.Int(attribute->type);
+		DumpText(pEncoder, "name", attribute->name);
+		if (attribute->mesh)
+		{
+			pEncoder.Key("mesh");
+			DumpMesh(pEncoder, *attribute->mesh);
+		}
+		pEncoder.EndMap();
+	}
+	pEncoder.EndList();
+
+	pEncoder.Key("materials");
+	pEncoder.BeginList();
+	for (size_t i = 0; i < pNode.materials.size(); i++)
+		pEncoder.String(pNode.materials[i]->name);
+	pEncoder.EndList();
+
+	pEncoder.Key("children");
+	pEncoder.BeginList();
+	for (size_t i = 0; i < pNode.children.size(); i++)
+		DumpNode(pEncoder, *pNode.children[i]);
+	pEncoder.EndList();
+	pEncoder.EndMap();
+}
+
+}
+
+void JsonEncoder::Separate()
+{
+	if (mAfterKey)
+		mAfterKey = false;
+	else if (!mFirst.empty())
+	{
+		if (!mFirst.back())
+			mOut.WriteChar(',');
+		mFirst.back() = false;
+	}
+}
+
+void JsonEncoder::Begin(char pBracket)
+{
+	Separate();
+	mOut.WriteChar(pBracket);
+	mFirst.push_back(true);
+}
+
+void JsonEncoder::End(char pBracket)
+{
+	mFirst.pop_back();
+	mOut.WriteChar(pBracket);
+	if (mFirst.empty())
+		mOut.WriteChar('\n');
+}
+
+void JsonEncoder::BeginMap()
+{
+	Begin('{');
+}
+
+void JsonEncoder::EndMap()
+{
+	End('}');
+}
+
+void JsonEncoder::BeginList()
+{
+	Begin('[');
+}
+
+void JsonEncoder::EndList()
+{
+	End(']');
+}
+
+void JsonEncoder::Key(const char* pName)
+{
+	String(pName, strlen(pName));
+	mOut.WriteChar(':');
+	mAfterKey = true;
+}
+
+void JsonEncoder::String(const char* pText, size_t pLength)
+{
+	static const char kHex[] = "0123456789abcdef";
+	Separate();
+	mOut.WriteChar('"');
+	size_t plain = 0;
+	for (size_t i = 0; i < pLength; i++)
+	{
+		unsigned char c = (unsigned char)pText[i];
+		if (c >= 0x20 && c != '"' && c != '\\')
+			continue;
+		mOut.WriteText(pText + plain, i - plain);
+		plain = i + 1;
+		mOut.WriteChar('\\');
+		switch (c)
+		{
+		case '"': mOut.WriteChar('"'); break;
+		case '\\': mOut.WriteChar('\\'); break;
+		case '\n': mOut.WriteChar('n'); break;
+		case '\r': mOut.WriteChar('r'); break;
+		case '\t': mOut.WriteChar('t'); break;
+		default:
+			mOut.WriteText("u00", 3);
+			mOut.WriteChar(kHex[c >> 4]);
+			mOut.WriteChar(kHex[c & 15]);
+			break;
+		}
+	}
+	mOut.WriteText(pText + plain, pLength - plain);
+	mOut.WriteChar('"');
+}
+
+void JsonEncoder::Int(long long pValue)
+{
+	Separate();
+	mOut.WriteInt(pValue);
+}
+
+void JsonEncoder::Real(double pValue)
+{
+	Separate();
+	if (pValue - pValue == 0.0)
+		mOut.WriteReal(pValue);
+	else
+		mOut.WriteText("null", 4);
+}
+
+void JsonEncoder::Block(char pType, const void* pData, size_t pCount)
+{
+	BeginMap();
+	Key("type");
+	String(BlockTypeName(pType), strlen(BlockTypeName(pType)));
+	Key("count");
+	Int((long long)pCount);
+	Key("base64");
+	Separate();
+	mOut.WriteChar('"');
+	WriteBase64(mOut, (const unsigned char*)pData, pCount * BlockElementSize(pType));
+	mOut.WriteChar('"');
+	EndMap();
+}
+
+CborEncoder::CborEncoder(TextWriter& pOut)
+	: mOut(pOut)
+{
+	// Tag 55799: marks the stream as CBOR for tools that sniff content.
+	mOut.WriteText("\xD9\xD9\xF7", 3);
+}
+
+void CborEncoder::Head(int pMajor, unsigned long long pValue)
+{
+	unsigned char head[9];
+	int size;
+	if (pValue < 24)
+	{
+		head[0] = (unsigned char)((pMajor << 5) | pValue);
+		size = 1;
+	}
+	else
+	{
+		int bytes = pValue <= 0xFF ? 1 : pValue <= 0xFFFF ? 2 : pValue <= 0xFFFFFFFFULL ? 4 : 8;
+		head[0] = (unsigned char)((pMajor << 5) | (bytes == 1 ? 24 : bytes == 2 ? 25 : bytes == 4 ? 26 : 27));
+		for (int i = 0; i < bytes; i++)
+			head[1 + i] = (unsigned char)(pValue >> (8 * (bytes - 1 - i)));
+		size = 1 + bytes;
+	}
+	mOut.WriteText((const char*)head, size);
+}
+
+void CborEncoder::BeginMap()
+{
+	mOut.WriteChar((char)0xBF);
+}
+
+void CborEncoder::EndMap()
+{
+	mOut.WriteChar((char)0xFF);
+}
+
+void CborEncoder::BeginList()
+{
+	mOut.WriteChar((char)0x9F);
+}
+
+void CborEncoder::EndList()
+{
+	mOut.WriteChar((char)0xFF);
+}
+
+void CborEncoder::Key(const char* pName)
+{
+	String(pName, strlen(pName));
+}
+
+void CborEncoder::String(const char* pText, size_t pLength)
+{
+	Head(3, pLength);
+	mOut.WriteText(pText, pLength);
+}
+
+void CborEncoder::Int(long long pValue)
+{
+	if (pValue < 0)
+		Head(1, (unsigned long long)(-(pValue + 1)));
+	else
+		Head(0, (unsigned long long)pValue);
+}
+
+void CborEncoder::Real(double pValue)
+{
+	unsigned char bytes[9];
+	int size;
+	if (pValue >= -FLT_MAX && pValue <= FLT_MAX && (double)(float)pValue == pValue)
+	{
+		float single = (float)pValue;
+		uint32_t bits;
+		memcpy(&bits, &single, 4);
+		bytes[0] = 0xFA;
+		for (int i = 0; i < 4; i++)
+			bytes[1 + i] = (unsigned char)(bits >> (24 - 8 * i));
+		size = 5;
+	}
+	else
+	{
+		uint64_t bits;
+		memcpy(&bits, &pValue, 8);
+		bytes[0] = 0xFB;
+		for (int i = 0; i < 8; i++)
+			bytes[1 + i] = (unsigned char)(bits >> (56 - 8 * i));
+		size = 9;
+	}
+	mOut.WriteText((const char*)bytes, size);
+}
+
+void CborEncoder::Block(char pType, const void* pData, size_t pCount)
+{
+	size_t size = pCount * BlockElementSize(pType);
+	Head(6, BlockTag(pType));
+	Head(2, size);
+	mOut.WriteText((const char*)pData, size);
+}
+
+void DumpScene(const Scene& pScene, DumpEncoder& pEncoder)
+{
+	pEncoder.BeginMap();
+	pEncoder.Key("nodes");
+	pEncoder.BeginList();
+	for (size_t i = 0; i < pScene.root.children.size(); i++)
+		DumpNode(pEncoder, *pScene.root.children[i]);
+	pEncoder.EndList();
+
+	pEncoder.Key("animStacks");
+	pEncoder.BeginList();
+	for (size_t i = 0; i < pScene.animStacks.size(); i++)
+	{
+		const AnimStack& stack = pScene.animStacks[i];
+		pEncoder.BeginMap();
+		DumpText(pEncoder, "name", stack.name);
+		pEncoder.Key("layers");
+		pEncoder.BeginList();
+		for (size_t j = 0; j < stack.layers.size(); j++)
+			pEncoder.String(stack.layers[j]->name);
+		pEncoder.EndList();
+		pEncoder.EndMap();
+	}
+	pEncoder.EndList();
+	pEncoder.EndMap();
+}
+
+}
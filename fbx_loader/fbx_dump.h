@@ -0,0 +1,124 @@
+#ifndef FBX_DUMP_H
+#define FBX_DUMP_H
+
+#include "fbx_scene.h"
+
+#include <stddef.h>
+#include <vector>
+
+namespace fbxl {
+
+class TextWriter;
+
+/**
+* Receives a scene as a stream of events - maps of named fields, lists,
+* scalars and typed arrays - and encodes each one as it arrives, so nothing
+* is built up in memory first.
+*/
+class DumpEncoder
+{
+public:
+	virtual ~DumpEncoder() {}
+
+	virtual void BeginMap() = 0;
+	virtual void EndMap() = 0;
+	virtual void BeginList() = 0;
+	virtual void EndList() = 0;
+
+	/**
+	* Name of the next value in the current map.
+	*/
+	virtual void Key(const char* pName) = 0;
+
+	virtual void String(const char* pText, size_t pLength) = 0;
+	virtual void Int(long long pValue) = 0;
+	virtual void Real(double pValue) = 0;
+
+	/**
+	* pCount raw little-endian elements of FBX array type pType ('d', 'f',
+	* 'l', 'i' or 'b'), written as one block rather than value by value.
+	*/
+	virtual void Block(char pType, const void* pData, size_t pCount) = 0;
+
+	void String(const std::string& pText) { String(pText.data(), pText.size()); }
+};
+
+/**
+* JSON. Blocks become {"type": "f64", "count": n, "base64": "..."} with
+* type one of f64, f32, i64, i32, u8, and the little-endian elements base64
+* encoded. NaN and infinities, which JSON cannot hold, become null.
+*/
+class JsonEncoder : public DumpEncoder
+{
+public:
+	explicit JsonEncoder(TextWriter& pOut) : mOut(pOut), mAfterKey(false) {}
+
+	virtual void BeginMap();
+	virtual void EndMap();
+	virtual void BeginList();
+	virtual void EndList();
+	virtual void Key(const char* pName);
+	virtual void String(const char* pText, size_t pLength);
+	virtual void Int(long long pValue);
+	virtual void Real(double pValue);
+	virtual void Block(char pType, const void* pData, size_t pCount);
+
+	using DumpEncoder::String;
+
+private:
+	void Separate();
+	void Begin(char pBracket);
+	void End(char pBracket);
+
+	TextWriter& mOut;
+	std::vector<bool> mFirst;
+	bool mAfterKey;
+};
+
+/**
+* CBOR (RFC 8949), opened with the self-describe tag. Maps and lists use
+* indefinite lengths so they can be streamed. Reals that a float holds
+* exactly are stored as floats. Blocks are RFC 8746 typed arrays: a tag
+* naming the little-endian element type around a byte string of the raw
+* elements, which a reader can use in place.
+*/
+class CborEncoder : public DumpEncoder
+{
+public:
+	explicit CborEncoder(TextWriter& pOut);
+
+	virtual void BeginMap();
+	virtual void EndMap();
+	virtual void BeginList();
+	virtual void EndList();
+	virtual void Key(const char* pName);
+	virtual void String(const char* pText, size_t pLength);
+	virtual void Int(long long pValue);
+	virtual void Real(double pValue);
+	virtual void Block(char pType, const void* pData, size_t pCount);
+
+	using DumpEncoder::String;
+
+private:
+	void Head(int pMajor, unsigned long long pValue);
+
+	TextWriter& mOut;
+};
+
+/**
+* Walk pScene and send it to pEncoder:
+*   { "nodes": [node...], "animStacks": [{"name", "layers": [name...]}] }
+* A node is {"name", "translation", "rotation", "scaling", "attributes",
+* "materials", "children"}. Attributes hold their NodeAttribute::EType
+* "type" and "name", and a mesh attribute carries "mesh" with its
+* "vertices" and "polygonVertexIndex" blocks (the latter as stored, the last
+* vertex of each polygon as ~index) and its "layers". Layer elements keep
+* their "mappingMode", "referenceMode", "stride", "direct" and "index"
+* blocks, and textures list their LayerElement::EType "channel" and
+* "fileName". Every array is dumped whole.
+*/
+void DumpScene(const Scene& pScene, DumpEncoder& pEncoder);
+
+}
+
+#endif
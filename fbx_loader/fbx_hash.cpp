@@ -0,0 +1,107 @@
+#include "fbx_hash.h"
+
+#include <string.h>
+
+namespace fbxl {
+
+namespace {
+
+const uint64_t kPrime1 = 0x9E3779B185EBCA87ULL;
+const uint64_t kPrime2 = 0xC2B2AE3D27D4EB4FULL;
+const uint64_t kPrime3 = 0x165667B19E3779F9ULL;
+const uint64_t kPrime4 = 0x85EBCA77C2B2AE63ULL;
+const uint64_t kPrime5 = 0x27D4EB2F165667C5ULL;
+
+inline uint64_t RotateLeft(uint64_t pValue, int pBits)
+{
+	return (pValue << pBits) | (pValue >> (64 - pBits));
+}
+
+inline uint64_t Read64(const unsigned char* p)
+{
+	uint64_t v;
+	memcpy(&v, p, 8);
+	return v;
+}
+
+inline uint32_t Read32(const unsigned char* p)
+{
+	uint32_t v;
+	memcpy(&v, p, 4);
+	return v;
+}
+
+inline uint64_t Round(uint64_t pAccumulator, uint64_t pInput)
+{
+	pAccumulator += pInput * kPrime2;
+	pAccumulator = RotateLeft(pAccumulator, 31);
+	return pAccumulator * kPrime1;
+}
+
+inline uint64_t MergeRound(uint64_t pAccumulator, uint64_t pValue)
+{
+	pAccumulator ^= Round(0, pValue);
+	return pAccumulator * kPrime1 + kPrime4;
+}
+
+}
+
+uint64_t HashBytes(const void* pData, size_t pSize, uint64_t pSeed)
+{
+	const unsigned char* p = (const unsigned char*)pData;
+	const unsigned char* end = p + pSize;
+	uint64_t hash;
+
+	if (pSize >= 32)
+	{
+		uint64_t v1 = pSeed + kPrime1 + kPrime2;
+		uint64_t v2 = pSeed + kPrime2;
+		uint64_t v3 = pSeed;
+		uint64_t v4 = pSeed - kPrime1;
+		const unsigned char* limit = end - 32;
+		do
+		{
+			v1 = Round(v1, Read64(p));
+			v2 = Round(v2, Read64(p + 8));
+			v3 = Round(v3, Read64(p + 16));
+			v4 = Round(v4, Read64(p + 24));
+			p += 32;
+		} while (p <= limit);
+
+		hash = RotateLeft(v1, 1) + RotateLeft(v2, 7) + RotateLeft(v3, 12) + RotateLeft(v4, 18);
+		hash = MergeRound(hash, v1);
+		hash = MergeRound(hash, v2);
+		hash = MergeRound(hash, v3);
+		hash = MergeRound(hash, v4);
+	}
+	else
+		hash = pSeed + kPrime5;
+
+	hash += (uint64_t)pSize;
+
+	for (; p + 8 <= end; p += 8)
+	{
+		hash ^= Round(0, Read64(p));
+		hash = RotateLeft(hash, 27) * kPrime1 + kPrime4;
+	}
+	if (p + 4 <= end)
+	{
+		hash ^= (uint64_t)Read32(p) * kPrime1;
+		hash = RotateLeft(hash, 23) * kPrime2 + kPrime3;
+		p += 4;
+	}
+	for (; p < end; p++)
+	{
+		hash ^= (uint64_t)*p * kPrime5;
+		hash = RotateLeft(hash, 11) * kPrime1;
+	}
+
+	hash ^= hash >> 33;
+	hash *= kPrime2;
+	hash ^= hash >> 29;
+	hash *= kPrime3;
+	hash ^= hash >> 32;
+	return hash;
+}
+
+}
@@ -0,0 +1,17 @@
+#ifndef FBX_HASH_H
+#define FBX_HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace fbxl {
+
+/**
+* 64-bit XXH64 hash of pSize bytes. Reads eight bytes at a time in four
+* independent lanes, so it runs at memory speed on large files.
+*/
+uint64_t HashBytes(const void* pData, size_t pSize, uint64_t pSeed = 0);
+
+}
+
+#endif
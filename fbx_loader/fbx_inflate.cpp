@@ -0,0 +1,414 @@
+#include "fbx_inflate.h"
+
+#include <stdint.h>
+#include <string.h>
+
+namespace fbxl {
+
+namespace {
+
+const int kFastBits = 10;
+const int kMaxBits = 15;
+
+const unsigned short kLengthBase[29] = {
+	3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+	35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+const unsigned char kLengthExtra[29] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+	3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+const unsigned short kDistBase[30] = {
+	1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+	257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+const unsigned char kDistExtra[30] = {
+	0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+	7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+const unsigned char kCodeLengthOrder[19] = {
+	16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+/**
+* LSB-first bit reader over the compressed block. Reading past the end of the
+* input yields zero bits; the caller checks overrun() once the stream is done.
+*/
+struct BitStream
+{
+	const unsigned char* p;
+	const unsigned char* end;
+	uint64_t bits;
+	int count;
+	int padding;
+
+	void Refill()
+	{
+		while (count <= 56)
+		{
+			if (p < end)
+				bits |= (uint64_t)*p++ << count;
+			else
+				++padding;
+			count += 8;
+		}
+	}
+
+	unsigned Get(int n)
+	{
+		if (count < n)
+			Refill();
+		unsigned v = (unsigned)(bits & ((1ull << n) - 1));
+		bits >>= n;
+		count -= n;
+		return v;
+	}
+
+	bool Overrun() const { return padding * 8 > count; }
+};
+
+/**
+* Canonical Huffman decoding table: codes up to kFastBits long resolve with a
+* single lookup, longer ones fall back to a per-length walk.
+*/
+struct Huffman
+{
+	unsigned short fast[1 << kFastBits];
+	unsigned short count[kMaxBits + 1];
+	unsigned short symbol[288];
+};
+
+bool BuildHuffman(Huffman& h, const unsigned char* pLengths, int n)
+{
+	memset(h.count, 0, sizeof(h.count));
+	memset(h.fast, 0, sizeof(h.fast));
+	for (int i = 0; i < n; i++)
+		h.count[pLengths[i]]++;
+	h.count[0] = 0;
+
+	int left = 1;
+	for (int len = 1; len <= kMaxBits; len++)
+	{
+		left <<= 1;
+		left -= h.count[len];
+		if (left < 0)
+			return false;
+	}
+
+	unsigned short offsets[kMaxBits + 2];
+	unsigned short nextCode[kMaxBits + 1];
+	offsets[1] = 0;
+	int code = 0;
+	for (int len = 1; len <= kMaxBits; len++)
+	{
+		offsets[len + 1] = offsets[len] + h.count[len];
+		code = (code + (len > 1 ? h.count[len - 1] : 0)) << 1;
+		nextCode[len] = (unsigned short)code;
+	}
+
+	for (int sym = 0; sym < n; sym++)
+	{
+		int len = pLengths[sym];
+		if (len == 0)
+			continue;
+		h.symbol[offsets[len]++] = (unsigned short)sym;
+
+		int c = nextCode[len]++;
+		if (len <= kFastBits)
+		{
+			int reversed = 0;
+			for (int b = 0; b < len; b++)
+				reversed |= ((c >> b) & 1) << (len - 1 - b);
+			for (int k = reversed; k < (1 << kFastBits); k += 1 << len)
+				h.fast[k] = (unsigned short)((len << 9) | sym);
+		}
+	}
+	return true;
+}
+
+int Decode(BitStream& bs, const Huffman& h)
+{
+	if (bs.count < kMaxBits)
+		bs.Refill();
+
+	unsigned entry = h.fast[bs.bits & ((1u << kFastBits) - 1)];
+	if (entry)
+	{
+		int len = entry >> 9;
+		bs.bits >>= len;
+		bs.count -= len;
+		return entry & 511;
+	}
+
+	int code = 0, first = 0, index = 0;
+	for (int len = 1; len <= kMaxBits; len++)
+	{
+		code |= (int)((bs.bits >> (len - 1)) & 1);
+		int c = h.count[len];
+		if (code - c < first)
+		{
+			bs.bits >>= len;
+			bs.count -= len;
+			return h.symbol[index + (code - first)];
+		}
+		index += c;
+		first += c;
+		first <<= 1;
+		code <<= 1;
+	}
+	return -1;
+}
+
+/**
+* Output window. With truncate set, filling the window ends decoding early
+* (stopped) instead of being an error.
+*/
+struct Output
+{
+	unsigned char* begin;
+	unsigned char* cur;
+	unsigned char* end;
+	bool truncate;
+	bool stopped;
+
+	bool Full()
+	{
+		if (cur != end)
+			return false;
+		stopped = truncate;
+		return true;
+	}
+};
+
+bool InflateCodes(BitStream& bs, Output& out, const Huffman& lencode, const Huffman& distcode)
+{
+	for (;;)
+	{
+		int sym = Decode(bs, lencode);
+		if (sym < 0)
+			return false;
+		if (sym < 256)
+		{
+			if (out.Full())
+				return out.stopped;
+			*out.cur++ = (unsigned char)sym;
+			continue;
+		}
+		if (sym == 256)
+			return true;
+
+		sym -= 257;
+		if (sym >= 29)
+			return false;
+		size_t len = kLengthBase[sym] + bs.Get(kLengthExtra[sym]);
+
+		int dsym = Decode(bs, distcode);
+		if (dsym < 0 || dsym >= 30)
+			return false;
+		size_t dist = kDistBase[dsym] + bs.Get(kDistExtra[dsym]);
+
+		if (dist > (size_t)(out.cur - out.begin))
+			return false;
+		if (len > (size_t)(out.end - out.cur))
+		{
+			if (!out.truncate)
+				return false;
+			len = out.end - out.cur;
+			out.stopped = true;
+		}
+
+		const unsigned char* from = out.cur - dist;
+		if (dist >= len)
+		{
+			memcpy(out.cur, from, len);
+			out.cur += len;
+		}
+		else
+		{
+			while (len--)
+				*out.cur++ = *from++;
+		}
+		if (out.stopped)
+			return true;
+	}
+}
+
+bool InflateStored(BitStream& bs, Output& out)
+{
+	bs.Get(bs.count & 7);
+	unsigned len = bs.Get(16);
+	unsigned nlen = bs.Get(16);
+	if (len != (~nlen & 0xffff))
+		return false;
+	if (len > (size_t)(out.end - out.cur))
+	{
+		if (!out.truncate)
+			return false;
+		len = (unsigned)(out.end - out.cur);
+		out.stopped = true;
+	}
+
+	while (len && bs.count >= 8)
+	{
+		*out.cur++ = (unsigned char)bs.Get(8);
+		--len;
+	}
+	if (len > (size_t)(bs.end - bs.p))
+		return false;
+	memcpy(out.cur, bs.p, len);
+	out.cur += len;
+	bs.p += len;
+	return true;
+}
+
+bool InflateFixed(BitStream& bs, Output& out)
+{
+	unsigned char lengths[288 + 30];
+	int i = 0;
+	for (; i < 144; i++) lengths[i] = 8;
+	for (; i < 256; i++) lengths[i] = 9;
+	for (; i < 280; i++) lengths[i] = 7;
+	for (; i < 288; i++) lengths[i] = 8;
+	for (; i < 288 + 30; i++) lengths[i] = 5;
+
+	Huffman lencode, distcode;
+	BuildHuffman(lencode, lengths, 288);
+	BuildHuffman(distcode, lengths + 288, 30);
+	return InflateCodes(bs, out, lencode, distcode);
+}
+
+bool InflateDynamic(BitStream& bs, Output& out)
+{
+	int nlen = bs.Get(5) + 257;
+	int ndist = bs.Get(5) + 1;
+	int ncode = bs.Get(4) + 4;
+	if (nlen > 286 || ndist > 30)
+		return false;
+
+	unsigned char lengths[288 + 32];
+	memset(lengths, 0, 19);
+	for (int i = 0; i < ncode; i++)
+		lengths[kCodeLengthOrder[i]] = (unsigned char)bs.Get(3);
+
+	Huffman lencode, distcode;
+	if (!BuildHuffman(lencode, lengths, 19))
+		return false;
+
+	int index = 0;
+	while (index < nlen + ndist)
+	{
+		int sym = Decode(bs, lencode);
+		if (sym < 0)
+			return false;
+		if (sym < 16)
+		{
+			lengths[index++] = (unsigned char)sym;
+			continue;
+		}
+
+		unsigned char value = 0;
+		int repeat;
+		if (sym == 16)
+		{
+			if (index == 0)
+				return false;
+			value = lengths[index - 1];
+			repeat = 3 + bs.Get(2);
+		}
+		else if (sym == 17)
+			repeat = 3 + bs.Get(3);
+		else
+			repeat = 11 + bs.Get(7);
+
+		if (index + repeat > nlen + ndist)
+			return false;
+		while (repeat--)
+			lengths[index++] = value;
+	}
+
+	if (lengths[256] == 0)
+		return false;
+	if (!BuildHuffman(lencode, lengths, nlen))
+		return false;
+	if (!BuildHuffman(distcode, lengths + nlen, ndist))
+		return false;
+	return InflateCodes(bs, out, lencode, distcode);
+}
+
+uint32_t Adler32(const unsigned char* p, size_t n)
+{
+	uint32_t a = 1, b = 0;
+	while (n)
+	{
+		size_t chunk = n < 5552 ? n : 5552;
+		n -= chunk;
+		while (chunk--)
+		{
+			a += *p++;
+			b += a;
+		}
+		a %= 65521;
+		b %= 65521;
+	}
+	return (b << 16) | a;
+}
+
+bool Inflate(const unsigned char* pSrc, size_t srcSize, unsigned char* pDst, size_t dstSize, bool pTruncate)
+{
+	if (srcSize < 6)
+		return false;
+	unsigned cmf = pSrc[0], flg = pSrc[1];
+	if ((cmf & 0x0f) != 8 || ((cmf << 8) | flg) % 31 != 0 || (flg & 0x20))
+		return false;
+
+	BitStream bs;
+	bs.p = pSrc + 2;
+	bs.end = pSrc + srcSize;
+	bs.bits = 0;
+	bs.count = 0;
+	bs.padding = 0;
+
+	Output out;
+	out.begin = out.cur = pDst;
+	out.end = pDst + dstSize;
+	out.truncate = pTruncate;
+	out.stopped = false;
+
+	bool last;
+	do
+	{
+		last = bs.Get(1) != 0;
+		bool ok;
+		switch (bs.Get(2))
+		{
+		case 0: ok = InflateStored(bs, out); break;
+		case 1: ok = InflateFixed(bs, out); break;
+		case 2: ok = InflateDynamic(bs, out); break;
+		default: ok = false; break;
+		}
+		if (!ok || bs.Overrun())
+			return false;
+		if (out.stopped)
+			return true;
+	} while (!last);
+
+	if (out.cur != out.end)
+		return false;
+
+	bs.Get(bs.count & 7);
+	uint32_t adler = 0;
+	for (int i = 0; i < 4; i++)
+		adler = (adler << 8) | bs.Get(8);
+	if (bs.Overrun())
+		return false;
+	return adler == Adler32(pDst, dstSize);
+}
+
+}
+
+bool ZlibInflate(const unsigned char* pSrc, size_t srcSize, unsigned char* pDst, size_t dstSize)
+{
+	return Inflate(pSrc, srcSize, pDst, dstSize, false);
+}
+
+bool ZlibInflatePrefix(const unsigned char* pSrc, size_t srcSize, unsigned char* pDst, size_t dstSize)
+{
+	return Inflate(pSrc, srcSize, pDst, dstSize, true);
+}
+
+}
@@ -0,0 +1,25 @@
+#ifndef FBX_INFLATE_H
+#define FBX_INFLATE_H
+
+#include <stddef.h>
+
+namespace fbxl {
+
+/**
+* Inflate a zlib stream (RFC 1950 header around RFC 1951 deflate data) into a
+* caller-provided buffer whose size is known up front, as it is for every
+* compressed FBX array. Returns false if the stream is malformed, if its
+* checksum does not match, or if it does not produce exactly dstSize bytes.
+*/
+bool ZlibInflate(const unsigned char* pSrc, size_t srcSize, unsigned char* pDst, size_t dstSize);
+
+/**
+* Inflate only the first dstSize bytes of a zlib stream and stop there. Used
+* to peek at the head of a large array without decoding all of it; the
+* checksum cannot be verified in that case.
+*/
+bool ZlibInflatePrefix(const unsigned char* pSrc, size_t srcSize, unsigned char* pDst, size_t dstSize);
+
+}
+
+#endif
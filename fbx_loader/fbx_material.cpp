@@ -0,0 +1,293 @@
+#include "fbx_material.h"
+#include "fbx_hash.h"
+
+#include <ctype.h>
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <set>
+
+namespace fbxl {
+
+namespace {
+
+const char* const kTextureSlotNames[kMaterialTextureSlots] = {
+	"DiffuseColor",
+	"DiffuseFactor",
+	"EmissiveColor",
+	"EmissiveFactor",
+	"AmbientColor",
+	"AmbientFactor",
+	"SpecularColor",
+	"SpecularFactor",
+	"ShininessExponent",
+	"NormalMap",
+	"Bump",
+	"TransparentColor",
+	"TransparencyFactor",
+	"ReflectionColor",
+	"ReflectionFactor",
+	"DisplacementColor",
+	"VectorDisplacementColor"
+};
+
+bool EqualsNoCase(const std::string& pText, const char* pOther)
+{
+	size_t i = 0;
+	for (; i < pText.size() && pOther[i]; i++)
+	{
+		if (tolower((unsigned char)pText[i]) != tolower((unsigned char)pOther[i]))
+			return false;
+	}
+	return i == pText.size() && !pOther[i];
+}
+
+/**
+* pValue as a float, with -0 made +0 so that it hashes like 0.
+*/
+float ToFloat(double pValue)
+{
+	return (float)pValue + 0.0f;
+}
+
+void ToFloats(const double* pValues, float* pOut)
+{
+	for (int i = 0; i < 3; i++)
+		pOut[i] = ToFloat(pValues[i]);
+}
+
+/**
+* pName, or pName followed by "_2", "_3" and so on if pTaken has it, added
+* to pTaken.
+*/
+std::string MakeUniqueName(const std::string& pName, std::set<std::string>& pTaken)
+{
+	std::string name = pName;
+	for (int n = 2; !pTaken.insert(name).second; n++)
+	{
+		char suffix[16];
+		sprintf(suffix, "_%d", n);
+		name = pName + suffix;
+	}
+	return name;
+}
+
+}
+
+const char* GetTextureSlotName(int pSlot)
+{
+	return pSlot >= 0 && pSlot < kMaterialTextureSlots ? kTextureSlotNames[pSlot] : "";
+}
+
+int MaterialTable::GetIndex(const Material* pMaterial) const
+{
+	std::map<const Material*, int>::const_iterator found = indices.find(pMaterial);
+	return found == indices.end() ? -1 : found->second;
+}
+
+void BuildMaterialTable(const Scene& pScene, MaterialTable& pOut)
+{
+	pOut.materials.clear();
+	pOut.sources.clear();
+	pOut.names.clear();
+	pOut.textures.clear();
+	pOut.indices.clear();
+
+	std::map<std::pair<std::string, std::string>, int> textureIndex;
+	std::multimap<uint64_t, int> materialIndex;
+	std::set<std::string> names;
+	for (size_t i = 0; i < pScene.materials.size(); i++)
+	{
+		const Material& material = pScene.materials[i];
+		FlatMaterial flat;
+		memset(&flat, 0, sizeof(flat));
+		flat.shadingModel = EqualsNoCase(material.shadingModel, "phong") ? eShadingPhong :
+			EqualsNoCase(material.shadingModel, "lambert") ? eShadingLambert : eShadingOther;
+		ToFloats(material.ambient, flat.ambient);
+		flat.ambientFactor = ToFloat(material.ambientFactor);
+		ToFloats(material.diffuse, flat.diffuse);
+		flat.diffuseFactor = ToFloat(material.diffuseFactor);
+		ToFloats(material.emissive, flat.emissive);
+		flat.emissiveFactor = ToFloat(material.emissiveFactor);
+		ToFloats(material.specular, flat.specular);
+		flat.specularFactor = ToFloat(material.specularFactor);
+		flat.shininess = ToFloat(material.shininess);
+		ToFloats(material.transparent, flat.transparent);
+		flat.transparencyFactor = ToFloat(material.transparencyFactor);
+		ToFloats(material.reflection, flat.reflection);
+		flat.reflectionFactor = ToFloat(material.reflectionFactor);
+		flat.bumpFactor = ToFloat(material.bumpFactor);
+		for (int c = 0; c < kMaterialTextureSlots; c++)
+		{
+			flat.textures[c] = -1;
+			const std::vector<const Texture*>& textures = material.textures[LayerElement::eTextureDiffuse + c];
+			if (textures.empty())
+				continue;
+			const std::pair<std::string, std::string> key(textures[0]->fileName, textures[0]->relativeFileName);
+			std::map<std::pair<std::string, std::string>, int>::iterator found = textureIndex.find(key);
+			if (found == textureIndex.end())
+			{
+				found = textureIndex.insert(std::make_pair(key, (int)pOut.textures.size())).first;
+				pOut.textures.push_back(textures[0]);
+			}
+			flat.textures[c] = found->second;
+		}
+
+		const uint64_t hash = HashBytes(&flat, sizeof(flat));
+		int index = -1;
+		std::pair<std::multimap<uint64_t, int>::iterator, std::multimap<uint64_t, int>::iterator> range =
+			materialIndex.equal_range(hash);
+		for (std::multimap<uint64_t, int>::iterator it = range.first; it != range.second && index < 0; ++it)
+		{
+			if (memcmp(&pOut.materials[it->second], &flat, sizeof(flat)) == 0)
+				index = it->second;
+		}
+		if (index < 0)
+		{
+			index = (int)pOut.materials.size();
+			pOut.materials.push_back(flat);
+			pOut.sources.push_back(&material);
+			pOut.names.push_back(MakeUniqueName(material.name.empty() ? "material" : material.name, names));
+			materialIndex.insert(std::make_pair(hash, index));
+		}
+		pOut.indices[&material] = index;
+	}
+}
+
+void GetNodeMaterials(const MaterialTable& pTable, const Node& pNode, std::vector<int>& pOut)
+{
+	pOut.resize(pNode.materials.size());
+	for (size_t m = 0; m < pNode.materials.size(); m++)
+		pOut[m] = pTable.GetIndex(pNode.materials[m]);
+}
+
+void MergeMaterialSlots(const MaterialTable& pTable, const std::vector<const Node*>& pNodes,
+	std::vector<int>& pPolygonMaterials)
+{
+	if (pNodes.empty() || pPolygonMaterials.empty())
+		return;
+	size_t slotCount = pNodes[0]->materials.size();
+	for (size_t n = 1; n < pNodes.size(); n++)
+		slotCount = std::min(slotCount, pNodes[n]->materials.size());
+
+	// Two slots merge when every node maps both to the same entry.
+	std::vector<std::vector<int> > materials(pNodes.size());
+	for (size_t n = 0; n < pNodes.size(); n++)
+		GetNodeMaterials(pTable, *pNodes[n], materials[n]);
+	std::vector<int> first(slotCount);
+	bool merged = false;
+	for (size_t s = 0; s < slotCount; s++)
+	{
+		first[s] = (int)s;
+		for (size_t e = 0; e < s && first[s] == (int)s; e++)
+		{
+			if (first[e] != (int)e)
+				continue;
+			bool same = true;
+			for (size_t n = 0; n < pNodes.size() && same; n++)
+				same = materials[n][e] >= 0 && materials[n][e] == materials[n][s];
+			if (same)
+			{
+				first[s] = (int)e;
+				merged = true;
+			}
+		}
+	}
+	if (!merged)
+		return;
+	for (size_t p = 0; p < pPolygonMaterials.size(); p++)
+	{
+		const int slot = pPolygonMaterials[p];
+		if (slot >= 0 && slot < (int)slotCount)
+			pPolygonMaterials[p] = first[slot];
+	}
+}
+
+void GroupTrianglesByMaterial(const std::vector<int>& pPolygonMaterials, std::vector<uint32_t>& pTriangles,
+	std::vector<int>& pTrianglePolygons, std::vector<MaterialRange>& pRanges)
+{
+	pRanges.clear();
+	const size_t triangleCount = pTriangles.size() / 3;
+	if (!triangleCount)
+		return;
+	if (pPolygonMaterials.empty() || pTrianglePolygons.size() != triangleCount)
+	{
+		MaterialRange range = { 0, 0, (uint32_t)(triangleCount * 3) };
+		pRanges.push_back(range);
+		return;
+	}
+
+	// Counting sort on the rank of each slot among those used, which is
+	// stable. The slots used are found with a bitmap over the range the mesh
+	// spans, when that is no bigger than the mesh, else with a map: either
+	// way nothing grows with the slot numbers in the file, and only the
+	// distinct slots are sorted.
+	std::vector<int> slots(triangleCount);
+	int lowest = INT_MAX, highest = 0;
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		const int polygon = pTrianglePolygons[t];
+		const int slot = polygon >= 0 && polygon < (int)pPolygonMaterials.size() ? pPolygonMaterials[polygon] : 0;
+		slots[t] = slot > 0 ? slot : 0;
+		lowest = std::min(lowest, slots[t]);
+		highest = std::max(highest, slots[t]);
+	}
+	std::vector<int> used;
+	const size_t span = (size_t)highest - (size_t)lowest + 1;
+	if (span <= triangleCount)
+	{
+		std::vector<int> ranks(span, -1);
+		for (size_t t = 0; t < triangleCount; t++)
+			ranks[slots[t] - lowest] = 0;
+		for (size_t s = 0; s < span; s++)
+		{
+			if (ranks[s] == 0)
+			{
+				ranks[s] = (int)used.size();
+				used.push_back(lowest + (int)s);
+			}
+		}
+		for (size_t t = 0; t < triangleCount; t++)
+			slots[t] = ranks[slots[t] - lowest];
+	}
+	else
+	{
+		std::map<int, int> ranks;
+		for (size_t t = 0; t < triangleCount; t++)
+			ranks[slots[t]] = 0;
+		for (std::map<int, int>::iterator it = ranks.begin(); it != ranks.end(); ++it)
+		{
+			it->second = (int)used.size();
+			used.push_back(it->first);
+		}
+		for (size_t t = 0; t < triangleCount; t++)
+			slots[t] = ranks[slots[t]];
+	}
+	std::vector<size_t> starts(used.size() + 1, 0);
+	for (size_t t = 0; t < triangleCount; t++)
+		++starts[(size_t)slots[t] + 1];
+	for (size_t s = 0; s < used.size(); s++)
+	{
+		starts[s + 1] += starts[s];
+		MaterialRange range = { used[s], (uint32_t)(starts[s] * 3), (uint32_t)((starts[s + 1] - starts[s]) * 3) };
+		pRanges.push_back(range);
+	}
+	if (pRanges.size() == 1)
+		return;
+
+	std::vector<uint32_t> triangles(pTriangles.size());
+	std::vector<int> trianglePolygons(triangleCount);
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		const size_t to = starts[slots[t]]++;
+		triangles[to * 3] = pTriangles[t * 3];
+		triangles[to * 3 + 1] = pTriangles[t * 3 + 1];
+		triangles[to * 3 + 2] = pTriangles[t * 3 + 2];
+		trianglePolygons[to] = pTrianglePolygons[t];
+	}
+	pTriangles.swap(triangles);
+	pTrianglePolygons.swap(trianglePolygons);
+}
+
+}
@@ -0,0 +1,122 @@
+#ifndef FBX_MATERIAL_H
+#define FBX_MATERIAL_H
+
+#include "fbx_scene.h"
+
+#include <stdint.h>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace fbxl {
+
+const int kMaterialTextureSlots = LayerElement::eTypeCount - LayerElement::eTextureDiffuse;
+
+enum ShadingModel
+{
+	eShadingOther,
+	eShadingLambert,
+	eShadingPhong
+};
+
+/**
+* The material property texture slot pSlot is bound to: "DiffuseColor" for
+* slot 0 (LayerElement::eTextureDiffuse) and so on.
+*/
+const char* GetTextureSlotName(int pSlot);
+
+/**
+* A material as the table stores it: the Lambert and Phong properties as
+* floats, and for each texture channel (eTextureDiffuse onward) the index of
+* its first texture in MaterialTable::textures, -1 when it has none. Every
+* field is four bytes, so the struct has no padding and two materials are
+* the same exactly when their bytes are.
+*/
+struct FlatMaterial
+{
+	int32_t shadingModel;
+	float ambient[3];
+	float ambientFactor;
+	float diffuse[3];
+	float diffuseFactor;
+	float emissive[3];
+	float emissiveFactor;
+	float specular[3];
+	float specularFactor;
+	float shininess;
+	float transparent[3];
+	float transparencyFactor;
+	float reflection[3];
+	float reflectionFactor;
+	float bumpFactor;
+	int32_t textures[kMaterialTextureSlots];
+};
+
+/**
+* The materials of a scene with duplicates merged. Exporters write one
+* material per object that uses it, so identical materials are common;
+* each entry here stands for every scene material with the same shading
+* model, property values and texture files, and keeps the first one as
+* its source. names holds a name per entry, unique within the table: the
+* source's, with "_<n>" added when an earlier entry took it. Textures are
+* merged the same way, by FileName and RelativeFilename.
+*/
+struct MaterialTable
+{
+	std::vector<FlatMaterial> materials;
+	std::vector<const Material*> sources;
+	std::vector<std::string> names;
+	std::vector<const Texture*> textures;
+	std::map<const Material*, int> indices;
+
+	/**
+	* The entry pMaterial was merged into, -1 for a material of another scene.
+	*/
+	int GetIndex(const Material* pMaterial) const;
+};
+
+/**
+* Build pOut from every material of pScene. Materials are looked up by a
+* hash of their flattened bytes and compared in full only on a match, so
+* this is linear in the number of materials.
+*/
+void BuildMaterialTable(const Scene& pScene, MaterialTable& pOut);
+
+/**
+* Entries of pTable for each material slot of pNode, -1 for an empty slot.
+*/
+void GetNodeMaterials(const MaterialTable& pTable, const Node& pNode, std::vector<int>& pOut);
+
+/**
+* Rewrite the slots of pPolygonMaterials that hold the same entry of pTable
+* on every node of pNodes (the nodes instancing one mesh) to the first such
+* slot, so that grouping makes one range per material rather than per slot.
+* Slots the nodes disagree on, or that some node leaves empty, are kept.
+*/
+void MergeMaterialSlots(const MaterialTable& pTable, const std::vector<const Node*>& pNodes,
+	std::vector<int>& pPolygonMaterials);
+
+/**
+* indexCount indices from firstIndex that all use material slot slot of
+* the nodes instancing the mesh: one draw call.
+*/
+struct MaterialRange
+{
+	int slot;
+	uint32_t firstIndex;
+	uint32_t indexCount;
+};
+
+/**
+* Sort the triangles of pTriangles by the material slot of their polygon in
+* pPolygonMaterials (pTrianglePolygons gives each triangle's polygon, and
+* is permuted along), keeping their order within a slot, and write one range
+* per slot used to pRanges, in slot order. A polygon without a slot counts
+* as slot 0; without pPolygonMaterials the whole mesh is one range.
+*/
+void GroupTrianglesByMaterial(const std::vector<int>& pPolygonMaterials, std::vector<uint32_t>& pTriangles,
+	std::vector<int>& pTrianglePolygons, std::vector<MaterialRange>& pRanges);
+
+}
+
+#endif
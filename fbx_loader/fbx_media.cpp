@@ -0,0 +1,113 @@
+#include "fbx_media.h"
+
+#include <stdio.h>
+#include <set>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <errno.h>
+#include <sys/stat.h>
+#endif
+
+namespace fbxl {
+
+namespace {
+
+bool MakeDirectory(const std::string& pPath)
+{
+#ifdef _WIN32
+	return CreateDirectoryA(pPath.c_str(), NULL) || GetLastError() == ERROR_ALREADY_EXISTS;
+#else
+	return mkdir(pPath.c_str(), 0755) == 0 || errno == EEXIST;
+#endif
+}
+
+std::string GetLastComponent(const std::string& pPath)
+{
+	size_t slash = pPath.find_last_of("/\\");
+	return slash == std::string::npos ? pPath : pPath.substr(slash + 1);
+}
+
+/**
+* The name a video goes by when matching textures to embedded files.
+*/
+const std::string& GetMediaKey(const Video& pVideo)
+{
+	return pVideo.relativeFileName.empty() ? pVideo.fileName : pVideo.relativeFileName;
+}
+
+}
+
+void CollectEmbeddedMedia(const Scene& pScene, std::vector<const Video*>& pOut)
+{
+	pOut.clear();
+	std::set<std::string> seen;
+	for (size_t i = 0; i < pScene.videos.size(); i++)
+	{
+		const Video& video = pScene.videos[i];
+		if (video.IsEmbedded() && (GetMediaKey(video).empty() || seen.insert(GetMediaKey(video)).second))
+			pOut.push_back(&video);
+	}
+}
+
+const Video* FindEmbeddedMedia(const Scene& pScene, const Texture& pTexture)
+{
+	if (pTexture.video && pTexture.video->IsEmbedded())
+		return pTexture.video;
+	for (size_t i = 0; i < pScene.videos.size(); i++)
+	{
+		const Video& video = pScene.videos[i];
+		if (!video.IsEmbedded())
+			continue;
+		if ((!pTexture.relativeFileName.empty() && video.relativeFileName == pTexture.relativeFileName) ||
+			(!pTexture.fileName.empty() && video.fileName == pTexture.fileName))
+			return &video;
+	}
+	return NULL;
+}
+
+std::string GetMediaFileName(const Video& pVideo, int pIndex)
+{
+	std::string name = GetLastComponent(pVideo.relativeFileName);
+	if (name.empty())
+		name = GetLastComponent(pVideo.fileName);
+	if (name.empty())
+	{
+		char temp[32];
+		sprintf(temp, "FbxTemp_%04d", pIndex);
+		name = temp;
+	}
+	return name;
+}
+
+bool ExtractEmbeddedMedia(const std::vector<const Video*>& pMedia, const std::string& pDirectory,
+	std::vector<std::string>& pWritten, std::string& pError)
+{
+	pWritten.clear();
+	if (pMedia.empty())
+		return true;
+	if (!MakeDirectory(pDirectory))
+	{
+		pError = "cannot create '" + pDirectory + "'";
+		return false;
+	}
+	for (size_t i = 0; i < pMedia.size(); i++)
+	{
+		const std::string path = pDirectory + "/" + GetMediaFileName(*pMedia[i], (int)i + 1);
+		FILE* file = fopen(path.c_str(), "wb");
+		bool ok = file && fwrite(pMedia[i]->content, 1, pMedia[i]->contentSize, file) == pMedia[i]->contentSize;
+		if (file && fclose(file) != 0)
+			ok = false;
+		if (!ok)
+		{
+			pError = "cannot write '" + path + "'";
+			return false;
+		}
+		pWritten.push_back(path);
+	}
+	return true;
+}
+
+}
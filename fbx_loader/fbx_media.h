@@ -0,0 +1,42 @@
+#ifndef FBX_MEDIA_H
+#define FBX_MEDIA_H
+
+#include "fbx_scene.h"
+
+#include <string>
+#include <vector>
+
+namespace fbxl {
+
+/**
+* The videos of pScene that carry an embedded file, in file order, one per
+* RelativeFilename (the SDK embeds a file once even when several videos
+* name it). Each is a view into the document; nothing is copied.
+*/
+void CollectEmbeddedMedia(const Scene& pScene, std::vector<const Video*>& pOut);
+
+/**
+* The embedded file pTexture shows: its own video's content when it has
+* any, otherwise that of the first video embedding a file of the same
+* relative or absolute name. NULL when the image is not in the document.
+*/
+const Video* FindEmbeddedMedia(const Scene& pScene, const Texture& pTexture);
+
+/**
+* The name an extracted copy of pVideo gets: the last component of its
+* RelativeFilename, else of its Filename, else "FbxTemp_<pIndex>" the way
+* the SDK names files it cannot name.
+*/
+std::string GetMediaFileName(const Video& pVideo, int pIndex);
+
+/**
+* Write pMedia into pDirectory, creating it if need be, under the names
+* GetMediaFileName gives; pWritten receives the paths. This is the only
+* place the tools write embedded files to disk, and only when asked to.
+*/
+bool ExtractEmbeddedMedia(const std::vector<const Video*>& pMedia, const std::string& pDirectory,
+	std::vector<std::string>& pWritten, std::string& pError);
+
+}
+
+#endif
@@ -0,0 +1,180 @@
+#include "fbx_mesh.h"
+
+#include <algorithm>
+
+namespace fbxl {
+
+namespace {
+
+template <typename Real>
+size_t StreamBytes(const AttributeStream<Real>& pStream)
+{
+	return pStream.values.size() * sizeof(Real) + pStream.indices.size() * sizeof(int);
+}
+
+template <typename Real>
+bool ExtractAttribute(const LayerElement& pElement, int pComponents, AttributeStream<Real>& pOut)
+{
+	pOut.mappingMode = pElement.mappingMode;
+	pOut.components = pComponents;
+	bool ok = true;
+	if (pElement.stride == pComponents)
+		ok = pElement.directArray.CopyTo(pOut.values);
+	else
+	{
+		// Stride differs from what the stream stores (e.g. 4-component
+		// tangents with w): decode once, then keep the leading components.
+		std::vector<Real> raw;
+		ok = pElement.directArray.CopyTo(raw);
+		int count = pElement.GetCount();
+		int keep = pComponents < pElement.stride ? pComponents : pElement.stride;
+		pOut.values.assign((size_t)count * pComponents, Real());
+		for (int i = 0; i < count; i++)
+		{
+			for (int c = 0; c < keep; c++)
+				pOut.values[(size_t)i * pComponents + c] = raw[(size_t)i * pElement.stride + c];
+		}
+	}
+	if (pElement.referenceMode != LayerElement::eDirect)
+		ok = pElement.indexArray.CopyTo(pOut.indices) && ok;
+	else
+		pOut.indices.clear();
+	return ok;
+}
+
+/**
+* Material slot of each of pPolygonCount polygons. Only eAllSame and
+* eByPolygon make sense for materials; anything else reads as slot 0.
+*/
+bool ExtractPolygonMaterials(const LayerElement& pElement, int pPolygonCount, std::vector<int>& pOut)
+{
+	std::vector<int> slots;
+	bool ok = pElement.indexArray.CopyTo(slots);
+	pOut.assign(pPolygonCount, 0);
+	if (slots.empty())
+		return ok;
+	if (pElement.mappingMode == LayerElement::eByPolygon)
+	{
+		const int count = std::min(pPolygonCount, (int)slots.size());
+		for (int p = 0; p < count; p++)
+			pOut[p] = slots[p];
+	}
+	else if (pElement.mappingMode == LayerElement::eAllSame)
+		pOut.assign(pPolygonCount, slots[0]);
+	return ok;
+}
+
+}
+
+template <typename Real>
+size_t MeshStreams<Real>::GetMemoryUsage() const
+{
+	size_t bytes = positions.size() * sizeof(Real);
+	bytes += (polygonVertices.size() + polygonStarts.size() + polygonMaterials.size()) * sizeof(int);
+	bytes += StreamBytes(normals) + StreamBytes(tangents) + StreamBytes(binormals) + StreamBytes(colors);
+	for (size_t i = 0; i < uvSets.size(); i++)
+		bytes += StreamBytes(uvSets[i]);
+	return bytes;
+}
+
+template <typename Real>
+void MeshStreams<Real>::ResolveToPolygonVertices(const AttributeStream<Real>& pStream, std::vector<int>& pOut) const
+{
+	const int polygonVertexCount = GetPolygonVertexCount();
+	pOut.assign(polygonVertexCount, -1);
+	if (pStream.Empty())
+		return;
+
+	switch (pStream.mappingMode)
+	{
+	case LayerElement::eByControlPoint:
+		for (int i = 0; i < polygonVertexCount; i++)
+			pOut[i] = polygonVertices[i];
+		break;
+	case LayerElement::eByPolygonVertex:
+		for (int i = 0; i < polygonVertexCount; i++)
+			pOut[i] = i;
+		break;
+	case LayerElement::eByPolygon:
+		for (int p = 0; p < GetPolygonCount(); p++)
+		{
+			for (int i = polygonStarts[p]; i < polygonStarts[p + 1]; i++)
+				pOut[i] = p;
+		}
+		break;
+	case LayerElement::eAllSame:
+		for (int i = 0; i < polygonVertexCount; i++)
+			pOut[i] = 0;
+		break;
+	default:
+		return;
+	}
+
+	const int indexCount = (int)pStream.indices.size();
+	const int elementCount = pStream.GetCount();
+	const bool indexed = !pStream.indices.empty();
+	for (int i = 0; i < polygonVertexCount; i++)
+	{
+		int element = pOut[i];
+		if (indexed)
+			element = element >= 0 && element < indexCount ? pStream.indices[element] : -1;
+		pOut[i] = element >= 0 && element < elementCount ? element : -1;
+	}
+}
+
+template <typename Real>
+bool ExtractMeshStreams(const Mesh& pMesh, MeshStreams<Real>& pOut)
+{
+	bool ok = pMesh.vertices.CopyTo(pOut.positions);
+	pOut.positions.resize((size_t)pMesh.GetControlPointsCount() * 3);
+
+	ok = pMesh.polygonVertexIndex.CopyTo(pOut.polygonVertices) && ok;
+	pOut.polygonStarts.clear();
+	pOut.polygonStarts.push_back(0);
+	const size_t count = pOut.polygonVertices.size();
+	for (size_t i = 0; i < count; i++)
+	{
+		int index = pOut.polygonVertices[i];
+		if (index < 0)
+		{
+			pOut.polygonVertices[i] = ~index;
+			pOut.polygonStarts.push_back((int)i + 1);
+		}
+	}
+	if (pOut.polygonStarts.back() != (int)count)
+		pOut.polygonStarts.push_back((int)count);
+
+	pOut.normals = AttributeStream<Real>();
+	pOut.tangents = AttributeStream<Real>();
+	pOut.binormals = AttributeStream<Real>();
+	pOut.colors = AttributeStream<Real>();
+	pOut.uvSets.clear();
+	pOut.polygonMaterials.clear();
+	for (size_t i = 0; i < pMesh.layers.size(); i++)
+	{
+		const Layer& layer = pMesh.layers[i];
+		if (layer.normals && pOut.normals.Empty())
+			ok = ExtractAttribute(*layer.normals, 3, pOut.normals) && ok;
+		if (layer.tangents && pOut.tangents.Empty())
+			ok = ExtractAttribute(*layer.tangents, 3, pOut.tangents) && ok;
+		if (layer.binormals && pOut.binormals.Empty())
+			ok = ExtractAttribute(*layer.binormals, 3, pOut.binormals) && ok;
+		if (layer.colors && pOut.colors.Empty())
+			ok = ExtractAttribute(*layer.colors, 4, pOut.colors) && ok;
+		if (layer.uvs)
+		{
+			pOut.uvSets.push_back(AttributeStream<Real>());
+			ok = ExtractAttribute(*layer.uvs, 2, pOut.uvSets.back()) && ok;
+		}
+		if (layer.materials && pOut.polygonMaterials.empty())
+			ok = ExtractPolygonMaterials(*layer.materials, pOut.GetPolygonCount(), pOut.polygonMaterials) && ok;
+	}
+	return ok;
+}
+
+template struct MeshStreams<float>;
+template struct MeshStreams<double>;
+template bool ExtractMeshStreams(const Mesh&, MeshStreams<float>&);
+template bool ExtractMeshStreams(const Mesh&, MeshStreams<double>&);
+
+}
@@ -0,0 +1,85 @@
+#ifndef FBX_MESH_H
+#define FBX_MESH_H
+
+#include "fbx_scene.h"
+
+#include <vector>
+
+namespace fbxl {
+
+/**
+* One vertex attribute of a mesh as a contiguous array of Real, components
+* values per element. The mapping mode and, for indexed elements, the index
+* array are carried over from the layer element unchanged.
+*/
+template <typename Real>
+struct AttributeStream
+{
+	LayerElement::EMappingMode mappingMode;
+	int components;
+	std::vector<Real> values;
+	std::vector<int> indices;
+
+	AttributeStream() : mappingMode(LayerElement::eNone), components(0) {}
+
+	bool Empty() const { return values.empty(); }
+	int GetCount() const { return components ? (int)(values.size() / components) : 0; }
+	const Real* Get(int pIndex) const { return &values[(size_t)pIndex * components]; }
+};
+
+/**
+* A mesh decoded into flat structure-of-arrays buffers: one array per
+* attribute instead of one record per vertex, in float (half the size of the
+* document's doubles) or double. Positions are xyz per control point;
+* polygonVertices holds the control point of every polygon vertex with the
+* end-of-polygon markers removed, and polygonStarts the offset of each polygon
+* into it plus a final end offset. polygonMaterials gives each polygon's
+* material slot on the node (Node::materials), from the first layer that
+* has materials; it is empty when none has.
+*/
+template <typename Real>
+struct MeshStreams
+{
+	std::vector<Real> positions;
+	std::vector<int> polygonVertices;
+	std::vector<int> polygonStarts;
+	std::vector<int> polygonMaterials;
+	AttributeStream<Real> normals;
+	AttributeStream<Real> tangents;
+	AttributeStream<Real> binormals;
+	AttributeStream<Real> colors;
+	std::vector<AttributeStream<Real> > uvSets;
+
+	int GetControlPointsCount() const { return (int)(positions.size() / 3); }
+	int GetPolygonVertexCount() const { return (int)polygonVertices.size(); }
+	int GetPolygonCount() const { return polygonStarts.empty() ? 0 : (int)polygonStarts.size() - 1; }
+
+	/**
+	* Bytes held by all buffers.
+	*/
+	size_t GetMemoryUsage() const;
+
+	/**
+	* Resolve pStream's mapping and reference modes to polygon-vertex level:
+	* pOut[i] is the element of pStream used by polygon vertex i, or -1 where
+	* the stream has nothing for it (eByEdge, out-of-range indices).
+	*/
+	void ResolveToPolygonVertices(const AttributeStream<Real>& pStream, std::vector<int>& pOut) const;
+};
+
+typedef MeshStreams<float> MeshStreamsF;
+typedef MeshStreams<double> MeshStreamsD;
+
+/**
+* Decode pMesh into pOut. Each array is converted in one pass straight from
+* the document, without per-element lookups. Normals, tangents, binormals and
+* colors come from the first layer that has them; every layer with UVs adds a
+* UV set.
+* Returns false if an array could not be decoded.
+*/
+template <typename Real>
+bool ExtractMeshStreams(const Mesh& pMesh, MeshStreams<Real>& pOut);
+
+}
+
+#endif
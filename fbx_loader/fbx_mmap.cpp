@@ -0,0 +1,122 @@
+#include "fbx_mmap.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace fbxl {
+
+MappedFile::MappedFile()
+	: mData(NULL)
+	, mSize(0)
+#ifdef _WIN32
+	, mFile(INVALID_HANDLE_VALUE)
+	, mMapping(NULL)
+#endif
+{
+}
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::Open(const char* pFilename)
+{
+	Close();
+	HANDLE file = CreateFileA(pFilename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+	mFile = file;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size))
+	{
+		Close();
+		return false;
+	}
+	mSize = (size_t)size.QuadPart;
+	if (mSize == 0)
+		return true;
+
+	mMapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (!mMapping)
+	{
+		Close();
+		return false;
+	}
+	mData = (const unsigned char*)MapViewOfFile(mMapping, FILE_MAP_READ, 0, 0, 0);
+	if (!mData)
+	{
+		Close();
+		return false;
+	}
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (mData)
+		UnmapViewOfFile(mData);
+	if (mMapping)
+		CloseHandle(mMapping);
+	if (mFile != INVALID_HANDLE_VALUE)
+		CloseHandle(mFile);
+	mData = NULL;
+	mSize = 0;
+	mMapping = NULL;
+	mFile = INVALID_HANDLE_VALUE;
+}
+
+#else
+
+bool MappedFile::Open(const char* pFilename)
+{
+	Close();
+	int fd = open(pFilename, O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	struct stat st;
+	if (fstat(fd, &st) != 0)
+	{
+		close(fd);
+		return false;
+	}
+	mSize = (size_t)st.st_size;
+	if (mSize == 0)
+	{
+		close(fd);
+		return true;
+	}
+
+	void* p = mmap(NULL, mSize, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (p == MAP_FAILED)
+	{
+		mSize = 0;
+		return false;
+	}
+	mData = (const unsigned char*)p;
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (mData)
+		munmap((void*)mData, mSize);
+	mData = NULL;
+	mSize = 0;
+}
+
+#endif
+
+}
@@ -0,0 +1,38 @@
+#ifndef FBX_MMAP_H
+#define FBX_MMAP_H
+
+#include <stddef.h>
+
+namespace fbxl {
+
+/**
+* Read-only memory mapping of a whole file. Pages are faulted in on demand,
+* so parts of the file nobody reads never become resident.
+*/
+class MappedFile
+{
+public:
+	MappedFile();
+	~MappedFile();
+
+	bool Open(const char* pFilename);
+	void Close();
+
+	const unsigned char* GetData() const { return mData; }
+	size_t GetSize() const { return mSize; }
+
+private:
+	MappedFile(const MappedFile&);
+	MappedFile& operator=(const MappedFile&);
+
+	const unsigned char* mData;
+	size_t mSize;
+#ifdef _WIN32
+	void* mFile;
+	void* mMapping;
+#endif
+};
+
+}
+
+#endif
@@ -0,0 +1,13 @@
+#include "fbx_path.h"
+
+namespace fbxl {
+
+std::string JoinPath(const std::string& pDirectory, const std::string& pName)
+{
+	if (pDirectory.empty() || pDirectory == ".")
+		return pName;
+	char last = pDirectory[pDirectory.size() - 1];
+	return last == '/' || last == '\\' ? pDirectory + pName : pDirectory + "/" + pName;
+}
+
+}
@@ -0,0 +1,16 @@
+#ifndef FBX_PATH_H
+#define FBX_PATH_H
+
+#include <string>
+
+namespace fbxl {
+
+/**
+* pName under pDirectory, with a slash between them unless pDirectory ends
+* with one. pName alone when pDirectory is empty or ".".
+*/
+std::string JoinPath(const std::string& pDirectory, const std::string& pName);
+
+}
+
+#endif
@@ -0,0 +1,398 @@
+#include "fbx_pipeline.h"
+#include "fbx_thread_pool.h"
+#include "fbx_triangulate.h"
+#include "fbx_writer.h"
+
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <map>
+
+namespace fbxl {
+
+namespace {
+
+void CollectNode(const Node& pNode, std::map<const Mesh*, size_t>& pSeen, std::vector<MeshJob>& pJobs)
+{
+	for (size_t i = 0; i < pNode.attributes.size(); i++)
+	{
+		const Mesh* mesh = pNode.attributes[i]->mesh;
+		if (!mesh)
+			continue;
+		std::map<const Mesh*, size_t>::iterator found = pSeen.find(mesh);
+		if (found == pSeen.end())
+		{
+			found = pSeen.insert(std::make_pair(mesh, pJobs.size())).first;
+			pJobs.push_back(MeshJob());
+			pJobs.back().mesh = mesh;
+		}
+		pJobs[found->second].nodes.push_back(&pNode);
+	}
+	for (size_t i = 0; i < pNode.children.size(); i++)
+		CollectNode(*pNode.children[i], pSeen, pJobs);
+}
+
+/**
+* Write "pTag x y z\n" with the shortest text that reads back as each float.
+*/
+void WriteValues(TextWriter& pOut, const char* pTag, const float* pValues, int pCount)
+{
+	pOut.WriteText(pTag);
+	for (int i = 0; i < pCount; i++)
+	{
+		pOut.WriteChar(' ');
+		pOut.WriteReal(pValues[i]);
+	}
+	pOut.WriteChar('\n');
+}
+
+/**
+* Write pCount indices of pTriangles from pFirst as OBJ faces over the last
+* pVertexCount vertices. Each corner repeats its relative index for every
+* attribute the mesh has.
+*/
+void WriteFaces(TextWriter& pOut, const std::vector<uint32_t>& pTriangles, size_t pFirst, size_t pCount,
+	int pVertexCount, bool pHasUVs, bool pHasNormals)
+{
+	const int repeats = 1 + (pHasUVs || pHasNormals ? 1 : 0) + (pHasNormals ? 1 : 0);
+	for (size_t t = pFirst; t + 2 < pFirst + pCount; t += 3)
+	{
+		pOut.WriteChar('f');
+		for (int c = 0; c < 3; c++)
+		{
+			int relative = (int)pTriangles[t + c] - pVertexCount;
+			pOut.WriteChar(' ');
+			for (int r = 0; r < repeats; r++)
+			{
+				if (r)
+					pOut.WriteChar('/');
+				if (r != 1 || pHasUVs)
+					pOut.WriteInt(relative);
+			}
+		}
+		pOut.WriteChar('\n');
+	}
+}
+
+/**
+* WriteFaces for each of pRanges, after a "usemtl" naming the entry of
+* pTable that pNode has in its slot; all of pTriangles at once when there is
+* no table or pNode has no materials.
+*/
+void WriteMaterialFaces(TextWriter& pOut, const std::vector<uint32_t>& pTriangles,
+	const std::vector<MaterialRange>& pRanges, const MaterialTable* pTable, const Node* pNode, int pVertexCount,
+	bool pHasUVs, bool pHasNormals)
+{
+	if (!pTable || !pNode || pNode->materials.empty())
+	{
+		WriteFaces(pOut, pTriangles, 0, pTriangles.size(), pVertexCount, pHasUVs, pHasNormals);
+		return;
+	}
+	for (size_t r = 0; r < pRanges.size(); r++)
+	{
+		const MaterialRange& range = pRanges[r];
+		const int entry = range.slot < (int)pNode->materials.size() ? pTable->GetIndex(pNode->materials[range.slot]) : -1;
+		if (entry >= 0)
+		{
+			pOut.WriteText("usemtl ");
+			pOut.WriteText(pTable->names[entry]);
+			pOut.WriteChar('\n');
+		}
+		WriteFaces(pOut, pTriangles, range.firstIndex, range.indexCount, pVertexCount, pHasUVs, pHasNormals);
+	}
+}
+
+/**
+* Write "pTag r g b\n" for pColor times pFactor.
+*/
+void WriteColor(TextWriter& pOut, const char* pTag, const float* pColor, float pFactor)
+{
+	const float values[3] = { pColor[0] * pFactor, pColor[1] * pFactor, pColor[2] * pFactor };
+	WriteValues(pOut, pTag, values, 3);
+}
+
+/**
+* Texture channel and the MTL statement that names its texture. Opacity
+* maps come from TransparencyFactor, else TransparentColor.
+*/
+struct MtlTexture
+{
+	LayerElement::EType channel;
+	const char* tag;
+};
+
+const MtlTexture kMtlTextures[] = {
+	{ LayerElement::eTextureAmbient, "map_Ka" },
+	{ LayerElement::eTextureDiffuse, "map_Kd" },
+	{ LayerElement::eTextureSpecular, "map_Ks" },
+	{ LayerElement::eTextureEmissive, "map_Ke" },
+	{ LayerElement::eTextureShininess, "map_Ns" },
+	{ LayerElement::eTextureTransparencyFactor, "map_d" },
+	{ LayerElement::eTextureTransparency, "map_d" },
+	{ LayerElement::eTextureBump, "bump" },
+	{ LayerElement::eTextureNormalMap, "norm" },
+	{ LayerElement::eTextureDisplacement, "disp" },
+	{ LayerElement::eTextureReflection, "refl" }
+};
+
+/**
+* Write a welded, triangulated mesh as an OBJ object, then its levels of
+* detail as objects that reuse its vertices. Faces use negative (relative)
+* indices so the objects do not depend on what precedes them in the file.
+*/
+void SerializeObj(MeshJob& pJob, const MaterialTable* pTable)
+{
+	const IndexedMeshF& mesh = pJob.indexed;
+	const int vertexCount = mesh.GetVertexCount();
+	size_t triangleCount = pJob.triangles.size();
+	for (size_t l = 0; l < pJob.lods.size(); l++)
+		triangleCount += pJob.lods[l].triangles.size();
+	pJob.output.clear();
+	pJob.output.reserve((size_t)vertexCount * 96 + triangleCount * 16);
+	StringSink sink(pJob.output);
+	TextWriter out(sink, 64 * 1024);
+
+	const char* name = pJob.nodes.empty() ? "mesh" : pJob.nodes[0]->name.c_str();
+	out.WriteText("o ");
+	out.WriteText(name);
+	out.WriteChar('\n');
+	for (int v = 0; v < vertexCount; v++)
+		WriteValues(out, "v", &mesh.positions[(size_t)v * 3], 3);
+	const bool hasUVs = !mesh.uvSets.empty();
+	const bool hasNormals = !mesh.normals.empty();
+	if (hasUVs)
+	{
+		for (int v = 0; v < vertexCount; v++)
+			WriteValues(out, "vt", &mesh.uvSets[0][(size_t)v * 2], 2);
+	}
+	if (hasNormals)
+	{
+		for (int v = 0; v < vertexCount; v++)
+			WriteValues(out, "vn", &mesh.normals[(size_t)v * 3], 3);
+	}
+	const Node* node = pJob.nodes.empty() ? NULL : pJob.nodes[0];
+	WriteMaterialFaces(out, pJob.triangles, pJob.materialRanges, pTable, node, vertexCount, hasUVs, hasNormals);
+
+	for (size_t l = 0; l < pJob.lods.size(); l++)
+	{
+		const MeshLod& lod = pJob.lods[l];
+		out.WriteText("o ");
+		out.WriteText(name);
+		out.WriteText("_LOD");
+		out.WriteInt((int)l + 1);
+		out.WriteText("\n# lod ");
+		out.WriteInt((int)l + 1);
+		out.WriteText(" ratio ");
+		out.WriteReal(lod.ratio);
+		out.WriteText(" error ");
+		out.WriteReal(lod.error);
+		out.WriteChar('\n');
+		WriteMaterialFaces(out, lod.triangles, lod.materialRanges, pTable, node, vertexCount, hasUVs, hasNormals);
+	}
+}
+
+/**
+* Reorder the triangles of each of pRanges for the vertex cache, and with
+* pOverdraw for overdraw, on their own, so that no triangle moves from one
+* material's draw call to another's. Each range is renumbered to the
+* vertices it uses before it is optimized, so the pass stays linear in the
+* mesh however many ranges it has.
+*/
+void OptimizeRanges(const IndexedMeshF& pMesh, std::vector<uint32_t>& pTriangles, std::vector<int>& pTrianglePolygons,
+	const std::vector<MaterialRange>& pRanges, bool pOverdraw)
+{
+	const int vertexCount = pMesh.GetVertexCount();
+	if (pRanges.size() <= 1)
+	{
+		OptimizeVertexCache(pTriangles, vertexCount, &pTrianglePolygons);
+		if (pOverdraw)
+			OptimizeOverdraw(pMesh, pTriangles, &pTrianglePolygons);
+		return;
+	}
+	const uint32_t unused = 0xffffffffu;
+	std::vector<uint32_t> local((size_t)vertexCount, unused);
+	std::vector<uint32_t> globals;
+	std::vector<uint32_t> triangles;
+	std::vector<int> trianglePolygons;
+	IndexedMeshF rangeMesh;
+	for (size_t r = 0; r < pRanges.size(); r++)
+	{
+		const size_t first = pRanges[r].firstIndex;
+		const size_t count = pRanges[r].indexCount;
+		globals.clear();
+		triangles.resize(count);
+		for (size_t i = 0; i < count; i++)
+		{
+			const uint32_t v = pTriangles[first + i];
+			if (local[v] == unused)
+			{
+				local[v] = (uint32_t)globals.size();
+				globals.push_back(v);
+			}
+			triangles[i] = local[v];
+		}
+		trianglePolygons.assign(pTrianglePolygons.begin() + first / 3, pTrianglePolygons.begin() + (first + count) / 3);
+		OptimizeVertexCache(triangles, (int)globals.size(), &trianglePolygons);
+		if (pOverdraw)
+		{
+			// Overdraw only reads positions.
+			rangeMesh.positions.resize(globals.size() * 3);
+			for (size_t v = 0; v < globals.size(); v++)
+			{
+				for (int c = 0; c < 3; c++)
+					rangeMesh.positions[v * 3 + c] = pMesh.positions[(size_t)globals[v] * 3 + c];
+			}
+			OptimizeOverdraw(rangeMesh, triangles, &trianglePolygons);
+		}
+		for (size_t i = 0; i < count; i++)
+			pTriangles[first + i] = globals[triangles[i]];
+		std::copy(trianglePolygons.begin(), trianglePolygons.end(), pTrianglePolygons.begin() + first / 3);
+		for (size_t v = 0; v < globals.size(); v++)
+			local[globals[v]] = unused;
+	}
+}
+
+void ProcessJob(MeshJob& pJob, const PipelineOptions& pOptions)
+{
+	MeshStreamsF streams;
+	pJob.ok = ExtractMeshStreams(*pJob.mesh, streams);
+	BuildIndexedMesh(streams, pJob.indexed);
+	pJob.polygonMaterials.swap(streams.polygonMaterials);
+	if (pOptions.materials)
+		MergeMaterialSlots(*pOptions.materials, pJob.nodes, pJob.polygonMaterials);
+	TriangulateIndexedMesh(pJob.indexed, pJob.triangles, &pJob.trianglePolygons);
+	if (!pOptions.conversion.IsIdentity())
+		ConvertIndexedMesh(pOptions.conversion, pJob.indexed, pJob.triangles);
+	const int vertexCount = pJob.indexed.GetVertexCount();
+	pJob.cacheBefore = AnalyzeVertexCache(pJob.triangles, vertexCount);
+	GroupTrianglesByMaterial(pJob.polygonMaterials, pJob.triangles, pJob.trianglePolygons, pJob.materialRanges);
+	if (pOptions.optimize)
+	{
+		OptimizeRanges(pJob.indexed, pJob.triangles, pJob.trianglePolygons, pJob.materialRanges, true);
+		OptimizeVertexFetch(pJob.indexed, pJob.triangles);
+		pJob.cacheAfter = AnalyzeVertexCache(pJob.triangles, vertexCount);
+	}
+	else
+		pJob.cacheAfter = pJob.cacheBefore;
+
+	// Levels of detail index the final vertex order, so they come last.
+	pJob.lods.clear();
+	if (!pOptions.lodRatios.empty())
+	{
+		std::vector<int> triangleMaterials;
+		if (!pJob.polygonMaterials.empty())
+		{
+			triangleMaterials.resize(pJob.trianglePolygons.size());
+			for (size_t t = 0; t < triangleMaterials.size(); t++)
+			{
+				const int polygon = pJob.trianglePolygons[t];
+				triangleMaterials[t] = polygon < (int)pJob.polygonMaterials.size() ? pJob.polygonMaterials[polygon] : 0;
+			}
+		}
+		BuildMeshLods(pJob.indexed, pJob.triangles, pJob.trianglePolygons, triangleMaterials, pOptions.lodRatios,
+			pJob.lods);
+		for (size_t l = 0; l < pJob.lods.size(); l++)
+		{
+			MeshLod& lod = pJob.lods[l];
+			GroupTrianglesByMaterial(pJob.polygonMaterials, lod.triangles, lod.trianglePolygons, lod.materialRanges);
+			if (pOptions.optimize)
+				OptimizeRanges(pJob.indexed, lod.triangles, lod.trianglePolygons, lod.materialRanges, false);
+		}
+	}
+
+	pJob.output.clear();
+	if (pOptions.format == eMeshTextObj)
+		SerializeObj(pJob, pOptions.materials);
+}
+
+}
+
+void CollectMeshJobs(const Scene& pScene, std::vector<MeshJob>& pJobs)
+{
+	pJobs.clear();
+	std::map<const Mesh*, size_t> seen;
+	CollectNode(pScene.root, seen, pJobs);
+}
+
+PipelineStats RunMeshPipeline(std::vector<MeshJob>& pJobs, ThreadPool& pPool, const PipelineOptions& pOptions)
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	// Biggest meshes first, so one large mesh does not start last and leave
+	// every other thread idle while it finishes.
+	std::vector<size_t> order(pJobs.size());
+	for (size_t i = 0; i < order.size(); i++)
+		order[i] = i;
+	std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+		return pJobs[a].mesh->polygonVertexIndex.Size() > pJobs[b].mesh->polygonVertexIndex.Size();
+	});
+
+	pPool.ParallelFor(order.size(), [&](size_t i) {
+		ProcessJob(pJobs[order[i]], pOptions);
+	});
+
+	PipelineStats stats = PipelineStats();
+	stats.meshCount = pJobs.size();
+	stats.threadCount = pPool.GetThreadCount();
+	for (size_t i = 0; i < pJobs.size(); i++)
+	{
+		if (!pJobs[i].ok)
+			++stats.failedCount;
+		stats.vertexCount += pJobs[i].indexed.GetVertexCount();
+		stats.triangleCount += pJobs[i].triangles.size() / 3;
+		for (size_t l = 0; l < pJobs[i].lods.size(); l++)
+			stats.lodTriangleCount += pJobs[i].lods[l].triangles.size() / 3;
+		stats.rangeCount += pJobs[i].materialRanges.size();
+		stats.outputBytes += pJobs[i].output.size();
+		stats.cacheBefore += pJobs[i].cacheBefore;
+		stats.cacheAfter += pJobs[i].cacheAfter;
+	}
+	stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	return stats;
+}
+
+void SerializeMtl(const MaterialTable& pTable, std::string& pOut)
+{
+	pOut.clear();
+	StringSink sink(pOut);
+	TextWriter out(sink, 64 * 1024);
+	for (size_t m = 0; m < pTable.materials.size(); m++)
+	{
+		const FlatMaterial& material = pTable.materials[m];
+		const bool phong = material.shadingModel == eShadingPhong;
+		if (m)
+			out.WriteChar('\n');
+		out.WriteText("newmtl ");
+		out.WriteText(pTable.names[m]);
+		out.WriteText(phong ? "\nillum 2\n" : "\nillum 1\n");
+		WriteColor(out, "Ka", material.ambient, material.ambientFactor);
+		WriteColor(out, "Kd", material.diffuse, material.diffuseFactor);
+		if (phong)
+		{
+			WriteColor(out, "Ks", material.specular, material.specularFactor);
+			WriteValues(out, "Ns", &material.shininess, 1);
+		}
+		WriteColor(out, "Ke", material.emissive, material.emissiveFactor);
+		// FBX stores how much light passes, MTL how much is blocked.
+		const float transparency = material.transparencyFactor *
+			(material.transparent[0] + material.transparent[1] + material.transparent[2]) / 3.0f;
+		const float opacity = std::min(1.0f, std::max(0.0f, 1.0f - transparency));
+		WriteValues(out, "d", &opacity, 1);
+
+		const char* written = "";
+		for (size_t t = 0; t < sizeof(kMtlTextures) / sizeof(kMtlTextures[0]); t++)
+		{
+			const int texture = material.textures[kMtlTextures[t].channel - LayerElement::eTextureDiffuse];
+			if (texture < 0 || !strcmp(kMtlTextures[t].tag, written))
+				continue;
+			const Texture* source = pTable.textures[texture];
+			out.WriteText(kMtlTextures[t].tag);
+			out.WriteChar(' ');
+			out.WriteText(source->relativeFileName.empty() ? source->fileName : source->relativeFileName);
+			out.WriteChar('\n');
+			written = kMtlTextures[t].tag;
+		}
+	}
+}
+
+}
@@ -0,0 +1,130 @@
+#ifndef FBX_PIPELINE_H
+#define FBX_PIPELINE_H
+
+#include "fbx_convert.h"
+#include "fbx_material.h"
+#include "fbx_scene.h"
+#include "fbx_simplify.h"
+#include "fbx_vcache.h"
+#include "fbx_weld.h"
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace fbxl {
+
+class ThreadPool;
+
+/**
+* One mesh of a scene and everything the pipeline made of it. A mesh that
+* several nodes instance is processed once; nodes lists them all.
+* trianglePolygons gives the polygon each triangle was cut from and
+* polygonMaterials each polygon's material slot (empty when the mesh has no
+* material layer; slots holding the same material are merged when the
+* pipeline is given a material table). Triangles are grouped by material
+* slot, one range of materialRanges per slot used, so each slot is one draw
+* call.
+* cacheBefore and cacheAfter are what the triangles cost on the vertex cache
+* as triangulated and once reordered (the same when the pipeline did not
+* reorder them). lods holds the levels of detail asked for, over the same
+* vertices and grouped the same way.
+*/
+struct MeshJob
+{
+	const Mesh* mesh;
+	std::vector<const Node*> nodes;
+	IndexedMeshF indexed;
+	std::vector<uint32_t> triangles;
+	std::vector<int> trianglePolygons;
+	std::vector<int> polygonMaterials;
+	std::vector<MaterialRange> materialRanges;
+	VertexCacheStats cacheBefore;
+	VertexCacheStats cacheAfter;
+	std::vector<MeshLod> lods;
+	std::string output;
+	bool ok;
+
+	MeshJob() : mesh(NULL), ok(false) {}
+};
+
+/**
+* What RunMeshPipeline did.
+*/
+struct PipelineStats
+{
+	size_t meshCount;
+	size_t failedCount;
+	size_t vertexCount;
+	size_t triangleCount;
+	size_t lodTriangleCount;
+	size_t rangeCount;
+	size_t outputBytes;
+	VertexCacheStats cacheBefore;
+	VertexCacheStats cacheAfter;
+	int threadCount;
+	double seconds;
+};
+
+/**
+* One job per mesh, in the depth-first order the scene's node tree is
+* printed in.
+*/
+void CollectMeshJobs(const Scene& pScene, std::vector<MeshJob>& pJobs);
+
+/**
+* Text RunMeshPipeline writes to MeshJob::output.
+*/
+enum MeshTextFormat
+{
+	eMeshTextNone,
+	eMeshTextObj
+};
+
+/**
+* What RunMeshPipeline does beyond extracting, welding and triangulating:
+* whether it reorders triangles and vertices for the vertex cache, overdraw
+* and vertex fetch, which levels of detail it builds (triangle fractions,
+* decreasing; none by default), the axis and unit conversion applied to the
+* welded vertices (none by default), what text it writes, and the material
+* table of the scene, if any, by which material slots are merged (see
+* MergeMaterialSlots).
+*/
+struct PipelineOptions
+{
+	MeshTextFormat format;
+	bool optimize;
+	std::vector<float> lodRatios;
+	AxisConversion conversion;
+	const MaterialTable* materials;
+
+	PipelineOptions() : format(eMeshTextObj), optimize(true), materials(NULL) {}
+};
+
+/**
+* Run every job through the pipeline on pPool. Jobs share nothing, and each
+* result stays in its own slot, so concatenating the outputs in job order
+* gives the same bytes no matter how many threads ran or how the work was
+* split among them. In OBJ text, each level of detail follows its mesh as an
+* object of its own, "<name>_LOD<n>", reusing the mesh's vertices and
+* preceded by a "# lod <n> ratio <r> error <e>" comment. Given a material
+* table, the faces of each material range follow a "usemtl" naming the
+* table entry of the first node's material in that slot, as SerializeMtl
+* names it; without one there are no usemtl lines.
+*/
+PipelineStats RunMeshPipeline(std::vector<MeshJob>& pJobs, ThreadPool& pPool,
+	const PipelineOptions& pOptions = PipelineOptions());
+
+/**
+* pTable as an MTL material library for the OBJ text of the pipeline: one
+* newmtl per entry, under its name in pTable.names, with its colors
+* multiplied by their factors, its opacity, and a map statement for each
+* texture channel the MTL format has, naming the texture's
+* RelativeFilename (else its FileName). The OBJ text refers to it with an
+* "mtllib" line its writer puts first.
+*/
+void SerializeMtl(const MaterialTable& pTable, std::string& pOut);
+
+}
+
+#endif
@@ -0,0 +1,358 @@
+#include "fbx_reader.h"
+#include "fbx_inflate.h"
+#include "fbx_thread_pool.h"
+#include "fbx_visitor.h"
+
+#include <algorithm>
+#include <chrono>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+namespace fbxl {
+
+namespace {
+
+template <typename T>
+T ReadLE(const unsigned char* p)
+{
+	T v;
+	memcpy(&v, p, sizeof(T));
+	return v;
+}
+
+int ElementSize(char type)
+{
+	switch (type)
+	{
+	case 'b': return 1;
+	case 'i': case 'f': return 4;
+	case 'l': case 'd': return 8;
+	default: return 0;
+	}
+}
+
+template <typename T>
+bool DecodeArray(const Property& prop, std::vector<T>& out)
+{
+	out.clear();
+	if (!prop.IsArray())
+	{
+		if (prop.IsString() || prop.type == 'R')
+			return false;
+		out.push_back(prop.type == 'F' || prop.type == 'D' ? (T)prop.AsDouble() : (T)prop.AsInt());
+		return true;
+	}
+
+	const unsigned char* raw = prop.data;
+	std::vector<unsigned char> inflated;
+	if (prop.encoding == 1)
+	{
+		inflated.resize((size_t)prop.arrayCount * ElementSize(prop.type));
+		if (!ZlibInflate(prop.data, prop.size, inflated.data(), inflated.size()))
+			return false;
+		raw = inflated.data();
+	}
+
+	out.resize(prop.arrayCount);
+	if (prop.arrayCount)
+		ConvertArray(prop.type, raw, prop.arrayCount, &out[0]);
+	return true;
+}
+
+void CollectDeflated(Record& pRecord, std::vector<Property*>& pOut)
+{
+	for (size_t i = 0; i < pRecord.properties.size(); i++)
+	{
+		Property& prop = pRecord.properties[i];
+		if (prop.IsArray() && prop.encoding == 1)
+			pOut.push_back(&prop);
+	}
+	for (size_t i = 0; i < pRecord.children.size(); i++)
+		CollectDeflated(pRecord.children[i], pOut);
+}
+
+bool LargerFirst(const Property* a, const Property* b)
+{
+	return a->size > b->size;
+}
+
+/**
+* Visitor that materializes the streamed records into a Record tree.
+*/
+class TreeBuilder : public RecordVisitor
+{
+public:
+	explicit TreeBuilder(Record& pRoot)
+	{
+		mStack.push_back(&pRoot);
+	}
+
+	virtual bool BeginRecord(const StringRef& pName, size_t pPropertyCount, int /*pDepth*/)
+	{
+		Record* parent = mStack.back();
+		parent->children.push_back(Record());
+		Record* record = &parent->children.back();
+		record->name = pName;
+		record->properties.reserve(pPropertyCount);
+		mStack.push_back(record);
+		return true;
+	}
+
+	virtual void OnProperty(const Property& pProperty) { mStack.back()->properties.push_back(pProperty); }
+	virtual void OnArray(const Property& pProperty) { mStack.back()->properties.push_back(pProperty); }
+	virtual void EndRecord(const StringRef& /*pName*/, int /*pDepth*/) { mStack.pop_back(); }
+
+private:
+	std::vector<Record*> mStack;
+};
+
+}
+
+bool Property::IsArray() const
+{
+	return ElementSize(type) != 0;
+}
+
+int Property::GetElementSize() const
+{
+	return ElementSize(type);
+}
+
+bool Property::IsString() const
+{
+	return type == 'S';
+}
+
+int64_t Property::AsInt() const
+{
+	switch (type)
+	{
+	case 'Y': return ReadLE<int16_t>(data);
+	case 'C': return data[0];
+	case 'I': return ReadLE<int32_t>(data);
+	case 'L': return ReadLE<int64_t>(data);
+	case 'F': return (int64_t)ReadLE<float>(data);
+	case 'D': return (int64_t)ReadLE<double>(data);
+	default: return 0;
+	}
+}
+
+double Property::AsDouble() const
+{
+	switch (type)
+	{
+	case 'F': return ReadLE<float>(data);
+	case 'D': return ReadLE<double>(data);
+	default: return (double)AsInt();
+	}
+}
+
+std::string Property::AsString() const
+{
+	if (type != 'S' && type != 'R')
+		return std::string();
+	return std::string((const char*)data, size);
+}
+
+StringRef Property::AsStringRef() const
+{
+	if (type != 'S' && type != 'R')
+		return StringRef();
+	return StringRef((const char*)data, size);
+}
+
+bool Property::GetArray(std::vector<double>& pOut) const { return DecodeArray(*this, pOut); }
+bool Property::GetArray(std::vector<float>& pOut) const { return DecodeArray(*this, pOut); }
+bool Property::GetArray(std::vector<int>& pOut) const { return DecodeArray(*this, pOut); }
+bool Property::GetArray(std::vector<int64_t>& pOut) const { return DecodeArray(*this, pOut); }
+
+ArrayView::ArrayView()
+	: mProperty(NULL)
+	, mInflatedCount(0)
+	, mCorrupt(false)
+{
+}
+
+ArrayView::ArrayView(const Property* pProperty)
+	: mProperty(pProperty && pProperty->IsArray() ? pProperty : NULL)
+	, mInflatedCount(0)
+	, mCorrupt(false)
+{
+}
+
+ArrayView::ArrayView(const ArrayView& pOther)
+	: mProperty(pOther.mProperty)
+	, mInflatedCount(0)
+	, mCorrupt(false)
+{
+}
+
+ArrayView& ArrayView::operator=(const ArrayView& pOther)
+{
+	mProperty = pOther.mProperty;
+	mInflated.clear();
+	mInflatedCount = 0;
+	mCorrupt = false;
+	return *this;
+}
+
+const unsigned char* ArrayView::Bytes(size_t pCount) const
+{
+	if (mProperty->encoding == 0)
+		return mProperty->data;
+	if (pCount <= mInflatedCount)
+		return mInflated.data();
+
+	// Grow geometrically so walking an array front to back stays linear, and
+	// go straight to the full array once most of it is wanted anyway.
+	const size_t total = mProperty->arrayCount;
+	const size_t elementSize = ElementSize(mProperty->type);
+	size_t want = pCount * 2 > 256 ? pCount * 2 : 256;
+	if (want * 2 >= total)
+		want = total;
+
+	mInflated.resize(want * elementSize);
+	bool ok = want == total ?
+		ZlibInflate(mProperty->data, mProperty->size, mInflated.data(), mInflated.size()) :
+		ZlibInflatePrefix(mProperty->data, mProperty->size, mInflated.data(), mInflated.size());
+	if (!ok)
+	{
+		mInflated.assign(total * elementSize, 0);
+		want = total;
+		mCorrupt = true;
+	}
+	mInflatedCount = want;
+	return mInflated.data();
+}
+
+const Record* Record::Find(const char* pName) const
+{
+	for (size_t i = 0; i < children.size(); i++)
+	{
+		if (children[i].name == pName)
+			return &children[i];
+	}
+	return NULL;
+}
+
+Document::Document()
+	: mOwnedUsed(0)
+	, mVersion(0)
+	, mBinary(false)
+{
+}
+
+bool Document::Fail(const char* pFormat, ...)
+{
+	char message[512];
+	va_list args;
+	va_start(args, pFormat);
+	vsnprintf(message, sizeof(message), pFormat, args);
+	va_end(args);
+	mError = message;
+	return false;
+}
+
+bool Document::Load(const char* pFilename)
+{
+	Close();
+	if (!mFile.Open(pFilename))
+		return Fail("cannot open '%s'", pFilename);
+
+	mBinary = IsBinaryFbx(mFile.GetData(), mFile.GetSize());
+	return mBinary ? ParseBinary() : ParseAscii();
+}
+
+void Document::Close()
+{
+	mRoot = Record();
+	mInflated.clear();
+	mOwned.clear();
+	mOwnedUsed = 0;
+	mFile.Close();
+}
+
+InflateStats Document::InflateArrays(ThreadPool& pPool)
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	InflateStats stats;
+	stats.arrayCount = 0;
+	stats.failedCount = 0;
+	stats.compressedBytes = 0;
+	stats.inflatedBytes = 0;
+	stats.threadCount = pPool.GetThreadCount();
+
+	// One pass over the tree finds the work; biggest arrays go first so the
+	// tail of the parallel loop is made of small ones.
+	std::vector<Property*> arrays;
+	CollectDeflated(mRoot, arrays);
+	std::sort(arrays.begin(), arrays.end(), LargerFirst);
+
+	// All results share one allocation, each slice 16-byte aligned.
+	std::vector<size_t> offsets(arrays.size());
+	size_t total = 0;
+	for (size_t i = 0; i < arrays.size(); i++)
+	{
+		offsets[i] = total;
+		total += ((size_t)arrays[i]->arrayCount * ElementSize(arrays[i]->type) + 15) & ~(size_t)15;
+		stats.compressedBytes += arrays[i]->size;
+	}
+	mInflated.assign(total, 0);
+
+	std::vector<char> ok(arrays.size(), 0);
+	unsigned char* base = mInflated.data();
+	pPool.ParallelFor(arrays.size(), [&](size_t i) {
+		const Property& prop = *arrays[i];
+		size_t bytes = (size_t)prop.arrayCount * ElementSize(prop.type);
+		ok[i] = ZlibInflate(prop.data, prop.size, base + offsets[i], bytes) ? 1 : 0;
+	});
+
+	for (size_t i = 0; i < arrays.size(); i++)
+	{
+		Property& prop = *arrays[i];
+		if (!ok[i])
+		{
+			++stats.failedCount;
+			continue;
+		}
+		prop.data = base + offsets[i];
+		prop.size = prop.arrayCount * ElementSize(prop.type);
+		prop.encoding = 0;
+		stats.inflatedBytes += prop.size;
+		++stats.arrayCount;
+	}
+
+	stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	return stats;
+}
+
+bool Document::ParseBinary()
+{
+	mVersion = GetBinaryFbxVersion(mFile.GetData());
+
+	TreeBuilder builder(mRoot);
+	std::string error;
+	if (!VisitBinaryRecords(mFile.GetData(), mFile.GetSize(), builder, error))
+	{
+		mError = error;
+		return false;
+	}
+	return true;
+}
+
+unsigned char* Document::AllocateOwned(size_t pSize)
+{
+	const size_t blockSize = 64 * 1024;
+	if (mOwned.empty() || mOwnedUsed + pSize > mOwned.back().size())
+	{
+		mOwned.push_back(std::vector<unsigned char>(pSize > blockSize ? pSize : blockSize));
+		mOwnedUsed = 0;
+	}
+	unsigned char* p = mOwned.back().data() + mOwnedUsed;
+	mOwnedUsed += pSize;
+	return p;
+}
+
+}
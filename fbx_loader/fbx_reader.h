@@ -0,0 +1,271 @@
+#ifndef FBX_READER_H
+#define FBX_READER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "fbx_mmap.h"
+
+namespace fbxl {
+
+/**
+* Non-owning string: record names and string values point straight into the
+* mapped file.
+*/
+struct StringRef
+{
+	const char* data;
+	size_t size;
+
+	StringRef() : data(""), size(0) {}
+	StringRef(const char* pData, size_t pSize) : data(pData), size(pSize) {}
+
+	bool operator==(const char* pText) const { return strlen(pText) == size && memcmp(data, pText, size) == 0; }
+	bool operator!=(const char* pText) const { return !(*this == pText); }
+	std::string Str() const { return std::string(data, size); }
+};
+
+/**
+* Read element pIndex of a raw little-endian array of FBX element type pType,
+* converting it to T.
+*/
+template <typename T>
+inline T ReadElement(char pType, const unsigned char* pData, size_t pIndex)
+{
+	switch (pType)
+	{
+	case 'b': return (T)pData[pIndex];
+	case 'i': { int32_t v; memcpy(&v, pData + pIndex * 4, 4); return (T)v; }
+	case 'f': { float v; memcpy(&v, pData + pIndex * 4, 4); return (T)v; }
+	case 'l': { int64_t v; memcpy(&v, pData + pIndex * 8, 8); return (T)v; }
+	case 'd': { double v; memcpy(&v, pData + pIndex * 8, 8); return (T)v; }
+	default: return T();
+	}
+}
+
+/**
+* Convert pCount elements of a raw little-endian array of FBX element type
+* pType to T. The type is dispatched once rather than per element, so each
+* case is a straight loop the compiler can vectorise.
+*/
+template <typename S, typename T>
+inline void ConvertElements(const unsigned char* pData, size_t pCount, T* pOut)
+{
+	for (size_t i = 0; i < pCount; i++)
+	{
+		S v;
+		memcpy(&v, pData + i * sizeof(S), sizeof(S));
+		pOut[i] = (T)v;
+	}
+}
+
+template <typename T>
+inline void ConvertArray(char pType, const unsigned char* pData, size_t pCount, T* pOut)
+{
+	switch (pType)
+	{
+	case 'b': ConvertElements<uint8_t>(pData, pCount, pOut); break;
+	case 'i': ConvertElements<int32_t>(pData, pCount, pOut); break;
+	case 'f': ConvertElements<float>(pData, pCount, pOut); break;
+	case 'l': ConvertElements<int64_t>(pData, pCount, pOut); break;
+	case 'd': ConvertElements<double>(pData, pCount, pOut); break;
+	default:
+		for (size_t i = 0; i < pCount; i++)
+			pOut[i] = T();
+		break;
+	}
+}
+
+/**
+* One typed value of a record, using the binary FBX type codes:
+* 'Y' int16, 'C' bool, 'I' int32, 'F' float, 'D' double, 'L' int64,
+* 'S' string, 'R' raw bytes, and the arrays 'f', 'd', 'l', 'i', 'b'.
+* The payload is not copied: it points into the mapped file, and array
+* payloads stay in their on-disk (possibly deflated) form until requested.
+*/
+struct Property
+{
+	char type;
+	uint32_t encoding;
+	uint32_t arrayCount;
+	uint32_t size;
+	const unsigned char* data;
+
+	bool IsArray() const;
+	bool IsString() const;
+	int GetElementSize() const;
+
+	int64_t AsInt() const;
+	double AsDouble() const;
+	std::string AsString() const;
+	StringRef AsStringRef() const;
+
+	/**
+	* Decode an array (or a single numeric scalar) converting each element to
+	* the requested type. Returns false if the payload cannot be inflated.
+	*/
+	bool GetArray(std::vector<double>& pOut) const;
+	bool GetArray(std::vector<float>& pOut) const;
+	bool GetArray(std::vector<int>& pOut) const;
+	bool GetArray(std::vector<int64_t>& pOut) const;
+};
+
+/**
+* Read-only view of an array property. Uncompressed arrays are read straight
+* out of the mapped file. Deflated ones are inflated into a private buffer the
+* first time an element is touched, and only as far as needed: reading the
+* first few entries of a large array inflates a few kilobytes, not the array.
+*/
+class ArrayView
+{
+public:
+	ArrayView();
+	explicit ArrayView(const Property* pProperty);
+	ArrayView(const ArrayView& pOther);
+	ArrayView& operator=(const ArrayView& pOther);
+
+	size_t Size() const { return mProperty ? mProperty->arrayCount : 0; }
+	bool Empty() const { return Size() == 0; }
+
+	/**
+	* False once inflating the payload has failed; elements then read as 0.
+	*/
+	bool IsValid() const { return !mCorrupt; }
+
+	template <typename T>
+	T Get(size_t pIndex) const
+	{
+		return ReadElement<T>(mProperty->type, Bytes(pIndex + 1), pIndex);
+	}
+
+	double GetDouble(size_t pIndex) const { return Get<double>(pIndex); }
+	int GetInt(size_t pIndex) const { return Get<int>(pIndex); }
+
+	/**
+	* Element type code ('d', 'f', 'l', 'i' or 'b'), 0 for an empty view.
+	*/
+	char GetType() const { return mProperty ? mProperty->type : 0; }
+
+	/**
+	* The whole array as raw little-endian elements of GetType(), inflated
+	* if need be; NULL for an empty view.
+	*/
+	const unsigned char* GetData() const { return Size() ? Bytes(Size()) : NULL; }
+
+	/**
+	* Decode the whole array into pOut, converting each element to T.
+	*/
+	template <typename T>
+	bool CopyTo(std::vector<T>& pOut) const
+	{
+		size_t count = Size();
+		pOut.resize(count);
+		if (!count)
+			return true;
+		ConvertArray(mProperty->type, Bytes(count), count, &pOut[0]);
+		return !mCorrupt;
+	}
+
+private:
+	const unsigned char* Bytes(size_t pCount) const;
+
+	const Property* mProperty;
+	mutable std::vector<unsigned char> mInflated;
+	mutable size_t mInflatedCount;
+	mutable bool mCorrupt;
+};
+
+/**
+* A node record: a name, its values and its nested records.
+*/
+struct Record
+{
+	StringRef name;
+	std::vector<Property> properties;
+	std::vector<Record> children;
+
+	/**
+	* Return the first child record with the given name, or NULL.
+	*/
+	const Record* Find(const char* pName) const;
+};
+
+class ThreadPool;
+
+/**
+* What Document::InflateArrays did.
+*/
+struct InflateStats
+{
+	size_t arrayCount;
+	size_t failedCount;
+	size_t compressedBytes;
+	size_t inflatedBytes;
+	int threadCount;
+	double seconds;
+};
+
+/**
+* An FBX file parsed into its record tree. Both the binary ("Kaydara FBX
+* Binary") and the ASCII flavours are accepted; the rest of the loader only
+* sees records and properties and does not care which one it came from.
+* The file is memory-mapped and the records refer into the mapping, so the
+* document must outlive everything built from it.
+*/
+class Document
+{
+public:
+	Document();
+
+	bool Load(const char* pFilename);
+
+	/**
+	* Drop the record tree and unmap the file. The buffer InflateArrays fills
+	* keeps its capacity, so a document reused for many files stops growing
+	* it once it has seen the largest one.
+	*/
+	void Close();
+
+	const std::string& GetError() const { return mError; }
+	int GetVersion() const { return mVersion; }
+	size_t GetFileSize() const { return mFile.GetSize(); }
+	bool IsBinary() const { return mBinary; }
+	const Record& GetRoot() const { return mRoot; }
+
+	/**
+	* Inflate every deflated array of the document up front on pPool and
+	* repoint the properties at the results, so that array views built
+	* afterwards read them like uncompressed arrays. Worth it when the caller
+	* is going to touch most of the data; otherwise the lazy path is cheaper.
+	* Arrays that fail to inflate are left as they were.
+	*/
+	InflateStats InflateArrays(ThreadPool& pPool);
+
+private:
+	Document(const Document&);
+	Document& operator=(const Document&);
+
+	bool ParseBinary();
+
+	bool ParseAscii();
+	unsigned char* AllocateOwned(size_t pSize);
+
+	bool Fail(const char* pFormat, ...);
+
+	MappedFile mFile;
+	std::vector<unsigned char> mInflated;
+	std::deque<std::vector<unsigned char> > mOwned;
+	size_t mOwnedUsed;
+	std::string mError;
+	int mVersion;
+	bool mBinary;
+	Record mRoot;
+};
+
+}
+
+#endif
@@ -0,0 +1,805 @@
+#include "fbx_scene.h"
+
+#include <map>
+
+namespace fbxl {
+
+namespace {
+
+/**
+* How each LayerElementXxx record stores its data.
+*/
+struct LayerElementFormat
+{
+	const char* recordName;
+	LayerElement::EType type;
+	const char* directName;
+	const char* indexName;
+	int stride;
+};
+
+const LayerElementFormat kLayerElementFormats[] = {
+	{ "LayerElementNormal", LayerElement::eNormal, "Normals", "NormalsIndex", 3 },
+	{ "LayerElementBinormal", LayerElement::eBiNormal, "Binormals", "BinormalsIndex", 3 },
+	{ "LayerElementTangent", LayerElement::eTangent, "Tangents", "TangentsIndex", 3 },
+	{ "LayerElementUV", LayerElement::eUV, "UV", "UVIndex", 2 },
+	{ "LayerElementColor", LayerElement::eVertexColor, "Colors", "ColorIndex", 4 },
+	{ "LayerElementMaterial", LayerElement::eMaterial, NULL, "Materials", 0 },
+	{ "LayerElementSmoothing", LayerElement::eSmoothing, "Smoothing", NULL, 1 },
+};
+
+/**
+* Material property a texture is connected to, and the texture layer type the
+* FBX SDK reports it under.
+*/
+struct TextureChannel
+{
+	const char* property;
+	LayerElement::EType type;
+};
+
+const TextureChannel kTextureChannels[] = {
+	{ "DiffuseColor", LayerElement::eTextureDiffuse },
+	{ "DiffuseFactor", LayerElement::eTextureDiffuseFactor },
+	{ "EmissiveColor", LayerElement::eTextureEmissive },
+	{ "EmissiveFactor", LayerElement::eTextureEmissiveFactor },
+	{ "AmbientColor", LayerElement::eTextureAmbient },
+	{ "AmbientFactor", LayerElement::eTextureAmbientFactor },
+	{ "SpecularColor", LayerElement::eTextureSpecular },
+	{ "SpecularFactor", LayerElement::eTextureSpecularFactor },
+	{ "ShininessExponent", LayerElement::eTextureShininess },
+	{ "NormalMap", LayerElement::eTextureNormalMap },
+	{ "Bump", LayerElement::eTextureBump },
+	{ "TransparentColor", LayerElement::eTextureTransparency },
+	{ "TransparencyFactor", LayerElement::eTextureTransparencyFactor },
+	{ "ReflectionColor", LayerElement::eTextureReflection },
+	{ "ReflectionFactor", LayerElement::eTextureReflectionFactor },
+	{ "DisplacementColor", LayerElement::eTextureDisplacement },
+	{ "VectorDisplacementColor", LayerElement::eTextureDisplacementVector },
+};
+
+struct AttributeClass
+{
+	const char* subclass;
+	NodeAttribute::EType type;
+};
+
+const AttributeClass kAttributeClasses[] = {
+	{ "Mesh", NodeAttribute::eMesh },
+	{ "Shape", NodeAttribute::eShape },
+	{ "NurbsCurve", NodeAttribute::eNurbsCurve },
+	{ "NurbsSurface", NodeAttribute::eNurbsSurface },
+	{ "TrimNurbsSurface", NodeAttribute::eTrimNurbsSurface },
+	{ "Nurb", NodeAttribute::eNurbs },
+	{ "Patch", NodeAttribute::ePatch },
+	{ "Boundary", NodeAttribute::eBoundary },
+	{ "Line", NodeAttribute::eLine },
+	{ "Null", NodeAttribute::eNull },
+	{ "Marker", NodeAttribute::eMarker },
+	{ "LimbNode", NodeAttribute::eSkeleton },
+	{ "Limb", NodeAttribute::eSkeleton },
+	{ "Root", NodeAttribute::eSkeleton },
+	{ "Camera", NodeAttribute::eCamera },
+	{ "CameraStereo", NodeAttribute::eCameraStereo },
+	{ "CameraSwitcher", NodeAttribute::eCameraSwitcher },
+	{ "Light", NodeAttribute::eLight },
+	{ "OpticalReference", NodeAttribute::eOpticalReference },
+	{ "OpticalMarker", NodeAttribute::eOpticalMarker },
+	{ "LodGroup", NodeAttribute::eLODGroup },
+	{ "SubDiv", NodeAttribute::eSubDiv },
+	{ "CachedEffect", NodeAttribute::eCachedEffect },
+};
+
+/**
+* One entry of the Objects section, with whatever it was turned into.
+*/
+struct ObjectEntry
+{
+	const Record* record;
+	Node* node;
+	NodeAttribute* attribute;
+	Material* material;
+	Texture* texture;
+	Video* video;
+	AnimStack* animStack;
+	AnimLayer* animLayer;
+	AnimCurveNode* animCurveNode;
+	AnimCurve* animCurve;
+	Skin* skin;
+	Cluster* cluster;
+	BlendShape* blendShape;
+	BlendShapeChannel* blendShapeChannel;
+	Shape* shape;
+
+	ObjectEntry() : record(NULL), node(NULL), attribute(NULL), material(NULL),
+		texture(NULL), video(NULL), animStack(NULL), animLayer(NULL), animCurveNode(NULL), animCurve(NULL),
+		skin(NULL), cluster(NULL), blendShape(NULL), blendShapeChannel(NULL), shape(NULL) {}
+};
+
+/**
+* Frames per second of each GlobalSettings TimeMode (FbxTime::EMode); 0 for
+* the default mode, and for custom, which uses CustomFrameRate.
+*/
+const double kTimeModeRates[] = {
+	0.0, 120.0, 100.0, 60.0, 50.0, 48.0, 30.0, 30.0, 29.97002997, 29.97002997,
+	25.0, 24.0, 1000.0, 23.976, 0.0, 96.0, 72.0, 59.94, 119.88
+};
+const int kTimeModeCustom = 14;
+
+std::string StringAt(const Record& pRecord, size_t pIndex)
+{
+	return pIndex < pRecord.properties.size() ? pRecord.properties[pIndex].AsString() : std::string();
+}
+
+/**
+* Binary files store object names as "Name\x00\x01Class", ASCII files as
+* "Class::Name". Both are reduced to the plain name.
+*/
+std::string ObjectName(const Record& pRecord, bool pBinary)
+{
+	std::string full = StringAt(pRecord, 1);
+	if (pBinary)
+	{
+		size_t sep = full.find(std::string("\x00\x01", 2));
+		return sep == std::string::npos ? full : full.substr(0, sep);
+	}
+	size_t sep = full.find("::");
+	return sep == std::string::npos ? full : full.substr(sep + 2);
+}
+
+const Record* FindP(const Record* pProperties70, const char* pName)
+{
+	if (!pProperties70)
+		return NULL;
+	for (size_t i = 0; i < pProperties70->children.size(); i++)
+	{
+		const Record& p = pProperties70->children[i];
+		if (p.name == "P" && !p.properties.empty() && p.properties[0].AsString() == pName)
+			return &p;
+	}
+	return NULL;
+}
+
+/**
+* Read a vector property, falling back to the ObjectType's template and then
+* to pDefault, the same order the SDK resolves property values in.
+*/
+void ReadVector3(const Record& pObject, const Record* pTemplate, const char* pName, const double* pDefault, double* pOut)
+{
+	const Record* p = FindP(pObject.Find("Properties70"), pName);
+	if (!p)
+		p = FindP(pTemplate, pName);
+	for (int i = 0; i < 3; i++)
+		pOut[i] = p && p->properties.size() > (size_t)(4 + i) ? p->properties[4 + i].AsDouble() : pDefault[i];
+}
+
+/**
+* Read a scalar property the same way, from the object, its template or
+* pDefault.
+*/
+double ReadNumber(const Record& pObject, const Record* pTemplate, const char* pName, double pDefault)
+{
+	const Record* p = FindP(pObject.Find("Properties70"), pName);
+	if (!p)
+		p = FindP(pTemplate, pName);
+	return p && p->properties.size() > 4 ? p->properties[4].AsDouble() : pDefault;
+}
+
+int64_t ReadTime(const Record& pObject, const char* pName)
+{
+	const Record* p = FindP(pObject.Find("Properties70"), pName);
+	return p && p->properties.size() > 4 ? p->properties[4].AsInt() : 0;
+}
+
+LayerElement::EMappingMode ParseMappingMode(const std::string& pText)
+{
+	if (pText == "ByVertex" || pText == "ByVertice" || pText == "ByControlPoint") return LayerElement::eByControlPoint;
+	if (pText == "ByPolygonVertex") return LayerElement::eByPolygonVertex;
+	if (pText == "ByPolygon") return LayerElement::eByPolygon;
+	if (pText == "ByEdge") return LayerElement::eByEdge;
+	if (pText == "AllSame") return LayerElement::eAllSame;
+	return LayerElement::eNone;
+}
+
+LayerElement::EReferenceMode ParseReferenceMode(const std::string& pText)
+{
+	if (pText == "Index") return LayerElement::eIndex;
+	if (pText == "IndexToDirect") return LayerElement::eIndexToDirect;
+	return LayerElement::eDirect;
+}
+
+ArrayView FindArray(const Record& pParent, const char* pName)
+{
+	const Record* r = pParent.Find(pName);
+	return ArrayView(r && !r->properties.empty() ? &r->properties[0] : NULL);
+}
+
+/**
+* A 16-double matrix child such as a cluster's Transform; pOut is left as
+* it is when the child is missing or short.
+*/
+void ReadMatrix(const Record& pParent, const char* pName, double* pOut)
+{
+	ArrayView values = FindArray(pParent, pName);
+	if (values.Size() < 16)
+		return;
+	for (size_t i = 0; i < 16; i++)
+		pOut[i] = values.GetDouble(i);
+}
+
+void BuildMesh(const Record& pGeometry, Mesh& pMesh)
+{
+	pMesh.vertices = FindArray(pGeometry, "Vertices");
+	pMesh.polygonVertexIndex = FindArray(pGeometry, "PolygonVertexIndex");
+
+	// Layer elements, keyed by (type, typed index) for the Layer records.
+	std::map<std::pair<std::string, int>, const LayerElement*> byName;
+	for (size_t i = 0; i < pGeometry.children.size(); i++)
+	{
+		const Record& child = pGeometry.children[i];
+		for (size_t f = 0; f < sizeof(kLayerElementFormats) / sizeof(kLayerElementFormats[0]); f++)
+		{
+			const LayerElementFormat& format = kLayerElementFormats[f];
+			if (child.name != format.recordName)
+				continue;
+
+			pMesh.elements.push_back(LayerElement());
+			LayerElement& element = pMesh.elements.back();
+			element.type = format.type;
+			element.stride = format.stride;
+			const Record* name = child.Find("Name");
+			element.name = name ? StringAt(*name, 0) : std::string();
+			const Record* mapping = child.Find("MappingInformationType");
+			element.mappingMode = mapping ? ParseMappingMode(StringAt(*mapping, 0)) : LayerElement::eNone;
+			const Record* reference = child.Find("ReferenceInformationType");
+			element.referenceMode = reference ? ParseReferenceMode(StringAt(*reference, 0)) : LayerElement::eDirect;
+			if (format.directName)
+				element.directArray = FindArray(child, format.directName);
+			if (format.indexName)
+				element.indexArray = FindArray(child, format.indexName);
+
+			int typedIndex = child.properties.empty() ? 0 : (int)child.properties[0].AsInt();
+			byName[std::make_pair(std::string(format.recordName), typedIndex)] = &element;
+			break;
+		}
+	}
+
+	std::map<int, const Record*> layerRecords;
+	for (size_t i = 0; i < pGeometry.children.size(); i++)
+	{
+		const Record& child = pGeometry.children[i];
+		if (child.name == "Layer")
+			layerRecords[child.properties.empty() ? 0 : (int)child.properties[0].AsInt()] = &child;
+	}
+
+	if (layerRecords.empty() && !pMesh.elements.empty())
+	{
+		// No explicit Layer records: every element with typed index 0 forms layer 0.
+		Layer layer;
+		for (size_t i = 0; i < pMesh.elements.size(); i++)
+		{
+			const LayerElement& element = pMesh.elements[i];
+			const LayerElement** slot = NULL;
+			switch (element.type)
+			{
+			case LayerElement::eNormal: slot = &layer.normals; break;
+			case LayerElement::eBiNormal: slot = &layer.binormals; break;
+			case LayerElement::eTangent: slot = &layer.tangents; break;
+			case LayerElement::eUV: slot = &layer.uvs; break;
+			case LayerElement::eVertexColor: slot = &layer.colors; break;
+			case LayerElement::eMaterial: slot = &layer.materials; break;
+			default: break;
+			}
+			if (slot && !*slot)
+				*slot = &element;
+		}
+		pMesh.layers.push_back(layer);
+		return;
+	}
+
+	for (std::map<int, const Record*>::const_iterator it = layerRecords.begin(); it != layerRecords.end(); ++it)
+	{
+		Layer layer;
+		const Record& layerRecord = *it->second;
+		for (size_t i = 0; i < layerRecord.children.size(); i++)
+		{
+			const Record& ref = layerRecord.children[i];
+			if (ref.name != "LayerElement")
+				continue;
+			const Record* type = ref.Find("Type");
+			const Record* typedIndex = ref.Find("TypedIndex");
+			if (!type)
+				continue;
+			std::string typeName = StringAt(*type, 0);
+			int index = typedIndex && !typedIndex->properties.empty() ? (int)typedIndex->properties[0].AsInt() : 0;
+
+			std::map<std::pair<std::string, int>, const LayerElement*>::const_iterator found =
+				byName.find(std::make_pair(typeName, index));
+			if (found == byName.end())
+				continue;
+			const LayerElement* element = found->second;
+			switch (element->type)
+			{
+			case LayerElement::eNormal: layer.normals = element; break;
+			case LayerElement::eBiNormal: layer.binormals = element; break;
+			case LayerElement::eTangent: layer.tangents = element; break;
+			case LayerElement::eUV: layer.uvs = element; break;
+			case LayerElement::eVertexColor: layer.colors = element; break;
+			case LayerElement::eMaterial: layer.materials = element; break;
+			default: break;
+			}
+		}
+		pMesh.layers.push_back(layer);
+	}
+}
+
+}
+
+void LayerElement::GetDirect(int pIndex, double* pOut) const
+{
+	size_t base = (size_t)pIndex * stride;
+	for (int i = 0; i < stride; i++)
+		pOut[i] = directArray.GetDouble(base + i);
+}
+
+void Mesh::GetControlPoint(int pIndex, double* pOut) const
+{
+	size_t base = (size_t)pIndex * 3;
+	for (int i = 0; i < 3; i++)
+		pOut[i] = vertices.GetDouble(base + i);
+}
+
+void Mesh::BuildPolygonStarts() const
+{
+	if (!mPolygonStarts.empty())
+		return;
+	mPolygonStarts.push_back(0);
+	const size_t count = polygonVertexIndex.Size();
+	for (size_t i = 0; i < count; i++)
+	{
+		if (polygonVertexIndex.GetInt(i) < 0)
+			mPolygonStarts.push_back((int)i + 1);
+	}
+}
+
+int Mesh::GetPolygonCount() const
+{
+	BuildPolygonStarts();
+	return (int)mPolygonStarts.size() - 1;
+}
+
+int Mesh::GetPolygonStart(int pPolygon) const
+{
+	BuildPolygonStarts();
+	return mPolygonStarts[pPolygon];
+}
+
+int Mesh::GetPolygonSize(int pPolygon) const
+{
+	BuildPolygonStarts();
+	return mPolygonStarts[pPolygon + 1] - mPolygonStarts[pPolygon];
+}
+
+Layer::Layer()
+	: normals(NULL)
+	, binormals(NULL)
+	, tangents(NULL)
+	, uvs(NULL)
+	, colors(NULL)
+	, materials(NULL)
+{
+}
+
+AnimCurveNode::AnimCurveNode()
+	: node(NULL)
+{
+	for (int i = 0; i < 3; i++)
+	{
+		defaults[i] = 0.0;
+		curves[i] = NULL;
+	}
+}
+
+Cluster::Cluster()
+	: link(NULL)
+{
+	for (int i = 0; i < 16; i++)
+		transform[i] = transformLink[i] = i % 5 == 0 ? 1.0 : 0.0;
+}
+
+Node::Node()
+	: rotationOrder(0)
+	, inheritType(1)
+	, parent(NULL)
+{
+	for (int i = 0; i < 3; i++)
+	{
+		translation[i] = 0.0;
+		rotation[i] = 0.0;
+		scaling[i] = 1.0;
+		rotationOffset[i] = rotationPivot[i] = 0.0;
+		scalingOffset[i] = scalingPivot[i] = 0.0;
+		preRotation[i] = postRotation[i] = 0.0;
+	}
+}
+
+Material::Material()
+	: ambientFactor(1.0)
+	, diffuseFactor(1.0)
+	, emissiveFactor(1.0)
+	, specularFactor(1.0)
+	, shininess(20.0)
+	, transparencyFactor(0.0)
+	, reflectionFactor(1.0)
+	, bumpFactor(1.0)
+{
+	for (int i = 0; i < 3; i++)
+	{
+		ambient[i] = 0.2;
+		diffuse[i] = 0.8;
+		emissive[i] = 0.0;
+		specular[i] = 0.2;
+		transparent[i] = 0.0;
+		reflection[i] = 0.0;
+	}
+}
+
+bool BuildScene(const Document& pDocument, Scene& pScene)
+{
+	const Record& root = pDocument.GetRoot();
+	const bool binary = pDocument.IsBinary();
+
+	const Record* objects = root.Find("Objects");
+	const Record* connections = root.Find("Connections");
+	if (!objects)
+		return false;
+
+	// Property templates from the Definitions section, keyed by object type.
+	std::map<std::string, const Record*> templates;
+	if (const Record* definitions = root.Find("Definitions"))
+	{
+		for (size_t i = 0; i < definitions->children.size(); i++)
+		{
+			const Record& objectType = definitions->children[i];
+			const Record* propertyTemplate = objectType.Find("PropertyTemplate");
+			if (objectType.name == "ObjectType" && propertyTemplate)
+				templates[StringAt(objectType, 0)] = propertyTemplate->Find("Properties70");
+		}
+	}
+
+	if (const Record* globalSettings = root.Find("GlobalSettings"))
+	{
+		const Record* properties = globalSettings->Find("Properties70");
+		const Record* timeMode = FindP(properties, "TimeMode");
+		const Record* customRate = FindP(properties, "CustomFrameRate");
+		int mode = timeMode && timeMode->properties.size() > 4 ? (int)timeMode->properties[4].AsInt() : 0;
+		if (mode == kTimeModeCustom)
+			pScene.frameRate = customRate && customRate->properties.size() > 4 ? customRate->properties[4].AsDouble() : 0.0;
+		else if (mode > 0 && mode < (int)(sizeof(kTimeModeRates) / sizeof(kTimeModeRates[0])))
+			pScene.frameRate = kTimeModeRates[mode];
+
+		AxisSystem& axes = pScene.axisSystem;
+		axes.upAxis = (int)ReadNumber(*globalSettings, NULL, "UpAxis", axes.upAxis);
+		axes.upSign = (int)ReadNumber(*globalSettings, NULL, "UpAxisSign", axes.upSign);
+		axes.frontAxis = (int)ReadNumber(*globalSettings, NULL, "FrontAxis", axes.frontAxis);
+		axes.frontSign = (int)ReadNumber(*globalSettings, NULL, "FrontAxisSign", axes.frontSign);
+		axes.coordAxis = (int)ReadNumber(*globalSettings, NULL, "CoordAxis", axes.coordAxis);
+		axes.coordSign = (int)ReadNumber(*globalSettings, NULL, "CoordAxisSign", axes.coordSign);
+		pScene.unitScale = ReadNumber(*globalSettings, NULL, "UnitScaleFactor", 1.0);
+	}
+
+	static const double kZero[3] = { 0.0, 0.0, 0.0 };
+	static const double kOne[3] = { 1.0, 1.0, 1.0 };
+
+	std::map<int64_t, ObjectEntry> entries;
+	for (size_t i = 0; i < objects->children.size(); i++)
+	{
+		const Record& object = objects->children[i];
+		if (object.properties.empty())
+			continue;
+		ObjectEntry& entry = entries[object.properties[0].AsInt()];
+		entry.record = &object;
+
+		std::string subclass = StringAt(object, 2);
+		if (object.name == "Model")
+		{
+			pScene.nodes.push_back(Node());
+			Node& node = pScene.nodes.back();
+			node.name = ObjectName(object, binary);
+			const Record* nodeTemplate = templates.count("Model") ? templates["Model"] : NULL;
+			ReadVector3(object, nodeTemplate, "Lcl Translation", kZero, node.translation);
+			ReadVector3(object, nodeTemplate, "Lcl Rotation", kZero, node.rotation);
+			ReadVector3(object, nodeTemplate, "Lcl Scaling", kOne, node.scaling);
+			ReadVector3(object, nodeTemplate, "RotationOffset", kZero, node.rotationOffset);
+			ReadVector3(object, nodeTemplate, "RotationPivot", kZero, node.rotationPivot);
+			ReadVector3(object, nodeTemplate, "ScalingOffset", kZero, node.scalingOffset);
+			ReadVector3(object, nodeTemplate, "ScalingPivot", kZero, node.scalingPivot);
+			ReadVector3(object, nodeTemplate, "PreRotation", kZero, node.preRotation);
+			ReadVector3(object, nodeTemplate, "PostRotation", kZero, node.postRotation);
+			node.rotationOrder = (int)ReadNumber(object, nodeTemplate, "RotationOrder", 0.0);
+			node.inheritType = (int)ReadNumber(object, nodeTemplate, "InheritType", 1.0);
+			entry.node = &node;
+		}
+		else if (object.name == "Geometry" && subclass == "Shape")
+		{
+			pScene.shapes.push_back(Shape());
+			Shape& shape = pScene.shapes.back();
+			shape.name = ObjectName(object, binary);
+			shape.indexes = FindArray(object, "Indexes");
+			shape.vertices = FindArray(object, "Vertices");
+			shape.normals = FindArray(object, "Normals");
+			entry.shape = &shape;
+		}
+		else if (object.name == "Geometry" || object.name == "NodeAttribute")
+		{
+			pScene.attributes.push_back(NodeAttribute());
+			NodeAttribute& attribute = pScene.attributes.back();
+			attribute.type = NodeAttribute::eUnknown;
+			attribute.name = ObjectName(object, binary);
+			attribute.mesh = NULL;
+			for (size_t c = 0; c < sizeof(kAttributeClasses) / sizeof(kAttributeClasses[0]); c++)
+			{
+				if (subclass == kAttributeClasses[c].subclass)
+				{
+					attribute.type = kAttributeClasses[c].type;
+					break;
+				}
+			}
+			if (attribute.type == NodeAttribute::eMesh)
+			{
+				pScene.meshes.push_back(Mesh());
+				attribute.mesh = &pScene.meshes.back();
+				BuildMesh(object, *attribute.mesh);
+			}
+			entry.attribute = &attribute;
+		}
+		else if (object.name == "Material")
+		{
+			pScene.materials.push_back(Material());
+			Material& material = pScene.materials.back();
+			material.name = ObjectName(object, binary);
+			const Record* materialTemplate = templates.count("Material") ? templates["Material"] : NULL;
+			const Record* shadingModel = object.Find("ShadingModel");
+			if (!shadingModel)
+				shadingModel = FindP(object.Find("Properties70"), "ShadingModel");
+			material.shadingModel = shadingModel ? StringAt(*shadingModel, shadingModel->name == "P" ? 4 : 0) : std::string();
+			ReadVector3(object, materialTemplate, "AmbientColor", material.ambient, material.ambient);
+			material.ambientFactor = ReadNumber(object, materialTemplate, "AmbientFactor", material.ambientFactor);
+			ReadVector3(object, materialTemplate, "DiffuseColor", material.diffuse, material.diffuse);
+			material.diffuseFactor = ReadNumber(object, materialTemplate, "DiffuseFactor", material.diffuseFactor);
+			ReadVector3(object, materialTemplate, "EmissiveColor", material.emissive, material.emissive);
+			material.emissiveFactor = ReadNumber(object, materialTemplate, "EmissiveFactor", material.emissiveFactor);
+			ReadVector3(object, materialTemplate, "SpecularColor", material.specular, material.specular);
+			material.specularFactor = ReadNumber(object, materialTemplate, "SpecularFactor", material.specularFactor);
+			material.shininess = ReadNumber(object, materialTemplate, "ShininessExponent", material.shininess);
+			ReadVector3(object, materialTemplate, "TransparentColor", material.transparent, material.transparent);
+			material.transparencyFactor = ReadNumber(object, materialTemplate, "TransparencyFactor",
+				material.transparencyFactor);
+			ReadVector3(object, materialTemplate, "ReflectionColor", material.reflection, material.reflection);
+			material.reflectionFactor = ReadNumber(object, materialTemplate, "ReflectionFactor", material.reflectionFactor);
+			material.bumpFactor = ReadNumber(object, materialTemplate, "BumpFactor", material.bumpFactor);
+			entry.material = &material;
+		}
+		else if (object.name == "Texture")
+		{
+			pScene.textures.push_back(Texture());
+			Texture& texture = pScene.textures.back();
+			texture.name = ObjectName(object, binary);
+			const Record* fileName = object.Find("FileName");
+			const Record* relativeFileName = object.Find("RelativeFilename");
+			texture.fileName = fileName ? StringAt(*fileName, 0) : std::string();
+			texture.relativeFileName = relativeFileName ? StringAt(*relativeFileName, 0) : std::string();
+			entry.texture = &texture;
+		}
+		else if (object.name == "Video")
+		{
+			pScene.videos.push_back(Video());
+			Video& video = pScene.videos.back();
+			video.name = ObjectName(object, binary);
+			const Record* fileName = object.Find("Filename");
+			if (!fileName)
+				fileName = object.Find("FileName");
+			const Record* relativeFileName = object.Find("RelativeFilename");
+			video.fileName = fileName ? StringAt(*fileName, 0) : std::string();
+			video.relativeFileName = relativeFileName ? StringAt(*relativeFileName, 0) : std::string();
+			const Record* content = object.Find("Content");
+			if (content && !content->properties.empty() && content->properties[0].type == 'R')
+			{
+				video.content = content->properties[0].data;
+				video.contentSize = content->properties[0].size;
+			}
+			entry.video = &video;
+		}
+		else if (object.name == "AnimationStack")
+		{
+			pScene.animStacks.push_back(AnimStack());
+			AnimStack& stack = pScene.animStacks.back();
+			stack.name = ObjectName(object, binary);
+			stack.localStart = ReadTime(object, "LocalStart");
+			stack.localStop = ReadTime(object, "LocalStop");
+			entry.animStack = &stack;
+		}
+		else if (object.name == "AnimationLayer")
+		{
+			pScene.animLayers.push_back(AnimLayer());
+			AnimLayer& layer = pScene.animLayers.back();
+			layer.name = ObjectName(object, binary);
+			const Record* layerTemplate = templates.count("AnimationLayer") ? templates["AnimationLayer"] : NULL;
+			layer.weight = ReadNumber(object, layerTemplate, "Weight", 100.0);
+			int blendMode = (int)ReadNumber(object, layerTemplate, "BlendMode", 0.0);
+			layer.blendMode = blendMode == 1 ? AnimLayer::eBlendOverride :
+				blendMode == 2 ? AnimLayer::eBlendOverridePassthrough : AnimLayer::eBlendAdditive;
+			entry.animLayer = &layer;
+		}
+		else if (object.name == "AnimationCurveNode")
+		{
+			pScene.animCurveNodes.push_back(AnimCurveNode());
+			AnimCurveNode& curveNode = pScene.animCurveNodes.back();
+			curveNode.name = ObjectName(object, binary);
+			static const char* const kComponents[3] = { "d|X", "d|Y", "d|Z" };
+			for (int c = 0; c < 3; c++)
+				curveNode.defaults[c] = ReadNumber(object, NULL, kComponents[c], 0.0);
+			entry.animCurveNode = &curveNode;
+		}
+		else if (object.name == "AnimationCurve")
+		{
+			pScene.animCurves.push_back(AnimCurve());
+			AnimCurve& curve = pScene.animCurves.back();
+			const Record* defaultValue = object.Find("Default");
+			curve.defaultValue = defaultValue && !defaultValue->properties.empty() ? defaultValue->properties[0].AsDouble() : 0.0;
+			curve.keyTimes = FindArray(object, "KeyTime");
+			curve.keyValues = FindArray(object, "KeyValueFloat");
+			curve.keyFlags = FindArray(object, "KeyAttrFlags");
+			curve.keyData = FindArray(object, "KeyAttrDataFloat");
+			curve.keyRefCounts = FindArray(object, "KeyAttrRefCount");
+			entry.animCurve = &curve;
+		}
+		else if (object.name == "Deformer" && subclass == "Skin")
+		{
+			pScene.skins.push_back(Skin());
+			pScene.skins.back().name = ObjectName(object, binary);
+			entry.skin = &pScene.skins.back();
+		}
+		else if (object.name == "Deformer" && subclass == "BlendShape")
+		{
+			pScene.blendShapes.push_back(BlendShape());
+			pScene.blendShapes.back().name = ObjectName(object, binary);
+			entry.blendShape = &pScene.blendShapes.back();
+		}
+		else if (object.name == "Deformer" && subclass == "BlendShapeChannel")
+		{
+			pScene.blendShapeChannels.push_back(BlendShapeChannel());
+			BlendShapeChannel& channel = pScene.blendShapeChannels.back();
+			channel.name = ObjectName(object, binary);
+			// Older files write DeformPercent as a plain child.
+			const Record* deformPercent = object.Find("DeformPercent");
+			channel.deformPercent = ReadNumber(object, NULL, "DeformPercent",
+				deformPercent && !deformPercent->properties.empty() ? deformPercent->properties[0].AsDouble() : 0.0);
+			channel.fullWeights = FindArray(object, "FullWeights");
+			entry.blendShapeChannel = &channel;
+		}
+		else if (object.name == "Deformer" && subclass == "Cluster")
+		{
+			pScene.clusters.push_back(Cluster());
+			Cluster& cluster = pScene.clusters.back();
+			cluster.name = ObjectName(object, binary);
+			cluster.indexes = FindArray(object, "Indexes");
+			cluster.weights = FindArray(object, "Weights");
+			ReadMatrix(object, "Transform", cluster.transform);
+			ReadMatrix(object, "TransformLink", cluster.transformLink);
+			entry.cluster = &cluster;
+		}
+	}
+
+	// Wire the graph together in connection order, which is also child order.
+	for (size_t i = 0; connections && i < connections->children.size(); i++)
+	{
+		const Record& c = connections->children[i];
+		if (c.name != "C" || c.properties.size() < 3)
+			continue;
+		std::string kind = StringAt(c, 0);
+		int64_t srcId = c.properties[1].AsInt();
+		int64_t dstId = c.properties[2].AsInt();
+
+		std::map<int64_t, ObjectEntry>::iterator src = entries.find(srcId);
+		if (src == entries.end())
+			continue;
+		std::map<int64_t, ObjectEntry>::iterator dst = entries.find(dstId);
+		ObjectEntry* parent = dst == entries.end() ? NULL : &dst->second;
+
+		if (src->second.node)
+		{
+			Node* node = src->second.node;
+			if (dstId == 0)
+			{
+				node->parent = &pScene.root;
+				pScene.root.children.push_back(node);
+			}
+			else if (parent && parent->node && !node->parent)
+			{
+				node->parent = parent->node;
+				parent->node->children.push_back(node);
+			}
+			else if (parent && parent->cluster)
+				parent->cluster->link = node;
+		}
+		else if (src->second.attribute && parent && parent->node)
+			parent->node->attributes.push_back(src->second.attribute);
+		else if (src->second.material && parent && parent->node)
+			parent->node->materials.push_back(src->second.material);
+		else if (src->second.texture && parent && parent->material && kind == "OP")
+		{
+			std::string property = StringAt(c, 3);
+			for (size_t t = 0; t < sizeof(kTextureChannels) / sizeof(kTextureChannels[0]); t++)
+			{
+				if (property == kTextureChannels[t].property)
+				{
+					parent->material->textures[kTextureChannels[t].type].push_back(src->second.texture);
+					break;
+				}
+			}
+		}
+		else if (src->second.video && parent && parent->texture)
+			parent->texture->video = src->second.video;
+		else if (src->second.cluster && parent && parent->skin)
+			parent->skin->clusters.push_back(src->second.cluster);
+		else if (src->second.skin && parent && parent->attribute && parent->attribute->mesh)
+		{
+			src->second.skin->mesh = parent->attribute->mesh;
+			parent->attribute->mesh->skins.push_back(src->second.skin);
+		}
+		else if (src->second.shape && parent && parent->blendShapeChannel)
+			parent->blendShapeChannel->shapes.push_back(src->second.shape);
+		else if (src->second.blendShapeChannel && parent && parent->blendShape)
+			parent->blendShape->channels.push_back(src->second.blendShapeChannel);
+		else if (src->second.blendShape && parent && parent->attribute && parent->attribute->mesh)
+		{
+			src->second.blendShape->mesh = parent->attribute->mesh;
+			parent->attribute->mesh->blendShapes.push_back(src->second.blendShape);
+		}
+		else if (src->second.animLayer && parent && parent->animStack)
+			parent->animStack->layers.push_back(src->second.animLayer);
+		else if (src->second.animCurveNode && parent && parent->animLayer)
+			parent->animLayer->curveNodes.push_back(src->second.animCurveNode);
+		else if (src->second.animCurveNode && parent && parent->node && kind == "OP")
+		{
+			src->second.animCurveNode->node = parent->node;
+			src->second.animCurveNode->property = StringAt(c, 3);
+		}
+		else if (src->second.animCurve && parent && parent->animCurveNode && kind == "OP")
+		{
+			// "d|X", "d|Y", "d|Z"
+			std::string property = StringAt(c, 3);
+			int component = property.empty() ? -1 : property[property.size() - 1] - 'X';
+			if (component >= 0 && component < 3)
+				parent->animCurveNode->curves[component] = src->second.animCurve;
+		}
+	}
+
+	// FBX 7 binds textures through materials; expose them on the first layer
+	// of each mesh the way FbxLayer::GetTextures does for older files.
+	for (size_t i = 0; i < pScene.nodes.size(); i++)
+	{
+		const Node& node = pScene.nodes[i];
+		for (size_t a = 0; a < node.attributes.size(); a++)
+		{
+			Mesh* mesh = node.attributes[a]->mesh;
+			if (!mesh || mesh->layers.empty())
+				continue;
+			Layer& layer = mesh->layers[0];
+			for (int t = LayerElement::eTextureDiffuse; t < LayerElement::eTypeCount; t++)
+			{
+				if (!layer.textures[t].empty())
+					continue;
+				for (size_t m = 0; m < node.materials.size(); m++)
+				{
+					const std::vector<const Texture*>& textures = node.materials[m]->textures[t];
+					layer.textures[t].insert(layer.textures[t].end(), textures.begin(), textures.end());
+				}
+			}
+		}
+	}
+	return true;
+}
+
+}
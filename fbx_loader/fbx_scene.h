@@ -0,0 +1,480 @@
+#ifndef FBX_SCENE_H
+#define FBX_SCENE_H
+
+#include "fbx_reader.h"
+
+#include <deque>
+#include <string>
+#include <vector>
+
+namespace fbxl {
+
+/**
+* Per-polygon-vertex (or per-control-point, ...) data attached to a mesh,
+* mirroring FbxLayerElementTemplate: a direct array of stride-sized tuples
+* and, for eIndexToDirect, an index array into it. Both are views into the
+* document, decoded only when read.
+*/
+struct LayerElement
+{
+	enum EType
+	{
+		eUnknown,
+		eNormal,
+		eBiNormal,
+		eTangent,
+		eMaterial,
+		ePolygonGroup,
+		eUV,
+		eVertexColor,
+		eSmoothing,
+		eVertexCrease,
+		eEdgeCrease,
+		eHole,
+		eUserData,
+		eVisibility,
+
+		eTextureDiffuse,
+		eTextureDiffuseFactor,
+		eTextureEmissive,
+		eTextureEmissiveFactor,
+		eTextureAmbient,
+		eTextureAmbientFactor,
+		eTextureSpecular,
+		eTextureSpecularFactor,
+		eTextureShininess,
+		eTextureNormalMap,
+		eTextureBump,
+		eTextureTransparency,
+		eTextureTransparencyFactor,
+		eTextureReflection,
+		eTextureReflectionFactor,
+		eTextureDisplacement,
+		eTextureDisplacementVector,
+
+		eTypeCount
+	};
+
+	enum EMappingMode
+	{
+		eNone,
+		eByControlPoint,
+		eByPolygonVertex,
+		eByPolygon,
+		eByEdge,
+		eAllSame
+	};
+
+	enum EReferenceMode
+	{
+		eDirect,
+		eIndex,
+		eIndexToDirect
+	};
+
+	EType type;
+	std::string name;
+	EMappingMode mappingMode;
+	EReferenceMode referenceMode;
+	int stride;
+	ArrayView directArray;
+	ArrayView indexArray;
+
+	int GetCount() const { return stride ? (int)(directArray.Size() / stride) : 0; }
+	void GetDirect(int pIndex, double* pOut) const;
+	int GetIndex(int pIndex) const { return indexArray.GetInt(pIndex); }
+};
+
+/**
+* Mirrors FbxVideo: the image file behind a texture. content views the copy
+* of the file embedded in the document (the Content record), in place in the
+* mapped file for binary documents and decoded once from base64 for ASCII
+* ones; contentSize is 0 when the file is only referenced by name. Nothing
+* is written to disk, unlike the SDK, which extracts embedded files into a
+* .fbm folder on import.
+*/
+struct Video
+{
+	std::string name;
+	std::string fileName;
+	std::string relativeFileName;
+	const unsigned char* content;
+	size_t contentSize;
+
+	Video() : content(NULL), contentSize(0) {}
+
+	bool IsEmbedded() const { return contentSize != 0; }
+};
+
+struct Texture
+{
+	std::string name;
+	std::string fileName;
+	std::string relativeFileName;
+	const Video* video;
+
+	Texture() : video(NULL) {}
+};
+
+/**
+* A surface material with the properties FbxSurfaceLambert and
+* FbxSurfacePhong define, read from the object, then its template, then the
+* SDK's defaults. shadingModel is the file's ShadingModel ("lambert",
+* "phong", or whatever the exporter wrote); Phong-only properties keep their
+* defaults on other models. Colors are RGB, each with its factor.
+*/
+struct Material
+{
+	std::string name;
+	std::string shadingModel;
+	double ambient[3];
+	double ambientFactor;
+	double diffuse[3];
+	double diffuseFactor;
+	double emissive[3];
+	double emissiveFactor;
+	double specular[3];
+	double specularFactor;
+	double shininess;
+	double transparent[3];
+	double transparencyFactor;
+	double reflection[3];
+	double reflectionFactor;
+	double bumpFactor;
+	std::vector<const Texture*> textures[LayerElement::eTypeCount];
+
+	Material();
+};
+
+/**
+* One FBX "Layer": a selection of the mesh's layer elements, at most one of
+* each kind. Texture channels come from the materials bound to the node.
+*/
+struct Layer
+{
+	const LayerElement* normals;
+	const LayerElement* binormals;
+	const LayerElement* tangents;
+	const LayerElement* uvs;
+	const LayerElement* colors;
+	const LayerElement* materials;
+	std::vector<const Texture*> textures[LayerElement::eTypeCount];
+
+	Layer();
+};
+
+/**
+* Geometry of a mesh. Vertices and PolygonVertexIndex stay views into the
+* document; the polygon table is only built when polygons are asked for.
+*/
+struct Skin;
+struct BlendShape;
+
+struct Mesh
+{
+	ArrayView vertices;
+	ArrayView polygonVertexIndex;
+	std::deque<LayerElement> elements;
+	std::vector<Layer> layers;
+	std::vector<Skin*> skins;
+	std::vector<BlendShape*> blendShapes;
+
+	int GetControlPointsCount() const { return (int)(vertices.Size() / 3); }
+	void GetControlPoint(int pIndex, double* pOut) const;
+	int GetPolygonVertexCount() const { return (int)polygonVertexIndex.Size(); }
+
+	/**
+	* Control point index of polygon vertex pIndex. The file marks the last
+	* vertex of each polygon by storing ~index; that is undone here.
+	*/
+	int GetPolygonVertex(int pIndex) const
+	{
+		int index = polygonVertexIndex.GetInt(pIndex);
+		return index < 0 ? ~index : index;
+	}
+
+	int GetPolygonCount() const;
+	int GetPolygonStart(int pPolygon) const;
+	int GetPolygonSize(int pPolygon) const;
+
+private:
+	void BuildPolygonStarts() const;
+
+	mutable std::vector<int> mPolygonStarts;
+};
+
+/**
+* Mirrors FbxNodeAttribute: what a node is (mesh, skeleton, camera, ...).
+*/
+struct NodeAttribute
+{
+	enum EType
+	{
+		eUnknown,
+		eNull,
+		eMarker,
+		eSkeleton,
+		eMesh,
+		eNurbs,
+		ePatch,
+		eCamera,
+		eCameraStereo,
+		eCameraSwitcher,
+		eLight,
+		eOpticalReference,
+		eOpticalMarker,
+		eNurbsCurve,
+		eTrimNurbsSurface,
+		eBoundary,
+		eNurbsSurface,
+		eShape,
+		eLODGroup,
+		eSubDiv,
+		eCachedEffect,
+		eLine
+	};
+
+	EType type;
+	std::string name;
+	Mesh* mesh;
+};
+
+/**
+* A node of the scene tree. translation, rotation (Euler degrees, applied
+* in rotationOrder) and scaling are the Lcl properties; the rest are the
+* FbxNode pivot properties that place them, as FbxTransform combines them:
+* T * Roff * Rp * Rpre * R * Rpost^-1 * Rp^-1 * Soff * Sp * S * Sp^-1.
+* rotationOrder is an EFbxRotationOrder (0 is XYZ: X first) and
+* inheritType an FbxTransform::EInheritType (1, RSrs, is the default).
+*/
+struct Node
+{
+	std::string name;
+	double translation[3];
+	double rotation[3];
+	double scaling[3];
+	double rotationOffset[3];
+	double rotationPivot[3];
+	double scalingOffset[3];
+	double scalingPivot[3];
+	double preRotation[3];
+	double postRotation[3];
+	int rotationOrder;
+	int inheritType;
+	Node* parent;
+	std::vector<NodeAttribute*> attributes;
+	std::vector<Material*> materials;
+	std::vector<Node*> children;
+
+	Node();
+};
+
+/**
+* Mirrors FbxCluster: the control points one bone moves, and by how much.
+* transformLink is the global matrix of the bone at bind time; transform
+* is the file's Transform, the mesh's bind matrix relative to the bone
+* (transformLink * transform is what FbxCluster::GetTransformMatrix
+* returns). Both are 16 doubles as the file stores them (FbxAMatrix
+* layout, translation in elements 12 to 14), identity when missing.
+*/
+struct Cluster
+{
+	std::string name;
+	Node* link;
+	ArrayView indexes;
+	ArrayView weights;
+	double transform[16];
+	double transformLink[16];
+
+	Cluster();
+};
+
+/**
+* Mirrors FbxSkin: the clusters that deform one mesh.
+*/
+struct Skin
+{
+	std::string name;
+	Mesh* mesh;
+	std::vector<Cluster*> clusters;
+
+	Skin() : mesh(NULL) {}
+};
+
+/**
+* A blend shape target as the file stores it, sparse: indexes are the
+* control points it moves, vertices their offsets from the base mesh, and
+* normals, when present, the matching normal offsets. FbxShape expands
+* these into full control point copies; here they stay views.
+*/
+struct Shape
+{
+	std::string name;
+	ArrayView indexes;
+	ArrayView vertices;
+	ArrayView normals;
+};
+
+/**
+* Mirrors FbxBlendShapeChannel: one slider, deformPercent, over one target
+* or a chain of in-between targets reached at fullWeights percent each.
+*/
+struct BlendShapeChannel
+{
+	std::string name;
+	double deformPercent;
+	ArrayView fullWeights;
+	std::vector<Shape*> shapes;
+
+	BlendShapeChannel() : deformPercent(0.0) {}
+};
+
+/**
+* Mirrors FbxBlendShape: the channels that deform one mesh.
+*/
+struct BlendShape
+{
+	std::string name;
+	Mesh* mesh;
+	std::vector<BlendShapeChannel*> channels;
+
+	BlendShape() : mesh(NULL) {}
+};
+
+/**
+* FBX time unit (FbxTime): ticks per second.
+*/
+const int64_t kTimeTicksPerSecond = 46186158000LL;
+
+/**
+* Mirrors FbxAnimCurve: one animated value over time. Keys stay views into
+* the document. Interpolation and tangents live in attribute entries, each
+* shared by a run of consecutive keys whose length keyRefCounts gives; an
+* entry is one keyFlags word and four keyData floats (right slope, next
+* key's left slope, packed weights, velocity).
+*/
+struct AnimCurve
+{
+	enum EFlags
+	{
+		eInterpolationConstant = 0x00000002,
+		eInterpolationLinear = 0x00000004,
+		eInterpolationCubic = 0x00000008,
+		eConstantNext = 0x00000100
+	};
+
+	double defaultValue;
+	ArrayView keyTimes;
+	ArrayView keyValues;
+	ArrayView keyFlags;
+	ArrayView keyData;
+	ArrayView keyRefCounts;
+
+	int GetKeyCount() const { return (int)keyTimes.Size(); }
+};
+
+/**
+* Mirrors FbxAnimCurveNode: the curves driving one property of a node, such
+* as "Lcl Translation", within one layer, one curve per component. A
+* component without a curve holds its default.
+*/
+struct AnimCurveNode
+{
+	std::string name;
+	std::string property;
+	Node* node;
+	double defaults[3];
+	const AnimCurve* curves[3];
+
+	AnimCurveNode();
+};
+
+struct AnimLayer
+{
+	enum EBlendMode
+	{
+		eBlendAdditive,
+		eBlendOverride,
+		eBlendOverridePassthrough
+	};
+
+	std::string name;
+	double weight;
+	EBlendMode blendMode;
+	std::vector<AnimCurveNode*> curveNodes;
+};
+
+/**
+* Mirrors FbxAnimStack. localStart/localStop are the span the take plays,
+* in KTime ticks; both are 0 when the file does not set them.
+*/
+struct AnimStack
+{
+	std::string name;
+	int64_t localStart;
+	int64_t localStop;
+	std::vector<AnimLayer*> layers;
+};
+
+/**
+* Mirrors FbxAxisSystem as GlobalSettings stores it: the file axis (0 for
+* X, 1 for Y, 2 for Z) and sign of the up, front and side (coord) vectors.
+* The default is the SDK's, Y up, Z front and X to the side, right handed.
+*/
+struct AxisSystem
+{
+	int upAxis;
+	int upSign;
+	int frontAxis;
+	int frontSign;
+	int coordAxis;
+	int coordSign;
+
+	AxisSystem() : upAxis(1), upSign(1), frontAxis(2), frontSign(1), coordAxis(0), coordSign(1) {}
+	AxisSystem(int pUpAxis, int pUpSign, int pFrontAxis, int pFrontSign, int pCoordAxis, int pCoordSign)
+		: upAxis(pUpAxis), upSign(pUpSign), frontAxis(pFrontAxis), frontSign(pFrontSign), coordAxis(pCoordAxis),
+		coordSign(pCoordSign) {}
+};
+
+/**
+* The object graph of an FBX document, resolved from its Objects and
+* Connections sections. frameRate is the document's frames per second
+* (GlobalSettings TimeMode), 0 when it does not say. axisSystem and
+* unitScale (centimetres per file unit, UnitScaleFactor) say how to read
+* its coordinates. Everything is owned
+* by the scene, but geometry arrays are views into the Document, which has
+* to stay alive as long as the scene.
+*/
+struct Scene
+{
+	Node root;
+	double frameRate;
+	AxisSystem axisSystem;
+	double unitScale;
+	std::deque<Node> nodes;
+	std::deque<NodeAttribute> attributes;
+	std::deque<Mesh> meshes;
+	std::deque<Material> materials;
+	std::deque<Texture> textures;
+	std::deque<Video> videos;
+	std::deque<AnimStack> animStacks;
+	std::deque<AnimLayer> animLayers;
+	std::deque<AnimCurveNode> animCurveNodes;
+	std::deque<AnimCurve> animCurves;
+	std::deque<Skin> skins;
+	std::deque<Cluster> clusters;
+	std::deque<BlendShape> blendShapes;
+	std::deque<BlendShapeChannel> blendShapeChannels;
+	std::deque<Shape> shapes;
+
+	Scene() : frameRate(0.0), unitScale(1.0) {}
+};
+
+/**
+* Build pScene from a parsed document. Unknown object types are skipped.
+*/
+bool BuildScene(const Document& pDocument, Scene& pScene);
+
+}
+
+#endif
@@ -0,0 +1,569 @@
+#include "fbx_simplify.h"
+
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+namespace fbxl {
+
+namespace {
+
+/**
+* Weight of the planes that hold creases in place, relative to the planes
+* of the triangles around them.
+*/
+const double kCreaseWeight = 10.0;
+
+/**
+* A collapse is refused if it turns a triangle's normal by more than about
+* 75 degrees.
+*/
+const double kMinFlipCosine = 0.25;
+
+void Cross(const double* a, const double* b, double* pOut)
+{
+	pOut[0] = a[1] * b[2] - a[2] * b[1];
+	pOut[1] = a[2] * b[0] - a[0] * b[2];
+	pOut[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+double Dot(const double* a, const double* b)
+{
+	return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+/**
+* Sum of weighted squared distances to a set of planes, as the upper half
+* of a symmetric 4x4 matrix, and the sum of the weights.
+*/
+struct Quadric
+{
+	double a[10];
+	double weight;
+
+	Quadric() : weight(0.0)
+	{
+		for (int i = 0; i < 10; i++)
+			a[i] = 0.0;
+	}
+
+	void AddPlane(const double* pNormal, double pDistance, double pWeight)
+	{
+		const double p[4] = { pNormal[0], pNormal[1], pNormal[2], pDistance };
+		int k = 0;
+		for (int i = 0; i < 4; i++)
+		{
+			for (int j = i; j < 4; j++)
+				a[k++] += pWeight * p[i] * p[j];
+		}
+		weight += pWeight;
+	}
+
+	void Add(const Quadric& pOther)
+	{
+		for (int i = 0; i < 10; i++)
+			a[i] += pOther.a[i];
+		weight += pOther.weight;
+	}
+
+	/**
+	* Mean squared distance from pPoint to the planes.
+	*/
+	double GetError(const double* pPoint) const
+	{
+		if (weight <= 0.0)
+			return 0.0;
+		const double x = pPoint[0], y = pPoint[1], z = pPoint[2];
+		const double error = a[0] * x * x + 2.0 * a[1] * x * y + 2.0 * a[2] * x * z + 2.0 * a[3] * x +
+			a[4] * y * y + 2.0 * a[5] * y * z + 2.0 * a[6] * y + a[7] * z * z + 2.0 * a[8] * z + a[9];
+		return error > 0.0 ? error / weight : 0.0;
+	}
+};
+
+enum VertexKind
+{
+	eInterior,
+	eCrease,
+	eLocked
+};
+
+/**
+* One triangle edge seen from one of its ends.
+*/
+struct EdgeEnd
+{
+	uint32_t other;
+	uint32_t triangle;
+	uint32_t wedge;
+	uint32_t otherWedge;
+	int material;
+	bool forward;
+};
+
+bool HasLowerOther(const EdgeEnd& a, const EdgeEnd& b)
+{
+	return a.other < b.other;
+}
+
+struct Collapse
+{
+	uint32_t from;
+	uint32_t to;
+	double cost;
+};
+
+/**
+* Order pCollapses by cost into pOut in linear time: a counting sort on the
+* top 16 bits of the cost as a float (exponent and 7 bits of mantissa), which
+* ranks costs within 1% of each other as equal.
+*/
+void SortByCost(const std::vector<Collapse>& pCollapses, std::vector<Collapse>& pOut)
+{
+	std::vector<uint16_t> keys(pCollapses.size());
+	std::vector<uint32_t> starts(65536 + 1, 0);
+	for (size_t i = 0; i < pCollapses.size(); i++)
+	{
+		const float cost = (float)pCollapses[i].cost;
+		uint32_t bits;
+		memcpy(&bits, &cost, sizeof(bits));
+		keys[i] = (uint16_t)(bits >> 16);
+		starts[keys[i] + 1]++;
+	}
+	for (size_t k = 0; k < 65536; k++)
+		starts[k + 1] += starts[k];
+	pOut.resize(pCollapses.size());
+	for (size_t i = 0; i < pCollapses.size(); i++)
+		pOut[starts[keys[i]]++] = pCollapses[i];
+}
+
+/**
+* Edge collapse on positions rather than vertices: the vertices at one
+* position (its wedges) move together, and each goes to the wedge on the
+* same side of the collapsed edge, which is how seams survive.
+*/
+class Simplifier
+{
+public:
+	Simplifier(const std::vector<double>& pPositions, const std::vector<uint32_t>& pTriangles,
+		const std::vector<int>& pMaterials);
+
+	/**
+	* Collapse edges, cheapest first, until at most pTarget triangles are left
+	* or no collapse is allowed.
+	*/
+	void Reduce(size_t pTarget);
+
+	size_t GetTriangleCount() const { return mSources.size(); }
+	const std::vector<uint32_t>& GetTriangles() const { return mTriangles; }
+	const std::vector<uint32_t>& GetSources() const { return mSources; }
+	double GetError() const { return sqrt(mMaxCost); }
+
+private:
+	uint32_t GetPosition(uint32_t pTriangle, int pCorner) const { return mPositionOf[mTriangles[pTriangle * 3 + pCorner]]; }
+	const double* GetPoint(uint32_t pPosition) const { return &mPoints[(size_t)pPosition * 3]; }
+
+	void BuildAdjacency();
+	void Classify(bool pAddCreasePlanes, std::vector<Collapse>& pCollapses);
+	bool TryCollapse(const Collapse& pCollapse, size_t& pRemoved);
+	void Compact();
+
+	std::vector<uint32_t> mPositionOf;
+	std::vector<double> mPoints;
+	std::vector<uint32_t> mTriangles;
+	std::vector<uint32_t> mSources;
+	std::vector<int> mMaterials;
+	std::vector<Quadric> mQuadrics;
+	std::vector<uint32_t> mRemap;
+	std::vector<uint32_t> mOffsets;
+	std::vector<uint32_t> mAdjacent;
+	std::vector<unsigned char> mKinds;
+	std::vector<bool> mLocked;
+	std::vector<uint32_t> mStamps;
+	uint32_t mStamp;
+	double mMaxCost;
+};
+
+Simplifier::Simplifier(const std::vector<double>& pPositions, const std::vector<uint32_t>& pTriangles,
+	const std::vector<int>& pMaterials)
+	: mStamp(0)
+	, mMaxCost(0.0)
+{
+	// Group the vertices by position; seams are where a group has several.
+	const uint32_t vertexCount = (uint32_t)(pPositions.size() / 3);
+	std::vector<uint32_t> sorted(vertexCount);
+	for (uint32_t v = 0; v < vertexCount; v++)
+		sorted[v] = v;
+	struct ByPosition
+	{
+		const double* points;
+		bool operator()(uint32_t a, uint32_t b) const
+		{
+			const double* pa = points + (size_t)a * 3;
+			const double* pb = points + (size_t)b * 3;
+			if (pa[0] != pb[0])
+				return pa[0] < pb[0];
+			if (pa[1] != pb[1])
+				return pa[1] < pb[1];
+			return pa[2] < pb[2];
+		}
+	} byPosition = { vertexCount ? &pPositions[0] : NULL };
+	std::sort(sorted.begin(), sorted.end(), byPosition);
+	mPositionOf.resize(vertexCount);
+	for (uint32_t i = 0; i < vertexCount; i++)
+	{
+		if (i == 0 || byPosition(sorted[i - 1], sorted[i]))
+			mPoints.insert(mPoints.end(), &pPositions[(size_t)sorted[i] * 3], &pPositions[(size_t)sorted[i] * 3] + 3);
+		mPositionOf[sorted[i]] = (uint32_t)(mPoints.size() / 3 - 1);
+	}
+	const size_t positionCount = mPoints.size() / 3;
+
+	mRemap.resize(vertexCount);
+	for (uint32_t v = 0; v < vertexCount; v++)
+		mRemap[v] = v;
+	mQuadrics.resize(positionCount);
+	mKinds.resize(positionCount);
+	mStamps.assign(positionCount * 2, 0);
+
+	// Triangles that are already degenerate are left out from the start.
+	const size_t triangleCount = pTriangles.size() / 3;
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		const uint32_t* wedges = &pTriangles[t * 3];
+		const uint32_t a = mPositionOf[wedges[0]], b = mPositionOf[wedges[1]], c = mPositionOf[wedges[2]];
+		if (a == b || b == c || a == c)
+			continue;
+		mTriangles.insert(mTriangles.end(), wedges, wedges + 3);
+		mSources.push_back((uint32_t)t);
+		mMaterials.push_back(t < pMaterials.size() ? pMaterials[t] : 0);
+
+		const double* pa = GetPoint(a);
+		const double* pb = GetPoint(b);
+		const double* pc = GetPoint(c);
+		const double e1[3] = { pb[0] - pa[0], pb[1] - pa[1], pb[2] - pa[2] };
+		const double e2[3] = { pc[0] - pa[0], pc[1] - pa[1], pc[2] - pa[2] };
+		double normal[3];
+		Cross(e1, e2, normal);
+		const double length = sqrt(Dot(normal, normal));
+		if (length <= 0.0)
+			continue;
+		for (int i = 0; i < 3; i++)
+			normal[i] /= length;
+		const double distance = -Dot(normal, pa);
+		mQuadrics[a].AddPlane(normal, distance, length * 0.5);
+		mQuadrics[b].AddPlane(normal, distance, length * 0.5);
+		mQuadrics[c].AddPlane(normal, distance, length * 0.5);
+	}
+
+	std::vector<Collapse> unused;
+	BuildAdjacency();
+	Classify(true, unused);
+}
+
+void Simplifier::BuildAdjacency()
+{
+	const size_t positionCount = mPoints.size() / 3;
+	const size_t triangleCount = mSources.size();
+	mOffsets.assign(positionCount + 1, 0);
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		for (int c = 0; c < 3; c++)
+			mOffsets[GetPosition((uint32_t)t, c) + 1]++;
+	}
+	for (size_t p = 0; p < positionCount; p++)
+		mOffsets[p + 1] += mOffsets[p];
+	mAdjacent.resize(triangleCount * 3);
+	std::vector<uint32_t> cursor(mOffsets.begin(), mOffsets.end() - 1);
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		for (int c = 0; c < 3; c++)
+			mAdjacent[cursor[GetPosition((uint32_t)t, c)]++] = (uint32_t)t;
+	}
+}
+
+/**
+* Sort every position into interior (no crease edge), crease (two) or
+* locked (any other number: a crease ends or several meet), and list the
+* collapses the kinds allow with their cost. An edge is a crease unless
+* exactly two triangles share it, in opposite directions, with the same
+* material and the same wedges at both ends.
+*/
+void Simplifier::Classify(bool pAddCreasePlanes, std::vector<Collapse>& pCollapses)
+{
+	const size_t positionCount = mPoints.size() / 3;
+	pCollapses.clear();
+	std::vector<EdgeEnd> ends;
+	std::vector<std::pair<uint32_t, bool> > neighbours;
+	for (uint32_t p = 0; p < positionCount; p++)
+	{
+		ends.clear();
+		for (uint32_t i = mOffsets[p]; i < mOffsets[p + 1]; i++)
+		{
+			const uint32_t t = mAdjacent[i];
+			int c = 0;
+			while (GetPosition(t, c) != p)
+				c++;
+			const int next = (c + 1) % 3;
+			const int previous = (c + 2) % 3;
+			const uint32_t wedge = mTriangles[t * 3 + c];
+			EdgeEnd forward = { GetPosition(t, next), t, wedge, mTriangles[t * 3 + next], mMaterials[t], true };
+			EdgeEnd backward = { GetPosition(t, previous), t, wedge, mTriangles[t * 3 + previous], mMaterials[t], false };
+			ends.push_back(forward);
+			ends.push_back(backward);
+		}
+		std::sort(ends.begin(), ends.end(), HasLowerOther);
+
+		neighbours.clear();
+		int creases = 0;
+		for (size_t first = 0; first < ends.size();)
+		{
+			size_t last = first + 1;
+			while (last < ends.size() && ends[last].other == ends[first].other)
+				last++;
+			const EdgeEnd& a = ends[first];
+			const EdgeEnd& b = ends[last - 1];
+			const bool crease = last - first != 2 || a.forward == b.forward || a.wedge != b.wedge ||
+				a.otherWedge != b.otherWedge || a.material != b.material;
+			if (crease)
+			{
+				creases++;
+				if (pAddCreasePlanes)
+				{
+					// A plane through the edge, square to each triangle on it.
+					const double* pp = GetPoint(p);
+					const double* pq = GetPoint(a.other);
+					const double edge[3] = { pq[0] - pp[0], pq[1] - pp[1], pq[2] - pp[2] };
+					const double lengthSquared = Dot(edge, edge);
+					for (size_t e = first; e < last; e++)
+					{
+						const uint32_t t = ends[e].triangle;
+						const double* p0 = GetPoint(GetPosition(t, 0));
+						const double* p1 = GetPoint(GetPosition(t, 1));
+						const double* p2 = GetPoint(GetPosition(t, 2));
+						const double e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+						const double e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+						double face[3], normal[3];
+						Cross(e1, e2, face);
+						Cross(edge, face, normal);
+						const double length = sqrt(Dot(normal, normal));
+						if (length <= 0.0)
+							continue;
+						for (int i = 0; i < 3; i++)
+							normal[i] /= length;
+						mQuadrics[p].AddPlane(normal, -Dot(normal, pp), lengthSquared * kCreaseWeight);
+					}
+				}
+			}
+			neighbours.push_back(std::make_pair(a.other, crease));
+			first = last;
+		}
+		mKinds[p] = (unsigned char)(creases == 0 ? eInterior : creases == 2 ? eCrease : eLocked);
+
+		if (mKinds[p] == eLocked)
+			continue;
+		for (size_t n = 0; n < neighbours.size(); n++)
+		{
+			if (mKinds[p] == eCrease && !neighbours[n].second)
+				continue;
+			Collapse collapse = { p, neighbours[n].first, mQuadrics[p].GetError(GetPoint(neighbours[n].first)) };
+			pCollapses.push_back(collapse);
+		}
+	}
+}
+
+/**
+* Collapse pCollapse.from onto pCollapse.to unless it would leave a wedge
+* with nowhere to go, pinch the surface (the two positions share more
+* neighbours than the triangles on their edge) or flip a triangle.
+*/
+bool Simplifier::TryCollapse(const Collapse& pCollapse, size_t& pRemoved)
+{
+	const uint32_t from = pCollapse.from;
+	const uint32_t to = pCollapse.to;
+	if (mLocked[from] || mLocked[to])
+		return false;
+
+	uint32_t pairs[16][2];
+	int pairCount = 0;
+	size_t shared = 0;
+	const uint32_t neighbourStamp = ++mStamp;
+	const double* target = GetPoint(to);
+	for (uint32_t i = mOffsets[from]; i < mOffsets[from + 1]; i++)
+	{
+		const uint32_t t = mAdjacent[i];
+		int c = 0;
+		while (GetPosition(t, c) != from)
+			c++;
+		const uint32_t p1 = GetPosition(t, (c + 1) % 3);
+		const uint32_t p2 = GetPosition(t, (c + 2) % 3);
+		mStamps[p1 * 2] = neighbourStamp;
+		mStamps[p2 * 2] = neighbourStamp;
+		if (p1 == to || p2 == to)
+		{
+			const uint32_t wedge = mTriangles[t * 3 + c];
+			const uint32_t toWedge = mTriangles[t * 3 + (p1 == to ? (c + 1) % 3 : (c + 2) % 3)];
+			int k = 0;
+			while (k < pairCount && pairs[k][0] != wedge)
+				k++;
+			if (k == pairCount)
+			{
+				if (pairCount == 16)
+					return false;
+				pairs[k][0] = wedge;
+				pairs[k][1] = toWedge;
+				pairCount++;
+			}
+			else if (pairs[k][1] != toWedge)
+				return false;
+			shared++;
+			continue;
+		}
+
+		const double* a = GetPoint(from);
+		const double* b = GetPoint(p1);
+		const double* d = GetPoint(p2);
+		const double e1[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+		const double e2[3] = { d[0] - a[0], d[1] - a[1], d[2] - a[2] };
+		const double f1[3] = { b[0] - target[0], b[1] - target[1], b[2] - target[2] };
+		const double f2[3] = { d[0] - target[0], d[1] - target[1], d[2] - target[2] };
+		double before[3], after[3];
+		Cross(e1, e2, before);
+		Cross(f1, f2, after);
+		if (Dot(before, after) <= kMinFlipCosine * sqrt(Dot(before, before) * Dot(after, after)))
+			return false;
+	}
+	if (!shared)
+		return false;
+	for (uint32_t i = mOffsets[from]; i < mOffsets[from + 1]; i++)
+	{
+		const uint32_t t = mAdjacent[i];
+		for (int c = 0; c < 3; c++)
+		{
+			if (GetPosition(t, c) != from)
+				continue;
+			int k = 0;
+			while (k < pairCount && pairs[k][0] != mTriangles[t * 3 + c])
+				k++;
+			if (k == pairCount)
+				return false;
+		}
+	}
+
+	// Link condition: the only neighbours the two ends share are the
+	// triangles' third corners.
+	const uint32_t countedStamp = neighbourStamp;
+	size_t common = 0;
+	for (uint32_t i = mOffsets[to]; i < mOffsets[to + 1]; i++)
+	{
+		const uint32_t t = mAdjacent[i];
+		for (int c = 0; c < 3; c++)
+		{
+			const uint32_t p = GetPosition(t, c);
+			if (p == to || p == from || mStamps[p * 2] != neighbourStamp || mStamps[p * 2 + 1] == countedStamp)
+				continue;
+			mStamps[p * 2 + 1] = countedStamp;
+			common++;
+		}
+	}
+	if (common != shared)
+		return false;
+
+	for (int k = 0; k < pairCount; k++)
+		mRemap[pairs[k][0]] = pairs[k][1];
+	for (uint32_t i = mOffsets[from]; i < mOffsets[from + 1]; i++)
+	{
+		const uint32_t t = mAdjacent[i];
+		for (int c = 0; c < 3; c++)
+			mLocked[GetPosition(t, c)] = true;
+	}
+	mQuadrics[to].Add(mQuadrics[from]);
+	mMaxCost = std::max(mMaxCost, pCollapse.cost);
+	pRemoved += shared;
+	return true;
+}
+
+/**
+* Apply the pass's wedge moves and drop the triangles they collapsed.
+*/
+void Simplifier::Compact()
+{
+	size_t kept = 0;
+	for (size_t t = 0; t < mSources.size(); t++)
+	{
+		uint32_t wedges[3];
+		for (int c = 0; c < 3; c++)
+			wedges[c] = mRemap[mTriangles[t * 3 + c]];
+		const uint32_t a = mPositionOf[wedges[0]], b = mPositionOf[wedges[1]], c = mPositionOf[wedges[2]];
+		if (a == b || b == c || a == c)
+			continue;
+		for (int i = 0; i < 3; i++)
+			mTriangles[kept * 3 + i] = wedges[i];
+		mSources[kept] = mSources[t];
+		mMaterials[kept] = mMaterials[t];
+		kept++;
+	}
+	mTriangles.resize(kept * 3);
+	mSources.resize(kept);
+	mMaterials.resize(kept);
+}
+
+void Simplifier::Reduce(size_t pTarget)
+{
+	std::vector<Collapse> collapses;
+	std::vector<Collapse> sorted;
+	while (GetTriangleCount() > pTarget)
+	{
+		BuildAdjacency();
+		Classify(false, collapses);
+		SortByCost(collapses, sorted);
+
+		// Each pass removes at most a sixth of what is left, so later
+		// collapses are ranked with up-to-date quadrics and neighbourhoods.
+		const size_t count = GetTriangleCount();
+		const size_t goal = std::min(count - pTarget, std::max<size_t>(count / 6, 1));
+		mLocked.assign(mPoints.size() / 3, false);
+		size_t removed = 0;
+		for (size_t i = 0; i < sorted.size() && removed < goal; i++)
+			TryCollapse(sorted[i], removed);
+		if (!removed)
+			break;
+		Compact();
+	}
+}
+
+}
+
+template <typename Real>
+void BuildMeshLods(const IndexedMesh<Real>& pMesh, const std::vector<uint32_t>& pTriangles,
+	const std::vector<int>& pTrianglePolygons, const std::vector<int>& pTriangleMaterials,
+	const std::vector<float>& pRatios, std::vector<MeshLod>& pOut)
+{
+	pOut.clear();
+	if (pRatios.empty())
+		return;
+	std::vector<double> positions(pMesh.positions.begin(), pMesh.positions.end());
+	Simplifier simplifier(positions, pTriangles, pTriangleMaterials);
+	const size_t triangleCount = pTriangles.size() / 3;
+	for (size_t r = 0; r < pRatios.size(); r++)
+	{
+		simplifier.Reduce((size_t)(pRatios[r] * triangleCount));
+		pOut.push_back(MeshLod());
+		MeshLod& lod = pOut.back();
+		lod.ratio = pRatios[r];
+		lod.error = (float)simplifier.GetError();
+		lod.triangles = simplifier.GetTriangles();
+		const std::vector<uint32_t>& sources = simplifier.GetSources();
+		if (pTrianglePolygons.size() == triangleCount)
+		{
+			lod.trianglePolygons.resize(sources.size());
+			for (size_t t = 0; t < sources.size(); t++)
+				lod.trianglePolygons[t] = pTrianglePolygons[sources[t]];
+		}
+	}
+}
+
+template void BuildMeshLods(const IndexedMesh<float>&, const std::vector<uint32_t>&, const std::vector<int>&,
+	const std::vector<int>&, const std::vector<float>&, std::vector<MeshLod>&);
+template void BuildMeshLods(const IndexedMesh<double>&, const std::vector<uint32_t>&, const std::vector<int>&,
+	const std::vector<int>&, const std::vector<float>&, std::vector<MeshLod>&);
+
+}
@@ -0,0 +1,59 @@
+#ifndef FBX_SIMPLIFY_H
+#define FBX_SIMPLIFY_H
+
+#include "fbx_material.h"
+#include "fbx_weld.h"
+
+#include <stdint.h>
+#include <vector>
+
+namespace fbxl {
+
+/**
+* Triangle fractions of the LOD chain the tools build by default.
+*/
+const float kDefaultLodRatios[] = { 0.5f, 0.25f, 0.12f };
+
+/**
+* One level of detail: a triangle list over the vertices of the full mesh
+* (no vertex is moved or added, so the vertex buffers are shared), the
+* polygon each triangle descends from, and the geometric error, an
+* estimate in mesh units of how far the level strays from the full mesh's
+* surface. ratio is the fraction of triangles asked for; a mesh that runs
+* out of collapses keeps more. Triangles stay in the order of the full
+* mesh's, so a level of a mesh grouped by material is grouped too;
+* materialRanges is left for the caller to fill (see
+* GroupTrianglesByMaterial).
+*/
+struct MeshLod
+{
+	float ratio;
+	float error;
+	std::vector<uint32_t> triangles;
+	std::vector<int> trianglePolygons;
+	std::vector<MaterialRange> materialRanges;
+
+	MeshLod() : ratio(1.0f), error(0.0f) {}
+};
+
+/**
+* Build a chain of levels of detail of pTriangles, one per entry of
+* pRatios (decreasing fractions of the triangle count), by quadric error
+* edge collapse. Every collapse moves one vertex onto a neighbour, so
+* attributes never have to be interpolated. Vertices with the same position
+* but different attributes (UV or normal seams), edges with one triangle
+* (borders) and edges between triangles of different materials are creases:
+* a vertex on one can only slide along it, and one where creases meet or
+* end never moves, so seams and material boundaries keep their shape.
+* pTrianglePolygons and pTriangleMaterials give each triangle's polygon and
+* material; either may be empty. Each level continues from the previous
+* one, so the chain costs about as much as its first level.
+*/
+template <typename Real>
+void BuildMeshLods(const IndexedMesh<Real>& pMesh, const std::vector<uint32_t>& pTriangles,
+	const std::vector<int>& pTrianglePolygons, const std::vector<int>& pTriangleMaterials,
+	const std::vector<float>& pRatios, std::vector<MeshLod>& pOut);
+
+}
+
+#endif
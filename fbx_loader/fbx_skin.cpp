@@ -0,0 +1,439 @@
+#include "fbx_skin.h"
+
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define FBX_SKIN_SSE
+#include <xmmintrin.h>
+#endif
+
+namespace fbxl {
+
+namespace {
+
+struct Influence
+{
+	float weight;
+	uint16_t bone;
+};
+
+bool IsHeavier(const Influence& a, const Influence& b)
+{
+	return a.weight != b.weight ? a.weight > b.weight : a.bone < b.bone;
+}
+
+/**
+* pOut = a * b for matrices in the file's layout: element (row r, column c)
+* at [c * 4 + r], acting on column vectors.
+*/
+void MultiplyMatrices(const double* a, const double* b, double* pOut)
+{
+	double result[16];
+	for (int c = 0; c < 4; c++)
+	{
+		for (int r = 0; r < 4; r++)
+		{
+			double sum = 0.0;
+			for (int k = 0; k < 4; k++)
+				sum += a[k * 4 + r] * b[c * 4 + k];
+			result[c * 4 + r] = sum;
+		}
+	}
+	memcpy(pOut, result, sizeof(result));
+}
+
+/**
+* Inverse of an affine matrix in the same layout. A singular matrix gives
+* the identity.
+*/
+void InvertAffine(const double* m, double* pOut)
+{
+	// Cofactors of the upper 3x3, a(r, c) = m[c * 4 + r].
+	double c00 = m[5] * m[10] - m[9] * m[6];
+	double c01 = m[9] * m[2] - m[1] * m[10];
+	double c02 = m[1] * m[6] - m[5] * m[2];
+	double determinant = m[0] * c00 + m[4] * c01 + m[8] * c02;
+	double result[16] = { 1.0, 0.0, 0.0, 0.0, 0.0, 1.0, 0.0, 0.0, 0.0, 0.0, 1.0, 0.0, 0.0, 0.0, 0.0, 1.0 };
+	if (determinant != 0.0)
+	{
+		double inverse = 1.0 / determinant;
+		result[0] = c00 * inverse;
+		result[1] = c01 * inverse;
+		result[2] = c02 * inverse;
+		result[4] = (m[8] * m[6] - m[4] * m[10]) * inverse;
+		result[5] = (m[0] * m[10] - m[8] * m[2]) * inverse;
+		result[6] = (m[4] * m[2] - m[0] * m[6]) * inverse;
+		result[8] = (m[4] * m[9] - m[8] * m[5]) * inverse;
+		result[9] = (m[8] * m[1] - m[0] * m[9]) * inverse;
+		result[10] = (m[0] * m[5] - m[4] * m[1]) * inverse;
+		for (int r = 0; r < 3; r++)
+			result[12 + r] = -(result[r] * m[12] + result[4 + r] * m[13] + result[8 + r] * m[14]);
+	}
+	memcpy(pOut, result, sizeof(result));
+}
+
+#ifdef FBX_SKIN_SSE
+/**
+* Flushes denormals to zero while it lives. Bind matrices are full of
+* values like 1e-20 whose products underflow, and denormal operands slow
+* the kernels down tenfold.
+*/
+class FlushDenormals
+{
+public:
+	FlushDenormals() : mSaved(_mm_getcsr()) { _mm_setcsr(mSaved | 0x8040); }
+	~FlushDenormals() { _mm_setcsr(mSaved); }
+
+private:
+	unsigned int mSaved;
+};
+#endif
+
+void NormalizeInto(const float* pNormal, float* pOut)
+{
+	float length = sqrtf(pNormal[0] * pNormal[0] + pNormal[1] * pNormal[1] + pNormal[2] * pNormal[2]);
+	float scale = length > 0.0f ? 1.0f / length : 0.0f;
+	pOut[0] = pNormal[0] * scale;
+	pOut[1] = pNormal[1] * scale;
+	pOut[2] = pNormal[2] * scale;
+}
+
+/**
+* Apply the unit dual quaternion (pReal, pDual) to a point and, when given,
+* rotate a normal.
+*/
+void TransformDualQuaternion(const float* pReal, const float* pDual, const float* pIn, float* pOut,
+	const float* pNormal, float* pOutNormal)
+{
+	const float x = pReal[0], y = pReal[1], z = pReal[2], w = pReal[3];
+	// Translation 2 * (w * d - dw * r + r x d).
+	float tx = 2.0f * (w * pDual[0] - pDual[3] * x + y * pDual[2] - z * pDual[1]);
+	float ty = 2.0f * (w * pDual[1] - pDual[3] * y + z * pDual[0] - x * pDual[2]);
+	float tz = 2.0f * (w * pDual[2] - pDual[3] * z + x * pDual[1] - y * pDual[0]);
+
+	// v + 2 * r x (r x v + w * v)
+	float ax = y * pIn[2] - z * pIn[1] + w * pIn[0];
+	float ay = z * pIn[0] - x * pIn[2] + w * pIn[1];
+	float az = x * pIn[1] - y * pIn[0] + w * pIn[2];
+	pOut[0] = pIn[0] + 2.0f * (y * az - z * ay) + tx;
+	pOut[1] = pIn[1] + 2.0f * (z * ax - x * az) + ty;
+	pOut[2] = pIn[2] + 2.0f * (x * ay - y * ax) + tz;
+
+	if (pNormal)
+	{
+		ax = y * pNormal[2] - z * pNormal[1] + w * pNormal[0];
+		ay = z * pNormal[0] - x * pNormal[2] + w * pNormal[1];
+		az = x * pNormal[1] - y * pNormal[0] + w * pNormal[2];
+		float normal[3] = {
+			pNormal[0] + 2.0f * (y * az - z * ay),
+			pNormal[1] + 2.0f * (z * ax - x * az),
+			pNormal[2] + 2.0f * (x * ay - y * ax) };
+		NormalizeInto(normal, pOutNormal);
+	}
+}
+
+}
+
+bool BuildSkinInfluences(const Mesh& pMesh, int pInfluenceCount, SkinInfluences& pOut)
+{
+	pOut = SkinInfluences();
+	if (pInfluenceCount != 4 && pInfluenceCount != 8)
+		return false;
+	for (size_t s = 0; s < pMesh.skins.size(); s++)
+		pOut.clusters.insert(pOut.clusters.end(), pMesh.skins[s]->clusters.begin(), pMesh.skins[s]->clusters.end());
+	if (pOut.clusters.empty() || pOut.clusters.size() > 0x10000)
+		return false;
+
+	const int vertexCount = pMesh.GetControlPointsCount();
+	pOut.influenceCount = pInfluenceCount;
+	pOut.vertexCount = vertexCount;
+
+	// Count the influences of each control point, then gather them into one
+	// array ordered by control point.
+	std::vector<std::vector<int> > indexes(pOut.clusters.size());
+	std::vector<std::vector<float> > weights(pOut.clusters.size());
+	std::vector<int> starts(vertexCount + 1, 0);
+	for (size_t b = 0; b < pOut.clusters.size(); b++)
+	{
+		pOut.clusters[b]->indexes.CopyTo(indexes[b]);
+		pOut.clusters[b]->weights.CopyTo(weights[b]);
+		const size_t count = std::min(indexes[b].size(), weights[b].size());
+		for (size_t i = 0; i < count; i++)
+		{
+			if (weights[b][i] > 0.0f && indexes[b][i] >= 0 && indexes[b][i] < vertexCount)
+				starts[indexes[b][i] + 1]++;
+		}
+	}
+	for (int v = 0; v < vertexCount; v++)
+		starts[v + 1] += starts[v];
+	std::vector<Influence> influences(starts[vertexCount]);
+	std::vector<int> fill(starts.begin(), starts.end() - 1);
+	for (size_t b = 0; b < pOut.clusters.size(); b++)
+	{
+		const size_t count = std::min(indexes[b].size(), weights[b].size());
+		for (size_t i = 0; i < count; i++)
+		{
+			if (weights[b][i] > 0.0f && indexes[b][i] >= 0 && indexes[b][i] < vertexCount)
+			{
+				Influence& influence = influences[fill[indexes[b][i]]++];
+				influence.weight = weights[b][i];
+				influence.bone = (uint16_t)b;
+			}
+		}
+	}
+
+	pOut.bones.assign((size_t)vertexCount * pInfluenceCount, 0);
+	pOut.weights.assign((size_t)vertexCount * pInfluenceCount, 0.0f);
+	for (int v = 0; v < vertexCount; v++)
+	{
+		Influence* first = influences.empty() ? NULL : &influences[0] + starts[v];
+		const int count = starts[v + 1] - starts[v];
+		const int kept = std::min(count, pInfluenceCount);
+		pOut.maxInfluences = std::max(pOut.maxInfluences, count);
+		if (count > pInfluenceCount)
+			pOut.truncatedCount++;
+		if (!count)
+		{
+			pOut.unweightedCount++;
+			continue;
+		}
+		std::partial_sort(first, first + kept, first + count, IsHeavier);
+		float sum = 0.0f;
+		for (int k = 0; k < kept; k++)
+			sum += first[k].weight;
+		for (int k = 0; k < kept; k++)
+		{
+			pOut.bones[(size_t)v * pInfluenceCount + k] = first[k].bone;
+			pOut.weights[(size_t)v * pInfluenceCount + k] = first[k].weight / sum;
+		}
+	}
+	return true;
+}
+
+void BuildSkinMatrices(const SkinInfluences& pSkin, const double* pMeshGlobal, const double* pBoneGlobals,
+	std::vector<float>& pOut)
+{
+	double meshInverse[16];
+	if (pMeshGlobal)
+		InvertAffine(pMeshGlobal, meshInverse);
+
+	pOut.resize(pSkin.clusters.size() * 16);
+	for (size_t b = 0; b < pSkin.clusters.size(); b++)
+	{
+		// Transform takes bind-time mesh space to bone space; the bone's
+		// global matrix takes it out to where the bone is now.
+		const Cluster* cluster = pSkin.clusters[b];
+		double matrix[16];
+		MultiplyMatrices(pBoneGlobals ? pBoneGlobals + b * 16 : cluster->transformLink, cluster->transform, matrix);
+		if (pMeshGlobal)
+			MultiplyMatrices(meshInverse, matrix, matrix);
+
+		float* out = &pOut[b * 16];
+		for (int i = 0; i < 16; i++)
+			out[i] = (float)matrix[i];
+		out[3] = out[7] = out[11] = 0.0f;
+		out[15] = 1.0f;
+	}
+}
+
+void BuildDualQuaternions(const float* pMatrices, size_t pCount, std::vector<float>& pOut)
+{
+	pOut.resize(pCount * 8);
+	for (size_t b = 0; b < pCount; b++)
+	{
+		const float* m = pMatrices + b * 16;
+		float r[3][3];
+		for (int c = 0; c < 3; c++)
+		{
+			float column[3];
+			NormalizeInto(m + c * 4, column);
+			for (int i = 0; i < 3; i++)
+				r[i][c] = column[i];
+		}
+
+		float q[4];
+		const float trace = r[0][0] + r[1][1] + r[2][2];
+		if (trace > 0.0f)
+		{
+			float s = sqrtf(trace + 1.0f) * 2.0f;
+			q[0] = (r[2][1] - r[1][2]) / s;
+			q[1] = (r[0][2] - r[2][0]) / s;
+			q[2] = (r[1][0] - r[0][1]) / s;
+			q[3] = 0.25f * s;
+		}
+		else if (r[0][0] > r[1][1] && r[0][0] > r[2][2])
+		{
+			float s = sqrtf(1.0f + r[0][0] - r[1][1] - r[2][2]) * 2.0f;
+			q[0] = 0.25f * s;
+			q[1] = (r[0][1] + r[1][0]) / s;
+			q[2] = (r[0][2] + r[2][0]) / s;
+			q[3] = (r[2][1] - r[1][2]) / s;
+		}
+		else if (r[1][1] > r[2][2])
+		{
+			float s = sqrtf(1.0f + r[1][1] - r[0][0] - r[2][2]) * 2.0f;
+			q[0] = (r[0][1] + r[1][0]) / s;
+			q[1] = 0.25f * s;
+			q[2] = (r[1][2] + r[2][1]) / s;
+			q[3] = (r[0][2] - r[2][0]) / s;
+		}
+		else
+		{
+			float s = sqrtf(1.0f + r[2][2] - r[0][0] - r[1][1]) * 2.0f;
+			q[0] = (r[0][2] + r[2][0]) / s;
+			q[1] = (r[1][2] + r[2][1]) / s;
+			q[2] = 0.25f * s;
+			q[3] = (r[1][0] - r[0][1]) / s;
+		}
+		float length = sqrtf(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+		for (int i = 0; i < 4; i++)
+			q[i] /= length;
+
+		// Dual part: half the translation times the rotation.
+		const float tx = m[12], ty = m[13], tz = m[14];
+		float* out = &pOut[b * 8];
+		memcpy(out, q, sizeof(q));
+		out[4] = 0.5f * (tx * q[3] + ty * q[2] - tz * q[1]);
+		out[5] = 0.5f * (ty * q[3] + tz * q[0] - tx * q[2]);
+		out[6] = 0.5f * (tz * q[3] + tx * q[1] - ty * q[0]);
+		out[7] = -0.5f * (tx * q[0] + ty * q[1] + tz * q[2]);
+	}
+}
+
+void SkinLinear(const SkinInfluences& pSkin, const float* pMatrices, const float* pPositions, const float* pNormals,
+	int pFirst, int pCount, float* pOutPositions, float* pOutNormals)
+{
+#ifdef FBX_SKIN_SSE
+	FlushDenormals flush;
+#endif
+	const int slots = pSkin.influenceCount;
+	const bool normals = pNormals && pOutNormals;
+	for (int v = pFirst; v < pFirst + pCount; v++)
+	{
+		const float* in = pPositions + (size_t)v * 3;
+		float* out = pOutPositions + (size_t)v * 3;
+		const float* weights = &pSkin.weights[(size_t)v * slots];
+		const uint16_t* bones = &pSkin.bones[(size_t)v * slots];
+		if (weights[0] == 0.0f)
+		{
+			memcpy(out, in, 3 * sizeof(float));
+			if (normals)
+				memcpy(pOutNormals + (size_t)v * 3, pNormals + (size_t)v * 3, 3 * sizeof(float));
+			continue;
+		}
+
+#ifdef FBX_SKIN_SSE
+		// Blend the matrices column by column, then x * c0 + y * c1 + z * c2 + c3.
+		__m128 c0 = _mm_setzero_ps(), c1 = c0, c2 = c0, c3 = c0;
+		for (int k = 0; k < slots && weights[k] != 0.0f; k++)
+		{
+			const float* m = pMatrices + (size_t)bones[k] * 16;
+			const __m128 weight = _mm_set1_ps(weights[k]);
+			c0 = _mm_add_ps(c0, _mm_mul_ps(weight, _mm_loadu_ps(m)));
+			c1 = _mm_add_ps(c1, _mm_mul_ps(weight, _mm_loadu_ps(m + 4)));
+			c2 = _mm_add_ps(c2, _mm_mul_ps(weight, _mm_loadu_ps(m + 8)));
+			c3 = _mm_add_ps(c3, _mm_mul_ps(weight, _mm_loadu_ps(m + 12)));
+		}
+		__m128 p = _mm_add_ps(_mm_add_ps(_mm_mul_ps(c0, _mm_set1_ps(in[0])), _mm_mul_ps(c1, _mm_set1_ps(in[1]))),
+			_mm_add_ps(_mm_mul_ps(c2, _mm_set1_ps(in[2])), c3));
+		_mm_storel_pi((__m64*)out, p);
+		_mm_store_ss(out + 2, _mm_movehl_ps(p, p));
+		if (normals)
+		{
+			const float* normal = pNormals + (size_t)v * 3;
+			float result[4];
+			_mm_storeu_ps(result, _mm_add_ps(_mm_add_ps(_mm_mul_ps(c0, _mm_set1_ps(normal[0])),
+				_mm_mul_ps(c1, _mm_set1_ps(normal[1]))), _mm_mul_ps(c2, _mm_set1_ps(normal[2]))));
+			NormalizeInto(result, pOutNormals + (size_t)v * 3);
+		}
+#else
+		float m[12] = { 0.0f };
+		for (int k = 0; k < slots && weights[k] != 0.0f; k++)
+		{
+			const float* bone = pMatrices + (size_t)bones[k] * 16;
+			for (int c = 0; c < 4; c++)
+			{
+				for (int r = 0; r < 3; r++)
+					m[c * 3 + r] += weights[k] * bone[c * 4 + r];
+			}
+		}
+		for (int r = 0; r < 3; r++)
+			out[r] = m[r] * in[0] + m[3 + r] * in[1] + m[6 + r] * in[2] + m[9 + r];
+		if (normals)
+		{
+			const float* normal = pNormals + (size_t)v * 3;
+			float result[3];
+			for (int r = 0; r < 3; r++)
+				result[r] = m[r] * normal[0] + m[3 + r] * normal[1] + m[6 + r] * normal[2];
+			NormalizeInto(result, pOutNormals + (size_t)v * 3);
+		}
+#endif
+	}
+}
+
+void SkinDualQuaternion(const SkinInfluences& pSkin, const float* pDualQuaternions, const float* pPositions,
+	const float* pNormals, int pFirst, int pCount, float* pOutPositions, float* pOutNormals)
+{
+#ifdef FBX_SKIN_SSE
+	FlushDenormals flush;
+#endif
+	const int slots = pSkin.influenceCount;
+	const bool normals = pNormals && pOutNormals;
+	for (int v = pFirst; v < pFirst + pCount; v++)
+	{
+		const float* in = pPositions + (size_t)v * 3;
+		float* out = pOutPositions + (size_t)v * 3;
+		const float* weights = &pSkin.weights[(size_t)v * slots];
+		const uint16_t* bones = &pSkin.bones[(size_t)v * slots];
+		if (weights[0] == 0.0f)
+		{
+			memcpy(out, in, 3 * sizeof(float));
+			if (normals)
+				memcpy(pOutNormals + (size_t)v * 3, pNormals + (size_t)v * 3, 3 * sizeof(float));
+			continue;
+		}
+
+		const float* pivot = pDualQuaternions + (size_t)bones[0] * 8;
+		float real[4], dual[4];
+#ifdef FBX_SKIN_SSE
+		__m128 blendedReal = _mm_setzero_ps(), blendedDual = blendedReal;
+		for (int k = 0; k < slots && weights[k] != 0.0f; k++)
+		{
+			const float* q = pDualQuaternions + (size_t)bones[k] * 8;
+			float dot = q[0] * pivot[0] + q[1] * pivot[1] + q[2] * pivot[2] + q[3] * pivot[3];
+			const __m128 weight = _mm_set1_ps(dot < 0.0f ? -weights[k] : weights[k]);
+			blendedReal = _mm_add_ps(blendedReal, _mm_mul_ps(weight, _mm_loadu_ps(q)));
+			blendedDual = _mm_add_ps(blendedDual, _mm_mul_ps(weight, _mm_loadu_ps(q + 4)));
+		}
+		_mm_storeu_ps(real, blendedReal);
+		_mm_storeu_ps(dual, blendedDual);
+#else
+		for (int i = 0; i < 4; i++)
+			real[i] = dual[i] = 0.0f;
+		for (int k = 0; k < slots && weights[k] != 0.0f; k++)
+		{
+			const float* q = pDualQuaternions + (size_t)bones[k] * 8;
+			float dot = q[0] * pivot[0] + q[1] * pivot[1] + q[2] * pivot[2] + q[3] * pivot[3];
+			const float weight = dot < 0.0f ? -weights[k] : weights[k];
+			for (int i = 0; i < 4; i++)
+			{
+				real[i] += weight * q[i];
+				dual[i] += weight * q[4 + i];
+			}
+		}
+#endif
+		float length = sqrtf(real[0] * real[0] + real[1] * real[1] + real[2] * real[2] + real[3] * real[3]);
+		float scale = length > 0.0f ? 1.0f / length : 0.0f;
+		for (int i = 0; i < 4; i++)
+		{
+			real[i] *= scale;
+			dual[i] *= scale;
+		}
+		TransformDualQuaternion(real, dual, in, out, normals ? pNormals + (size_t)v * 3 : NULL,
+			normals ? pOutNormals + (size_t)v * 3 : NULL);
+	}
+}
+
+}
@@ -0,0 +1,86 @@
+#ifndef FBX_SKIN_H
+#define FBX_SKIN_H
+
+#include "fbx_scene.h"
+
+#include <stdint.h>
+#include <vector>
+
+namespace fbxl {
+
+/**
+* The cluster weights of a skinned mesh gathered per control point into
+* influenceCount (bone, weight) slots, heaviest first and summing to one.
+* Bone b is clusters[b]. Unused slots have bone 0 and weight 0; a control
+* point no cluster touches has weight 0 in every slot and is left where it
+* is by the skinning kernels.
+*/
+struct SkinInfluences
+{
+	int influenceCount;
+	int vertexCount;
+	std::vector<const Cluster*> clusters;
+	std::vector<uint16_t> bones;
+	std::vector<float> weights;
+
+	/**
+	* Control points that had more influences than slots (the lightest were
+	* dropped before normalizing), and control points with none.
+	*/
+	int truncatedCount;
+	int unweightedCount;
+	int maxInfluences;
+
+	SkinInfluences() : influenceCount(0), vertexCount(0), truncatedCount(0), unweightedCount(0), maxInfluences(0) {}
+
+	int GetBoneCount() const { return (int)clusters.size(); }
+};
+
+/**
+* Gather the clusters of every skin of pMesh into pOut with pInfluenceCount
+* slots per control point (4 or 8). Returns false if the mesh has no skin,
+* pInfluenceCount is not 4 or 8, or there are more than 65536 bones.
+*/
+bool BuildSkinInfluences(const Mesh& pMesh, int pInfluenceCount, SkinInfluences& pOut);
+
+/**
+* One skinning matrix per bone, 16 floats in the layout of the file's
+* matrices (four columns, translation last), for bones posed at
+* pBoneGlobals, boneCount global matrices of 16 doubles in that layout. With
+* pBoneGlobals NULL the bones are in their bind pose (TransformLink). With
+* pMeshGlobal NULL skinned vertices come out in global space, otherwise in
+* the space of the mesh placed at pMeshGlobal.
+*/
+void BuildSkinMatrices(const SkinInfluences& pSkin, const double* pMeshGlobal, const double* pBoneGlobals,
+	std::vector<float>& pOut);
+
+/**
+* The rigid part of each of pCount skinning matrices as a unit dual
+* quaternion, 8 floats: rotation (x, y, z, w) then dual part (x, y, z, w).
+* Scaling and shear are dropped.
+*/
+void BuildDualQuaternions(const float* pMatrices, size_t pCount, std::vector<float>& pOut);
+
+/**
+* Linear blend skinning of control points [pFirst, pFirst + pCount): each
+* output is its input transformed by the weighted sum of its bones'
+* matrices. Positions are xyz floats indexed by control point, in and out;
+* pNormals/pOutNormals may be NULL, and normals come out unit length. Uses
+* SSE when the compiler targets it, four lanes per matrix column, with
+* denormals flushed to zero for the duration of the call.
+*/
+void SkinLinear(const SkinInfluences& pSkin, const float* pMatrices, const float* pPositions, const float* pNormals,
+	int pFirst, int pCount, float* pOutPositions, float* pOutNormals);
+
+/**
+* Dual quaternion skinning of the same range, with pDualQuaternions from
+* BuildDualQuaternions. Blending keeps every bone on the hemisphere of the
+* vertex's heaviest one, so joints do not collapse the way they do with
+* linear blending.
+*/
+void SkinDualQuaternion(const SkinInfluences& pSkin, const float* pDualQuaternions, const float* pPositions,
+	const float* pNormals, int pFirst, int pCount, float* pOutPositions, float* pOutNormals);
+
+}
+
+#endif
@@ -0,0 +1,261 @@
+#include "fbx_texture.h"
+#include "fbx_media.h"
+#include "fbx_path.h"
+#include "fbx_thread_pool.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <chrono>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+
+namespace fbxl {
+
+namespace {
+
+std::string ToLower(const std::string& pText)
+{
+	std::string lower(pText);
+	for (size_t i = 0; i < lower.size(); i++)
+		lower[i] = (char)tolower((unsigned char)lower[i]);
+	return lower;
+}
+
+/**
+* Split pPath at either kind of slash, dropping empty and "." components.
+* pPrefix receives what makes the path absolute on this system ("/", or a
+* drive such as "C:/" on Windows) and stays empty otherwise; a drive letter
+* elsewhere is dropped, since it means nothing there.
+*/
+void SplitPath(const std::string& pPath, std::vector<std::string>& pComponents, std::string& pPrefix)
+{
+	pComponents.clear();
+	pPrefix.clear();
+	size_t start = 0;
+	if (pPath.size() >= 2 && isalpha((unsigned char)pPath[0]) && pPath[1] == ':')
+	{
+		start = 2;
+#ifdef _WIN32
+		pPrefix = pPath.substr(0, 2) + "/";
+#endif
+	}
+	else if (!pPath.empty() && (pPath[0] == '/' || pPath[0] == '\\'))
+	{
+#ifdef _WIN32
+		// UNC paths and drive-relative ones are left to the search roots.
+#else
+		pPrefix = "/";
+#endif
+	}
+	for (size_t i = start; i <= pPath.size(); i++)
+	{
+		if (i == pPath.size() || pPath[i] == '/' || pPath[i] == '\\')
+		{
+			std::string component = pPath.substr(start, i - start);
+			if (!component.empty() && component != ".")
+				pComponents.push_back(component);
+			start = i + 1;
+		}
+	}
+}
+
+bool ReadFile(const std::string& pPath, std::vector<unsigned char>& pOut)
+{
+	FILE* file = fopen(pPath.c_str(), "rb");
+	if (!file)
+		return false;
+	bool ok = fseek(file, 0, SEEK_END) == 0;
+	long size = ok ? ftell(file) : -1;
+	ok = size >= 0 && fseek(file, 0, SEEK_SET) == 0;
+	if (ok)
+	{
+		pOut.resize((size_t)size);
+		ok = size == 0 || fread(&pOut[0], 1, (size_t)size, file) == (size_t)size;
+	}
+	fclose(file);
+	return ok;
+}
+
+}
+
+void TextureResolver::AddSearchRoot(const std::string& pDirectory)
+{
+	mRoots.push_back(pDirectory.empty() ? std::string(".") : pDirectory);
+	mResolved.clear();
+}
+
+const TextureResolver::DirectoryListing& TextureResolver::List(const std::string& pDirectory)
+{
+	std::map<std::string, DirectoryListing>::iterator found = mListings.find(pDirectory);
+	if (found != mListings.end())
+		return found->second;
+	DirectoryListing& listing = mListings[pDirectory];
+	std::vector<std::pair<std::string, bool> > entries;
+#ifdef _WIN32
+	WIN32_FIND_DATAA data;
+	HANDLE find = FindFirstFileA(JoinPath(pDirectory, "*").c_str(), &data);
+	if (find != INVALID_HANDLE_VALUE)
+	{
+		do
+		{
+			const bool isDirectory = (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
+			entries.push_back(std::make_pair(std::string(data.cFileName), isDirectory));
+		} while (FindNextFileA(find, &data));
+		FindClose(find);
+	}
+#else
+	if (DIR* dir = opendir(pDirectory.c_str()))
+	{
+		while (struct dirent* entry = readdir(dir))
+		{
+			// The entry type comes with the listing on most file systems;
+			// only fall back to stat where it does not.
+			bool isDirectory = entry->d_type == DT_DIR;
+			if (entry->d_type == DT_UNKNOWN || entry->d_type == DT_LNK)
+			{
+				struct stat st;
+				isDirectory = stat(JoinPath(pDirectory, entry->d_name).c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+			}
+			entries.push_back(std::make_pair(std::string(entry->d_name), isDirectory));
+		}
+		closedir(dir);
+	}
+#endif
+	for (size_t i = 0; i < entries.size(); i++)
+	{
+		const std::string& name = entries[i].first;
+		if (name == "." || name == "..")
+			continue;
+		listing.entries[name] = entries[i].second;
+		listing.folded.insert(std::make_pair(ToLower(name), name));
+	}
+	return listing;
+}
+
+bool TextureResolver::Find(const std::string& pRoot, const std::vector<std::string>& pComponents, size_t pFirst,
+	std::string& pPath)
+{
+	if (pFirst >= pComponents.size())
+		return false;
+	++mCandidateCount;
+	std::string path = pRoot;
+	for (size_t i = pFirst; i < pComponents.size(); i++)
+	{
+		const bool last = i + 1 == pComponents.size();
+		if (pComponents[i] == "..")
+		{
+			if (last)
+				return false;
+			path = JoinPath(path, "..");
+			continue;
+		}
+		const DirectoryListing& listing = List(path);
+		std::map<std::string, bool>::const_iterator entry = listing.entries.find(pComponents[i]);
+		if (entry == listing.entries.end())
+		{
+			std::map<std::string, std::string>::const_iterator folded = listing.folded.find(ToLower(pComponents[i]));
+			if (folded == listing.folded.end())
+				return false;
+			entry = listing.entries.find(folded->second);
+		}
+		if (entry->second == last)
+			return false;
+		path = JoinPath(path, entry->first);
+	}
+	pPath = path;
+	return true;
+}
+
+bool TextureResolver::Resolve(const std::string& pFileName, const std::string& pRelativeFileName, std::string& pPath)
+{
+	const std::pair<std::string, std::string> key(pFileName, pRelativeFileName);
+	std::map<std::pair<std::string, std::string>, std::string>::const_iterator cached = mResolved.find(key);
+	if (cached != mResolved.end())
+	{
+		pPath = cached->second;
+		return !pPath.empty();
+	}
+
+	std::vector<std::string> relative, absolute;
+	std::string relativePrefix, absolutePrefix;
+	SplitPath(pRelativeFileName, relative, relativePrefix);
+	SplitPath(pFileName, absolute, absolutePrefix);
+
+	bool found = false;
+	for (size_t r = 0; r < mRoots.size() && !found; r++)
+	{
+		if (relativePrefix.empty())
+			found = Find(mRoots[r], relative, 0, pPath);
+		for (size_t i = 0; i < absolute.size() && !found; i++)
+			found = Find(mRoots[r], absolute, i, pPath);
+		for (size_t i = 1; i < relative.size() && !found; i++)
+			found = Find(mRoots[r], relative, i, pPath);
+	}
+	if (!found && !absolutePrefix.empty())
+		found = Find(absolutePrefix, absolute, 0, pPath);
+	if (!found && !relativePrefix.empty())
+		found = Find(relativePrefix, relative, 0, pPath);
+	if (!found)
+		pPath.clear();
+	mResolved[key] = pPath;
+	return found;
+}
+
+TextureResolveStats ResolveSceneTextures(const Scene& pScene, TextureResolver& pResolver, ThreadPool& pPool,
+	std::vector<ResolvedTexture>& pTextures, std::vector<TextureFile>& pFiles)
+{
+	TextureResolveStats stats = TextureResolveStats();
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	const size_t candidatesBefore = pResolver.GetCandidateCount();
+	const size_t directoriesBefore = pResolver.GetDirectoryCount();
+
+	pTextures.assign(pScene.textures.size(), ResolvedTexture());
+	pFiles.clear();
+	std::map<std::string, size_t> fileIndex;
+	for (size_t i = 0; i < pScene.textures.size(); i++)
+	{
+		const Texture& texture = pScene.textures[i];
+		ResolvedTexture& resolved = pTextures[i];
+		resolved.texture = &texture;
+		resolved.video = FindEmbeddedMedia(pScene, texture);
+		if (resolved.video)
+		{
+			resolved.source = eTextureEmbedded;
+			++stats.embeddedCount;
+		}
+		else if (pResolver.Resolve(texture.fileName, texture.relativeFileName, resolved.path))
+		{
+			resolved.source = eTextureFile;
+			if (fileIndex.insert(std::make_pair(resolved.path, pFiles.size())).second)
+			{
+				pFiles.push_back(TextureFile());
+				pFiles.back().path = resolved.path;
+			}
+		}
+		else
+			++stats.missingCount;
+	}
+	stats.textureCount = pTextures.size();
+	stats.fileCount = pFiles.size();
+	stats.candidateCount = pResolver.GetCandidateCount() - candidatesBefore;
+	stats.directoryCount = pResolver.GetDirectoryCount() - directoriesBefore;
+	std::chrono::steady_clock::time_point resolved = std::chrono::steady_clock::now();
+	stats.resolveSeconds = std::chrono::duration<double>(resolved - start).count();
+
+	pPool.ParallelFor(pFiles.size(), [&](size_t i) {
+		pFiles[i].ok = ReadFile(pFiles[i].path, pFiles[i].data);
+	});
+	for (size_t i = 0; i < pFiles.size(); i++)
+		stats.bytes += pFiles[i].data.size();
+	stats.threadCount = pPool.GetThreadCount();
+	stats.prefetchSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - resolved).count();
+	return stats;
+}
+
+}
@@ -0,0 +1,136 @@
+#ifndef FBX_TEXTURE_H
+#define FBX_TEXTURE_H
+
+#include "fbx_scene.h"
+
+#include <stddef.h>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace fbxl {
+
+class ThreadPool;
+
+/**
+* Where a texture's image was found.
+*/
+enum TextureSource
+{
+	eTextureMissing,
+	eTextureFile,
+	eTextureEmbedded
+};
+
+/**
+* A texture of the scene and its image: a path on disk, or the video whose
+* embedded copy it uses (see FindEmbeddedMedia).
+*/
+struct ResolvedTexture
+{
+	const Texture* texture;
+	TextureSource source;
+	std::string path;
+	const Video* video;
+
+	ResolvedTexture() : texture(NULL), source(eTextureMissing), video(NULL) {}
+};
+
+/**
+* An image read ahead of use by ResolveSceneTextures.
+*/
+struct TextureFile
+{
+	std::string path;
+	std::vector<unsigned char> data;
+	bool ok;
+
+	TextureFile() : ok(false) {}
+};
+
+/**
+* What ResolveSceneTextures did. candidateCount is the number of paths
+* tried, each of which would have been a stat without the directory
+* listings; directoryCount is the number of directories actually listed.
+*/
+struct TextureResolveStats
+{
+	size_t textureCount;
+	size_t fileCount;
+	size_t embeddedCount;
+	size_t missingCount;
+	size_t candidateCount;
+	size_t directoryCount;
+	size_t bytes;
+	int threadCount;
+	double resolveSeconds;
+	double prefetchSeconds;
+};
+
+/**
+* Finds the images textures name. FileName is usually an absolute path on
+* the artist's machine (often a Windows one) and RelativeFilename is
+* relative to the FBX, so neither can be trusted; both are normalized
+* (backslashes, drive letters, "." components) and tried under each search
+* root in turn: the relative name, then every tail of the absolute one
+* ("art/tex/skin.jpg", "tex/skin.jpg", "skin.jpg"), then every shorter tail
+* of the relative one; after all roots, the absolute path itself (and the
+* relative name, when it is absolute too). Names are matched case-insensitively when no exact match exists,
+* since paths written on Windows rarely have the case the files have.
+* Lookups go through cached directory listings, so each directory is read
+* once however many candidates fall in it, and a missing directory costs
+* one failed listing. Results are cached per name pair. Not thread-safe.
+*/
+class TextureResolver
+{
+public:
+	TextureResolver() : mCandidateCount(0) {}
+
+	/**
+	* Search pDirectory after the roots already added.
+	*/
+	void AddSearchRoot(const std::string& pDirectory);
+
+	const std::vector<std::string>& GetSearchRoots() const { return mRoots; }
+
+	/**
+	* Resolve a texture's FileName and RelativeFilename to an existing file,
+	* written to pPath. False when no candidate exists.
+	*/
+	bool Resolve(const std::string& pFileName, const std::string& pRelativeFileName, std::string& pPath);
+
+	size_t GetCandidateCount() const { return mCandidateCount; }
+	size_t GetDirectoryCount() const { return mListings.size(); }
+
+private:
+	/**
+	* The names in one directory, mapped to whether each is a directory
+	* itself, plus the first name of each lowercase spelling.
+	*/
+	struct DirectoryListing
+	{
+		std::map<std::string, bool> entries;
+		std::map<std::string, std::string> folded;
+	};
+
+	const DirectoryListing& List(const std::string& pDirectory);
+	bool Find(const std::string& pRoot, const std::vector<std::string>& pComponents, size_t pFirst, std::string& pPath);
+
+	std::vector<std::string> mRoots;
+	std::map<std::string, DirectoryListing> mListings;
+	std::map<std::pair<std::string, std::string>, std::string> mResolved;
+	size_t mCandidateCount;
+};
+
+/**
+* Resolve every texture of pScene, one ResolvedTexture each in pTextures:
+* embedded copies first, then files through pResolver. Every distinct file
+* found is then read into pFiles on pPool, in parallel, so decoding can
+* start without touching the disk again.
+*/
+TextureResolveStats ResolveSceneTextures(const Scene& pScene, TextureResolver& pResolver, ThreadPool& pPool,
+	std::vector<ResolvedTexture>& pTextures, std::vector<TextureFile>& pFiles);
+
+}
+
+#endif
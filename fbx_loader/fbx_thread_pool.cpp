@@ -0,0 +1,143 @@
+#include "fbx_thread_pool.h"
+
+namespace fbxl {
+
+ThreadPool::ThreadPool(int pThreadCount)
+	: mTask(NULL)
+	, mBusy(0)
+	, mGeneration(0)
+	, mStop(false)
+{
+	if (pThreadCount <= 0)
+		pThreadCount = (int)std::thread::hardware_concurrency();
+	if (pThreadCount <= 0)
+		pThreadCount = 1;
+	mRanges.reset(new WorkRange[pThreadCount]);
+	for (int i = 0; i < pThreadCount; i++)
+		mRanges[i].begin = mRanges[i].end = 0;
+	for (int i = 1; i < pThreadCount; i++)
+		mThreads.push_back(std::thread(&ThreadPool::WorkerLoop, this, i));
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mStop = true;
+	}
+	mWake.notify_all();
+	for (size_t i = 0; i < mThreads.size(); i++)
+		mThreads[i].join();
+}
+
+bool ThreadPool::PopLocal(int pSlot, size_t& pIndex)
+{
+	WorkRange& range = mRanges[pSlot];
+	std::lock_guard<std::mutex> lock(range.mutex);
+	if (range.begin >= range.end)
+		return false;
+	pIndex = range.begin++;
+	return true;
+}
+
+bool ThreadPool::Steal(int pSlot, size_t& pIndex)
+{
+	const int threadCount = GetThreadCount();
+	for (int offset = 1; offset < threadCount; offset++)
+	{
+		WorkRange& victim = mRanges[(pSlot + offset) % threadCount];
+		size_t begin, end;
+		{
+			std::lock_guard<std::mutex> lock(victim.mutex);
+			if (victim.begin >= victim.end)
+				continue;
+			// Take the back half, rounded up so a single item can be taken.
+			end = victim.end;
+			begin = victim.end - (victim.end - victim.begin + 1) / 2;
+			victim.end = begin;
+		}
+
+		// Our own range is empty, so nobody steals from it while we refill it.
+		WorkRange& own = mRanges[pSlot];
+		std::lock_guard<std::mutex> lock(own.mutex);
+		own.begin = begin + 1;
+		own.end = end;
+		pIndex = begin;
+		return true;
+	}
+	return false;
+}
+
+void ThreadPool::RunItems(int pSlot)
+{
+	size_t i;
+	while (PopLocal(pSlot, i) || Steal(pSlot, i))
+		(*mTask)(i, pSlot);
+}
+
+void ThreadPool::WorkerLoop(int pSlot)
+{
+	unsigned seen = 0;
+	for (;;)
+	{
+		{
+			std::unique_lock<std::mutex> lock(mMutex);
+			while (!mStop && mGeneration == seen)
+				mWake.wait(lock);
+			if (mStop)
+				return;
+			seen = mGeneration;
+			++mBusy;
+		}
+
+		RunItems(pSlot);
+
+		std::lock_guard<std::mutex> lock(mMutex);
+		if (--mBusy == 0)
+			mDone.notify_all();
+	}
+}
+
+void ThreadPool::ParallelFor(size_t pCount, const std::function<void(size_t)>& pTask)
+{
+	ParallelForSlots(pCount, [&](size_t i, int) { pTask(i); });
+}
+
+void ThreadPool::ParallelForSlots(size_t pCount, const std::function<void(size_t, int)>& pTask)
+{
+	if (pCount == 0)
+		return;
+	if (mThreads.empty() || pCount == 1)
+	{
+		for (size_t i = 0; i < pCount; i++)
+			pTask(i, 0);
+		return;
+	}
+
+	{
+		// The task is set before the ranges are filled: a worker still
+		// draining the previous call may pick up items as soon as they appear.
+		std::lock_guard<std::mutex> lock(mMutex);
+		mTask = &pTask;
+		const size_t threadCount = (size_t)GetThreadCount();
+		for (size_t i = 0; i < threadCount; i++)
+		{
+			std::lock_guard<std::mutex> rangeLock(mRanges[i].mutex);
+			mRanges[i].begin = pCount * i / threadCount;
+			mRanges[i].end = pCount * (i + 1) / threadCount;
+		}
+		++mGeneration;
+	}
+	mWake.notify_all();
+
+	RunItems(0);
+
+	// Every range was empty when RunItems returned; items taken by thieves
+	// are finished by the time their thread stops being busy.
+	std::unique_lock<std::mutex> lock(mMutex);
+	while (mBusy != 0)
+		mDone.wait(lock);
+	mTask = NULL;
+}
+
+}
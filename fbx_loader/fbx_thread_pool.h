@@ -0,0 +1,79 @@
+#ifndef FBX_THREAD_POOL_H
+#define FBX_THREAD_POOL_H
+
+#include <stddef.h>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace fbxl {
+
+/**
+* Fixed set of worker threads that are started once and reused. Each
+* ParallelFor splits its index range evenly across the threads; a thread that
+* runs out of work steals half of what another one has left, so uneven items
+* (one huge mesh next to many small ones) still balance without every thread
+* contending on one shared counter.
+*/
+class ThreadPool
+{
+public:
+	/**
+	* pThreadCount <= 0 uses one thread per hardware core. The calling thread
+	* also works, so the pool starts pThreadCount - 1 extra threads.
+	*/
+	explicit ThreadPool(int pThreadCount = 0);
+	~ThreadPool();
+
+	int GetThreadCount() const { return (int)mThreads.size() + 1; }
+
+	/**
+	* Run pTask(i) for every i in [0, pCount) and return once all are done.
+	* Only one ParallelFor may be in flight per pool.
+	*/
+	void ParallelFor(size_t pCount, const std::function<void(size_t)>& pTask);
+
+	/**
+	* Same as ParallelFor, but also passes the slot, in [0, GetThreadCount()),
+	* of the thread running the item. No two items run on the same slot at
+	* once, so per-slot state needs no locking.
+	*/
+	void ParallelForSlots(size_t pCount, const std::function<void(size_t, int)>& pTask);
+
+private:
+	ThreadPool(const ThreadPool&);
+	ThreadPool& operator=(const ThreadPool&);
+
+	/**
+	* The part of the index range a thread still has to run. The owner takes
+	* items from the front, thieves cut from the back.
+	*/
+	struct WorkRange
+	{
+		std::mutex mutex;
+		size_t begin;
+		size_t end;
+	};
+
+	void WorkerLoop(int pSlot);
+	void RunItems(int pSlot);
+	bool PopLocal(int pSlot, size_t& pIndex);
+	bool Steal(int pSlot, size_t& pIndex);
+
+	std::vector<std::thread> mThreads;
+	std::unique_ptr<WorkRange[]> mRanges;
+	std::mutex mMutex;
+	std::condition_variable mWake;
+	std::condition_variable mDone;
+	const std::function<void(size_t, int)>* mTask;
+	int mBusy;
+	unsigned mGeneration;
+	bool mStop;
+};
+
+}
+
+#endif
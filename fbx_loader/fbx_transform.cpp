@@ -0,0 +1,297 @@
+#include "fbx_transform.h"
+
+#include <math.h>
+#include <string.h>
+#include <map>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define FBX_TRANSFORM_SSE
+#include <xmmintrin.h>
+#endif
+
+namespace fbxl {
+
+namespace {
+
+const double kDegreesToRadians = 3.14159265358979323846 / 180.0;
+
+/**
+* EInheritType values.
+*/
+const int kInheritRrs = 2;
+
+/**
+* pOut = pA * pB for 4x4 matrices whose last row is (0, 0, 0, 1). pOut may
+* be neither input.
+*/
+void MultiplyAffine(const float* pA, const float* pB, float* pOut)
+{
+#ifdef FBX_TRANSFORM_SSE
+	const __m128 a0 = _mm_loadu_ps(pA);
+	const __m128 a1 = _mm_loadu_ps(pA + 4);
+	const __m128 a2 = _mm_loadu_ps(pA + 8);
+	const __m128 a3 = _mm_loadu_ps(pA + 12);
+	for (int c = 0; c < 4; c++)
+	{
+		const float* b = pB + c * 4;
+		__m128 column = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a0, _mm_set1_ps(b[0])), _mm_mul_ps(a1, _mm_set1_ps(b[1]))),
+			_mm_mul_ps(a2, _mm_set1_ps(b[2])));
+		if (c == 3)
+			column = _mm_add_ps(column, a3);
+		_mm_storeu_ps(pOut + c * 4, column);
+	}
+#else
+	for (int c = 0; c < 4; c++)
+	{
+		const float* b = pB + c * 4;
+		for (int r = 0; r < 4; r++)
+			pOut[c * 4 + r] = pA[r] * b[0] + pA[4 + r] * b[1] + pA[8 + r] * b[2] + (c == 3 ? pA[12 + r] : 0.0f);
+	}
+#endif
+}
+
+void SetIdentity(double* pOut)
+{
+	for (int i = 0; i < 16; i++)
+		pOut[i] = i % 5 == 0 ? 1.0 : 0.0;
+}
+
+/**
+* Local matrix of node pIndex for its pose pPose (kPoseStride floats):
+* pre with the translation added, times the rotation, times post with the
+* scaling about the scaling pivot applied.
+*/
+void GetLocalMatrix(const FlatHierarchy& pHierarchy, int pIndex, const float* pPose, float* pOut)
+{
+	const float* pre = &pHierarchy.pre[(size_t)pIndex * 16];
+	const float* post = &pHierarchy.post[(size_t)pIndex * 16];
+	const float* pivot = &pHierarchy.scalingPivots[(size_t)pIndex * 3];
+
+	float translated[16];
+	memcpy(translated, pre, sizeof(translated));
+	for (int r = 0; r < 3; r++)
+		translated[12 + r] += pPose[r];
+
+	const double degrees[3] = { pPose[3], pPose[4], pPose[5] };
+	double rotation[16];
+	EulerToMatrix(degrees, pHierarchy.rotationOrders[pIndex], rotation);
+	float rotationF[16];
+	for (int i = 0; i < 16; i++)
+		rotationF[i] = (float)rotation[i];
+
+	// post * S * Sp^-1: scale post's columns, then move by -S * Sp.
+	const float* scaling = pPose + 6;
+	float scaled[16];
+	for (int c = 0; c < 3; c++)
+	{
+		for (int r = 0; r < 4; r++)
+			scaled[c * 4 + r] = post[c * 4 + r] * scaling[c];
+	}
+	for (int r = 0; r < 4; r++)
+		scaled[12 + r] = post[12 + r] - scaled[r] * pivot[0] - scaled[4 + r] * pivot[1] - scaled[8 + r] * pivot[2];
+
+	float rotated[16];
+	MultiplyAffine(translated, rotationF, rotated);
+	MultiplyAffine(rotated, scaled, pOut);
+}
+
+/**
+* pGlobal = pParentGlobal * pLocal, dropping the parent's own scaling
+* first for inherit type Rrs.
+*/
+void ComposeGlobal(const FlatHierarchy& pHierarchy, const float* pPose, int pIndex, const float* pParentGlobal,
+	const float* pLocal, float* pGlobal)
+{
+	const int parent = pHierarchy.parents[pIndex];
+	if (pHierarchy.inheritTypes[pIndex] == kInheritRrs)
+	{
+		const float* parentScaling = pPose + (size_t)parent * kPoseStride + 6;
+		float compensated[16];
+		memcpy(compensated, pParentGlobal, sizeof(compensated));
+		for (int c = 0; c < 3; c++)
+		{
+			const float inverse = parentScaling[c] != 0.0f ? 1.0f / parentScaling[c] : 0.0f;
+			for (int r = 0; r < 4; r++)
+				compensated[c * 4 + r] *= inverse;
+		}
+		MultiplyAffine(compensated, pLocal, pGlobal);
+	}
+	else
+		MultiplyAffine(pParentGlobal, pLocal, pGlobal);
+}
+
+void CollectNodes(const Node& pNode, int pParent, int pDepth, FlatHierarchy& pOut)
+{
+	for (size_t i = 0; i < pNode.children.size(); i++)
+	{
+		const int index = (int)pOut.nodes.size();
+		pOut.nodes.push_back(pNode.children[i]);
+		pOut.parents.push_back(pParent);
+		if (pDepth + 1 > pOut.maxDepth)
+			pOut.maxDepth = pDepth + 1;
+		CollectNodes(*pNode.children[i], index, pDepth + 1, pOut);
+	}
+}
+
+}
+
+const int kRotationOrderAxes[7][3] = {
+	{ 0, 1, 2 },
+	{ 0, 2, 1 },
+	{ 1, 2, 0 },
+	{ 1, 0, 2 },
+	{ 2, 0, 1 },
+	{ 2, 1, 0 },
+	{ 0, 1, 2 }
+};
+
+void EulerToMatrix(const double* pDegrees, int pOrder, double* pOut)
+{
+	const int* axes = kRotationOrderAxes[pOrder >= 0 && pOrder < 7 ? pOrder : 0];
+	SetIdentity(pOut);
+	for (int i = 0; i < 3; i++)
+	{
+		const int axis = axes[i];
+		const double angle = pDegrees[axis] * kDegreesToRadians;
+		if (angle == 0.0)
+			continue;
+		const double c = cos(angle), s = sin(angle);
+		// Rotate the rows of the two other axes: pOut = rotation * pOut.
+		const int u = (axis + 1) % 3, v = (axis + 2) % 3;
+		for (int column = 0; column < 3; column++)
+		{
+			const double pu = pOut[column * 4 + u], pv = pOut[column * 4 + v];
+			pOut[column * 4 + u] = c * pu - s * pv;
+			pOut[column * 4 + v] = s * pu + c * pv;
+		}
+	}
+}
+
+void BuildFlatHierarchy(const Scene& pScene, FlatHierarchy& pOut)
+{
+	pOut = FlatHierarchy();
+	CollectNodes(pScene.root, -1, 0, pOut);
+	const size_t count = pOut.nodes.size();
+	pOut.pre.resize(count * 16);
+	pOut.post.resize(count * 16);
+	pOut.scalingPivots.resize(count * 3);
+	pOut.rotationOrders.resize(count);
+	pOut.inheritTypes.resize(count);
+	for (size_t i = 0; i < count; i++)
+	{
+		const Node& node = *pOut.nodes[i];
+		pOut.rotationOrders[i] = (unsigned char)(node.rotationOrder >= 0 && node.rotationOrder < 7 ? node.rotationOrder : 0);
+		pOut.inheritTypes[i] = (unsigned char)node.inheritType;
+
+		// pre = T(Roff + Rp) * Rpre.
+		double pre[16];
+		EulerToMatrix(node.preRotation, 0, pre);
+		for (int r = 0; r < 3; r++)
+			pre[12 + r] = node.rotationOffset[r] + node.rotationPivot[r];
+
+		// post = Rpost^-1 * T(-Rp + Soff + Sp); the inverse of a rotation is
+		// its transpose.
+		double rotation[16], post[16];
+		EulerToMatrix(node.postRotation, 0, rotation);
+		SetIdentity(post);
+		for (int c = 0; c < 3; c++)
+		{
+			for (int r = 0; r < 3; r++)
+				post[c * 4 + r] = rotation[r * 4 + c];
+		}
+		const double moved[3] = {
+			-node.rotationPivot[0] + node.scalingOffset[0] + node.scalingPivot[0],
+			-node.rotationPivot[1] + node.scalingOffset[1] + node.scalingPivot[1],
+			-node.rotationPivot[2] + node.scalingOffset[2] + node.scalingPivot[2]
+		};
+		for (int r = 0; r < 3; r++)
+			post[12 + r] = post[r] * moved[0] + post[4 + r] * moved[1] + post[8 + r] * moved[2];
+
+		for (int k = 0; k < 16; k++)
+		{
+			pOut.pre[i * 16 + k] = (float)pre[k];
+			pOut.post[i * 16 + k] = (float)post[k];
+		}
+		for (int c = 0; c < 3; c++)
+			pOut.scalingPivots[i * 3 + c] = (float)node.scalingPivot[c];
+	}
+}
+
+void GetDefaultPose(const FlatHierarchy& pHierarchy, std::vector<float>& pPose)
+{
+	pPose.resize(pHierarchy.nodes.size() * kPoseStride);
+	for (size_t i = 0; i < pHierarchy.nodes.size(); i++)
+	{
+		const Node& node = *pHierarchy.nodes[i];
+		float* pose = &pPose[i * kPoseStride];
+		for (int c = 0; c < 3; c++)
+		{
+			pose[c] = (float)node.translation[c];
+			pose[3 + c] = (float)node.rotation[c];
+			pose[6 + c] = (float)node.scaling[c];
+		}
+	}
+}
+
+void MapAnimatedNodes(const FlatHierarchy& pHierarchy, const BakedAnimation& pAnimation, std::vector<int>& pMap)
+{
+	std::map<const Node*, int> indices;
+	for (size_t i = 0; i < pHierarchy.nodes.size(); i++)
+		indices[pHierarchy.nodes[i]] = (int)i;
+	pMap.resize(pAnimation.nodes.size());
+	for (size_t n = 0; n < pAnimation.nodes.size(); n++)
+	{
+		std::map<const Node*, int>::const_iterator found = indices.find(pAnimation.nodes[n]);
+		pMap[n] = found != indices.end() ? found->second : -1;
+	}
+}
+
+void ApplyBakedFrame(const BakedAnimation& pAnimation, const std::vector<int>& pMap, int pFrame, float* pPose)
+{
+	for (size_t n = 0; n < pMap.size(); n++)
+	{
+		if (pMap[n] < 0)
+			continue;
+		float* pose = pPose + (size_t)pMap[n] * kPoseStride;
+		for (int c = 0; c < eAnimChannelCount; c++)
+			pose[c] = pAnimation.GetStream(n, c)[pFrame];
+	}
+}
+
+void EvaluateGlobalTransforms(const FlatHierarchy& pHierarchy, const float* pPose, float* pGlobals)
+{
+	float local[16];
+	for (size_t i = 0; i < pHierarchy.nodes.size(); i++)
+	{
+		const int parent = pHierarchy.parents[i];
+		float* global = pGlobals + i * 16;
+		if (parent < 0)
+			GetLocalMatrix(pHierarchy, (int)i, pPose + i * kPoseStride, global);
+		else
+		{
+			GetLocalMatrix(pHierarchy, (int)i, pPose + i * kPoseStride, local);
+			ComposeGlobal(pHierarchy, pPose, (int)i, pGlobals + (size_t)parent * 16, local, global);
+		}
+	}
+}
+
+void EvaluateGlobalTransform(const FlatHierarchy& pHierarchy, const float* pPose, int pNode, float* pOut)
+{
+	std::vector<int> chain;
+	chain.reserve((size_t)pHierarchy.maxDepth + 1);
+	for (int n = pNode; n >= 0; n = pHierarchy.parents[n])
+		chain.push_back(n);
+	const int depth = (int)chain.size();
+
+	float global[16], local[16];
+	GetLocalMatrix(pHierarchy, chain[depth - 1], pPose + (size_t)chain[depth - 1] * kPoseStride, global);
+	for (int d = depth - 2; d >= 0; d--)
+	{
+		GetLocalMatrix(pHierarchy, chain[d], pPose + (size_t)chain[d] * kPoseStride, local);
+		ComposeGlobal(pHierarchy, pPose, chain[d], global, local, pOut);
+		memcpy(global, pOut, sizeof(global));
+	}
+	memcpy(pOut, global, sizeof(global));
+}
+
+}
@@ -0,0 +1,98 @@
+#ifndef FBX_TRANSFORM_H
+#define FBX_TRANSFORM_H
+
+#include "fbx_anim.h"
+#include "fbx_scene.h"
+
+#include <vector>
+
+namespace fbxl {
+
+/**
+* Local pose of a node as EvaluateGlobalTransforms reads it: translation,
+* Euler rotation in degrees and scaling, the Lcl properties or a baked
+* frame of them.
+*/
+const int kPoseStride = 9;
+
+/**
+* Axes of each EFbxRotationOrder, in the order they are applied: eEulerXYZ
+* rotates about X first, so its matrix is Rz * Ry * Rx. eSphericXYZ is
+* evaluated as XYZ.
+*/
+extern const int kRotationOrderAxes[7][3];
+
+/**
+* Rotation matrix of Euler angles pDegrees applied in pOrder (an
+* EFbxRotationOrder), as 16 doubles.
+*/
+void EulerToMatrix(const double* pDegrees, int pOrder, double* pOut);
+
+/**
+* The node tree of a scene flattened for evaluation: nodes parent before
+* child (in the depth-first order PrintNode visits them), each with the
+* index of its parent (-1 under the root) and the parts of FbxTransform's
+*   T * Roff * Rp * Rpre * R * Rpost^-1 * Rp^-1 * Soff * Sp * S * Sp^-1
+* that do not change with the pose folded into two matrices: pre is
+* Roff * Rp * Rpre and post is Rpost^-1 * Rp^-1 * Soff * Sp. Matrices are 16
+* floats in the file's layout (four columns, translation last).
+*/
+struct FlatHierarchy
+{
+	std::vector<const Node*> nodes;
+	std::vector<int> parents;
+	std::vector<float> pre;
+	std::vector<float> post;
+	std::vector<float> scalingPivots;
+	std::vector<unsigned char> rotationOrders;
+	std::vector<unsigned char> inheritTypes;
+	int maxDepth;
+
+	FlatHierarchy() : maxDepth(0) {}
+
+	int GetNodeCount() const { return (int)nodes.size(); }
+};
+
+/**
+* Flatten the node tree of pScene into pOut.
+*/
+void BuildFlatHierarchy(const Scene& pScene, FlatHierarchy& pOut);
+
+/**
+* The Lcl values of every node, kPoseStride floats apiece.
+*/
+void GetDefaultPose(const FlatHierarchy& pHierarchy, std::vector<float>& pPose);
+
+/**
+* For each node pAnimation animates, its index in pHierarchy, or -1 if it is
+* not in the tree.
+*/
+void MapAnimatedNodes(const FlatHierarchy& pHierarchy, const BakedAnimation& pAnimation, std::vector<int>& pMap);
+
+/**
+* Overwrite the pose of the nodes pAnimation animates with frame pFrame of
+* it; pMap comes from MapAnimatedNodes.
+*/
+void ApplyBakedFrame(const BakedAnimation& pAnimation, const std::vector<int>& pMap, int pFrame, float* pPose);
+
+/**
+* Global matrices of every node for pPose, 16 floats per node into
+* pGlobals, in one pass over the flattened tree: a node's parent is always
+* done before it, so there is no walking up the tree and nothing to cache.
+* Each node costs its rotation's sines and cosines and three affine matrix
+* products, done with SSE columns when the compiler targets it. Inherit
+* type Rrs (Maya's segment scale compensate) drops the parent's own
+* scaling; RrSs is evaluated like the default RSrs.
+*/
+void EvaluateGlobalTransforms(const FlatHierarchy& pHierarchy, const float* pPose, float* pGlobals);
+
+/**
+* Global matrix of node pNode alone, composing the local matrices of its
+* ancestors from the top, the way FbxNode::EvaluateGlobalTransform does
+* without its cache. Costs as many local matrices as the node is deep.
+*/
+void EvaluateGlobalTransform(const FlatHierarchy& pHierarchy, const float* pPose, int pNode, float* pOut);
+
+}
+
+#endif
@@ -0,0 +1,232 @@
+#include "fbx_triangulate.h"
+
+#include <math.h>
+
+namespace fbxl {
+
+namespace {
+
+/**
+* Twice the signed area of the 2D triangle abc, positive when it turns
+* counter-clockwise.
+*/
+double Cross2(const double* a, const double* b, const double* c)
+{
+	return (b[0] - a[0]) * (c[1] - a[1]) - (b[1] - a[1]) * (c[0] - a[0]);
+}
+
+bool SamePoint(const double* a, const double* b)
+{
+	return a[0] == b[0] && a[1] == b[1];
+}
+
+/**
+* Ear clipping of one polygon at a time; the buffers are kept between
+* polygons so a mesh allocates them once.
+*/
+template <typename Real>
+class EarClipper
+{
+public:
+	void Clip(const IndexedMesh<Real>& pMesh, int pStart, int pSize, std::vector<uint32_t>& pTriangles);
+
+private:
+	bool IsReflex(int pVertex) const
+	{
+		return Cross2(&mPoints[mPrev[pVertex] * 2], &mPoints[pVertex * 2], &mPoints[mNext[pVertex] * 2]) < 0.0;
+	}
+
+	bool IsEar(int pVertex) const;
+
+	std::vector<double> mPoints;
+	std::vector<int> mPrev;
+	std::vector<int> mNext;
+	std::vector<char> mReflex;
+	int mReflexCount;
+};
+
+template <typename Real>
+void EarClipper<Real>::Clip(const IndexedMesh<Real>& pMesh, int pStart, int pSize, std::vector<uint32_t>& pTriangles)
+{
+	// Newell normal, then drop its largest axis; the two axes kept are
+	// swapped when that component is negative so the polygon turns
+	// counter-clockwise in 2D.
+	double normal[3] = { 0.0, 0.0, 0.0 };
+	for (int i = 0; i < pSize; i++)
+	{
+		const Real* a = &pMesh.positions[pMesh.GetIndex(pStart + i) * 3];
+		const Real* b = &pMesh.positions[pMesh.GetIndex(pStart + (i + 1) % pSize) * 3];
+		normal[0] += ((double)a[1] - b[1]) * ((double)a[2] + b[2]);
+		normal[1] += ((double)a[2] - b[2]) * ((double)a[0] + b[0]);
+		normal[2] += ((double)a[0] - b[0]) * ((double)a[1] + b[1]);
+	}
+	int axis = 2;
+	if (fabs(normal[0]) > fabs(normal[1]) && fabs(normal[0]) > fabs(normal[2]))
+		axis = 0;
+	else if (fabs(normal[1]) > fabs(normal[2]))
+		axis = 1;
+	int u = (axis + 1) % 3;
+	int v = (axis + 2) % 3;
+	if (normal[axis] < 0.0)
+	{
+		int swap = u;
+		u = v;
+		v = swap;
+	}
+
+	mPoints.resize(pSize * 2);
+	mPrev.resize(pSize);
+	mNext.resize(pSize);
+	mReflex.resize(pSize);
+	for (int i = 0; i < pSize; i++)
+	{
+		const Real* position = &pMesh.positions[pMesh.GetIndex(pStart + i) * 3];
+		mPoints[i * 2] = position[u];
+		mPoints[i * 2 + 1] = position[v];
+		mPrev[i] = i ? i - 1 : pSize - 1;
+		mNext[i] = i + 1 < pSize ? i + 1 : 0;
+	}
+	mReflexCount = 0;
+	for (int i = 0; i < pSize; i++)
+	{
+		mReflex[i] = IsReflex(i);
+		mReflexCount += mReflex[i];
+	}
+
+	int vertex = 1;
+	int remaining = pSize;
+	int misses = 0;
+	while (remaining > 3)
+	{
+		if (!IsEar(vertex) && misses < remaining)
+		{
+			vertex = mNext[vertex];
+			misses++;
+			continue;
+		}
+		const int prev = mPrev[vertex];
+		const int next = mNext[vertex];
+		pTriangles.push_back(pMesh.GetIndex(pStart + prev));
+		pTriangles.push_back(pMesh.GetIndex(pStart + vertex));
+		pTriangles.push_back(pMesh.GetIndex(pStart + next));
+		mNext[prev] = next;
+		mPrev[next] = prev;
+		mReflexCount -= mReflex[vertex];
+		for (int n = 0; n < 2; n++)
+		{
+			const int neighbour = n ? next : prev;
+			const char reflex = IsReflex(neighbour);
+			mReflexCount += reflex - mReflex[neighbour];
+			mReflex[neighbour] = reflex;
+		}
+		remaining--;
+		misses = 0;
+		vertex = next;
+	}
+	pTriangles.push_back(pMesh.GetIndex(pStart + mPrev[vertex]));
+	pTriangles.push_back(pMesh.GetIndex(pStart + vertex));
+	pTriangles.push_back(pMesh.GetIndex(pStart + mNext[vertex]));
+}
+
+template <typename Real>
+bool EarClipper<Real>::IsEar(int pVertex) const
+{
+	if (mReflex[pVertex])
+		return false;
+	if (!mReflexCount)
+		return true;
+	// Only a reflex vertex can lie inside a convex corner's triangle.
+	const int prev = mPrev[pVertex];
+	const int next = mNext[pVertex];
+	const double* a = &mPoints[prev * 2];
+	const double* b = &mPoints[pVertex * 2];
+	const double* c = &mPoints[next * 2];
+	for (int i = mNext[next]; i != prev; i = mNext[i])
+	{
+		const double* p = &mPoints[i * 2];
+		if (!mReflex[i] || SamePoint(p, a) || SamePoint(p, b) || SamePoint(p, c))
+			continue;
+		if (Cross2(a, b, p) >= 0.0 && Cross2(b, c, p) >= 0.0 && Cross2(c, a, p) >= 0.0)
+			return false;
+	}
+	return true;
+}
+
+/**
+* True when the triangles abc and acd, which the a-c diagonal cuts quad
+* abcd into, face opposite ways: the diagonal runs outside the quad.
+*/
+template <typename Real>
+bool IsDiagonalOutside(const Real* a, const Real* b, const Real* c, const Real* d)
+{
+	double ab[3], ac[3], ad[3];
+	for (int i = 0; i < 3; i++)
+	{
+		ab[i] = (double)b[i] - a[i];
+		ac[i] = (double)c[i] - a[i];
+		ad[i] = (double)d[i] - a[i];
+	}
+	double first[3] = { ab[1] * ac[2] - ab[2] * ac[1], ab[2] * ac[0] - ab[0] * ac[2], ab[0] * ac[1] - ab[1] * ac[0] };
+	double second[3] = { ac[1] * ad[2] - ac[2] * ad[1], ac[2] * ad[0] - ac[0] * ad[2], ac[0] * ad[1] - ac[1] * ad[0] };
+	return first[0] * second[0] + first[1] * second[1] + first[2] * second[2] < 0.0;
+}
+
+}
+
+template <typename Real>
+void TriangulateIndexedMesh(const IndexedMesh<Real>& pMesh, std::vector<uint32_t>& pTriangles,
+	std::vector<int>* pTrianglePolygons)
+{
+	pTriangles.clear();
+	if (pTrianglePolygons)
+		pTrianglePolygons->clear();
+	const int polygonCount = pMesh.polygonStarts.empty() ? 0 : (int)pMesh.polygonStarts.size() - 1;
+	size_t triangleCount = 0;
+	for (int p = 0; p < polygonCount; p++)
+	{
+		int size = pMesh.polygonStarts[p + 1] - pMesh.polygonStarts[p];
+		if (size >= 3)
+			triangleCount += size - 2;
+	}
+	pTriangles.reserve(triangleCount * 3);
+	if (pTrianglePolygons)
+		pTrianglePolygons->reserve(triangleCount);
+
+	EarClipper<Real> clipper;
+	for (int p = 0; p < polygonCount; p++)
+	{
+		const int start = pMesh.polygonStarts[p];
+		const int size = pMesh.polygonStarts[p + 1] - start;
+		if (size == 3)
+		{
+			for (int i = 0; i < 3; i++)
+				pTriangles.push_back(pMesh.GetIndex(start + i));
+		}
+		else if (size == 4)
+		{
+			uint32_t quad[4];
+			for (int i = 0; i < 4; i++)
+				quad[i] = pMesh.GetIndex(start + i);
+			// A quad folded along both diagonals (bowtie, or badly warped)
+			// keeps the 0-2 split.
+			const Real* points[4];
+			for (int i = 0; i < 4; i++)
+				points[i] = &pMesh.positions[quad[i] * 3];
+			const int first = IsDiagonalOutside(points[0], points[1], points[2], points[3]) &&
+				!IsDiagonalOutside(points[1], points[2], points[3], points[0]) ? 1 : 0;
+			const int corners[6] = { first, first + 1, first + 2, first, first + 2, (first + 3) % 4 };
+			for (int i = 0; i < 6; i++)
+				pTriangles.push_back(quad[corners[i]]);
+		}
+		else if (size > 4)
+			clipper.Clip(pMesh, start, size, pTriangles);
+
+		if (pTrianglePolygons && size >= 3)
+			pTrianglePolygons->insert(pTrianglePolygons->end(), size - 2, p);
+	}
+}
+
+template void TriangulateIndexedMesh(const IndexedMesh<float>&, std::vector<uint32_t>&, std::vector<int>*);
+template void TriangulateIndexedMesh(const IndexedMesh<double>&, std::vector<uint32_t>&, std::vector<int>*);
+
+}
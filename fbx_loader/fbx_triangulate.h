@@ -0,0 +1,31 @@
+#ifndef FBX_TRIANGULATE_H
+#define FBX_TRIANGULATE_H
+
+#include "fbx_weld.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace fbxl {
+
+/**
+* Split every polygon of pMesh into triangles and write their vertex indices
+* to pTriangles, three per triangle, in polygon order; pTrianglePolygons, if
+* given, gets the polygon of each triangle, which is what per-polygon layer
+* elements such as materials follow. Triangles are kept as they are. Quads
+* are split along the 0-2 diagonal unless it lies outside a concave quad,
+* then along 1-3. Larger polygons are ear clipped in the plane of their
+* Newell normal, starting at the second vertex, so a convex polygon comes
+* out as the fan around its first vertex. When a degenerate or
+* self-intersecting polygon has no ear left, the next vertex is clipped
+* anyway, so every polygon of n >= 3 vertices gives n - 2 triangles;
+* smaller ones are dropped.
+*/
+template <typename Real>
+void TriangulateIndexedMesh(const IndexedMesh<Real>& pMesh, std::vector<uint32_t>& pTriangles,
+	std::vector<int>* pTrianglePolygons = NULL);
+
+}
+
+#endif
@@ -0,0 +1,339 @@
+#include "fbx_vcache.h"
+
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+namespace fbxl {
+
+namespace {
+
+/**
+* The triangles around each vertex, as one array: those of vertex v are
+* triangles[offsets[v], offsets[v + 1]).
+*/
+struct VertexTriangles
+{
+	std::vector<uint32_t> offsets;
+	std::vector<uint32_t> triangles;
+
+	void Build(const std::vector<uint32_t>& pTriangles, int pVertexCount)
+	{
+		const size_t triangleCount = pTriangles.size() / 3;
+		offsets.assign((size_t)pVertexCount + 1, 0);
+		for (size_t i = 0; i < triangleCount * 3; i++)
+			offsets[pTriangles[i] + 1]++;
+		for (int v = 0; v < pVertexCount; v++)
+			offsets[v + 1] += offsets[v];
+		triangles.resize(triangleCount * 3);
+		std::vector<uint32_t> cursor(offsets.begin(), offsets.end() - 1);
+		for (size_t i = 0; i < triangleCount * 3; i++)
+			triangles[cursor[pTriangles[i]]++] = (uint32_t)(i / 3);
+	}
+};
+
+/**
+* Next vertex to fan around once the candidates are used up: the most
+* recently emitted vertex with triangles left, else the lowest numbered one
+* past pCursor, else -1.
+*/
+int SkipDeadEnd(const std::vector<int>& pLive, std::vector<uint32_t>& pDeadEnds, int& pCursor, int pVertexCount)
+{
+	while (!pDeadEnds.empty())
+	{
+		const uint32_t v = pDeadEnds.back();
+		pDeadEnds.pop_back();
+		if (pLive[v] > 0)
+			return (int)v;
+	}
+	while (pCursor < pVertexCount)
+	{
+		if (pLive[pCursor] > 0)
+			return pCursor++;
+		pCursor++;
+	}
+	return -1;
+}
+
+/**
+* A run of triangles for OptimizeOverdraw, ranked by how far it faces out
+* from the mesh's centre.
+*/
+struct TriangleRun
+{
+	size_t first;
+	size_t count;
+	double facing;
+};
+
+bool FacesOutMore(const TriangleRun& a, const TriangleRun& b)
+{
+	return a.facing > b.facing;
+}
+
+/**
+* Apply pOrder, the old index of each triangle in its new place, to
+* pTriangles and, when it has one entry per triangle, pTrianglePolygons.
+*/
+void ReorderTriangles(const std::vector<uint32_t>& pOrder, std::vector<uint32_t>& pTriangles,
+	std::vector<int>* pTrianglePolygons)
+{
+	const size_t triangleCount = pOrder.size();
+	std::vector<uint32_t> triangles(triangleCount * 3);
+	for (size_t i = 0; i < triangleCount; i++)
+		memcpy(&triangles[i * 3], &pTriangles[(size_t)pOrder[i] * 3], 3 * sizeof(uint32_t));
+	pTriangles.swap(triangles);
+	if (pTrianglePolygons && pTrianglePolygons->size() == triangleCount)
+	{
+		std::vector<int> polygons(triangleCount);
+		for (size_t i = 0; i < triangleCount; i++)
+			polygons[i] = (*pTrianglePolygons)[pOrder[i]];
+		pTrianglePolygons->swap(polygons);
+	}
+}
+
+template <typename Real>
+void PermuteAttribute(std::vector<Real>& pValues, const std::vector<uint32_t>& pRemap, std::vector<Real>& pScratch)
+{
+	const size_t vertexCount = pRemap.size();
+	if (!vertexCount || pValues.empty())
+		return;
+	const size_t stride = pValues.size() / vertexCount;
+	pScratch.resize(pValues.size());
+	for (size_t v = 0; v < vertexCount; v++)
+		memcpy(&pScratch[pRemap[v] * stride], &pValues[v * stride], stride * sizeof(Real));
+	pValues.swap(pScratch);
+}
+
+}
+
+VertexCacheStats AnalyzeVertexCache(const std::vector<uint32_t>& pTriangles, int pVertexCount, int pCacheSize)
+{
+	VertexCacheStats stats;
+	stats.triangleCount = pTriangles.size() / 3;
+
+	// A vertex is in the FIFO while fewer than pCacheSize misses followed its
+	// own, so one timestamp per vertex is all the state the cache needs.
+	std::vector<size_t> missedAt((size_t)pVertexCount, 0);
+	std::vector<bool> used((size_t)pVertexCount, false);
+	size_t time = (size_t)pCacheSize + 1;
+	for (size_t i = 0; i < stats.triangleCount * 3; i++)
+	{
+		const uint32_t v = pTriangles[i];
+		if (time - missedAt[v] > (size_t)pCacheSize)
+		{
+			missedAt[v] = time++;
+			stats.missCount++;
+		}
+		if (!used[v])
+		{
+			used[v] = true;
+			stats.vertexCount++;
+		}
+	}
+	return stats;
+}
+
+void OptimizeVertexCache(std::vector<uint32_t>& pTriangles, int pVertexCount, std::vector<int>* pTrianglePolygons,
+	int pCacheSize)
+{
+	const size_t triangleCount = pTriangles.size() / 3;
+	if (triangleCount < 2 || pVertexCount <= 0)
+		return;
+
+	VertexTriangles adjacency;
+	adjacency.Build(pTriangles, pVertexCount);
+	std::vector<int> live((size_t)pVertexCount);
+	for (int v = 0; v < pVertexCount; v++)
+		live[v] = (int)(adjacency.offsets[v + 1] - adjacency.offsets[v]);
+
+	std::vector<int> cacheTime((size_t)pVertexCount, 0);
+	std::vector<bool> emitted(triangleCount, false);
+	std::vector<uint32_t> order;
+	order.reserve(triangleCount);
+	std::vector<uint32_t> deadEnds;
+	std::vector<uint32_t> candidates;
+	int time = pCacheSize + 1;
+	int cursor = 0;
+	int fan = SkipDeadEnd(live, deadEnds, cursor, pVertexCount);
+	while (fan >= 0)
+	{
+		candidates.clear();
+		for (uint32_t a = adjacency.offsets[fan]; a < adjacency.offsets[fan + 1]; a++)
+		{
+			const uint32_t t = adjacency.triangles[a];
+			if (emitted[t])
+				continue;
+			emitted[t] = true;
+			order.push_back(t);
+			for (int c = 0; c < 3; c++)
+			{
+				const uint32_t v = pTriangles[(size_t)t * 3 + c];
+				deadEnds.push_back(v);
+				candidates.push_back(v);
+				live[v]--;
+				if (time - cacheTime[v] > pCacheSize)
+					cacheTime[v] = time++;
+			}
+		}
+
+		// Prefer the candidate that has been in the cache longest, as long as
+		// its remaining triangles would not push it out; one that would is
+		// only taken when nothing else is left.
+		int next = -1;
+		int best = -1;
+		for (size_t i = 0; i < candidates.size(); i++)
+		{
+			const uint32_t v = candidates[i];
+			if (live[v] <= 0)
+				continue;
+			int priority = 0;
+			if (time - cacheTime[v] + 2 * live[v] <= pCacheSize)
+				priority = time - cacheTime[v];
+			if (priority > best)
+			{
+				best = priority;
+				next = (int)v;
+			}
+		}
+		fan = next >= 0 ? next : SkipDeadEnd(live, deadEnds, cursor, pVertexCount);
+	}
+
+	ReorderTriangles(order, pTriangles, pTrianglePolygons);
+}
+
+template <typename Real>
+void OptimizeOverdraw(const IndexedMesh<Real>& pMesh, std::vector<uint32_t>& pTriangles,
+	std::vector<int>* pTrianglePolygons, int pCacheSize)
+{
+	const size_t triangleCount = pTriangles.size() / 3;
+	const int vertexCount = pMesh.GetVertexCount();
+	if (triangleCount < 2 || vertexCount <= 0)
+		return;
+
+	// Cut the list where the cache starts over.
+	std::vector<TriangleRun> runs;
+	std::vector<size_t> missedAt((size_t)vertexCount, 0);
+	size_t time = (size_t)pCacheSize + 1;
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		int misses = 0;
+		for (int c = 0; c < 3; c++)
+		{
+			const uint32_t v = pTriangles[t * 3 + c];
+			if (time - missedAt[v] > (size_t)pCacheSize)
+			{
+				missedAt[v] = time++;
+				misses++;
+			}
+		}
+		if (misses == 3 || runs.empty())
+		{
+			TriangleRun run = { t, 0, 0.0 };
+			runs.push_back(run);
+		}
+		runs.back().count++;
+	}
+	if (runs.size() < 2)
+		return;
+
+	// Area-weighted centroids, so a finely tessellated part does not pull
+	// the mesh's centre towards it.
+	const Real* positions = &pMesh.positions[0];
+	std::vector<double> centroids(runs.size() * 3, 0.0);
+	std::vector<double> normals(runs.size() * 3, 0.0);
+	std::vector<double> areas(runs.size(), 0.0);
+	double meshCentroid[3] = { 0.0, 0.0, 0.0 };
+	double meshArea = 0.0;
+	for (size_t r = 0; r < runs.size(); r++)
+	{
+		for (size_t t = runs[r].first; t < runs[r].first + runs[r].count; t++)
+		{
+			const Real* p0 = positions + (size_t)pTriangles[t * 3] * 3;
+			const Real* p1 = positions + (size_t)pTriangles[t * 3 + 1] * 3;
+			const Real* p2 = positions + (size_t)pTriangles[t * 3 + 2] * 3;
+			const double e1[3] = { (double)p1[0] - p0[0], (double)p1[1] - p0[1], (double)p1[2] - p0[2] };
+			const double e2[3] = { (double)p2[0] - p0[0], (double)p2[1] - p0[1], (double)p2[2] - p0[2] };
+			const double n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+			const double area = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+			for (int c = 0; c < 3; c++)
+			{
+				centroids[r * 3 + c] += area * ((double)p0[c] + p1[c] + p2[c]) / 3.0;
+				normals[r * 3 + c] += n[c];
+			}
+			areas[r] += area;
+		}
+		for (int c = 0; c < 3; c++)
+			meshCentroid[c] += centroids[r * 3 + c];
+		meshArea += areas[r];
+	}
+	if (meshArea <= 0.0)
+		return;
+	for (int c = 0; c < 3; c++)
+		meshCentroid[c] /= meshArea;
+
+	for (size_t r = 0; r < runs.size(); r++)
+	{
+		if (areas[r] <= 0.0)
+			continue;
+		const double* n = &normals[r * 3];
+		const double length = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+		if (length <= 0.0)
+			continue;
+		double facing = 0.0;
+		for (int c = 0; c < 3; c++)
+			facing += (centroids[r * 3 + c] / areas[r] - meshCentroid[c]) * n[c] / length;
+		runs[r].facing = facing;
+	}
+	std::stable_sort(runs.begin(), runs.end(), FacesOutMore);
+
+	std::vector<uint32_t> order;
+	order.reserve(triangleCount);
+	for (size_t r = 0; r < runs.size(); r++)
+	{
+		for (size_t t = runs[r].first; t < runs[r].first + runs[r].count; t++)
+			order.push_back((uint32_t)t);
+	}
+	ReorderTriangles(order, pTriangles, pTrianglePolygons);
+}
+
+template <typename Real>
+void OptimizeVertexFetch(IndexedMesh<Real>& pMesh, std::vector<uint32_t>& pTriangles)
+{
+	const int vertexCount = pMesh.GetVertexCount();
+	const uint32_t unused = 0xffffffffu;
+	std::vector<uint32_t> remap((size_t)vertexCount, unused);
+	uint32_t next = 0;
+	for (size_t i = 0; i < pTriangles.size(); i++)
+	{
+		uint32_t& slot = remap[pTriangles[i]];
+		if (slot == unused)
+			slot = next++;
+		pTriangles[i] = slot;
+	}
+	for (int v = 0; v < vertexCount; v++)
+	{
+		if (remap[v] == unused)
+			remap[v] = next++;
+	}
+
+	std::vector<Real> scratch;
+	PermuteAttribute(pMesh.positions, remap, scratch);
+	PermuteAttribute(pMesh.normals, remap, scratch);
+	PermuteAttribute(pMesh.tangents, remap, scratch);
+	PermuteAttribute(pMesh.binormals, remap, scratch);
+	PermuteAttribute(pMesh.colors, remap, scratch);
+	for (size_t s = 0; s < pMesh.uvSets.size(); s++)
+		PermuteAttribute(pMesh.uvSets[s], remap, scratch);
+	for (size_t i = 0; i < pMesh.indices16.size(); i++)
+		pMesh.indices16[i] = (uint16_t)remap[pMesh.indices16[i]];
+	for (size_t i = 0; i < pMesh.indices32.size(); i++)
+		pMesh.indices32[i] = remap[pMesh.indices32[i]];
+}
+
+template void OptimizeOverdraw(const IndexedMesh<float>&, std::vector<uint32_t>&, std::vector<int>*, int);
+template void OptimizeOverdraw(const IndexedMesh<double>&, std::vector<uint32_t>&, std::vector<int>*, int);
+template void OptimizeVertexFetch(IndexedMesh<float>&, std::vector<uint32_t>&);
+template void OptimizeVertexFetch(IndexedMesh<double>&, std::vector<uint32_t>&);
+
+}
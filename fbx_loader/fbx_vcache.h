@@ -0,0 +1,85 @@
+#ifndef FBX_VCACHE_H
+#define FBX_VCACHE_H
+
+#include "fbx_weld.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace fbxl {
+
+/**
+* Entries of the post-transform cache OptimizeVertexCache orders for and
+* AnalyzeVertexCache simulates: a FIFO of this size is a fair stand-in for
+* current GPUs, which re-run the vertex shader on a miss.
+*/
+const int kVertexCacheSize = 16;
+
+/**
+* What a triangle list costs on a FIFO cache: vertex shader runs per
+* triangle (ACMR, 0.5 at best on a large regular grid, 3 at worst) and per
+* vertex referenced (ATVR, 1 at best).
+*/
+struct VertexCacheStats
+{
+	size_t triangleCount;
+	size_t vertexCount;
+	size_t missCount;
+
+	VertexCacheStats() : triangleCount(0), vertexCount(0), missCount(0) {}
+
+	double GetACMR() const { return triangleCount ? (double)missCount / triangleCount : 0.0; }
+	double GetATVR() const { return vertexCount ? (double)missCount / vertexCount : 0.0; }
+
+	VertexCacheStats& operator+=(const VertexCacheStats& pOther)
+	{
+		triangleCount += pOther.triangleCount;
+		vertexCount += pOther.vertexCount;
+		missCount += pOther.missCount;
+		return *this;
+	}
+};
+
+/**
+* Simulate drawing pTriangles, three indices below pVertexCount per
+* triangle, through a FIFO of pCacheSize entries.
+*/
+VertexCacheStats AnalyzeVertexCache(const std::vector<uint32_t>& pTriangles, int pVertexCount,
+	int pCacheSize = kVertexCacheSize);
+
+/**
+* Reorder the triangles of pTriangles for the post-transform cache with
+* Tipsify (Sander, Nehab and Barczak, 2007): fan around one vertex at a
+* time, moving on to a recently used vertex that still has triangles left
+* and would stay in the cache while they are drawn. Runs in time linear in
+* the number of triangles. pTrianglePolygons, when given and of one entry
+* per triangle, is permuted along.
+*/
+void OptimizeVertexCache(std::vector<uint32_t>& pTriangles, int pVertexCount,
+	std::vector<int>* pTrianglePolygons = NULL, int pCacheSize = kVertexCacheSize);
+
+/**
+* Reorder whole runs of pTriangles, as OptimizeVertexCache left them, so
+* that runs facing away from the mesh's centre are drawn first and hide
+* more of what follows from most viewpoints. A run starts at each triangle
+* whose three vertices all miss the cache, so moving runs around costs the
+* cache next to nothing. Linear apart from sorting the runs, of which there
+* are far fewer than triangles. pTrianglePolygons is permuted as above.
+*/
+template <typename Real>
+void OptimizeOverdraw(const IndexedMesh<Real>& pMesh, std::vector<uint32_t>& pTriangles,
+	std::vector<int>* pTrianglePolygons = NULL, int pCacheSize = kVertexCacheSize);
+
+/**
+* Renumber the vertices of pMesh in the order pTriangles first uses them,
+* so that drawing reads the vertex buffers front to back. Vertices no
+* triangle uses keep their relative order after the rest. Every attribute
+* array, pMesh's polygon vertex indices and pTriangles are remapped.
+*/
+template <typename Real>
+void OptimizeVertexFetch(IndexedMesh<Real>& pMesh, std::vector<uint32_t>& pTriangles);
+
+}
+
+#endif
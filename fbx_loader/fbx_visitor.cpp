@@ -0,0 +1,269 @@
+#include "fbx_visitor.h"
+#include "fbx_mmap.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+namespace fbxl {
+
+namespace {
+
+const char kBinaryMagic[] = "Kaydara FBX Binary  ";
+const size_t kBinaryHeaderSize = 27;
+
+template <typename T>
+T ReadLE(const unsigned char* p)
+{
+	T v;
+	memcpy(&v, p, sizeof(T));
+	return v;
+}
+
+/**
+* Recursive-descent walk over binary records. Records before version 7500
+* use 32-bit offsets and counts, later ones 64-bit.
+*/
+class BinaryStream
+{
+public:
+	BinaryStream(const unsigned char* pData, size_t pSize, RecordVisitor& pVisitor)
+		: mData(pData)
+		, mSize(pSize)
+		, mWide(GetBinaryFbxVersion(pData) >= 7500)
+		, mVisitor(pVisitor)
+	{
+	}
+
+	bool Run()
+	{
+		size_t offset = kBinaryHeaderSize;
+		while (offset < mSize)
+		{
+			bool isNull = false;
+			if (!VisitRecord(offset, 0, isNull))
+				return false;
+			if (isNull)
+				break;
+		}
+		return true;
+	}
+
+	const std::string& GetError() const { return mError; }
+
+private:
+	bool Fail(const char* pFormat, ...)
+	{
+		char message[512];
+		va_list args;
+		va_start(args, pFormat);
+		vsnprintf(message, sizeof(message), pFormat, args);
+		va_end(args);
+		mError = message;
+		return false;
+	}
+
+	bool VisitRecord(size_t& pOffset, int pDepth, bool& pIsNull)
+	{
+		const size_t headerSize = mWide ? 25 : 13;
+		if (mSize - pOffset < headerSize)
+			return Fail("truncated record header at offset %lu", (unsigned long)pOffset);
+
+		const unsigned char* p = mData + pOffset;
+		uint64_t endOffset, numProperties, propertyListLen;
+		if (mWide)
+		{
+			endOffset = ReadLE<uint64_t>(p);
+			numProperties = ReadLE<uint64_t>(p + 8);
+			propertyListLen = ReadLE<uint64_t>(p + 16);
+		}
+		else
+		{
+			endOffset = ReadLE<uint32_t>(p);
+			numProperties = ReadLE<uint32_t>(p + 4);
+			propertyListLen = ReadLE<uint32_t>(p + 8);
+		}
+		size_t nameLen = p[headerSize - 1];
+
+		if (endOffset == 0)
+		{
+			pIsNull = true;
+			pOffset += headerSize;
+			return true;
+		}
+
+		size_t start = pOffset;
+		pOffset += headerSize;
+		// endOffset is checked against the end of the header before either
+		// subtraction, so neither can wrap.
+		if (endOffset > mSize || endOffset < pOffset || nameLen > endOffset - pOffset)
+			return Fail("corrupt record at offset %lu", (unsigned long)start);
+
+		StringRef name((const char*)mData + pOffset, nameLen);
+		pOffset += nameLen;
+
+		size_t propertyEnd = pOffset + (size_t)propertyListLen;
+		if (propertyListLen > endOffset - pOffset)
+			return Fail("corrupt property list in '%s' at offset %lu", name.Str().c_str(), (unsigned long)start);
+
+		if (!mVisitor.BeginRecord(name, (size_t)numProperties, pDepth))
+		{
+			pOffset = (size_t)endOffset;
+			return true;
+		}
+
+		for (uint64_t i = 0; i < numProperties; i++)
+		{
+			Property prop;
+			if (!ReadProperty(pOffset, propertyEnd, prop))
+				return false;
+			if (prop.IsArray())
+				mVisitor.OnArray(prop);
+			else
+				mVisitor.OnProperty(prop);
+		}
+		pOffset = propertyEnd;
+
+		while (pOffset < endOffset)
+		{
+			bool isNull = false;
+			if (!VisitRecord(pOffset, pDepth + 1, isNull))
+				return false;
+			if (isNull)
+				break;
+		}
+
+		mVisitor.EndRecord(name, pDepth);
+		pOffset = (size_t)endOffset;
+		return true;
+	}
+
+	bool ReadProperty(size_t& pOffset, size_t pEnd, Property& pProperty)
+	{
+		if (pOffset >= pEnd)
+			return Fail("property list overrun at offset %lu", (unsigned long)pOffset);
+
+		pProperty.type = (char)mData[pOffset++];
+		pProperty.encoding = 0;
+		pProperty.arrayCount = 0;
+		pProperty.data = mData + pOffset;
+
+		size_t size;
+		switch (pProperty.type)
+		{
+		case 'Y': size = 2; break;
+		case 'C': size = 1; break;
+		case 'I': case 'F': size = 4; break;
+		case 'D': case 'L': size = 8; break;
+		case 'S': case 'R':
+			if (pEnd - pOffset < 4)
+				return Fail("truncated string property at offset %lu", (unsigned long)pOffset);
+			size = ReadLE<uint32_t>(mData + pOffset);
+			pOffset += 4;
+			pProperty.data = mData + pOffset;
+			break;
+		case 'f': case 'd': case 'l': case 'i': case 'b':
+			if (pEnd - pOffset < 12)
+				return Fail("truncated array property at offset %lu", (unsigned long)pOffset);
+			pProperty.arrayCount = ReadLE<uint32_t>(mData + pOffset);
+			pProperty.encoding = ReadLE<uint32_t>(mData + pOffset + 4);
+			size = ReadLE<uint32_t>(mData + pOffset + 8);
+			pOffset += 12;
+			pProperty.data = mData + pOffset;
+			if (pProperty.encoding > 1 ||
+				(pProperty.encoding == 0 && size != (size_t)pProperty.arrayCount * pProperty.GetElementSize()))
+				return Fail("bad array encoding at offset %lu", (unsigned long)pOffset);
+			break;
+		default:
+			return Fail("unknown property type '%c' at offset %lu", pProperty.type, (unsigned long)(pOffset - 1));
+		}
+
+		if (size > pEnd - pOffset)
+			return Fail("property overruns its record at offset %lu", (unsigned long)pOffset);
+		pProperty.size = (uint32_t)size;
+		pOffset += size;
+		return true;
+	}
+
+	const unsigned char* mData;
+	size_t mSize;
+	bool mWide;
+	RecordVisitor& mVisitor;
+	std::string mError;
+};
+
+void VisitChildren(const Record& pRecord, RecordVisitor& pVisitor, int pDepth)
+{
+	for (size_t i = 0; i < pRecord.children.size(); i++)
+	{
+		const Record& child = pRecord.children[i];
+		if (!pVisitor.BeginRecord(child.name, child.properties.size(), pDepth))
+			continue;
+		for (size_t p = 0; p < child.properties.size(); p++)
+		{
+			if (child.properties[p].IsArray())
+				pVisitor.OnArray(child.properties[p]);
+			else
+				pVisitor.OnProperty(child.properties[p]);
+		}
+		VisitChildren(child, pVisitor, pDepth + 1);
+		pVisitor.EndRecord(child.name, pDepth);
+	}
+}
+
+}
+
+bool IsBinaryFbx(const unsigned char* pData, size_t pSize)
+{
+	return pSize >= kBinaryHeaderSize && memcmp(pData, kBinaryMagic, sizeof(kBinaryMagic)) == 0;
+}
+
+int GetBinaryFbxVersion(const unsigned char* pData)
+{
+	return (int)ReadLE<uint32_t>(pData + 23);
+}
+
+bool VisitBinaryRecords(const unsigned char* pData, size_t pSize, RecordVisitor& pVisitor, std::string& pError)
+{
+	if (!IsBinaryFbx(pData, pSize))
+	{
+		pError = "not a binary FBX file";
+		return false;
+	}
+	BinaryStream stream(pData, pSize, pVisitor);
+	if (!stream.Run())
+	{
+		pError = stream.GetError();
+		return false;
+	}
+	return true;
+}
+
+void VisitRecordTree(const Record& pRoot, RecordVisitor& pVisitor)
+{
+	VisitChildren(pRoot, pVisitor, 0);
+}
+
+bool VisitFile(const char* pFilename, RecordVisitor& pVisitor, std::string& pError)
+{
+	MappedFile file;
+	if (!file.Open(pFilename))
+	{
+		pError = std::string("cannot open '") + pFilename + "'";
+		return false;
+	}
+	if (IsBinaryFbx(file.GetData(), file.GetSize()))
+		return VisitBinaryRecords(file.GetData(), file.GetSize(), pVisitor, pError);
+
+	file.Close();
+	Document document;
+	if (!document.Load(pFilename))
+	{
+		pError = document.GetError();
+		return false;
+	}
+	VisitRecordTree(document.GetRoot(), pVisitor);
+	return true;
+}
+
+}
@@ -0,0 +1,70 @@
+#ifndef FBX_VISITOR_H
+#define FBX_VISITOR_H
+
+#include "fbx_reader.h"
+
+#include <string>
+
+namespace fbxl {
+
+/**
+* Callbacks for a depth-first walk over FBX records in file order. The walk
+* itself keeps nothing, so a visitor that only counts or filters runs in
+* constant memory. Names and property payloads point into the source buffer
+* and remain valid for as long as that buffer does.
+*/
+class RecordVisitor
+{
+public:
+	virtual ~RecordVisitor() {}
+
+	/**
+	* A record starts. Return false to skip its values and nested records;
+	* EndRecord is then not called for it.
+	*/
+	virtual bool BeginRecord(const StringRef& /*pName*/, size_t /*pPropertyCount*/, int /*pDepth*/) { return true; }
+
+	/**
+	* A scalar or string value of the current record.
+	*/
+	virtual void OnProperty(const Property& /*pProperty*/) {}
+
+	/**
+	* An array value of the current record, still in its on-disk encoding.
+	* Wrap it in an ArrayView to read elements.
+	*/
+	virtual void OnArray(const Property& /*pProperty*/) {}
+
+	virtual void EndRecord(const StringRef& /*pName*/, int /*pDepth*/) {}
+};
+
+/**
+* True if pData starts with the "Kaydara FBX Binary" header.
+*/
+bool IsBinaryFbx(const unsigned char* pData, size_t pSize);
+
+/**
+* Version number stored in a binary FBX header (7400, 7500, ...).
+*/
+int GetBinaryFbxVersion(const unsigned char* pData);
+
+/**
+* Stream the records of an in-memory binary FBX file through pVisitor,
+* straight from the bytes. Returns false with pError set on malformed input.
+*/
+bool VisitBinaryRecords(const unsigned char* pData, size_t pSize, RecordVisitor& pVisitor, std::string& pError);
+
+/**
+* Replay an already parsed record tree through pVisitor.
+*/
+void VisitRecordTree(const Record& pRoot, RecordVisitor& pVisitor);
+
+/**
+* Stream the records of pFilename through pVisitor. Binary files are walked
+* directly in the mapped file; ASCII files are parsed into a tree first.
+*/
+bool VisitFile(const char* pFilename, RecordVisitor& pVisitor, std::string& pError);
+
+}
+
+#endif
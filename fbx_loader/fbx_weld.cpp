@@ -0,0 +1,150 @@
+#include "fbx_weld.h"
+
+#include <string.h>
+
+namespace fbxl {
+
+namespace {
+
+/**
+* One attribute taking part in the weld: its source values, the element each
+* polygon vertex uses, and the buffer its welded values go to.
+*/
+template <typename Real>
+struct WeldInput
+{
+	const AttributeStream<Real>* stream;
+	std::vector<int> elements;
+	std::vector<Real>* output;
+};
+
+uint32_t HashRow(const unsigned char* pBytes, size_t pSize)
+{
+	uint32_t hash = 2166136261u;
+	for (size_t i = 0; i + 4 <= pSize; i += 4)
+	{
+		uint32_t word;
+		memcpy(&word, pBytes + i, 4);
+		hash = (hash ^ word) * 16777619u;
+		hash ^= hash >> 15;
+	}
+	return hash;
+}
+
+}
+
+template <typename Real>
+void BuildIndexedMesh(const MeshStreams<Real>& pStreams, IndexedMesh<Real>& pOut)
+{
+	pOut = IndexedMesh<Real>();
+	pOut.polygonStarts = pStreams.polygonStarts;
+
+	std::vector<WeldInput<Real> > inputs;
+	const AttributeStream<Real>* streams[] = { &pStreams.normals, &pStreams.tangents, &pStreams.binormals, &pStreams.colors };
+	std::vector<Real>* outputs[] = { &pOut.normals, &pOut.tangents, &pOut.binormals, &pOut.colors };
+	for (int i = 0; i < 4; i++)
+	{
+		if (streams[i]->Empty())
+			continue;
+		inputs.push_back(WeldInput<Real>());
+		inputs.back().stream = streams[i];
+		inputs.back().output = outputs[i];
+	}
+	pOut.uvSets.resize(pStreams.uvSets.size());
+	for (size_t i = 0; i < pStreams.uvSets.size(); i++)
+	{
+		inputs.push_back(WeldInput<Real>());
+		inputs.back().stream = &pStreams.uvSets[i];
+		inputs.back().output = &pOut.uvSets[i];
+	}
+
+	int stride = 3;
+	for (size_t a = 0; a < inputs.size(); a++)
+	{
+		pStreams.ResolveToPolygonVertices(*inputs[a].stream, inputs[a].elements);
+		stride += inputs[a].stream->components;
+	}
+
+	const int polygonVertexCount = pStreams.GetPolygonVertexCount();
+	const int controlPointCount = pStreams.GetControlPointsCount();
+	if (polygonVertexCount == 0)
+		return;
+
+	// Open-addressed table of vertex numbers, at most half full.
+	size_t capacity = 16;
+	while (capacity < (size_t)polygonVertexCount * 2)
+		capacity <<= 1;
+	std::vector<int> table(capacity, -1);
+
+	std::vector<Real> vertices;
+	vertices.reserve((size_t)polygonVertexCount * stride);
+	std::vector<uint32_t> remap(polygonVertexCount);
+	std::vector<Real> row(stride);
+	const size_t rowBytes = stride * sizeof(Real);
+
+	for (int i = 0; i < polygonVertexCount; i++)
+	{
+		// Gather the polygon vertex's attributes into one row. Adding zero
+		// turns -0 into +0 so both hash the same.
+		int point = pStreams.polygonVertices[i];
+		for (int c = 0; c < 3; c++)
+			row[c] = point >= 0 && point < controlPointCount ? pStreams.positions[(size_t)point * 3 + c] + Real(0) : Real(0);
+		int column = 3;
+		for (size_t a = 0; a < inputs.size(); a++)
+		{
+			const AttributeStream<Real>& stream = *inputs[a].stream;
+			int element = inputs[a].elements[i];
+			for (int c = 0; c < stream.components; c++)
+				row[column + c] = element >= 0 ? stream.values[(size_t)element * stream.components + c] + Real(0) : Real(0);
+			column += stream.components;
+		}
+
+		size_t slot = HashRow((const unsigned char*)&row[0], rowBytes) & (capacity - 1);
+		for (;;)
+		{
+			int vertex = table[slot];
+			if (vertex < 0)
+			{
+				vertex = (int)(vertices.size() / stride);
+				table[slot] = vertex;
+				vertices.insert(vertices.end(), row.begin(), row.end());
+				remap[i] = (uint32_t)vertex;
+				break;
+			}
+			if (memcmp(&vertices[(size_t)vertex * stride], &row[0], rowBytes) == 0)
+			{
+				remap[i] = (uint32_t)vertex;
+				break;
+			}
+			slot = (slot + 1) & (capacity - 1);
+		}
+	}
+
+	// Split the interleaved unique vertices back into one array per attribute.
+	const size_t vertexCount = vertices.size() / stride;
+	pOut.positions.resize(vertexCount * 3);
+	for (size_t a = 0; a < inputs.size(); a++)
+		inputs[a].output->resize(vertexCount * inputs[a].stream->components);
+	for (size_t v = 0; v < vertexCount; v++)
+	{
+		const Real* source = &vertices[v * stride];
+		memcpy(&pOut.positions[v * 3], source, 3 * sizeof(Real));
+		int column = 3;
+		for (size_t a = 0; a < inputs.size(); a++)
+		{
+			const int components = inputs[a].stream->components;
+			memcpy(&(*inputs[a].output)[v * components], source + column, components * sizeof(Real));
+			column += components;
+		}
+	}
+
+	if (vertexCount <= 0x10000)
+		pOut.indices16.assign(remap.begin(), remap.end());
+	else
+		pOut.indices32.swap(remap);
+}
+
+template void BuildIndexedMesh(const MeshStreams<float>&, IndexedMesh<float>&);
+template void BuildIndexedMesh(const MeshStreams<double>&, IndexedMesh<double>&);
+
+}
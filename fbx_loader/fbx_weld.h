@@ -0,0 +1,59 @@
+#ifndef FBX_WELD_H
+#define FBX_WELD_H
+
+#include "fbx_mesh.h"
+
+#include <stdint.h>
+#include <vector>
+
+namespace fbxl {
+
+/**
+* A mesh welded into a GPU-style vertex and index buffer. Every polygon
+* vertex had all its attributes resolved to polygon-vertex level; polygon
+* vertices whose attributes are bit-identical share one vertex. Vertex
+* attributes are kept structure-of-arrays, with the same component counts as
+* MeshStreams. The index buffer has one entry per polygon vertex in polygon
+* order (polygonStarts gives the polygon boundaries) and uses 16-bit indices
+* when the vertex count allows it, 32-bit otherwise.
+*/
+template <typename Real>
+struct IndexedMesh
+{
+	std::vector<Real> positions;
+	std::vector<Real> normals;
+	std::vector<Real> tangents;
+	std::vector<Real> binormals;
+	std::vector<Real> colors;
+	std::vector<std::vector<Real> > uvSets;
+
+	std::vector<uint16_t> indices16;
+	std::vector<uint32_t> indices32;
+	std::vector<int> polygonStarts;
+
+	int GetVertexCount() const { return (int)(positions.size() / 3); }
+	int GetIndexCount() const { return (int)(indices16.empty() ? indices32.size() : indices16.size()); }
+	int GetIndexSize() const { return indices32.empty() ? 2 : 4; }
+	uint32_t GetIndex(int pIndex) const { return indices32.empty() ? indices16[pIndex] : indices32[pIndex]; }
+
+	/**
+	* Unique vertices per polygon vertex: 1.0 means nothing was shared, lower
+	* is better.
+	*/
+	double GetDedupRatio() const { return GetIndexCount() ? (double)GetVertexCount() / GetIndexCount() : 1.0; }
+};
+
+typedef IndexedMesh<float> IndexedMeshF;
+typedef IndexedMesh<double> IndexedMeshD;
+
+/**
+* Weld pStreams into pOut. Vertices are found through a hash table keyed on
+* their attribute bits, so the cost is linear in the number of polygon
+* vertices. Attributes a polygon vertex has no data for read as zero.
+*/
+template <typename Real>
+void BuildIndexedMesh(const MeshStreams<Real>& pStreams, IndexedMesh<Real>& pOut);
+
+}
+
+#endif
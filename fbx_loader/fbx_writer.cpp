@@ -0,0 +1,153 @@
+#include "fbx_writer.h"
+#include "fbx_dtoa.h"
+
+#include <stdarg.h>
+#include <string.h>
+
+namespace fbxl {
+
+namespace {
+
+const char kTabs[] = "\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t";
+const int kTabCount = (int)sizeof(kTabs) - 1;
+
+}
+
+bool FileSink::Write(const char* pData, size_t pSize)
+{
+	return fwrite(pData, 1, pSize, mFile) == pSize;
+}
+
+bool StringSink::Write(const char* pData, size_t pSize)
+{
+	mOut.append(pData, pSize);
+	return true;
+}
+
+TextWriter::TextWriter(OutputSink& pSink, size_t pBufferSize)
+	: mSink(pSink)
+	, mBuffer(pBufferSize < 256 ? 256 : pBufferSize)
+	, mUsed(0)
+	, mFailed(false)
+{
+}
+
+TextWriter::~TextWriter()
+{
+	Flush();
+}
+
+void TextWriter::Drain()
+{
+	if (mUsed && !mSink.Write(&mBuffer[0], mUsed))
+		mFailed = true;
+	mUsed = 0;
+}
+
+bool TextWriter::Flush()
+{
+	Drain();
+	return !mFailed;
+}
+
+char* TextWriter::Reserve(size_t pSize)
+{
+	if (mBuffer.size() - mUsed < pSize)
+		Drain();
+	return &mBuffer[mUsed];
+}
+
+void TextWriter::WriteText(const char* pText, size_t pLength)
+{
+	// Text longer than the buffer goes straight through.
+	if (pLength > mBuffer.size())
+	{
+		Drain();
+		if (!mSink.Write(pText, pLength))
+			mFailed = true;
+		return;
+	}
+	memcpy(Reserve(pLength), pText, pLength);
+	mUsed += pLength;
+}
+
+void TextWriter::WriteText(const char* pText)
+{
+	WriteText(pText, strlen(pText));
+}
+
+void TextWriter::WriteTabs(int pCount)
+{
+	for (; pCount > kTabCount; pCount -= kTabCount)
+		WriteText(kTabs, kTabCount);
+	if (pCount > 0)
+		WriteText(kTabs, pCount);
+}
+
+void TextWriter::WriteUInt(unsigned long long pValue)
+{
+	char reversed[24];
+	int count = 0;
+	do
+	{
+		reversed[count++] = (char)('0' + pValue % 10);
+		pValue /= 10;
+	} while (pValue);
+	char* out = Reserve(count);
+	for (int i = 0; i < count; i++)
+		out[i] = reversed[count - 1 - i];
+	mUsed += count;
+}
+
+void TextWriter::WriteInt(long long pValue)
+{
+	if (pValue < 0)
+	{
+		WriteChar('-');
+		WriteUInt(0ULL - (unsigned long long)pValue);
+	}
+	else
+		WriteUInt((unsigned long long)pValue);
+}
+
+void TextWriter::WriteFixed(double pValue)
+{
+	int length = FormatFixed6(pValue, Reserve(kMaxNumberText));
+	if (length)
+		mUsed += length;
+	else
+		WriteFormat("%f", pValue);
+}
+
+void TextWriter::WriteReal(double pValue)
+{
+	mUsed += FormatShortest(pValue, Reserve(kMaxNumberText));
+}
+
+void TextWriter::WriteReal(float pValue)
+{
+	mUsed += FormatShortest(pValue, Reserve(kMaxNumberText));
+}
+
+void TextWriter::WriteFormat(const char* pFormat, ...)
+{
+	char line[512];
+	va_list args;
+	va_start(args, pFormat);
+	int length = vsnprintf(line, sizeof(line), pFormat, args);
+	va_end(args);
+	if (length < 0)
+		return;
+	if (length < (int)sizeof(line))
+	{
+		WriteText(line, length);
+		return;
+	}
+	std::vector<char> text(length + 1);
+	va_start(args, pFormat);
+	vsnprintf(&text[0], text.size(), pFormat, args);
+	va_end(args);
+	WriteText(&text[0], length);
+}
+
+}
@@ -0,0 +1,128 @@
+#ifndef FBX_WRITER_H
+#define FBX_WRITER_H
+
+#include <stddef.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+namespace fbxl {
+
+/**
+* Where a TextWriter sends its text, one large chunk at a time.
+*/
+class OutputSink
+{
+public:
+	virtual ~OutputSink() {}
+
+	/**
+	* Take pSize bytes; false if they could not be written.
+	*/
+	virtual bool Write(const char* pData, size_t pSize) = 0;
+};
+
+/**
+* Sink writing to a stdio stream, one fwrite per chunk. The stream is not
+* closed.
+*/
+class FileSink : public OutputSink
+{
+public:
+	explicit FileSink(FILE* pFile) : mFile(pFile) {}
+	virtual bool Write(const char* pData, size_t pSize);
+
+private:
+	FILE* mFile;
+};
+
+/**
+* Sink appending to a string.
+*/
+class StringSink : public OutputSink
+{
+public:
+	explicit StringSink(std::string& pOut) : mOut(pOut) {}
+	virtual bool Write(const char* pData, size_t pSize);
+
+private:
+	std::string& mOut;
+};
+
+/**
+* Formats text into a reusable buffer and hands it to a sink only when the
+* buffer is full, so writing millions of short lines costs a few large
+* writes instead of a stdio call each. Numbers are converted without going
+* through printf.
+*/
+class TextWriter
+{
+public:
+	explicit TextWriter(OutputSink& pSink, size_t pBufferSize = 1 << 20);
+
+	/**
+	* Flushes what is left.
+	*/
+	~TextWriter();
+
+	void WriteChar(char pChar)
+	{
+		if (mUsed == mBuffer.size())
+			Drain();
+		mBuffer[mUsed++] = pChar;
+	}
+
+	void WriteText(const char* pText, size_t pLength);
+	void WriteText(const char* pText);
+	void WriteText(const std::string& pText) { WriteText(pText.data(), pText.size()); }
+
+	/**
+	* pCount tab characters.
+	*/
+	void WriteTabs(int pCount);
+
+	void WriteInt(long long pValue);
+	void WriteUInt(unsigned long long pValue);
+
+	/**
+	* pValue as printf("%f") would print it.
+	*/
+	void WriteFixed(double pValue);
+
+	/**
+	* The shortest text that reads back as pValue; see FormatShortest.
+	*/
+	void WriteReal(double pValue);
+	void WriteReal(float pValue);
+
+	/**
+	* printf-style formatting, for the odd line that needs it.
+	*/
+	void WriteFormat(const char* pFormat, ...);
+
+	/**
+	* Hand everything buffered to the sink. False once any write failed.
+	*/
+	bool Flush();
+
+	bool HasFailed() const { return mFailed; }
+
+private:
+	TextWriter(const TextWriter&);
+	TextWriter& operator=(const TextWriter&);
+
+	/**
+	* Make room for pSize more bytes and return where they go.
+	*/
+	char* Reserve(size_t pSize);
+	void Drain();
+
+	OutputSink& mSink;
+	std::vector<char> mBuffer;
+	size_t mUsed;
+	bool mFailed;
+};
+
+}
+
+#endif
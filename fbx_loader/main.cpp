@@ -1,163 +1,217 @@
-#pragma comment(lib, "libfbxsdk.lib")
-#define FBXSDK_SHARED
-#include <fbxsdk.h>
+#include "fbx_anim.h"
+#include "fbx_anim_compress.h"
+#include "fbx_baked.h"
+#include "fbx_batch.h"
+#include "fbx_blend_shape.h"
+#include "fbx_cache.h"
+#include "fbx_convert.h"
+#include "fbx_dump.h"
+#include "fbx_material.h"
+#include "fbx_media.h"
+#include "fbx_pipeline.h"
+#include "fbx_reader.h"
+#include "fbx_scene.h"
+#include "fbx_skin.h"
+#include "fbx_texture.h"
+#include "fbx_thread_pool.h"
+#include "fbx_transform.h"
+#include "fbx_visitor.h"
+#include "fbx_weld.h"
+#include "fbx_writer.h"
 
+#include <math.h>
+#include <algorithm>
+#include <chrono>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <string>
 
 using namespace std;
+using namespace fbxl;
 /* Tab character ("\t") counter */
 int numTabs = 0;
 
 /**
 * Print the required number of tabs.
 */
-void PrintTabs() {
-	for (int i = 0; i < numTabs; i++)
-		printf("\t");
+void PrintTabs(TextWriter& out) {
+	out.WriteTabs(numTabs);
 }
 
 /**
 * Return a string-based representation based on the attribute type.
 */
-FbxString GetAttributeTypeName(FbxNodeAttribute::EType type) {
+const char* GetAttributeTypeName(NodeAttribute::EType type) {
 	switch (type) {
-	case FbxNodeAttribute::eUnknown: return "unidentified";
-	case FbxNodeAttribute::eNull: return "null";
-	case FbxNodeAttribute::eMarker: return "marker";
-	case FbxNodeAttribute::eSkeleton: return "skeleton";
-	case FbxNodeAttribute::eMesh: return "mesh";
-	case FbxNodeAttribute::eNurbs: return "nurbs";
-	case FbxNodeAttribute::ePatch: return "patch";
-	case FbxNodeAttribute::eCamera: return "camera";
-	case FbxNodeAttribute::eCameraStereo: return "stereo";
-	case FbxNodeAttribute::eCameraSwitcher: return "camera switcher";
-	case FbxNodeAttribute::eLight: return "light";
-	case FbxNodeAttribute::eOpticalReference: return "optical reference";
-	case FbxNodeAttribute::eOpticalMarker: return "marker";
-	case FbxNodeAttribute::eNurbsCurve: return "nurbs curve";
-	case FbxNodeAttribute::eTrimNurbsSurface: return "trim nurbs surface";
-	case FbxNodeAttribute::eBoundary: return "boundary";
-	case FbxNodeAttribute::eNurbsSurface: return "nurbs surface";
-	case FbxNodeAttribute::eShape: return "shape";
-	case FbxNodeAttribute::eLODGroup: return "lodgroup";
-	case FbxNodeAttribute::eSubDiv: return "subdiv";
+	case NodeAttribute::eUnknown: return "unidentified";
+	case NodeAttribute::eNull: return "null";
+	case NodeAttribute::eMarker: return "marker";
+	case NodeAttribute::eSkeleton: return "skeleton";
+	case NodeAttribute::eMesh: return "mesh";
+	case NodeAttribute::eNurbs: return "nurbs";
+	case NodeAttribute::ePatch: return "patch";
+	case NodeAttribute::eCamera: return "camera";
+	case NodeAttribute::eCameraStereo: return "stereo";
+	case NodeAttribute::eCameraSwitcher: return "camera switcher";
+	case NodeAttribute::eLight: return "light";
+	case NodeAttribute::eOpticalReference: return "optical reference";
+	case NodeAttribute::eOpticalMarker: return "marker";
+	case NodeAttribute::eNurbsCurve: return "nurbs curve";
+	case NodeAttribute::eTrimNurbsSurface: return "trim nurbs surface";
+	case NodeAttribute::eBoundary: return "boundary";
+	case NodeAttribute::eNurbsSurface: return "nurbs surface";
+	case NodeAttribute::eShape: return "shape";
+	case NodeAttribute::eLODGroup: return "lodgroup";
+	case NodeAttribute::eSubDiv: return "subdiv";
 	default: return "unknown";
 	}
 }
 
-void PrintFbxVector4(FbxVector4 fv4)
+/**
+* Print "(x, y, z)" for count values, each the way printf("%f") would.
+*/
+void PrintTuple(TextWriter& out, const double* v, int count)
+{
+	out.WriteChar('(');
+	for (int i = 0; i < count; i++)
+	{
+		if (i)
+			out.WriteText(", ", 2);
+		out.WriteFixed(v[i]);
+	}
+	out.WriteChar(')');
+}
+
+void PrintVector4(TextWriter& out, const double* v, double w)
 {
-	PrintTabs();
-	printf("(%f, %f, %f, %f)\n", fv4.mData[0], fv4.mData[1], fv4.mData[2], fv4.mData[3]);
+	PrintTabs(out);
+	const double lValue[4] = { v[0], v[1], v[2], w };
+	PrintTuple(out, lValue, 4);
+	out.WriteChar('\n');
 }
 
-void PrintFbxVector2(FbxVector2 fv4)
+void PrintVector2(TextWriter& out, const double* v)
 {
-	PrintTabs();
-	printf("(%f, %f)\n", fv4.mData[0], fv4.mData[1]);
+	PrintTabs(out);
+	PrintTuple(out, v, 2);
+	out.WriteChar('\n');
 }
 
 /**
 * Print an attribute.
 */
-void PrintAttribute(FbxNodeAttribute* pAttribute, bool detail) {
+void PrintAttribute(TextWriter& out, const NodeAttribute* pAttribute, bool detail) {
 	if (!pAttribute) return;
 
-	FbxString typeName = GetAttributeTypeName(pAttribute->GetAttributeType());
-	FbxString attrName = pAttribute->GetName();
-	PrintTabs();
-	// Note: to retrieve the character array of a FbxString, use its Buffer() method.
-	printf("<attribute type='%s' name='%s'/>\n", typeName.Buffer(), attrName.Buffer());
-	if (string("mesh") == typeName.Buffer())
+	const char* typeName = GetAttributeTypeName(pAttribute->type);
+	const char* attrName = pAttribute->name.c_str();
+	PrintTabs(out);
+	out.WriteText("<attribute type='");
+	out.WriteText(typeName);
+	out.WriteText("' name='");
+	out.WriteText(attrName);
+	out.WriteText("'/>\n");
+	if (pAttribute->mesh)
 	{
-		FbxMesh* pMesh = (FbxMesh*)pAttribute;
+		const Mesh* pMesh = pAttribute->mesh;
 
-		PrintTabs();
-		printf("Mesh Control Points: \n");
-		FbxVector4* IControlPoints = pMesh->GetControlPoints();
+		PrintTabs(out);
+		out.WriteText("Mesh Control Points: \n");
 		++numTabs;
 		int count = detail ? pMesh->GetControlPointsCount() : 
 			(pMesh->GetControlPointsCount() < 3 ? pMesh->GetControlPointsCount() : 3);
+		double lValue[4];
 		for (int i = 0; i < count; i++)
 		{
-			PrintFbxVector4(IControlPoints[i]);
+			pMesh->GetControlPoint(i, lValue);
+			PrintVector4(out, lValue, 1.0);
 		}
 		--numTabs;
 
-		PrintTabs();
-		printf("Mesh Index: \n");
+		PrintTabs(out);
+		out.WriteText("Mesh Index: \n");
 		++numTabs;
-		int* pIndices = pMesh->GetPolygonVertices();
 		count = detail ? pMesh->GetPolygonVertexCount() : 
 			(pMesh->GetPolygonVertexCount() < 3 ? pMesh->GetPolygonVertexCount() : 3);
 		for (int i = 0; i < count; ++i)
 		{
-			PrintTabs();
-			printf("%d\n", pIndices[i]);
+			PrintTabs(out);
+			out.WriteInt(pMesh->GetPolygonVertex(i));
+			out.WriteChar('\n');
 		}
 		--numTabs;
 
-		PrintTabs();
-		printf("Mesh Layer Info: \n");
+		PrintTabs(out);
+		out.WriteText("Mesh Layer Info: \n");
 		++numTabs;
-		for (int i = 0; i < pMesh->GetLayerCount(); i++)
+		for (size_t i = 0; i < pMesh->layers.size(); i++)
 		{
-			FbxLayer* pLayer = pMesh->GetLayer(i);
-			FbxLayerElementNormal* pNormal = pLayer->GetNormals();
-
-			PrintTabs();
-			printf("Normals:\n");
-			++numTabs;
-			count = detail ? pNormal->mDirectArray->GetCount() : 
-				(pNormal->mDirectArray->GetCount() < 3 ? pNormal->mDirectArray->GetCount() : 3);
-			for (int i = 0; i < count; i++)
+			const Layer* pLayer = &pMesh->layers[i];
+			const LayerElement* pNormal = pLayer->normals;
+			if (pNormal)
 			{
-				PrintFbxVector4((*pNormal->mDirectArray)[i]);
+				PrintTabs(out);
+				out.WriteText("Normals:\n");
+				++numTabs;
+				count = detail ? pNormal->GetCount() : 
+					(pNormal->GetCount() < 3 ? pNormal->GetCount() : 3);
+				for (int i = 0; i < count; i++)
+				{
+					pNormal->GetDirect(i, lValue);
+					PrintVector4(out, lValue, 1.0);
+				}
+				--numTabs;
 			}
-			--numTabs;
-
-			FbxLayerElementUV* pUV = pLayer->GetUVs();
-			PrintTabs();
-			printf("UVs:\n");
-			++numTabs;
-			count = detail ? pUV->mDirectArray->GetCount() : 
-				(pUV->mDirectArray->GetCount() < 3 ? pUV->mDirectArray->GetCount() : 3);
-			for (int i = 0; i < count; i++)
+
+			const LayerElement* pUV = pLayer->uvs;
+			if (pUV)
 			{
-				PrintFbxVector2((*pUV->mDirectArray)[i]);
+				PrintTabs(out);
+				out.WriteText("UVs:\n");
+				++numTabs;
+				count = detail ? pUV->GetCount() : 
+					(pUV->GetCount() < 3 ? pUV->GetCount() : 3);
+				for (int i = 0; i < count; i++)
+				{
+					pUV->GetDirect(i, lValue);
+					PrintVector2(out, lValue);
+				}
+				--numTabs;
 			}
-			--numTabs;
 
-			FbxLayerElementTangent* pTangent = pLayer->GetTangents();
+			const LayerElement* pTangent = pLayer->tangents;
 			if (pTangent)
 			{
-				PrintTabs();
-				printf("Tangents:\n");
+				PrintTabs(out);
+				out.WriteText("Tangents:\n");
 				++numTabs;
-				count = detail ? pTangent->mDirectArray->GetCount() : 
-					(pTangent->mDirectArray->GetCount() < 3 ? pTangent->mDirectArray->GetCount() : 3);
+				count = detail ? pTangent->GetCount() : 
+					(pTangent->GetCount() < 3 ? pTangent->GetCount() : 3);
 				for (int i = 0; i < count; i++)
 				{
-					PrintFbxVector4((*pTangent->mDirectArray)[i]);
+					pTangent->GetDirect(i, lValue);
+					PrintVector4(out, lValue, 1.0);
 				}
 				--numTabs;
 			}
 
-			for (int i = FbxLayerElement::eTextureDiffuse; i < FbxLayerElement::eTypeCount; i++)
+			for (int i = LayerElement::eTextureDiffuse; i < LayerElement::eTypeCount; i++)
 			{
-				FbxLayerElementTexture* pTextures = pLayer->GetTextures((FbxLayerElement::EType)i);
-				if (pTextures)
+				const vector<const Texture*>& pTextures = pLayer->textures[i];
+				if (!pTextures.empty())
 				{
-					PrintTabs();
-					printf("Textures:\n");
+					PrintTabs(out);
+					out.WriteText("Textures:\n");
 					++numTabs;
-					count = detail ? pTextures->mDirectArray->GetCount() : 
-						pTextures->mDirectArray->GetCount() < 3 ? pTextures->mDirectArray->GetCount() : 3;
+					count = detail ? (int)pTextures.size() : 
+						(int)pTextures.size() < 3 ? (int)pTextures.size() : 3;
 					for (int j = 0; j < count; j++)
 					{
-						printf("%d:%s\n", i, (*pTextures->mDirectArray)[j]->GetUrl());
+						out.WriteInt(i);
+						out.WriteChar(':');
+						out.WriteText(pTextures[j]->fileName.c_str());
+						out.WriteChar('\n');
 					}
 					--numTabs;
 				}
@@ -167,60 +221,1030 @@ void PrintAttribute(FbxNodeAttribute* pAttribute, bool detail) {
 	}
 }
 
-void PrintNode(FbxNode* pNode, bool detail) {
-	PrintTabs();
-	const char* nodeName = pNode->GetName();
-	FbxDouble3 translation = pNode->LclTranslation.Get();
-	FbxDouble3 rotation = pNode->LclRotation.Get();
-	FbxDouble3 scaling = pNode->LclScaling.Get();
+void PrintNode(TextWriter& out, const Node* pNode, bool detail) {
+	PrintTabs(out);
+	const char* nodeName = pNode->name.c_str();
+	const double* translation = pNode->translation;
+	const double* rotation = pNode->rotation;
+	const double* scaling = pNode->scaling;
 
 	// Print the contents of the node.
-	printf("<node name='%s' translation='(%f, %f, %f)' rotation='(%f, %f, %f)' scaling='(%f, %f, %f)'>\n",
-		nodeName,
-		translation[0], translation[1], translation[2],
-		rotation[0], rotation[1], rotation[2],
-		scaling[0], scaling[1], scaling[2]
-		);
+	out.WriteText("<node name='");
+	out.WriteText(nodeName);
+	out.WriteText("' translation='");
+	PrintTuple(out, translation, 3);
+	out.WriteText("' rotation='");
+	PrintTuple(out, rotation, 3);
+	out.WriteText("' scaling='");
+	PrintTuple(out, scaling, 3);
+	out.WriteText("'>\n");
 	numTabs++;
 
 	// Print the node's attributes.
-	for (int i = 0; i < pNode->GetNodeAttributeCount(); i++)
-		PrintAttribute(pNode->GetNodeAttributeByIndex(i), detail);
+	for (size_t i = 0; i < pNode->attributes.size(); i++)
+		PrintAttribute(out, pNode->attributes[i], detail);
 
 	// Recursively print the children.
-	for (int j = 0; j < pNode->GetChildCount(); j++)
-		PrintNode(pNode->GetChild(j), detail);
+	for (size_t j = 0; j < pNode->children.size(); j++)
+		PrintNode(out, pNode->children[j], detail);
 
 	numTabs--;
-	PrintTabs();
-	printf("</node>\n");
+	PrintTabs(out);
+	out.WriteText("</node>\n");
 }
 
-void PrintAnimation(FbxScene* lScene, bool detail)
+void PrintAnimation(TextWriter& out, const Scene& lScene, bool detail)
 {
-	printf("\n---Animation Informations---\n");
-	int numStacks = lScene->GetSrcObjectCount<FbxAnimStack>();
-	printf("There are %d animation stack(s)\n", numStacks);
+	out.WriteText("\n---Animation Informations---\n");
+	int numStacks = (int)lScene.animStacks.size();
+	out.WriteFormat("There are %d animation stack(s)\n", numStacks);
 	for (int i = 0; i < numStacks; i++)
 	{
-		FbxAnimStack* pAnimStack = FbxCast<FbxAnimStack>(lScene->GetSrcObject<FbxAnimStack>());
-		printf("--%s\n", pAnimStack->GetName());
-		int numLayers = pAnimStack->GetMemberCount<FbxAnimLayer>();
+		const AnimStack* pAnimStack = &lScene.animStacks[i];
+		out.WriteText("--");
+		out.WriteText(pAnimStack->name.c_str());
+		out.WriteChar('\n');
+		int numLayers = (int)pAnimStack->layers.size();
 		numTabs++;
 		for (int j = 0; j < numLayers; j++)
 		{
-			FbxAnimLayer* lAnimLayer = pAnimStack->GetMember<FbxAnimLayer>(j);
-			PrintTabs();
-			printf("%s\n", lAnimLayer->GetName());
+			const AnimLayer* lAnimLayer = pAnimStack->layers[j];
+			PrintTabs(out);
+			out.WriteText(lAnimLayer->name.c_str());
+			out.WriteChar('\n');
 		}
 		numTabs--;
 	}
 }
 
+/**
+* Describe every animation stack, then report what baking them all in main
+* gave: what the baked streams hold and what it took.
+*/
+void PrintAnimationBake(const Scene& lScene, const vector<BakedAnimation>& lBaked, const AnimBakeStats& stats)
+{
+	printf("\n---Animation Bake Informations---\n");
+	vector<AnimStackInfo> lInfos;
+	DescribeAnimStacks(lScene, lInfos);
+	for (size_t i = 0; i < lInfos.size(); i++)
+	{
+		const AnimStackInfo& info = lInfos[i];
+		printf("%s: %.3f s to %.3f s (take %.3f s to %.3f s), %d layer(s), %lu curve(s), %lu key(s)\n",
+			info.stack->name.c_str(), (double)info.start / kTimeTicksPerSecond, (double)info.stop / kTimeTicksPerSecond,
+			(double)info.localStart / kTimeTicksPerSecond, (double)info.localStop / kTimeTicksPerSecond,
+			(int)info.layers.size(), (unsigned long)info.curveCount, (unsigned long)info.keyCount);
+		for (size_t j = 0; j < info.layers.size(); j++)
+		{
+			const AnimLayerInfo& layer = info.layers[j];
+			printf("\t%s: %d curve node(s), %lu curve(s), %lu key(s)", layer.layer->name.c_str(),
+				(int)layer.curveNodeCount, (unsigned long)layer.curveCount, (unsigned long)layer.keyCount);
+			if (layer.keyCount)
+				printf(" from %.3f s to %.3f s", (double)layer.firstKey / kTimeTicksPerSecond,
+					(double)layer.lastKey / kTimeTicksPerSecond);
+			printf("\n");
+		}
+	}
+
+	for (size_t i = 0; i < lBaked.size(); i++)
+	{
+		printf("%s: %d node(s), %d frame(s) at %g fps from %.3f s to %.3f s, %lu bytes\n",
+			lBaked[i].name.c_str(), (int)lBaked[i].nodes.size(), lBaked[i].frameCount, lBaked[i].sampleRate,
+			lBaked[i].startTime, lBaked[i].startTime + lBaked[i].GetDuration(),
+			(unsigned long)(lBaked[i].samples.size() * sizeof(float)));
+	}
+	printf("%d stack(s), %lu frame(s), %lu bytes, %.3f ms (longest stack %.3f ms) on %d thread(s)\n",
+		(int)stats.stackCount, (unsigned long)stats.frameCount, (unsigned long)stats.bytes,
+		stats.seconds * 1000.0, stats.longestSeconds * 1000.0, stats.threadCount);
+}
+
+/**
+* Largest angle, in degrees, between the rotation lCompressed decompresses
+* to and the matrix of the baked Euler angles in each node's own rotation
+* order, over every node and frame. Unlike the report of CompressAnimation,
+* which compares against its own quaternions, this checks the Euler
+* conversion too. lNonXyz gets how many nodes use another order than XYZ.
+*/
+double GetRotationOrderError(const BakedAnimation& lBaked, const CompressedAnimation& lCompressed, int& lNonXyz)
+{
+	lNonXyz = 0;
+	double error = 0.0;
+	for (size_t n = 0; n < lBaked.nodes.size(); n++)
+	{
+		const int order = lBaked.nodes[n]->rotationOrder;
+		if (order != 0 && order != 6)
+			++lNonXyz;
+		for (int f = 0; f < lBaked.frameCount; f++)
+		{
+			double degrees[3], expected[16];
+			for (int c = 0; c < 3; c++)
+				degrees[c] = lBaked.GetStream(n, eRotationX + c)[f];
+			EulerToMatrix(degrees, order, expected);
+			float t[3], q[4], s[3];
+			lCompressed.Evaluate(n, f, t, q, s);
+			const double length = sqrt((double)q[0] * q[0] + (double)q[1] * q[1] + (double)q[2] * q[2] + (double)q[3] * q[3]);
+			const double x = q[0] / length, y = q[1] / length, z = q[2] / length, w = q[3] / length;
+			const double m[9] = {
+				1 - 2 * (y * y + z * z), 2 * (x * y + z * w), 2 * (x * z - y * w),
+				2 * (x * y - z * w), 1 - 2 * (x * x + z * z), 2 * (y * z + x * w),
+				2 * (x * z + y * w), 2 * (y * z - x * w), 1 - 2 * (x * x + y * y)
+			};
+			// d = expected^T m rotates by the angle between them; atan2 of
+			// its axis and trace parts stays accurate for small angles.
+			double d[9];
+			for (int c = 0; c < 3; c++)
+			{
+				for (int r = 0; r < 3; r++)
+				{
+					d[c * 3 + r] = 0.0;
+					for (int k = 0; k < 3; k++)
+						d[c * 3 + r] += expected[r * 4 + k] * m[c * 3 + k];
+				}
+			}
+			const double sx = d[5] - d[7], sy = d[6] - d[2], sz = d[1] - d[3];
+			const double angle = atan2(sqrt(sx * sx + sy * sy + sz * sz), d[0] + d[4] + d[8] - 1.0);
+			error = max(error, angle * 180.0 / 3.14159265358979323846);
+		}
+	}
+	return error;
+}
+
+/**
+* Drop the keys of every baked animation stack that linear interpolation
+* reproduces within the tolerances in FBX_LOADER_ANIM_TOLERANCES
+* ("translation,rotation,scaling", rotation in degrees) and report what that
+* saved, checking the rotations against each node's Euler matrices.
+*/
+void PrintAnimationCompression(const vector<BakedAnimation>& lBaked)
+{
+	printf("\n---Animation Compression Informations---\n");
+	CompressionTolerances lTolerances;
+	const char* tolerances = getenv("FBX_LOADER_ANIM_TOLERANCES");
+	if (tolerances)
+		sscanf(tolerances, "%f,%f,%f", &lTolerances.translation, &lTolerances.rotation, &lTolerances.scaling);
+	printf("tolerances: translation %g, rotation %g deg, scaling %g\n",
+		lTolerances.translation, lTolerances.rotation, lTolerances.scaling);
+
+	ThreadPool lPool;
+	for (size_t i = 0; i < lBaked.size(); i++)
+	{
+		CompressedAnimation lCompressed;
+		CompressionReport r = CompressAnimation(lBaked[i], lTolerances, lPool, lCompressed);
+		printf("%s: %lu -> %lu bytes (ratio %.2f), %lu of %lu keys kept, %.3f ms\n",
+			lCompressed.name.c_str(), (unsigned long)r.rawBytes, (unsigned long)r.compressedBytes, r.GetRatio(),
+			(unsigned long)r.keptKeys, (unsigned long)r.rawKeys, r.seconds * 1000.0);
+		printf("max error: translation %g, rotation %g deg, scaling %g\n",
+			r.maxTranslationError, r.maxRotationError, r.maxScalingError);
+		int lNonXyz;
+		double lOrderError = GetRotationOrderError(lBaked[i], lCompressed, lNonXyz);
+		printf("max rotation error against the Euler matrices (%d non-XYZ node(s)): %g deg\n", lNonXyz, lOrderError);
+	}
+}
+
+/**
+* Largest distance, per coordinate, of the skinned control points from
+* where the mesh's global bind matrix (from its first cluster) puts them.
+*/
+double GetBindPoseError(const SkinInfluences& lSkin, const vector<float>& lPositions, const vector<float>& lSkinned)
+{
+	const Cluster* lCluster = lSkin.clusters[0];
+	double m[16];
+	for (int c = 0; c < 4; c++)
+	{
+		for (int r = 0; r < 4; r++)
+		{
+			m[c * 4 + r] = 0.0;
+			for (int k = 0; k < 4; k++)
+				m[c * 4 + r] += lCluster->transformLink[k * 4 + r] * lCluster->transform[c * 4 + k];
+		}
+	}
+	double error = 0.0;
+	for (int v = 0; v < lSkin.vertexCount; v++)
+	{
+		const float* p = &lPositions[v * 3];
+		for (int r = 0; r < 3; r++)
+		{
+			double expected = m[r] * p[0] + m[4 + r] * p[1] + m[8 + r] * p[2] + m[12 + r];
+			error = max(error, fabs(expected - lSkinned[v * 3 + r]));
+		}
+	}
+	return error;
+}
+
+/**
+* Skin every skinned mesh in its bind pose with linear blending and dual
+* quaternions, 4 and 8 influences per control point, on one thread. Skinned
+* at bind time a mesh must land where its bind transform puts it, which
+* checks the weights and both kernels; the timing gives the throughput.
+*/
+void PrintSkinning(const Scene& lScene)
+{
+	printf("\n---Skinning Informations---\n");
+	for (size_t i = 0; i < lScene.nodes.size(); i++)
+	{
+		const Node* pNode = &lScene.nodes[i];
+		for (size_t j = 0; j < pNode->attributes.size(); j++)
+		{
+			const Mesh* pMesh = pNode->attributes[j]->mesh;
+			if (!pMesh || pMesh->skins.empty())
+				continue;
+			vector<float> lPositions;
+			pMesh->vertices.CopyTo(lPositions);
+			for (int slots = 4; slots <= 8; slots += 4)
+			{
+				SkinInfluences lSkin;
+				if (!BuildSkinInfluences(*pMesh, slots, lSkin)) {
+					printf("%s: skin could not be gathered\n", pNode->name.c_str());
+					break;
+				}
+				if (slots == 4)
+					printf("%s: %d control points, %d bone(s), up to %d influence(s), %d unweighted\n",
+						pNode->name.c_str(), lSkin.vertexCount, lSkin.GetBoneCount(), lSkin.maxInfluences,
+						lSkin.unweightedCount);
+				vector<float> lMatrices, lDualQuaternions;
+				BuildSkinMatrices(lSkin, NULL, NULL, lMatrices);
+				BuildDualQuaternions(&lMatrices[0], lSkin.clusters.size(), lDualQuaternions);
+
+				vector<float> lSkinned(lPositions.size());
+				for (int method = 0; method < 2; method++)
+				{
+					int runs = 0;
+					chrono::steady_clock::time_point start = chrono::steady_clock::now();
+					double seconds = 0.0;
+					while (seconds < 0.02)
+					{
+						if (method == 0)
+							SkinLinear(lSkin, &lMatrices[0], &lPositions[0], NULL, 0, lSkin.vertexCount, &lSkinned[0], NULL);
+						else
+							SkinDualQuaternion(lSkin, &lDualQuaternions[0], &lPositions[0], NULL, 0, lSkin.vertexCount,
+								&lSkinned[0], NULL);
+						runs++;
+						seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+					}
+					printf("\t%s, %d influences: %d truncated, %.1f M vertices/s, bind pose error %g\n",
+						method == 0 ? "linear" : "dual quaternion", slots, lSkin.truncatedCount,
+						(double)lSkin.vertexCount * runs / seconds / 1e6, GetBindPoseError(lSkin, lPositions, lSkinned));
+				}
+			}
+		}
+	}
+}
+
+/**
+* Extract the blend shapes of every mesh as sparse deltas, report how much
+* smaller they are than full copies, and time one evaluation with every
+* channel at 50%.
+*/
+void PrintBlendShapes(const Scene& lScene)
+{
+	printf("\n---Blend Shape Informations---\n");
+	for (size_t i = 0; i < lScene.nodes.size(); i++)
+	{
+		const Node* pNode = &lScene.nodes[i];
+		for (size_t j = 0; j < pNode->attributes.size(); j++)
+		{
+			const Mesh* pMesh = pNode->attributes[j]->mesh;
+			if (!pMesh || pMesh->blendShapes.empty())
+				continue;
+			SparseBlendShapes lShapes;
+			if (!ExtractBlendShapes(*pMesh, 0.0f, lShapes)) {
+				printf("%s: blend shapes could not be decoded\n", pNode->name.c_str());
+				continue;
+			}
+			size_t storedDeltas = 0, keptDeltas = 0;
+			for (size_t b = 0; b < pMesh->blendShapes.size(); b++)
+			{
+				for (size_t c = 0; c < pMesh->blendShapes[b]->channels.size(); c++)
+				{
+					const BlendShapeChannel* pChannel = pMesh->blendShapes[b]->channels[c];
+					for (size_t s = 0; s < pChannel->shapes.size(); s++)
+						storedDeltas += pChannel->shapes[s]->indexes.Size();
+				}
+			}
+			for (size_t t = 0; t < lShapes.targets.size(); t++)
+				keptDeltas += lShapes.targets[t].GetCount();
+			printf("%s: %d channel(s), %d target(s), %lu of %lu deltas kept, %lu -> %lu bytes (ratio %.2f)\n",
+				pNode->name.c_str(), (int)lShapes.channels.size(), (int)lShapes.targets.size(),
+				(unsigned long)keptDeltas, (unsigned long)storedDeltas, (unsigned long)lShapes.GetDenseByteSize(),
+				(unsigned long)lShapes.GetByteSize(),
+				lShapes.GetByteSize() ? (double)lShapes.GetDenseByteSize() / lShapes.GetByteSize() : 0.0);
+
+			vector<float> lPositions, lOut;
+			pMesh->vertices.CopyTo(lPositions);
+			lOut.resize(lPositions.size());
+			vector<float> lChannelWeights(lShapes.channels.size(), 50.0f), lTargetWeights;
+			chrono::steady_clock::time_point start = chrono::steady_clock::now();
+			GetTargetWeights(lShapes, &lChannelWeights[0], lTargetWeights);
+			ApplyBlendShapes(lShapes, &lTargetWeights[0], &lPositions[0], NULL, &lOut[0], NULL);
+			double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+			printf("\tall channels at 50%%: %.3f ms\n", seconds * 1000.0);
+		}
+	}
+}
+
+/**
+* Flatten the node tree, check the global matrices of the default pose
+* against the bind matrices skin clusters store for their bones, and time
+* every frame of the first baked animation stack evaluated in one sweep
+* against node by node.
+*/
+void PrintGlobalTransforms(const Scene& lScene, const vector<BakedAnimation>& lBaked)
+{
+	printf("\n---Global Transform Informations---\n");
+	FlatHierarchy lHierarchy;
+	BuildFlatHierarchy(lScene, lHierarchy);
+	const int count = lHierarchy.GetNodeCount();
+	printf("%d node(s), %d level(s) deep\n", count, lHierarchy.maxDepth);
+	if (!count)
+		return;
+
+	vector<float> lPose, lGlobals((size_t)count * 16);
+	GetDefaultPose(lHierarchy, lPose);
+	EvaluateGlobalTransforms(lHierarchy, &lPose[0], &lGlobals[0]);
+
+	int bones = 0;
+	double bindError = 0.0;
+	for (int i = 0; i < count; i++)
+	{
+		for (size_t c = 0; c < lScene.clusters.size(); c++)
+		{
+			if (lScene.clusters[c].link != lHierarchy.nodes[i])
+				continue;
+			for (int k = 0; k < 16; k++)
+				bindError = max(bindError, fabs(lScene.clusters[c].transformLink[k] - lGlobals[(size_t)i * 16 + k]));
+			bones++;
+			break;
+		}
+	}
+	if (bones)
+		printf("default pose of %d bone(s) against their bind matrices: largest difference %g\n", bones, bindError);
+
+	if (lBaked.empty() || !lBaked[0].frameCount)
+		return;
+	const BakedAnimation& lAnimation = lBaked[0];
+	vector<int> lMap;
+	MapAnimatedNodes(lHierarchy, lAnimation, lMap);
+	vector<float> lSingle((size_t)count * 16);
+	double sweepSeconds = 0.0, nodeSeconds = 0.0, difference = 0.0;
+	for (int f = 0; f < lAnimation.frameCount; f++)
+	{
+		ApplyBakedFrame(lAnimation, lMap, f, &lPose[0]);
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		EvaluateGlobalTransforms(lHierarchy, &lPose[0], &lGlobals[0]);
+		chrono::steady_clock::time_point middle = chrono::steady_clock::now();
+		for (int i = 0; i < count; i++)
+			EvaluateGlobalTransform(lHierarchy, &lPose[0], i, &lSingle[(size_t)i * 16]);
+		chrono::steady_clock::time_point end = chrono::steady_clock::now();
+		sweepSeconds += chrono::duration<double>(middle - start).count();
+		nodeSeconds += chrono::duration<double>(end - middle).count();
+		for (size_t k = 0; k < lGlobals.size(); k++)
+			difference = max(difference, (double)fabs(lGlobals[k] - lSingle[k]));
+	}
+	printf("%s: %d frame(s), one sweep %.3f ms, node by node %.3f ms (%.1fx), largest difference %g\n",
+		lAnimation.name.c_str(), lAnimation.frameCount, sweepSeconds * 1000.0, nodeSeconds * 1000.0,
+		sweepSeconds > 0.0 ? nodeSeconds / sweepSeconds : 0.0, difference);
+}
+
+/**
+* List the files embedded in the document, as views into it, with the
+* textures that show each. Only with extract are they written out, into
+* "<file>.fbm" next to the FBX as the SDK would.
+*/
+void PrintEmbeddedMedia(const Scene& lScene, const string& filename, bool extract)
+{
+	printf("\n---Embedded Media Informations---\n");
+	vector<const Video*> lMedia;
+	CollectEmbeddedMedia(lScene, lMedia);
+	size_t bytes = 0;
+	for (size_t i = 0; i < lMedia.size(); i++) {
+		const Video* pVideo = lMedia[i];
+		int users = 0;
+		for (size_t t = 0; t < lScene.textures.size(); t++)
+			users += FindEmbeddedMedia(lScene, lScene.textures[t]) == pVideo;
+		printf("%s: %s, %lu bytes, %d texture(s)\n", pVideo->name.c_str(), GetMediaFileName(*pVideo, (int)i + 1).c_str(),
+			(unsigned long)pVideo->contentSize, users);
+		bytes += pVideo->contentSize;
+	}
+	int found = 0;
+	for (size_t t = 0; t < lScene.textures.size(); t++)
+		found += FindEmbeddedMedia(lScene, lScene.textures[t]) != NULL;
+	printf("%d embedded file(s), %lu bytes; %d of %d texture(s) embedded\n", (int)lMedia.size(), (unsigned long)bytes,
+		found, (int)lScene.textures.size());
+
+	if (!extract)
+		return;
+	size_t dot = filename.find_last_of('.');
+	size_t slash = filename.find_last_of("/\\");
+	string directory = (dot != string::npos && (slash == string::npos || dot > slash) ? filename.substr(0, dot) : filename) + ".fbm";
+	vector<string> lWritten;
+	string lError;
+	if (!ExtractEmbeddedMedia(lMedia, directory, lWritten, lError))
+		printf("Error returned: %s\n", lError.c_str());
+	for (size_t i = 0; i < lWritten.size(); i++)
+		printf("-> %s\n", lWritten[i].c_str());
+}
+
+/**
+* Resolve every texture against the FBX's folder, its .fbm folder and the
+* folders listed in FBX_LOADER_TEXTURE_PATHS (separated by ';'), read the
+* images found in parallel, and list the ones that are nowhere.
+*/
+void PrintTextures(const Scene& lScene, const string& filename)
+{
+	printf("\n---Texture Informations---\n");
+	TextureResolver lResolver;
+	size_t slash = filename.find_last_of("/\\");
+	lResolver.AddSearchRoot(slash == string::npos ? string(".") : filename.substr(0, slash));
+	size_t dot = filename.find_last_of('.');
+	lResolver.AddSearchRoot((dot != string::npos && (slash == string::npos || dot > slash) ? filename.substr(0, dot) : filename) + ".fbm");
+	if (const char* paths = getenv("FBX_LOADER_TEXTURE_PATHS")) {
+		string lPaths = paths;
+		for (size_t start = 0; start <= lPaths.size(); ) {
+			size_t end = lPaths.find(';', start);
+			if (end == string::npos)
+				end = lPaths.size();
+			if (end > start)
+				lResolver.AddSearchRoot(lPaths.substr(start, end - start));
+			start = end + 1;
+		}
+	}
+
+	ThreadPool lPool;
+	vector<ResolvedTexture> lTextures;
+	vector<TextureFile> lFiles;
+	TextureResolveStats stats = ResolveSceneTextures(lScene, lResolver, lPool, lTextures, lFiles);
+	for (size_t i = 0; i < lTextures.size(); i++) {
+		const ResolvedTexture& lTexture = lTextures[i];
+		if (lTexture.source == eTextureFile)
+			printf("%s: %s\n", lTexture.texture->name.c_str(), lTexture.path.c_str());
+		else if (lTexture.source == eTextureEmbedded)
+			printf("%s: embedded (%s)\n", lTexture.texture->name.c_str(), lTexture.video->name.c_str());
+		else
+			printf("%s: missing '%s' ('%s')\n", lTexture.texture->name.c_str(), lTexture.texture->fileName.c_str(),
+				lTexture.texture->relativeFileName.c_str());
+	}
+	size_t unreadable = 0;
+	for (size_t i = 0; i < lFiles.size(); i++)
+		unreadable += !lFiles[i].ok;
+	printf("%d texture(s): %d file(s) on disk, %d embedded, %d missing\n", (int)stats.textureCount,
+		(int)stats.fileCount, (int)stats.embeddedCount, (int)stats.missingCount);
+	printf("resolved in %.3f ms: %lu candidate path(s) against %lu directory listing(s) in %d root(s)\n",
+		stats.resolveSeconds * 1000.0, (unsigned long)stats.candidateCount, (unsigned long)stats.directoryCount,
+		(int)lResolver.GetSearchRoots().size());
+	printf("prefetched %.2f MB in %.3f ms on %d thread(s)", stats.bytes / (1024.0 * 1024.0),
+		stats.prefetchSeconds * 1000.0, stats.threadCount);
+	if (unreadable)
+		printf(", %d file(s) could not be read", (int)unreadable);
+	printf("\n");
+}
+
+/**
+* Merge the scene's materials into the flat material table and list it,
+* then group every mesh's triangles by material and list the draw calls
+* that leaves, each with the material the mesh's first node has in its
+* slot. Material switches count how often the material changes from one
+* polygon to the next in file order, which is what drawing the mesh as
+* triangulated would cost.
+*/
+void PrintMaterials(const Scene& lScene)
+{
+	static const char* const kShadingNames[] = { "other", "lambert", "phong" };
+	printf("\n---Material Informations---\n");
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	MaterialTable lTable;
+	BuildMaterialTable(lScene, lTable);
+	double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	for (size_t i = 0; i < lTable.materials.size(); i++) {
+		const FlatMaterial& m = lTable.materials[i];
+		printf("%d %s (%s): diffuse (%g %g %g) x %g, ambient (%g %g %g) x %g, emissive (%g %g %g) x %g",
+			(int)i, lTable.sources[i]->name.c_str(), kShadingNames[m.shadingModel], m.diffuse[0], m.diffuse[1],
+			m.diffuse[2], m.diffuseFactor, m.ambient[0], m.ambient[1], m.ambient[2], m.ambientFactor, m.emissive[0],
+			m.emissive[1], m.emissive[2], m.emissiveFactor);
+		if (m.shadingModel == eShadingPhong)
+			printf(", specular (%g %g %g) x %g, shininess %g", m.specular[0], m.specular[1], m.specular[2],
+				m.specularFactor, m.shininess);
+		printf(", transparency %g\n", m.transparencyFactor);
+		for (int c = 0; c < kMaterialTextureSlots; c++) {
+			if (m.textures[c] >= 0)
+				printf("\t%s: texture %d '%s'\n", GetTextureSlotName(c), m.textures[c],
+					lTable.textures[m.textures[c]]->fileName.c_str());
+		}
+	}
+	size_t textureUses = 0;
+	for (size_t i = 0; i < lScene.materials.size(); i++) {
+		for (int c = 0; c < kMaterialTextureSlots; c++)
+			textureUses += !lScene.materials[i].textures[LayerElement::eTextureDiffuse + c].empty();
+	}
+	printf("%d material(s) merged into %d, %d texture binding(s) into %d texture(s), in %.3f ms\n",
+		(int)lScene.materials.size(), (int)lTable.materials.size(), (int)textureUses, (int)lTable.textures.size(),
+		seconds * 1000.0);
+
+	ThreadPool lPool;
+	vector<MeshJob> lJobs;
+	CollectMeshJobs(lScene, lJobs);
+	PipelineOptions lOptions;
+	lOptions.format = eMeshTextNone;
+	lOptions.materials = &lTable;
+	PipelineStats stats = RunMeshPipeline(lJobs, lPool, lOptions);
+	size_t switches = 0;
+	vector<int> lNodeMaterials;
+	for (size_t i = 0; i < lJobs.size(); i++) {
+		const MeshJob& lJob = lJobs[i];
+		const vector<int>& lPolygonMaterials = lJob.polygonMaterials;
+		size_t runs = lJob.triangles.empty() ? 0 : 1;
+		for (size_t p = 1; p < lPolygonMaterials.size(); p++)
+			runs += lPolygonMaterials[p] != lPolygonMaterials[p - 1];
+		switches += runs;
+		if (!lJob.nodes.empty())
+			GetNodeMaterials(lTable, *lJob.nodes[0], lNodeMaterials);
+		else
+			lNodeMaterials.clear();
+		printf("%s: %lu triangles, %lu material switch(es) -> %lu draw call(s)\n",
+			lJob.nodes.empty() ? "mesh" : lJob.nodes[0]->name.c_str(), (unsigned long)lJob.triangles.size() / 3,
+			(unsigned long)runs, (unsigned long)lJob.materialRanges.size());
+		for (size_t r = 0; r < lJob.materialRanges.size(); r++) {
+			const MaterialRange& lRange = lJob.materialRanges[r];
+			const int material = lRange.slot < (int)lNodeMaterials.size() ? lNodeMaterials[lRange.slot] : -1;
+			printf("\tslot %d -> material %d %s: indices %u..%u, %u triangles\n", lRange.slot, material,
+				material >= 0 ? lTable.sources[material]->name.c_str() : "(none)", lRange.firstIndex,
+				lRange.firstIndex + lRange.indexCount, lRange.indexCount / 3);
+		}
+	}
+	printf("%d mesh(es), %lu triangles: %lu material switch(es) in file order -> %lu draw call(s)\n",
+		(int)stats.meshCount, (unsigned long)stats.triangleCount, (unsigned long)switches,
+		(unsigned long)stats.rangeCount);
+}
+
+void PrintInflateStats(const InflateStats& stats)
+{
+	printf("\n---Inflate Informations---\n");
+	printf("%d compressed array(s), %lu -> %lu bytes, %.3f ms on %d thread(s)\n",
+		(int)stats.arrayCount, (unsigned long)stats.compressedBytes, (unsigned long)stats.inflatedBytes,
+		stats.seconds * 1000.0, stats.threadCount);
+	if (stats.failedCount)
+		printf("%d array(s) failed to inflate\n", (int)stats.failedCount);
+}
+
+/**
+* Weld every mesh into a vertex and index buffer and report how much the
+* welding saved.
+*/
+void PrintWeldStats(const Scene& lScene)
+{
+	printf("\n---Weld Informations---\n");
+	size_t totalPolygonVertices = 0;
+	size_t totalVertices = 0;
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	for (size_t i = 0; i < lScene.nodes.size(); i++)
+	{
+		const Node* pNode = &lScene.nodes[i];
+		for (size_t j = 0; j < pNode->attributes.size(); j++)
+		{
+			const Mesh* pMesh = pNode->attributes[j]->mesh;
+			if (!pMesh)
+				continue;
+			MeshStreamsF lStreams;
+			ExtractMeshStreams(*pMesh, lStreams);
+			IndexedMeshF lIndexed;
+			BuildIndexedMesh(lStreams, lIndexed);
+			printf("%s: %d polygon vertices -> %d vertices (ratio %.3f), %d-bit indices\n",
+				pNode->name.c_str(), lIndexed.GetIndexCount(), lIndexed.GetVertexCount(),
+				lIndexed.GetDedupRatio(), lIndexed.GetIndexSize() * 8);
+			totalPolygonVertices += lIndexed.GetIndexCount();
+			totalVertices += lIndexed.GetVertexCount();
+		}
+	}
+	double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	printf("total: %lu polygon vertices -> %lu vertices (ratio %.3f), %.3f ms\n",
+		(unsigned long)totalPolygonVertices, (unsigned long)totalVertices,
+		totalPolygonVertices ? (double)totalVertices / totalPolygonVertices : 1.0, seconds * 1000.0);
+}
+
+/**
+* Read FBX_LOADER_TARGET_AXES, "up,front,side,unit" with each axis a sign
+* and a letter and the unit in centimetres ("+z,-y,+x,100" is the default,
+* Z up in metres), into pAxes and pUnit.
+*/
+bool ParseTargetAxes(const char* pText, AxisSystem& pAxes, double& pUnit)
+{
+	int axes[3], signs[3];
+	const char* p = pText;
+	for (int i = 0; i < 3; i++) {
+		if ((*p != '+' && *p != '-') || p[1] < 'x' || p[1] > 'z' || p[2] != ',')
+			return false;
+		signs[i] = *p == '-' ? -1 : 1;
+		axes[i] = p[1] - 'x';
+		p += 3;
+	}
+	char* end;
+	pUnit = strtod(p, &end);
+	if (end == p)
+		return false;
+	pAxes = AxisSystem(axes[0], signs[0], axes[1], signs[1], axes[2], signs[2]);
+	return true;
+}
+
+const char* FormatAxis(int pAxis, int pSign, char* pOut)
+{
+	pOut[0] = pSign < 0 ? '-' : '+';
+	pOut[1] = (char)('X' + pAxis);
+	pOut[2] = 0;
+	return pOut;
+}
+
+void PrintAxisSystem(const char* pLabel, const AxisSystem& pAxes, double pUnit)
+{
+	char up[3], front[3], side[3];
+	printf("%s: up %s, front %s, side %s, %g cm per unit\n", pLabel, FormatAxis(pAxes.upAxis, pAxes.upSign, up),
+		FormatAxis(pAxes.frontAxis, pAxes.frontSign, front), FormatAxis(pAxes.coordAxis, pAxes.coordSign, side), pUnit);
+}
+
+/**
+* Work out the conversion from the file's axis system and unit to the
+* target's, time it on every welded mesh, and check it on the node tree:
+* the converted hierarchy, evaluated on converted poses (every frame of the
+* first baked animation stack, or the default pose), has to give C * G * C^-1
+* for every global matrix G of the original.
+*/
+bool PrintAxisConversion(const Scene& lScene, const vector<BakedAnimation>& lBaked, AxisConversion& lConversion)
+{
+	printf("\n---Axis Conversion Informations---\n");
+	AxisSystem lTarget = kZUpAxisSystem;
+	double targetUnit = kCentimetersPerMeter;
+	const char* target = getenv("FBX_LOADER_TARGET_AXES");
+	if (target && !ParseTargetAxes(target, lTarget, targetUnit))
+		printf("FBX_LOADER_TARGET_AXES '%s' not understood, using +z,-y,+x,100\n", target);
+	PrintAxisSystem("file", lScene.axisSystem, lScene.unitScale);
+	PrintAxisSystem("target", lTarget, targetUnit);
+	if (!GetAxisConversion(lScene.axisSystem, lScene.unitScale, lTarget, targetUnit, lConversion)) {
+		printf("no conversion between these axis systems\n");
+		return false;
+	}
+	const float* m = lConversion.matrix;
+	printf("matrix (%g %g %g) (%g %g %g) (%g %g %g), handedness %s\n", m[0], m[3], m[6], m[1], m[4], m[7], m[2], m[5],
+		m[8], lConversion.flipsHandedness ? "flipped, winding reversed" : "kept");
+
+	ThreadPool lPool;
+	vector<MeshJob> lJobs;
+	CollectMeshJobs(lScene, lJobs);
+	PipelineOptions lOptions;
+	lOptions.format = eMeshTextNone;
+	lOptions.optimize = false;
+	RunMeshPipeline(lJobs, lPool, lOptions);
+	size_t vertices = 0, bytes = 0;
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	for (size_t i = 0; i < lJobs.size(); i++) {
+		const IndexedMeshF& mesh = lJobs[i].indexed;
+		vertices += mesh.GetVertexCount();
+		bytes += (mesh.positions.size() + mesh.normals.size() + mesh.tangents.size() + mesh.binormals.size()) * sizeof(float);
+		ConvertIndexedMesh(lConversion, lJobs[i].indexed, lJobs[i].triangles);
+	}
+	double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	printf("%d mesh(es), %lu vertices, %.2f MB converted in %.3f ms (%.0f MB/s)\n", (int)lJobs.size(),
+		(unsigned long)vertices, bytes / (1024.0 * 1024.0), seconds * 1000.0,
+		seconds > 0.0 ? bytes / (1024.0 * 1024.0) / seconds : 0.0);
+
+	FlatHierarchy lHierarchy, lConverted;
+	BuildFlatHierarchy(lScene, lHierarchy);
+	const int count = lHierarchy.GetNodeCount();
+	if (!count)
+		return true;
+	lConverted = lHierarchy;
+	ConvertFlatHierarchy(lConversion, lConverted);
+
+	BakedAnimation lAnimation;
+	if (!lBaked.empty())
+		lAnimation = lBaked[0];
+	BakedAnimation lConvertedAnimation = lAnimation;
+	start = chrono::steady_clock::now();
+	ConvertBakedAnimation(lConversion, lConvertedAnimation);
+	seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	vector<int> lMap;
+	MapAnimatedNodes(lHierarchy, lAnimation, lMap);
+
+	vector<float> lPose, lConvertedPose, lGlobals((size_t)count * 16), lConvertedGlobals((size_t)count * 16);
+	GetDefaultPose(lHierarchy, lPose);
+	lConvertedPose = lPose;
+	ConvertPose(lConversion, &lConvertedPose[0], count);
+	double difference = 0.0;
+	const int frames = max(lAnimation.frameCount, 1);
+	for (int f = 0; f < frames; f++) {
+		if (lAnimation.frameCount) {
+			ApplyBakedFrame(lAnimation, lMap, f, &lPose[0]);
+			ApplyBakedFrame(lConvertedAnimation, lMap, f, &lConvertedPose[0]);
+		}
+		EvaluateGlobalTransforms(lHierarchy, &lPose[0], &lGlobals[0]);
+		EvaluateGlobalTransforms(lConverted, &lConvertedPose[0], &lConvertedGlobals[0]);
+		for (int i = 0; i < count; i++) {
+			ConvertMatrix(lConversion, &lGlobals[(size_t)i * 16]);
+			for (int k = 0; k < 16; k++)
+				difference = max(difference, (double)fabs(lGlobals[(size_t)i * 16 + k] - lConvertedGlobals[(size_t)i * 16 + k]));
+		}
+	}
+	if (lAnimation.frameCount)
+		printf("%s: %d node(s), %d frame(s) converted in %.3f ms\n", lAnimation.name.c_str(),
+			(int)lAnimation.nodes.size(), lAnimation.frameCount, seconds * 1000.0);
+	printf("%d node(s) over %d frame(s): converted globals differ from C * G * C^-1 by at most %g\n", count, frames,
+		difference);
+	return true;
+}
+
+/**
+* Run every mesh through the parallel pipeline and write the results, in
+* scene order, to an OBJ file (with its materials in an MTL library) and/or
+* a baked file. With lods, each mesh also gets the levels of detail listed
+* in FBX_LOADER_LOD_RATIOS (triangle fractions separated by commas,
+* 0.5,0.25,0.12 by default). Vertices, and the transforms of the baked
+* nodes, are converted by lConversion. With embedMedia, the baked file
+* carries the files embedded in the FBX.
+*/
+void ExportMeshes(const Scene& lScene, const string& filename, bool obj, bool bake, bool lods,
+	const AxisConversion& lConversion, bool embedMedia)
+{
+	ThreadPool lPool;
+	vector<MeshJob> lJobs;
+	CollectMeshJobs(lScene, lJobs);
+	MaterialTable lTable;
+	BuildMaterialTable(lScene, lTable);
+	PipelineOptions lOptions;
+	lOptions.format = obj ? eMeshTextObj : eMeshTextNone;
+	lOptions.conversion = lConversion;
+	lOptions.materials = &lTable;
+	if (lods) {
+		const char* ratios = getenv("FBX_LOADER_LOD_RATIOS");
+		if (ratios) {
+			for (const char* p = ratios; *p; ) {
+				char* end;
+				float ratio = (float)strtod(p, &end);
+				if (end == p)
+					break;
+				if (ratio > 0.0f && ratio < 1.0f)
+					lOptions.lodRatios.push_back(ratio);
+				p = *end == ',' ? end + 1 : end;
+			}
+		}
+		else
+			lOptions.lodRatios.assign(kDefaultLodRatios, kDefaultLodRatios + sizeof(kDefaultLodRatios) / sizeof(kDefaultLodRatios[0]));
+	}
+	PipelineStats stats = RunMeshPipeline(lJobs, lPool, lOptions);
+
+	printf("\n---Mesh Pipeline Informations---\n");
+	printf("%d mesh(es), %lu vertices, %lu triangles, %.3f ms on %d thread(s)\n",
+		(int)stats.meshCount, (unsigned long)stats.vertexCount, (unsigned long)stats.triangleCount,
+		stats.seconds * 1000.0, stats.threadCount);
+	if (stats.failedCount)
+		printf("%d mesh(es) had arrays that failed to decode\n", (int)stats.failedCount);
+	printf("%lu draw call(s), one per material range\n", (unsigned long)stats.rangeCount);
+	printf("vertex cache (FIFO %d): ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n", kVertexCacheSize,
+		stats.cacheBefore.GetACMR(), stats.cacheAfter.GetACMR(), stats.cacheBefore.GetATVR(), stats.cacheAfter.GetATVR());
+	if (lods) {
+		printf("levels of detail: %lu triangles in all\n", (unsigned long)stats.lodTriangleCount);
+		for (size_t i = 0; i < lJobs.size(); i++) {
+			const MeshJob& lJob = lJobs[i];
+			printf("%s: %lu", lJob.nodes.empty() ? "mesh" : lJob.nodes[0]->name.c_str(),
+				(unsigned long)lJob.triangles.size() / 3);
+			for (size_t l = 0; l < lJob.lods.size(); l++)
+				printf(" -> %lu (error %g)", (unsigned long)lJob.lods[l].triangles.size() / 3, lJob.lods[l].error);
+			printf(" triangles\n");
+		}
+	}
+
+	if (obj) {
+		// The materials go to a library next to the OBJ file, which names it
+		// on its first line.
+		string objFile = filename + ".obj";
+		string mtlFile = filename + ".mtl";
+		string lLibrary, lHeader;
+		if (!lTable.materials.empty()) {
+			size_t slash = mtlFile.find_last_of("/\\");
+			lHeader = "mtllib " + mtlFile.substr(slash == string::npos ? 0 : slash + 1) + "\n";
+			SerializeMtl(lTable, lLibrary);
+			FILE* lMtl = fopen(mtlFile.c_str(), "wb");
+			if (lMtl) {
+				fwrite(lLibrary.data(), 1, lLibrary.size(), lMtl);
+				fclose(lMtl);
+				printf("%lu bytes -> %s (%d material(s))\n", (unsigned long)lLibrary.size(), mtlFile.c_str(),
+					(int)lTable.materials.size());
+			}
+			else
+				printf("cannot write '%s'\n", mtlFile.c_str());
+		}
+		FILE* lObj = fopen(objFile.c_str(), "wb");
+		if (lObj) {
+			fwrite(lHeader.data(), 1, lHeader.size(), lObj);
+			for (size_t i = 0; i < lJobs.size(); i++)
+				fwrite(lJobs[i].output.data(), 1, lJobs[i].output.size(), lObj);
+			fclose(lObj);
+			printf("%lu bytes -> %s\n", (unsigned long)(lHeader.size() + stats.outputBytes), objFile.c_str());
+		}
+		else
+			printf("cannot write '%s'\n", objFile.c_str());
+	}
+
+	if (bake) {
+		string bakedFile = filename + ".bake";
+		string lError;
+		if (!WriteBakedScene(lScene, lJobs, bakedFile.c_str(), lError, embedMedia, lConversion)) {
+			printf("Error returned: %s\n", lError.c_str());
+			return;
+		}
+
+		// Load it back the way a runtime would, to show what a cold start costs.
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		BakedScene lBaked;
+		if (!lBaked.Load(bakedFile.c_str())) {
+			printf("Error returned: %s\n", lBaked.GetError().c_str());
+			return;
+		}
+		double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+		printf("%lu bytes -> %s (%d node(s), %d mesh(es), %d material(s), %d embedded file(s)), loaded in %.3f ms\n",
+			(unsigned long)lBaked.GetHeader().fileSize, bakedFile.c_str(), lBaked.GetNodeCount(),
+			lBaked.GetMeshCount(), lBaked.GetMaterialCount(), lBaked.GetMediaCount(), seconds * 1000.0);
+	}
+}
+
+/**
+* Dump the whole scene, every array in full, to a JSON or CBOR file for
+* tools that would rather not parse the text dump.
+*/
+void DumpSceneFile(const Scene& lScene, const string& dumpFile, bool cbor)
+{
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	FILE* lFile = fopen(dumpFile.c_str(), "wb");
+	if (!lFile) {
+		printf("cannot write '%s'\n", dumpFile.c_str());
+		return;
+	}
+	bool ok;
+	{
+		FileSink lSink(lFile);
+		TextWriter lOut(lSink);
+		if (cbor) {
+			CborEncoder lEncoder(lOut);
+			DumpScene(lScene, lEncoder);
+		}
+		else {
+			JsonEncoder lEncoder(lOut);
+			DumpScene(lScene, lEncoder);
+		}
+		ok = lOut.Flush();
+	}
+	long size = ftell(lFile);
+	ok = fclose(lFile) == 0 && ok;
+	double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	if (ok)
+		printf("%ld bytes -> %s, %.3f ms\n", size, dumpFile.c_str(), seconds * 1000.0);
+	else
+		printf("cannot write '%s'\n", dumpFile.c_str());
+}
+
+/**
+* Record visitor that only tallies what the file contains, without decoding
+* arrays or keeping anything, so it runs at the speed the file can be read.
+*/
+class CountVisitor : public RecordVisitor
+{
+public:
+	CountVisitor() : records(0), properties(0), arrays(0), compressedArrays(0),
+		arrayElements(0), arrayBytes(0), maxDepth(0) {}
+
+	virtual bool BeginRecord(const StringRef&, size_t, int pDepth)
+	{
+		++records;
+		if (pDepth > maxDepth)
+			maxDepth = pDepth;
+		return true;
+	}
+
+	virtual void OnProperty(const Property&)
+	{
+		++properties;
+	}
+
+	virtual void OnArray(const Property& pProperty)
+	{
+		++arrays;
+		if (pProperty.encoding == 1)
+			++compressedArrays;
+		arrayElements += pProperty.arrayCount;
+		arrayBytes += pProperty.size;
+	}
+
+	size_t records;
+	size_t properties;
+	size_t arrays;
+	size_t compressedArrays;
+	size_t arrayElements;
+	size_t arrayBytes;
+	int maxDepth;
+};
+
+int CountRecords(const string& filename)
+{
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	CountVisitor lCounter;
+	string lError;
+	if (!VisitFile(filename.c_str(), lCounter, lError)) {
+		printf("Call to VisitFile() failed.\n");
+		printf("Error returned: %s\n\n", lError.c_str());
+		return -1;
+	}
+	double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+	MappedFile lFile;
+	double megabytes = lFile.Open(filename.c_str()) ? lFile.GetSize() / (1024.0 * 1024.0) : 0.0;
+
+	printf("---Record Counts---\n");
+	printf("records: %lu (max depth %d)\n", (unsigned long)lCounter.records, lCounter.maxDepth);
+	printf("values: %lu\n", (unsigned long)lCounter.properties);
+	printf("arrays: %lu (%lu compressed), %lu elements, %lu payload bytes\n",
+		(unsigned long)lCounter.arrays, (unsigned long)lCounter.compressedArrays,
+		(unsigned long)lCounter.arrayElements, (unsigned long)lCounter.arrayBytes);
+	printf("%.2f MB in %.3f ms, %.1f MB/s\n", megabytes, seconds * 1000.0,
+		seconds > 0.0 ? megabytes / seconds : 0.0);
+	return 0;
+}
+
+/**
+* Convert every file named by spec (a directory, a wildcard pattern or an
+* @list file) and report per-file results and overall throughput.
+*/
+int RunBatchMode(const string& spec, bool useCache)
+{
+	vector<string> lFiles;
+	string lError;
+	if (!CollectBatchInputs(spec, lFiles, lError)) {
+		printf("Error returned: %s\n", lError.c_str());
+		return -1;
+	}
+
+	// The cache lives in FBX_LOADER_CACHE (default ./fbx_cache) and is kept
+	// under FBX_LOADER_CACHE_MB megabytes (default 1024).
+	ConversionCache lCache;
+	if (useCache) {
+		const char* dir = getenv("FBX_LOADER_CACHE");
+		const char* megabytes = getenv("FBX_LOADER_CACHE_MB");
+		uint64_t limit = (uint64_t)(megabytes ? atoi(megabytes) : 1024) * 1024 * 1024;
+		if (!lCache.Open(dir ? dir : "fbx_cache", limit)) {
+			printf("Error returned: %s\n", lCache.GetError().c_str());
+			return -1;
+		}
+	}
+
+	ThreadPool lPool;
+	vector<BatchResult> lResults;
+	BatchStats stats = RunBatch(lFiles, lPool, lResults, useCache ? &lCache : NULL);
+
+	printf("---Batch Informations---\n");
+	for (size_t i = 0; i < lResults.size(); i++)
+	{
+		const BatchResult& r = lResults[i];
+		if (r.ok && r.cached)
+			printf("%s: cached, %.3f ms\n", r.input.c_str(), r.seconds * 1000.0);
+		else if (r.ok)
+			printf("%s: %d mesh(es), %lu triangles, %.3f ms\n", r.input.c_str(), (int)r.meshCount,
+				(unsigned long)r.triangleCount, r.seconds * 1000.0);
+		else
+			printf("%s: failed: %s\n", r.input.c_str(), r.error.c_str());
+	}
+	double megabytes = stats.bytes / (1024.0 * 1024.0);
+	printf("%d file(s), %d failed, %.2f MB in %.3f ms on %d thread(s)\n", (int)stats.fileCount,
+		(int)stats.failedCount, megabytes, stats.seconds * 1000.0, stats.threadCount);
+	printf("%.1f files/s, %.1f MB/s\n", stats.seconds > 0.0 ? stats.fileCount / stats.seconds : 0.0,
+		stats.seconds > 0.0 ? megabytes / stats.seconds : 0.0);
+	if (useCache) {
+		lCache.Flush();
+		CacheStats lCacheStats = lCache.GetStats();
+		printf("cache: %lu hit(s), %lu miss(es), %lu stored, %lu evicted, %lu entries, %.2f MB\n",
+			(unsigned long)lCacheStats.hits, (unsigned long)lCacheStats.misses, (unsigned long)lCacheStats.stores,
+			(unsigned long)lCacheStats.evictions, (unsigned long)lCacheStats.entries,
+			lCacheStats.bytes / (1024.0 * 1024.0));
+	}
+	return stats.failedCount ? 1 : 0;
+}
+
 int main(int argc, char* argv[])
 {
 	string filename = "zhankuang.fbx";
 	bool detail = false;
+	bool countOnly = false;
+	bool weld = false;
+	bool exportMeshes = false;
+	bool batch = false;
+	bool bake = false;
+	bool useCache = false;
+	bool json = false;
+	bool bakeAnimation = false;
+	bool cbor = false;
+	bool compressAnimation = false;
+	bool skinning = false;
+	bool blendShapes = false;
+	bool lods = false;
+	bool globals = false;
+	bool convert = false;
+	bool media = false;
+	bool extractMedia = false;
+	bool textures = false;
+	bool materials = false;
 	for (int i = 1; i < argc; i++)
 	{
 		if (argv[i][0] == '-')
@@ -232,6 +1256,83 @@ int main(int argc, char* argv[])
 				{
 					detail = true;
 				}
+				else if (argv[i][j] == 'c' || argv[i][j] == 'C')
+				{
+					countOnly = true;
+				}
+				else if (argv[i][j] == 'w' || argv[i][j] == 'W')
+				{
+					weld = true;
+				}
+				else if (argv[i][j] == 'm' || argv[i][j] == 'M')
+				{
+					exportMeshes = true;
+				}
+				else if (argv[i][j] == 'b' || argv[i][j] == 'B')
+				{
+					batch = true;
+				}
+				else if (argv[i][j] == 'k' || argv[i][j] == 'K')
+				{
+					bake = true;
+				}
+				else if (argv[i][j] == 'r' || argv[i][j] == 'R')
+				{
+					useCache = true;
+				}
+				else if (argv[i][j] == 'a' || argv[i][j] == 'A')
+				{
+					bakeAnimation = true;
+				}
+				else if (argv[i][j] == 'z' || argv[i][j] == 'Z')
+				{
+					compressAnimation = true;
+				}
+				else if (argv[i][j] == 's' || argv[i][j] == 'S')
+				{
+					skinning = true;
+				}
+				else if (argv[i][j] == 'h' || argv[i][j] == 'H')
+				{
+					blendShapes = true;
+				}
+				else if (argv[i][j] == 'l' || argv[i][j] == 'L')
+				{
+					lods = true;
+				}
+				else if (argv[i][j] == 'g' || argv[i][j] == 'G')
+				{
+					globals = true;
+				}
+				else if (argv[i][j] == 'x' || argv[i][j] == 'X')
+				{
+					convert = true;
+				}
+				else if (argv[i][j] == 'e' || argv[i][j] == 'E')
+				{
+					media = true;
+				}
+				else if (argv[i][j] == 'f' || argv[i][j] == 'F')
+				{
+					media = true;
+					extractMedia = true;
+				}
+				else if (argv[i][j] == 't' || argv[i][j] == 'T')
+				{
+					textures = true;
+				}
+				else if (argv[i][j] == 'u' || argv[i][j] == 'U')
+				{
+					materials = true;
+				}
+				else if (argv[i][j] == 'j' || argv[i][j] == 'J')
+				{
+					json = true;
+				}
+				else if (argv[i][j] == 'n' || argv[i][j] == 'N')
+				{
+					cbor = true;
+				}
 			}
 		}
 		else
@@ -239,31 +1340,92 @@ int main(int argc, char* argv[])
 			filename = argv[i];
 		}
 	}
+	if (batch)
+		return RunBatchMode(filename, useCache);
+
 	string outfile = filename + ".txt";
 	freopen(outfile.c_str(), "w", stdout);
 
-	FbxManager* lSdkManager = FbxManager::Create();
-	FbxIOSettings *ios = FbxIOSettings::Create(lSdkManager, IOSROOT);
-	lSdkManager->SetIOSettings(ios);
-	FbxImporter* lImporter = FbxImporter::Create(lSdkManager, "");
+	if (countOnly)
+		return CountRecords(filename);
 
-	if (!lImporter->Initialize(filename.c_str(), -1, lSdkManager->GetIOSettings())) {
-		printf("Call to FbxImporter::Initialize() failed.\n");
-		printf("Error returned: %s\n\n", lImporter->GetStatus().GetErrorString());
+	Document lDocument;
+	if (!lDocument.Load(filename.c_str())) {
+		printf("Call to Document::Load() failed.\n");
+		printf("Error returned: %s\n\n", lDocument.GetError().c_str());
 		exit(-1);
 	}
 
-	FbxScene* lScene = FbxScene::Create(lSdkManager, "myScene");
-	lImporter->Import(lScene);
-	lImporter->Destroy();
+	// A detail dump, a JSON/CBOR dump, a mesh export or LOD build, an
+	// animation bake, a skinning run, a blend shape extraction, a global
+	// transform run, an axis conversion or a material grouping reads every
+	// array, so inflate them all up front in parallel; otherwise leave them
+	// to the lazy views. Whenever they were inflated, what that took is
+	// reported at the end.
+	InflateStats lInflateStats;
+	bool inflateAll = detail || exportMeshes || bake || lods || json || cbor || bakeAnimation || compressAnimation ||
+		skinning || blendShapes || globals || convert || materials;
+	if (inflateAll) {
+		ThreadPool lPool;
+		lInflateStats = lDocument.InflateArrays(lPool);
+	}
 
-	FbxNode* lRootNode = lScene->GetRootNode();
-	if (lRootNode) {
-		for (int i = 0; i < lRootNode->GetChildCount(); i++)
-			PrintNode(lRootNode->GetChild(i), detail);
+	Scene lScene;
+	if (!BuildScene(lDocument, lScene)) {
+		printf("File has no Objects section; FBX versions before 7.0 are not supported.\n");
+		exit(-1);
+	}
+
+	// The dump can run to millions of lines, so it goes through one large
+	// buffer rather than a printf per value.
+	{
+		FileSink lSink(stdout);
+		TextWriter lOut(lSink);
+		const Node* lRootNode = &lScene.root;
+		for (size_t i = 0; i < lRootNode->children.size(); i++)
+			PrintNode(lOut, lRootNode->children[i], detail);
+		PrintAnimation(lOut, lScene, detail);
+	}
+	// Every stack is baked once, one per thread, at the document's frame
+	// rate (30 fps if it has none), for all the reports that need it.
+	vector<BakedAnimation> lBaked;
+	AnimBakeStats lBakeStats = AnimBakeStats();
+	if (bakeAnimation || compressAnimation || globals || convert) {
+		ThreadPool lPool;
+		lBakeStats = BakeAnimStacks(lScene, lScene.frameRate > 0.0 ? lScene.frameRate : 30.0, lPool, lBaked);
+	}
+	if (bakeAnimation)
+		PrintAnimationBake(lScene, lBaked, lBakeStats);
+	if (compressAnimation)
+		PrintAnimationCompression(lBaked);
+	if (skinning)
+		PrintSkinning(lScene);
+	if (blendShapes)
+		PrintBlendShapes(lScene);
+	if (globals)
+		PrintGlobalTransforms(lScene, lBaked);
+	if (media)
+		PrintEmbeddedMedia(lScene, filename, extractMedia);
+	if (textures)
+		PrintTextures(lScene, filename);
+	if (materials)
+		PrintMaterials(lScene);
+	if (weld)
+		PrintWeldStats(lScene);
+	AxisConversion lConversion;
+	if (convert && !PrintAxisConversion(lScene, lBaked, lConversion))
+		lConversion = AxisConversion();
+	if (exportMeshes || bake || lods)
+		ExportMeshes(lScene, filename, exportMeshes, bake, lods, lConversion, media);
+	if (json || cbor) {
+		printf("\n---Dump Informations---\n");
+		if (json)
+			DumpSceneFile(lScene, filename + ".json", false);
+		if (cbor)
+			DumpSceneFile(lScene, filename + ".cbor", true);
 	}
-	PrintAnimation(lScene, detail);
+	if (inflateAll)
+		PrintInflateStats(lInflateStats);
 
-	lSdkManager->Destroy();
 	return 0;
 }
\ No newline at end of file